@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+// View-projection for world shapes, pixels to clip space for the HUD
+uniform mat4 transform;
+
+out vec4 Color;
+
+void main() {
+    Color = aColor;
+    gl_Position = transform * vec4(aPos, 1.0);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform vec4 edgeColor = vec4(0.0, 1.0, 0.0, 1.0);
+
+void main()
+{
+    FragColor = edgeColor;
+}
@@ -0,0 +1,43 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+layout (location = 5) in uint aInstance;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float depthBias = 0.0005;
+
+// Instance records from IndirectRenderer, laid out as in vertex.glsl
+uniform samplerBuffer instances;
+uniform isamplerBuffer instanceIndices;
+
+// Joint palettes for the whole frame, four texels per matrix
+uniform samplerBuffer jointMatrices;
+
+mat4 jointMatrix(int jointOffset, uint slot) {
+    int base = (jointOffset + int(slot)) * 4;
+    return mat4(texelFetch(jointMatrices, base), texelFetch(jointMatrices, base + 1),
+                texelFetch(jointMatrices, base + 2), texelFetch(jointMatrices, base + 3));
+}
+
+// jointOffset is negative for models drawn without a palette
+mat4 skinMatrix(int jointOffset) {
+    if (jointOffset < 0) {
+        return mat4(1.0);
+    }
+    return jointMatrix(jointOffset, aJoints.x) * aWeights.x + jointMatrix(jointOffset, aJoints.y) * aWeights.y +
+           jointMatrix(jointOffset, aJoints.z) * aWeights.z + jointMatrix(jointOffset, aJoints.w) * aWeights.w;
+}
+
+void main()
+{
+    int base = int(aInstance) * 6;
+    mat4 model = mat4(texelFetch(instances, base), texelFetch(instances, base + 1),
+                      texelFetch(instances, base + 2), texelFetch(instances, base + 3));
+    int jointOffset = texelFetch(instanceIndices, base + 5).w;
+
+    gl_Position = projection * view * model * skinMatrix(jointOffset) * vec4(aPos, 1.0);
+    // Pull lines slightly toward the camera so they win against their own faces
+    gl_Position.z -= depthBias * gl_Position.w;
+}
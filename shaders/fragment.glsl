@@ -1,82 +1,159 @@
 #version 330 core
+// Permutations, see ShaderFeature: ALPHA_TEST discards below the material's
+// cutoff, NORMAL_MAP perturbs the normal with the material's normal map
 out vec4 FragColor;
 
 in vec2 TexCoords;
 in vec3 WorldPos;
 in vec3 Normal;
+flat in int MaterialIndex;
 
-// material parameters
-uniform sampler2D albedoMap;
-uniform sampler2D normalMap;
-uniform sampler2D metallicRoughnessMap;
-uniform sampler2D emissiveMap;
-uniform sampler2D occlusionMap;
-uniform sampler2D edgeMap;
-
-// material properties
-uniform vec4 baseColorFactor;
-uniform float metallicFactor;
-uniform float roughnessFactor;
-uniform vec3 emissiveFactor;
+// Material table: base color factor, then metallic, roughness and the layers
+// of the albedo and metallic-roughness images (-1 for none), then the normal
+// map layer and the alpha cutoff
+uniform samplerBuffer materials;
+uniform sampler2DArray albedoMaps;
+uniform sampler2DArray metallicRoughnessMaps;
+#ifdef NORMAL_MAP
+uniform sampler2DArray normalMaps;
+#endif
 
 // environment
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
 uniform vec3 viewPos;
+uniform vec3 sunDirection = vec3(0.4, 0.8, 0.3);
+uniform vec3 sunColor = vec3(0.8);
+uniform vec3 ambientColor = vec3(0.35);
+
+// Clustered point lights: two texels per light (position + radius, color),
+// offset and count per cluster, and the flattened per-cluster light lists
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+uniform vec4 clusterParams;   // Tile width and height in pixels, depth slice scale and bias
+uniform float clusterNear;
+uniform float clusterFar;
 
 const float PI = 3.14159265359;
 
 // PBR functions
-vec3 getNormalFromMap();
 float DistributionGGX(vec3 N, vec3 H, float roughness);
 float GeometrySchlickGGX(float NdotV, float roughness);
 float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness);
 vec3 fresnelSchlick(float cosTheta, vec3 F0);
 
-vec3 detectEdges(sampler2D tex, vec2 uv) {
-    float offset = 1.0 / 512.0;  // Adjust based on texture size
+uvec2 clusterRange() {
+    if (clusterSlices <= 0) {
+        return uvec2(0u);
+    }
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float depth = 2.0 * clusterNear * clusterFar / (clusterFar + clusterNear - ndcDepth * (clusterFar - clusterNear));
+    int slice = clamp(int(log(depth) * clusterParams.z + clusterParams.w), 0, clusterSlices - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterParams.xy), ivec2(0), ivec2(clusterTilesX - 1, clusterTilesY - 1));
+    return texelFetch(lightClusters, (slice * clusterTilesY + tile.y) * clusterTilesX + tile.x).xy;
+}
+
+#ifdef NORMAL_MAP
+// Meshes carry no tangents, so the tangent frame comes from screen-space
+// derivatives of the position and texture coordinates
+vec3 perturbNormal(vec3 N, float layer) {
+    vec3 dp1 = dFdx(WorldPos);
+    vec3 dp2 = dFdy(WorldPos);
+    vec2 duv1 = dFdx(TexCoords);
+    vec2 duv2 = dFdy(TexCoords);
+    vec3 dp2perp = cross(dp2, N);
+    vec3 dp1perp = cross(N, dp1);
+    vec3 T = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 B = dp2perp * duv1.y + dp1perp * duv2.y;
+    float invScale = inversesqrt(max(max(dot(T, T), dot(B, B)), 1e-20));
+    vec3 tangentNormal = texture(normalMaps, vec3(TexCoords, layer)).xyz * 2.0 - 1.0;
+    return normalize(mat3(T * invScale, B * invScale, N) * tangentNormal);
+}
+#endif
+
+vec3 shade(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness) {
+    vec3 H = normalize(V + L);
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+    float NdotL = max(dot(N, L), 0.0);
+    vec3 specular = DistributionGGX(N, H, roughness) * GeometrySmith(N, V, L, roughness) * F /
+                    (4.0 * max(dot(N, V), 0.0) * NdotL + 0.0001);
+    vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+void main() {
+    vec4 baseColorFactor = texelFetch(materials, MaterialIndex * 3);
+    vec4 factors = texelFetch(materials, MaterialIndex * 3 + 1);
+#if defined(ALPHA_TEST) || defined(NORMAL_MAP)
+    vec4 extra = texelFetch(materials, MaterialIndex * 3 + 2);
+#endif
     
-    // Sobel kernels
-    vec2 offsets[9] = vec2[](
-        vec2(-offset,  offset), vec2(0.0,  offset), vec2(offset,  offset),
-        vec2(-offset,     0.0), vec2(0.0,     0.0), vec2(offset,     0.0),
-        vec2(-offset, -offset), vec2(0.0, -offset), vec2(offset, -offset)
-    );
+    // Sample base color
+    vec4 albedo = baseColorFactor;
+    if (factors.z >= 0.0) {
+        albedo *= texture(albedoMaps, vec3(TexCoords, factors.z));
+    }
+#ifdef ALPHA_TEST
+    if (albedo.a < extra.y) {
+        discard;
+    }
+#endif
     
-    float kernelX[9] = float[](
-        -1, 0, 1,
-        -2, 0, 2,
-        -1, 0, 1
-    );
+    // Sample metallic-roughness
+    vec2 metallicRoughness = vec2(1.0);
+    if (factors.w >= 0.0) {
+        metallicRoughness = texture(metallicRoughnessMaps, vec3(TexCoords, factors.w)).bg;
+    }
+    float metallic = metallicRoughness.x * factors.x;
+    float roughness = clamp(metallicRoughness.y * factors.y, 0.05, 1.0);
     
-    float kernelY[9] = float[](
-        -1, -2, -1,
-         0,  0,  0,
-         1,  2,  1
-    );
+    vec3 N = normalize(Normal);
+#ifdef NORMAL_MAP
+    N = perturbNormal(N, extra.x);
+#endif
+    vec3 V = normalize(viewPos - WorldPos);
     
-    float edgeX = 0.0;
-    float edgeY = 0.0;
+    // Sun radiance is scaled by PI so a white Lambert surface facing it matches sunColor
+    vec3 color = shade(N, V, normalize(sunDirection), sunColor * PI, albedo.rgb, metallic, roughness);
     
-    for(int i = 0; i < 9; i++) {
-        float sample = texture(tex, uv + offsets[i]).r;
-        edgeX += sample * kernelX[i];
-        edgeY += sample * kernelY[i];
+    uvec2 range = clusterRange();
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r) * 2;
+        vec4 positionRadius = texelFetch(lightData, light);
+        vec3 toLight = positionRadius.xyz - WorldPos;
+        float distance = length(toLight);
+        // Windowed inverse square: reaches exactly zero at the light radius
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        vec3 radiance = texelFetch(lightData, light + 1).rgb * attenuation;
+        color += shade(N, V, toLight / max(distance, 0.0001), radiance, albedo.rgb, metallic, roughness);
     }
     
-    float edge = sqrt(edgeX * edgeX + edgeY * edgeY);
-    return vec3(edge);
+    color += ambientColor * albedo.rgb;
+    FragColor = vec4(color, albedo.a);
 }
 
-void main() {
-    // Sample base color
-    vec4 albedo = texture(albedoMap, TexCoords) * baseColorFactor;
-    
-    // Sample metallic-roughness
-    vec2 metallicRoughness = texture(metallicRoughnessMap, TexCoords).bg;
-    float metallic = metallicRoughness.x * metallicFactor;
-    float roughness = metallicRoughness.y * roughnessFactor;
-    
-    // For now, just output the base color to debug
-    FragColor = albedo;
-} 
\ No newline at end of file
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    return a2 / (PI * denom * denom);
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness) {
+    float r = roughness + 1.0;
+    float k = r * r / 8.0;
+    return NdotV / (NdotV * (1.0 - k) + k);
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+    return GeometrySchlickGGX(max(dot(N, V), 0.0), roughness) * GeometrySchlickGGX(max(dot(N, L), 0.0), roughness);
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
@@ -1,28 +1,30 @@
 #version 330 core
+// Permutations, see ShaderFeature: ALPHA_TEST discards below the material's cutoff
 out vec4 FragColor;
 
 in vec2 TexCoords;
 in vec3 WorldPos;
 in vec3 Normal;
 
-// material parameters
-uniform sampler2D albedoMap;
-uniform sampler2D metallicRoughnessMap;
-uniform vec4 baseColorFactor;
-uniform float metallicFactor;
-uniform float roughnessFactor;
+// Material table, same layout as fragment.glsl
+uniform samplerBuffer materials;
+uniform int materialIndex;
+uniform sampler2DArray albedoMaps;
 
 void main() {
-    // Sample base color
-    vec4 color = texture(albedoMap, TexCoords);
-    
-    // Apply material properties
-    color *= baseColorFactor;
+    // Base color factor times the albedo layer, if the material has one
+    vec4 color = texelFetch(materials, materialIndex * 3);
+    float albedoLayer = texelFetch(materials, materialIndex * 3 + 1).z;
+    if (albedoLayer >= 0.0) {
+        color *= texture(albedoMaps, vec3(TexCoords, albedoLayer));
+    }
     
-    // Ensure alpha is properly handled
-    if (color.a < 0.1) {
+#ifdef ALPHA_TEST
+    // Only masked and blended materials discard, so opaque ones keep early depth testing
+    if (color.a < texelFetch(materials, materialIndex * 3 + 2).y) {
         discard;
     }
+#endif
     
     FragColor = color;
-} 
\ No newline at end of file
+}
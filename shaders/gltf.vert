@@ -1,7 +1,12 @@
 #version 330 core
+// Permutations, see ShaderFeature: SKINNED blends the joint palette
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef SKINNED
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+#endif
 
 out vec2 TexCoords;
 out vec3 WorldPos;
@@ -11,11 +16,33 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+#ifdef SKINNED
+// Joint palettes for the whole frame, four texels per matrix
+uniform samplerBuffer jointMatrices;
+uniform int jointOffset;
+
+mat4 jointMatrix(uint slot) {
+    int base = (jointOffset + int(slot)) * 4;
+    return mat4(texelFetch(jointMatrices, base), texelFetch(jointMatrices, base + 1),
+                texelFetch(jointMatrices, base + 2), texelFetch(jointMatrices, base + 3));
+}
+
+mat4 skinMatrix() {
+    return jointMatrix(aJoints.x) * aWeights.x + jointMatrix(aJoints.y) * aWeights.y +
+           jointMatrix(aJoints.z) * aWeights.z + jointMatrix(aJoints.w) * aWeights.w;
+}
+#endif
+
 void main() {
+#ifdef SKINNED
+    mat4 skinnedModel = model * skinMatrix();
+#else
+    mat4 skinnedModel = model;
+#endif
     TexCoords = aTexCoords;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
-    Normal = normalize(mat3(model) * aNormal);
+    WorldPos = vec3(skinnedModel * vec4(aPos, 1.0));
+    Normal = normalize(mat3(skinnedModel) * aNormal);
     
     vec4 pos = projection * view * vec4(WorldPos, 1.0);
     gl_Position = pos;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 Corner;
+in vec4 Color;
+
+void main()
+{
+    // Soft round sprite without a texture
+    float falloff = 1.0 - smoothstep(0.4, 1.0, length(Corner));
+    if (falloff <= 0.0)
+        discard;
+    FragColor = vec4(Color.rgb, Color.a * falloff);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec4 aPositionSize;  // Per instance: world position, size
+layout (location = 1) in vec4 aColor;         // Per instance: RGBA8
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 Corner;
+out vec4 Color;
+
+void main()
+{
+    // Camera-facing quad from the vertex index; drawn as a 4-vertex strip
+    Corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+    Color = aColor;
+
+    vec4 viewPos = view * vec4(aPositionSize.xyz, 1.0);
+    viewPos.xy += Corner * aPositionSize.w;
+    gl_Position = projection * viewPos;
+}
@@ -0,0 +1,15 @@
+#version 330 core
+out vec3 Direction;
+
+// Inverse of projection times the view's rotation
+uniform mat4 inverseViewProjection;
+
+void main()
+{
+    // Full-screen triangle from gl_VertexID on the far plane, so it only fills
+    // pixels the scene left at the cleared depth
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(pos, 1.0, 1.0);
+    Direction = world.xyz / world.w;
+    gl_Position = vec4(pos, 1.0, 1.0);
+}
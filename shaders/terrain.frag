@@ -0,0 +1,73 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 WorldPos;
+in vec2 TerrainUV;
+
+uniform sampler2D heightMap;
+uniform vec4 heightmapTransform;
+uniform float sampleSpacing;
+uniform vec3 cameraPos;
+uniform vec3 sunDirection = vec3(0.4, 0.8, 0.3);
+uniform vec3 sunColor = vec3(0.8);
+uniform vec3 ambientColor = vec3(0.35);
+
+// Clustered point lights, same layout as fragment.glsl
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+uniform vec4 clusterParams;
+uniform float clusterNear;
+uniform float clusterFar;
+
+vec3 pointLights(vec3 normal)
+{
+    if (clusterSlices <= 0) {
+        return vec3(0.0);
+    }
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float depth = 2.0 * clusterNear * clusterFar / (clusterFar + clusterNear - ndcDepth * (clusterFar - clusterNear));
+    int slice = clamp(int(log(depth) * clusterParams.z + clusterParams.w), 0, clusterSlices - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterParams.xy), ivec2(0), ivec2(clusterTilesX - 1, clusterTilesY - 1));
+    uvec2 range = texelFetch(lightClusters, (slice * clusterTilesY + tile.y) * clusterTilesX + tile.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r) * 2;
+        vec4 positionRadius = texelFetch(lightData, light);
+        vec3 toLight = positionRadius.xyz - WorldPos;
+        float distance = length(toLight);
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance + 1.0);
+        result += texelFetch(lightData, light + 1).rgb * attenuation * max(dot(normal, toLight / max(distance, 0.0001)), 0.0);
+    }
+    return result;
+}
+
+void main()
+{
+    // Per-pixel normal from the heightmap keeps lighting stable while vertices morph
+    float texel = heightmapTransform.z;
+    float left = texture(heightMap, TerrainUV - vec2(texel, 0.0)).r;
+    float right = texture(heightMap, TerrainUV + vec2(texel, 0.0)).r;
+    float down = texture(heightMap, TerrainUV - vec2(0.0, texel)).r;
+    float up = texture(heightMap, TerrainUV + vec2(0.0, texel)).r;
+    vec3 normal = normalize(vec3(left - right, 2.0 * sampleSpacing, down - up));
+
+    vec3 grass = vec3(0.28, 0.36, 0.18);
+    vec3 rock = vec3(0.42, 0.39, 0.35);
+    vec3 snow = vec3(0.9, 0.92, 0.95);
+    float slope = 1.0 - normal.y;
+    vec3 albedo = mix(grass, rock, smoothstep(0.15, 0.35, slope));
+    albedo = mix(albedo, snow, smoothstep(380.0, 450.0, WorldPos.y) * (1.0 - smoothstep(0.3, 0.5, slope)));
+
+    float diffuse = max(dot(normal, normalize(sunDirection)), 0.0);
+    vec3 color = albedo * (ambientColor + sunColor * diffuse + pointLights(normal));
+
+    // Distance haze hides the far clip plane
+    float haze = 1.0 - exp(-distance(cameraPos, WorldPos) * 0.00025);
+    FragColor = vec4(mix(color, vec3(0.6, 0.68, 0.75), haze), 1.0);
+}
@@ -0,0 +1,42 @@
+#version 330 core
+layout (location = 0) in vec2 aGridPos;   // [0,1] within the node
+layout (location = 1) in vec4 aNode;      // xz offset, size, LOD level
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPos;
+uniform sampler2D heightMap;
+uniform float terrainSize;
+uniform float gridResolution;
+uniform vec4 heightmapTransform;          // scale, bias, texel size
+uniform vec2 morphRanges[16];             // start, 1 / (end - start)
+
+out vec3 WorldPos;
+out vec2 TerrainUV;
+
+vec2 terrainUV(vec2 xz)
+{
+    vec2 t = xz / terrainSize + 0.5;
+    return t * heightmapTransform.x + heightmapTransform.y;
+}
+
+float sampleHeight(vec2 xz)
+{
+    return textureLod(heightMap, terrainUV(xz), 0.0).r;
+}
+
+void main()
+{
+    vec2 xz = aNode.xy + aGridPos * aNode.z;
+    float distanceToCamera = distance(cameraPos, vec3(xz.x, sampleHeight(xz), xz.y));
+
+    // Slide odd vertices onto the next coarser grid as the node nears the end of its range
+    vec2 range = morphRanges[int(aNode.w)];
+    float morph = clamp((distanceToCamera - range.x) * range.y, 0.0, 1.0);
+    vec2 oddOffset = fract(aGridPos * gridResolution * 0.5) * 2.0 / gridResolution;
+    xz = aNode.xy + (aGridPos - oddOffset * morph) * aNode.z;
+
+    WorldPos = vec3(xz.x, sampleHeight(xz), xz.y);
+    TerrainUV = terrainUV(xz);
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D sceneColor;
+uniform vec4 sourceRect;    // xy = used fraction of the target, zw = texel size
+uniform float sharpness;
+
+void main()
+{
+    // Keep bilinear taps inside the rendered sub-rectangle
+    vec2 maxUV = sourceRect.xy - sourceRect.zw * 0.5;
+    vec2 uv = min(TexCoords * sourceRect.xy, maxUV);
+    vec2 texel = sourceRect.zw;
+
+    vec3 center = texture(sceneColor, uv).rgb;
+    vec3 north = texture(sceneColor, min(uv + vec2(0.0, texel.y), maxUV)).rgb;
+    vec3 south = texture(sceneColor, uv - vec2(0.0, texel.y)).rgb;
+    vec3 east = texture(sceneColor, min(uv + vec2(texel.x, 0.0), maxUV)).rgb;
+    vec3 west = texture(sceneColor, uv - vec2(texel.x, 0.0)).rgb;
+
+    // Unsharp mask to recover detail lost to the upscale
+    vec3 sharpened = center + sharpness * (4.0 * center - north - south - east - west);
+    FragColor = vec4(clamp(sharpened, 0.0, 1.0), 1.0);
+}
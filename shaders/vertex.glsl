@@ -1,19 +1,78 @@
 #version 330 core
+// Permutations, see ShaderFeature: INSTANCED takes the model matrix, material and
+// joint offset from IndirectRenderer's instance records instead of uniforms,
+// SKINNED blends the joint palette, UNIFORM_SCALE skips the inverse transpose
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef SKINNED
+layout (location = 3) in uvec4 aJoints;
+layout (location = 4) in vec4 aWeights;
+#endif
+#ifdef INSTANCED
+layout (location = 5) in uint aInstance;
+#endif
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+#ifdef INSTANCED
+// Instance records, six texels each: the model matrix, then the bounds
+// with the material index and joint offset in their w
+uniform samplerBuffer instances;
+uniform isamplerBuffer instanceIndices;
+#else
+uniform mat4 model;
+uniform int materialIndex;
+uniform int jointOffset;
+#endif
+
+#ifdef SKINNED
+// Joint palettes for the whole frame, four texels per matrix
+uniform samplerBuffer jointMatrices;
+
+mat4 jointMatrix(int jointOffset, uint slot) {
+    int base = (jointOffset + int(slot)) * 4;
+    return mat4(texelFetch(jointMatrices, base), texelFetch(jointMatrices, base + 1),
+                texelFetch(jointMatrices, base + 2), texelFetch(jointMatrices, base + 3));
+}
+
+mat4 skinMatrix(int jointOffset) {
+    return jointMatrix(jointOffset, aJoints.x) * aWeights.x + jointMatrix(jointOffset, aJoints.y) * aWeights.y +
+           jointMatrix(jointOffset, aJoints.z) * aWeights.z + jointMatrix(jointOffset, aJoints.w) * aWeights.w;
+}
+#endif
+
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
+flat out int MaterialIndex;
 
 void main() {
+#ifdef INSTANCED
+    int base = int(aInstance) * 6;
+    mat4 model = mat4(texelFetch(instances, base), texelFetch(instances, base + 1),
+                      texelFetch(instances, base + 2), texelFetch(instances, base + 3));
+    MaterialIndex = texelFetch(instanceIndices, base + 4).w;
+#ifdef SKINNED
+    int jointOffset = texelFetch(instanceIndices, base + 5).w;
+#endif
+#else
+    MaterialIndex = materialIndex;
+#endif
+
+#ifdef SKINNED
+    mat4 skinnedModel = model * skinMatrix(jointOffset);
+#else
+    mat4 skinnedModel = model;
+#endif
     TexCoords = aTexCoords;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;   
+    WorldPos = vec3(skinnedModel * vec4(aPos, 1.0));
+#ifdef UNIFORM_SCALE
+    // Rotation and one scale factor: the fragment shader's normalize() removes the scale
+    Normal = mat3(skinnedModel) * aNormal;
+#else
+    Normal = mat3(transpose(inverse(skinnedModel))) * aNormal;
+#endif
     gl_Position = projection * view * vec4(WorldPos, 1.0);
-} 
\ No newline at end of file
+}
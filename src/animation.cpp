@@ -0,0 +1,368 @@
+#include "animation.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace simd;
+
+namespace {
+
+size_t paddedCount(size_t count) {
+    return (count + 3) & ~size_t(3);
+}
+
+// out = a * b with each column built from four broadcasts
+void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+    const float* pa = &a[0][0];
+    const float* pb = &b[0][0];
+    Float4 a0 = Load(pa), a1 = Load(pa + 4), a2 = Load(pa + 8), a3 = Load(pa + 12);
+    float result[16];
+    for (int c = 0; c < 4; c++) {
+        Float4 column = a0 * Splat(pb[c * 4]) + a1 * Splat(pb[c * 4 + 1]) +
+                        a2 * Splat(pb[c * 4 + 2]) + a3 * Splat(pb[c * 4 + 3]);
+        Store(result + c * 4, column);
+    }
+    for (int c = 0; c < 4; c++) {
+        out[c] = glm::vec4(result[c * 4], result[c * 4 + 1], result[c * 4 + 2], result[c * 4 + 3]);
+    }
+}
+
+glm::vec4 normalizeQuat(const glm::vec4& q) {
+    float length = std::sqrt(glm::dot(q, q));
+    return length > 0.0f ? q / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+glm::vec4 hermite(const glm::vec4& p0, const glm::vec4& m0, const glm::vec4& p1, const glm::vec4& m1, float t) {
+    float t2 = t * t, t3 = t2 * t;
+    return p0 * (2.0f * t3 - 3.0f * t2 + 1.0f) + m0 * (t3 - 2.0f * t2 + t) +
+           p1 * (-2.0f * t3 + 3.0f * t2) + m1 * (t3 - t2);
+}
+
+} // namespace
+
+int Skeleton::FindNode(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+std::vector<glm::mat4> Skeleton::ComputeRestTransforms() const {
+    std::vector<glm::mat4> transforms(parents.size());
+    for (size_t i = 0; i < parents.size(); i++) {
+        glm::mat4 local = ComposeTransform(restTranslation[i], restRotation[i], restScale[i]);
+        transforms[i] = (parents[i] < 0 ? rootInverse : transforms[parents[i]]) * local;
+    }
+    return transforms;
+}
+
+glm::mat4 ComposeTransform(const glm::vec3& t, const glm::vec4& q, const glm::vec3& s) {
+    float x = q.x, y = q.y, z = q.z, w = q.w;
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * s.x, 2.0f * (x * y + w * z) * s.x, 2.0f * (x * z - w * y) * s.x, 0.0f);
+    m[1] = glm::vec4(2.0f * (x * y - w * z) * s.y, (1.0f - 2.0f * (x * x + z * z)) * s.y, 2.0f * (y * z + w * x) * s.y, 0.0f);
+    m[2] = glm::vec4(2.0f * (x * z + w * y) * s.z, 2.0f * (y * z - w * x) * s.z, (1.0f - 2.0f * (x * x + y * y)) * s.z, 0.0f);
+    m[3] = glm::vec4(t, 1.0f);
+    return m;
+}
+
+void DecomposeTransform(const glm::mat4& matrix, glm::vec3& translation, glm::vec4& rotation, glm::vec3& scale) {
+    translation = glm::vec3(matrix[3]);
+    scale = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+
+    glm::mat3 r;
+    for (int i = 0; i < 3; i++) {
+        r[i] = scale[i] > 0.0f ? glm::vec3(matrix[i]) / scale[i] : glm::vec3(0.0f);
+    }
+    // Largest-component extraction keeps the division well conditioned
+    float trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0.0f) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        rotation = glm::vec4((r[1][2] - r[2][1]) / s, (r[2][0] - r[0][2]) / s, (r[0][1] - r[1][0]) / s, 0.25f * s);
+    } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        float s = std::sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        rotation = glm::vec4(0.25f * s, (r[1][0] + r[0][1]) / s, (r[2][0] + r[0][2]) / s, (r[1][2] - r[2][1]) / s);
+    } else if (r[1][1] > r[2][2]) {
+        float s = std::sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        rotation = glm::vec4((r[1][0] + r[0][1]) / s, 0.25f * s, (r[2][1] + r[1][2]) / s, (r[2][0] - r[0][2]) / s);
+    } else {
+        float s = std::sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        rotation = glm::vec4((r[2][0] + r[0][2]) / s, (r[2][1] + r[1][2]) / s, 0.25f * s, (r[0][1] - r[1][0]) / s);
+    }
+    rotation = normalizeQuat(rotation);
+}
+
+Animator::Animator(const Skeleton& skeleton, const std::vector<AnimationClip>& clips)
+    : skeleton(skeleton), clips(clips) {
+    size_t nodeCount = skeleton.GetNodeCount();
+    initPose(restPose);
+    for (size_t i = 0; i < nodeCount; i++) {
+        restPose.values[Pose::TX][i] = skeleton.restTranslation[i].x;
+        restPose.values[Pose::TY][i] = skeleton.restTranslation[i].y;
+        restPose.values[Pose::TZ][i] = skeleton.restTranslation[i].z;
+        restPose.values[Pose::RX][i] = skeleton.restRotation[i].x;
+        restPose.values[Pose::RY][i] = skeleton.restRotation[i].y;
+        restPose.values[Pose::RZ][i] = skeleton.restRotation[i].z;
+        restPose.values[Pose::RW][i] = skeleton.restRotation[i].w;
+        restPose.values[Pose::SX][i] = skeleton.restScale[i].x;
+        restPose.values[Pose::SY][i] = skeleton.restScale[i].y;
+        restPose.values[Pose::SZ][i] = skeleton.restScale[i].z;
+    }
+    pose = restPose;
+    fadePose = restPose;
+
+    overridden.assign(nodeCount, 0);
+    overrideRotation.assign(nodeCount, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    locals.resize(nodeCount);
+    world.resize(nodeCount);
+    palette.resize(skeleton.slotNodes.size());
+    buildMatrices();
+}
+
+void Animator::initPose(Pose& target) const {
+    // Padding lanes hold an identity transform so SIMD math never sees garbage
+    size_t padded = paddedCount(skeleton.GetNodeCount());
+    for (int c = 0; c < Pose::Count; c++) {
+        bool one = c == Pose::RW || c == Pose::SX || c == Pose::SY || c == Pose::SZ;
+        target.values[c].assign(padded, one ? 1.0f : 0.0f);
+    }
+}
+
+bool Animator::Play(const std::string& clipName, bool loop, float blendSeconds) {
+    for (size_t i = 0; i < clips.size(); i++) {
+        if (clips[i].name == clipName) {
+            return Play(static_cast<int>(i), loop, blendSeconds);
+        }
+    }
+    return false;
+}
+
+bool Animator::Play(int clipIndex, bool loop, float blendSeconds) {
+    if (clipIndex < 0 || clipIndex >= static_cast<int>(clips.size())) {
+        return false;
+    }
+
+    if (current.clip >= 0 && blendSeconds > 0.0f) {
+        std::swap(previous, current);
+        blendTime = 0.0f;
+        blendDuration = blendSeconds;
+    } else {
+        previous.clip = -1;
+    }
+
+    current.clip = clipIndex;
+    current.time = 0.0f;
+    current.loop = loop;
+    current.cursors.assign(clips[clipIndex].channels.size(), 0);
+    return true;
+}
+
+void Animator::Stop() {
+    current.clip = -1;
+    previous.clip = -1;
+}
+
+void Animator::SetNodeRotation(int node, const glm::vec4& rotation) {
+    if (node >= 0 && node < static_cast<int>(overridden.size())) {
+        overridden[node] = 1;
+        overrideRotation[node] = normalizeQuat(rotation);
+    }
+}
+
+void Animator::ClearNodeRotation(int node) {
+    if (node >= 0 && node < static_cast<int>(overridden.size())) {
+        overridden[node] = 0;
+    }
+}
+
+void Animator::Advance(float deltaTime) {
+    pose = restPose;
+    if (current.clip >= 0) {
+        advanceLayer(current, deltaTime);
+        sampleLayer(current, pose);
+
+        if (previous.clip >= 0) {
+            blendTime += deltaTime;
+            if (blendTime >= blendDuration) {
+                previous.clip = -1;
+            } else {
+                advanceLayer(previous, deltaTime);
+                fadePose = restPose;
+                sampleLayer(previous, fadePose);
+                blendPoses(pose, fadePose, blendTime / blendDuration);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < overridden.size(); i++) {
+        if (overridden[i]) {
+            pose.values[Pose::RX][i] = overrideRotation[i].x;
+            pose.values[Pose::RY][i] = overrideRotation[i].y;
+            pose.values[Pose::RZ][i] = overrideRotation[i].z;
+            pose.values[Pose::RW][i] = overrideRotation[i].w;
+        }
+    }
+
+    buildMatrices();
+}
+
+void Animator::advanceLayer(Layer& layer, float deltaTime) const {
+    float duration = clips[layer.clip].duration;
+    layer.time += deltaTime * speed;
+    if (layer.loop && duration > 0.0f) {
+        layer.time = std::fmod(layer.time, duration);
+        if (layer.time < 0.0f) {
+            layer.time += duration;
+        }
+    } else {
+        layer.time = std::min(std::max(layer.time, 0.0f), duration);
+    }
+}
+
+void Animator::sampleLayer(Layer& layer, Pose& target) const {
+    const AnimationClip& clip = clips[layer.clip];
+    float time = layer.time;
+
+    for (size_t c = 0; c < clip.channels.size(); c++) {
+        const AnimationChannel& channel = clip.channels[c];
+        size_t keys = channel.times.size();
+        if (keys == 0) {
+            continue;
+        }
+
+        // Time only moves forward between loops, so the cursor rarely steps more than once
+        uint32_t& cursor = layer.cursors[c];
+        if (time < channel.times[cursor]) {
+            cursor = 0;
+        }
+        while (cursor + 1 < keys && channel.times[cursor + 1] <= time) {
+            cursor++;
+        }
+
+        bool cubic = channel.interpolation == AnimationInterpolation::CubicSpline;
+        size_t stride = cubic ? 3 : 1;
+        size_t offset = cubic ? 1 : 0;
+        glm::vec4 value;
+        if (cursor + 1 >= keys || time <= channel.times[cursor] ||
+            channel.interpolation == AnimationInterpolation::Step) {
+            value = channel.values[cursor * stride + offset];
+        } else {
+            float t0 = channel.times[cursor], t1 = channel.times[cursor + 1];
+            float span = t1 - t0;
+            float t = (time - t0) / span;
+            if (cubic) {
+                value = hermite(channel.values[cursor * 3 + 1], channel.values[cursor * 3 + 2] * span,
+                                channel.values[cursor * 3 + 4], channel.values[cursor * 3 + 3] * span, t);
+            } else {
+                glm::vec4 a = channel.values[cursor];
+                glm::vec4 b = channel.values[cursor + 1];
+                if (channel.path == AnimationPath::Rotation && glm::dot(a, b) < 0.0f) {
+                    b = -b;
+                }
+                value = a + (b - a) * t;
+            }
+        }
+
+        uint32_t node = channel.node;
+        switch (channel.path) {
+            case AnimationPath::Translation:
+                target.values[Pose::TX][node] = value.x;
+                target.values[Pose::TY][node] = value.y;
+                target.values[Pose::TZ][node] = value.z;
+                break;
+            case AnimationPath::Rotation:
+                value = normalizeQuat(value);
+                target.values[Pose::RX][node] = value.x;
+                target.values[Pose::RY][node] = value.y;
+                target.values[Pose::RZ][node] = value.z;
+                target.values[Pose::RW][node] = value.w;
+                break;
+            case AnimationPath::Scale:
+                target.values[Pose::SX][node] = value.x;
+                target.values[Pose::SY][node] = value.y;
+                target.values[Pose::SZ][node] = value.z;
+                break;
+        }
+    }
+}
+
+void Animator::blendPoses(Pose& target, const Pose& from, float weight) const {
+    Float4 toWeight = Splat(weight), fromWeight = Splat(1.0f - weight);
+    Float4 zero = Splat(0.0f);
+    size_t padded = target.values[0].size();
+
+    for (size_t i = 0; i < padded; i += 4) {
+        for (int c : { Pose::TX, Pose::TY, Pose::TZ, Pose::SX, Pose::SY, Pose::SZ }) {
+            Float4 blended = Load(&from.values[c][i]) * fromWeight + Load(&target.values[c][i]) * toWeight;
+            Store(&target.values[c][i], blended);
+        }
+
+        // Normalized lerp along the shorter arc
+        Float4 ax = Load(&from.values[Pose::RX][i]), ay = Load(&from.values[Pose::RY][i]);
+        Float4 az = Load(&from.values[Pose::RZ][i]), aw = Load(&from.values[Pose::RW][i]);
+        Float4 bx = Load(&target.values[Pose::RX][i]), by = Load(&target.values[Pose::RY][i]);
+        Float4 bz = Load(&target.values[Pose::RZ][i]), bw = Load(&target.values[Pose::RW][i]);
+        Float4 dot = ax * bx + ay * by + az * bz + aw * bw;
+        Float4 toSigned = Select(Less(dot, zero), zero - toWeight, toWeight);
+        Float4 x = ax * fromWeight + bx * toSigned;
+        Float4 y = ay * fromWeight + by * toSigned;
+        Float4 z = az * fromWeight + bz * toSigned;
+        Float4 w = aw * fromWeight + bw * toSigned;
+        Float4 inverseLength = Splat(1.0f) / Sqrt(x * x + y * y + z * z + w * w);
+        Store(&target.values[Pose::RX][i], x * inverseLength);
+        Store(&target.values[Pose::RY][i], y * inverseLength);
+        Store(&target.values[Pose::RZ][i], z * inverseLength);
+        Store(&target.values[Pose::RW][i], w * inverseLength);
+    }
+}
+
+void Animator::buildMatrices() {
+    size_t nodeCount = skeleton.GetNodeCount();
+    Float4 one = Splat(1.0f), two = Splat(2.0f);
+
+    // Local TRS matrices, four nodes per iteration
+    for (size_t base = 0; base < nodeCount; base += 4) {
+        Float4 x = Load(&pose.values[Pose::RX][base]), y = Load(&pose.values[Pose::RY][base]);
+        Float4 z = Load(&pose.values[Pose::RZ][base]), w = Load(&pose.values[Pose::RW][base]);
+        Float4 sx = Load(&pose.values[Pose::SX][base]), sy = Load(&pose.values[Pose::SY][base]);
+        Float4 sz = Load(&pose.values[Pose::SZ][base]);
+
+        Float4 xx = x * x, yy = y * y, zz = z * z;
+        Float4 xy = x * y, xz = x * z, yz = y * z;
+        Float4 wx = w * x, wy = w * y, wz = w * z;
+
+        float m[12][4];
+        Store(m[0], (one - two * (yy + zz)) * sx);
+        Store(m[1], two * (xy + wz) * sx);
+        Store(m[2], two * (xz - wy) * sx);
+        Store(m[3], two * (xy - wz) * sy);
+        Store(m[4], (one - two * (xx + zz)) * sy);
+        Store(m[5], two * (yz + wx) * sy);
+        Store(m[6], two * (xz + wy) * sz);
+        Store(m[7], two * (yz - wx) * sz);
+        Store(m[8], (one - two * (xx + yy)) * sz);
+        Store(m[9], Load(&pose.values[Pose::TX][base]));
+        Store(m[10], Load(&pose.values[Pose::TY][base]));
+        Store(m[11], Load(&pose.values[Pose::TZ][base]));
+
+        size_t lanes = std::min<size_t>(4, nodeCount - base);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            glm::mat4& local = locals[base + lane];
+            local[0] = glm::vec4(m[0][lane], m[1][lane], m[2][lane], 0.0f);
+            local[1] = glm::vec4(m[3][lane], m[4][lane], m[5][lane], 0.0f);
+            local[2] = glm::vec4(m[6][lane], m[7][lane], m[8][lane], 0.0f);
+            local[3] = glm::vec4(m[9][lane], m[10][lane], m[11][lane], 1.0f);
+        }
+    }
+
+    // Parents precede children, so one pass resolves the hierarchy
+    for (size_t i = 0; i < nodeCount; i++) {
+        int parent = skeleton.parents[i];
+        multiply(parent < 0 ? skeleton.rootInverse : world[parent], locals[i], world[i]);
+    }
+    for (size_t slot = 0; slot < palette.size(); slot++) {
+        multiply(world[skeleton.slotNodes[slot]], skeleton.slotOffsets[slot], palette[slot]);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// glTF node hierarchy of a model, ordered so parents come before children.
+// Model space is the rest frame of the scene's first root node, so entity
+// transforms authored against the root mesh stay valid.
+struct Skeleton {
+    std::vector<int> parents;               // -1 for root nodes
+    std::vector<std::string> names;
+    std::vector<glm::vec3> restTranslation;
+    std::vector<glm::vec4> restRotation;    // Quaternion x, y, z, w
+    std::vector<glm::vec3> restScale;
+    glm::mat4 rootInverse = glm::mat4(1.0f);
+
+    // Skinning palette: slot i is node slotNodes[i]'s model-space transform times slotOffsets[i]
+    std::vector<uint32_t> slotNodes;
+    std::vector<glm::mat4> slotOffsets;
+
+    size_t GetNodeCount() const { return parents.size(); }
+    int FindNode(const std::string& name) const;
+    // Model-space rest transform of every node
+    std::vector<glm::mat4> ComputeRestTransforms() const;
+};
+
+enum class AnimationPath : uint8_t { Translation, Rotation, Scale };
+enum class AnimationInterpolation : uint8_t { Step, Linear, CubicSpline };
+
+struct AnimationChannel {
+    uint32_t node = 0;
+    AnimationPath path = AnimationPath::Translation;
+    AnimationInterpolation interpolation = AnimationInterpolation::Linear;
+    std::vector<float> times;
+    std::vector<glm::vec4> values;   // Cubic splines store in-tangent, value, out-tangent per key
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f;
+    std::vector<AnimationChannel> channels;
+};
+
+glm::mat4 ComposeTransform(const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale);
+// Inverse of ComposeTransform for matrices without shear
+void DecomposeTransform(const glm::mat4& matrix, glm::vec3& translation, glm::vec4& rotation, glm::vec3& scale);
+
+// Plays clips on one instance of a skeleton and produces its skinning
+// palette. Each channel keeps a cursor to its last keyframe, so advancing a
+// clip costs O(1) per channel. Poses are stored structure-of-arrays and
+// blended and converted to matrices four nodes at a time with SIMD.
+class Animator {
+public:
+    Animator(const Skeleton& skeleton, const std::vector<AnimationClip>& clips);
+
+    // Cross-fades from the current clip; false if the model has no such clip
+    bool Play(const std::string& clipName, bool loop = true, float blendSeconds = 0.2f);
+    bool Play(int clipIndex, bool loop = true, float blendSeconds = 0.2f);
+    void Stop();
+    void SetSpeed(float newSpeed) { speed = newSpeed; }
+
+    // Procedural rotation replacing the sampled one, e.g. turret aim; quaternion x, y, z, w
+    void SetNodeRotation(int node, const glm::vec4& rotation);
+    void ClearNodeRotation(int node);
+
+    // Advances the clips and rebuilds the palette
+    void Advance(float deltaTime);
+    const std::vector<glm::mat4>& GetPalette() const { return palette; }
+
+private:
+    struct Layer {
+        int clip = -1;
+        float time = 0.0f;
+        bool loop = true;
+        std::vector<uint32_t> cursors;   // Last keyframe per channel
+    };
+
+    // Per-node TRS, one array per component, padded to a multiple of four nodes
+    struct Pose {
+        enum { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, Count };
+        std::vector<float> values[Count];
+    };
+
+    const Skeleton& skeleton;
+    const std::vector<AnimationClip>& clips;
+    float speed = 1.0f;
+
+    Layer current, previous;
+    float blendTime = 0.0f, blendDuration = 0.0f;
+
+    Pose restPose, pose, fadePose;
+    std::vector<uint8_t> overridden;
+    std::vector<glm::vec4> overrideRotation;
+    std::vector<glm::mat4> locals, world, palette;
+
+    void initPose(Pose& target) const;
+    void advanceLayer(Layer& layer, float deltaTime) const;
+    void sampleLayer(Layer& layer, Pose& target) const;
+    void blendPoses(Pose& target, const Pose& from, float weight) const;
+    void buildMatrices();
+};
@@ -1,57 +1,254 @@
 #include "background.h"
+#include "entity.h"
+#include "gl_state.h"
+#include "materials.h"
+#include "deletion_queue.h"
+#include "memory_tracker.h"
 #include "../external/glm/glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
 #include <iostream>
+#include <cstring>
 
-Background::Background(const char* path) : 
-    model(path),
-    shader("shaders/gltf.vert", "shaders/gltf.frag")  // Use glTF shader
-{
-    scale = 25.0f;  // Reduce scale to 0.25
-    std::cout << "Background shader program ID: " << shader.ID << std::endl;
-}
-
-void Background::Draw(const Camera &camera) {
-    // Get window dimensions
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    float aspectRatio = static_cast<float>(viewport[2]) / viewport[3];
-    
-    // Create view and projection matrices
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 1000.0f);
-    glm::mat4 view = camera.GetViewMatrix();
-    
-    // Set up shader
-    shader.use();
-    shader.setMat4("projection", projection);
-    shader.setMat4("view", view);
-    shader.setVec3("viewPos", camera.GetPosition());
-    
-    // Create model matrix that follows camera
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, camera.GetPosition());
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    modelMatrix = glm::scale(modelMatrix, glm::vec3(scale));
-    shader.setMat4("model", modelMatrix);
-    
-    // Save current OpenGL state
-    GLboolean depthTest, blend, cullFace;
-    glGetBooleanv(GL_DEPTH_TEST, &depthTest);
-    glGetBooleanv(GL_BLEND, &blend);
-    glGetBooleanv(GL_CULL_FACE, &cullFace);
-    
-    // Set rendering state for background
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);  // Change depth function
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    
-    // Draw the background
-    model.Draw(shader);
-    
-    // Restore previous OpenGL state
-    if (!depthTest) glDisable(GL_DEPTH_TEST);
-    if (!blend) glDisable(GL_BLEND);
-    if (!cullFace) glDisable(GL_CULL_FACE);
-    glDepthFunc(GL_LESS);  // Restore default depth function
-} 
\ No newline at end of file
+namespace {
+
+const char kCacheMagic[4] = { 'S', 'K', 'Y', '1' };
+
+struct CacheHeader {
+    char magic[4];
+    int32_t faceSize;
+    uint64_t sourceHash;
+};
+
+// Cubemap face order, GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards, with the up
+// vectors that match the faces' texture orientation
+const glm::vec3 kFaceDirections[6] = {
+    glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+};
+const glm::vec3 kFaceUps[6] = {
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+};
+
+}
+
+Background::Background(const char* modelPath, const SkyboxSettings& settings)
+    : modelPath(modelPath), cachePath(std::string(modelPath) + ".sky"), settings(settings) {
+    shader = std::make_unique<Shader>("shaders/skybox.vert", "shaders/skybox.frag");
+    glGenVertexArrays(1, &emptyVAO);
+#ifndef USE_GLES2
+    GLState::Get().SetEnabled(GL_TEXTURE_CUBE_MAP_SEAMLESS, true);
+#endif
+
+    sourceHash = hashSource();
+    if (loadCache()) {
+        std::cout << "Skybox loaded from cache: " << cachePath << std::endl;
+        return;
+    }
+    std::cout << "Baking skybox from: " << modelPath << std::endl;
+    model = std::make_unique<Model>(modelPath);
+}
+
+Background::~Background() {
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteTexture(cubemap, modelPath, cubemapBytes);
+    queue.DeleteVertexArray(emptyVAO);
+}
+
+uint64_t Background::hashSource() const {
+    // FNV-1a over the model file and the bake settings
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    std::ifstream file(modelPath, std::ios::binary);
+    std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    mix(contents.data(), contents.size());
+    float parameters[4] = { settings.rotation.x, settings.rotation.y, settings.rotation.z, settings.scale };
+    mix(parameters, sizeof(parameters));
+    return hash;
+}
+
+bool Background::loadCache() {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.good()) {
+        return false;
+    }
+    CacheHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file.good() || std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+        header.faceSize != settings.faceSize || header.sourceHash != sourceHash) {
+        return false;
+    }
+
+    size_t faceBytes = static_cast<size_t>(settings.faceSize) * settings.faceSize * 4;
+    std::vector<unsigned char> faces[6];
+    for (auto& face : faces) {
+        face.resize(faceBytes);
+        file.read(reinterpret_cast<char*>(face.data()), faceBytes);
+    }
+    if (!file.good()) {
+        return false;
+    }
+    createCubemap(faces);
+    return true;
+}
+
+void Background::createCubemap(const std::vector<unsigned char>* faces) {
+    int size = settings.faceSize;
+    glGenTextures(1, &cubemap);
+    GLState::Get().BindTexture(kSkyboxUnit, GL_TEXTURE_CUBE_MAP, cubemap);
+    for (int face = 0; face < 6; face++) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     faces ? faces[face].data() : nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    if (faces) {
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    }
+
+    // Full chain: a third more than the top level
+    cubemapBytes = static_cast<int64_t>(size) * size * 4 * 6 * 4 / 3;
+    MemoryTracker::Get().Add(modelPath, MemoryCategory::Texture, MemoryDomain::GPU, cubemapBytes);
+}
+
+void Background::bake() {
+    GLState& state = GLState::Get();
+    GLuint drawFramebuffer = state.GetFramebuffer(GL_DRAW_FRAMEBUFFER);
+    GLuint readFramebuffer = state.GetFramebuffer(GL_READ_FRAMEBUFFER);
+    int viewport[4];
+    state.GetViewport(viewport);
+    bool blend = state.IsEnabled(GL_BLEND);
+
+    int size = settings.faceSize;
+    createCubemap(nullptr);
+
+    GLuint depth, framebuffer;
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &framebuffer);
+    state.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    state.Viewport(0, 0, size, size);
+    state.SetEnabled(GL_DEPTH_TEST, true);
+    state.DepthFunc(GL_LESS);
+
+    // Placed as the camera-locked entity was, seen from its origin. The far
+    // plane only has to reach the model's farthest corner.
+    Transform transform;
+    transform.rotation = settings.rotation;
+    transform.scale = glm::vec3(settings.scale);
+    glm::mat4 modelMatrix = transform.ToMatrix();
+    float extent = 1.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 point((corner & 1) ? model->GetBoundsMax().x : model->GetBoundsMin().x,
+                        (corner & 2) ? model->GetBoundsMax().y : model->GetBoundsMin().y,
+                        (corner & 4) ? model->GetBoundsMax().z : model->GetBoundsMin().z);
+        extent = std::max(extent, glm::length(glm::vec3(modelMatrix * glm::vec4(point, 1.0f))));
+    }
+    glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, extent * 1e-4f, extent * 1.01f);
+
+    // Static draw; the sources only need alpha testing
+    ShaderVariants variants("shaders/gltf.vert", "shaders/gltf.frag", ShaderFeature::AlphaTest);
+    Shader& bakeShader = variants.Get(model->GetShaderFeatures());
+    MaterialTable::Get().Upload();
+    MaterialTable::Get().Bind(bakeShader);
+    bakeShader.setMat4("model", modelMatrix);
+    bakeShader.setMat4("projection", faceProjection);
+    bakeShader.setVec3("viewPos", glm::vec3(0.0f));
+
+    // Drawn over black, like the mesh over the cleared frame
+    const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const GLfloat farDepth = 1.0f;
+    size_t faceBytes = static_cast<size_t>(size) * size * 4;
+    std::vector<unsigned char> faces[6];
+    bool complete = true;
+    for (int face = 0; face < 6; face++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubemap, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Error: Skybox bake framebuffer is incomplete" << std::endl;
+            complete = false;
+            break;
+        }
+        state.DepthMask(true);
+        glClearBufferfv(GL_COLOR, 0, black);
+        glClearBufferfv(GL_DEPTH, 0, &farDepth);
+        bakeShader.setMat4("view", glm::lookAt(glm::vec3(0.0f), kFaceDirections[face], kFaceUps[face]));
+        model->Draw(bakeShader);
+
+        faces[face].resize(faceBytes);
+        glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, faces[face].data());
+    }
+    state.BindTexture(kSkyboxUnit, GL_TEXTURE_CUBE_MAP, cubemap);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    state.ForgetFramebuffer(framebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depth);
+    state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+    state.BindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+    state.Viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    state.SetEnabled(GL_BLEND, blend);
+
+    if (!complete) {
+        return;
+    }
+    std::ofstream file(cachePath, std::ios::binary);
+    CacheHeader header;
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.faceSize = size;
+    header.sourceHash = sourceHash;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& face : faces) {
+        file.write(reinterpret_cast<const char*>(face.data()), face.size());
+    }
+    if (!file.good()) {
+        std::cout << "Failed to write skybox cache: " << cachePath << std::endl;
+    }
+
+    // The cubemap is all that is drawn from now on
+    model.reset();
+}
+
+void Background::Draw(const glm::mat4& view, const glm::mat4& projection) {
+    if (!cubemap) {
+        if (!model) {
+            return;
+        }
+        // The model wraps around the four side faces; wait for the detail they resolve
+        float projectedPixels = static_cast<float>(settings.faceSize) * 4.0f;
+        model->RequestTextureDetail(projectedPixels);
+        if (!model->HasTextureDetail(projectedPixels) && waitedFrames++ < settings.maxDetailWaitFrames) {
+            return;
+        }
+        bake();
+    }
+
+    // Rotation only: the environment is infinitely far away
+    GLState& state = GLState::Get();
+    shader->use();
+    shader->setMat4("inverseViewProjection", glm::inverse(projection * glm::mat4(glm::mat3(view))));
+    shader->setInt("skybox", kSkyboxUnit);
+    state.BindTexture(kSkyboxUnit, GL_TEXTURE_CUBE_MAP, cubemap);
+    state.BindVertexArray(emptyVAO);
+
+    // At the far plane, so only pixels nothing else covered pass
+    state.DepthFunc(GL_LEQUAL);
+    state.DepthMask(false);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    state.DepthMask(true);
+    state.DepthFunc(GL_LESS);
+}
@@ -1,15 +1,63 @@
 #pragma once
 #include "model.h"
-#include "camera.h"
-#include "../external/glew/include/GL/glew.h"
+#include "shader.h"
+#include "../external/glm/glm/glm.hpp"
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
 
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+struct SkyboxSettings {
+    int faceSize = 1024;                      // Pixels per cubemap face side
+    glm::vec3 rotation = glm::vec3(0.0f);     // Degrees, applied like Transform::rotation
+    float scale = 1.0f;
+    int maxDetailWaitFrames = 120;            // Bake with whatever mips are resident after this many frames
+};
+
+// A camera-locked backdrop model baked into a cubemap, since it is really an
+// infinitely distant environment. The bake renders the model once from the
+// origin into the six faces and caches them next to the asset, so later runs
+// never load the model at all. At runtime the cubemap is one full-screen
+// triangle at the far plane drawn after the opaque passes: with GL_LEQUAL,
+// early depth testing rejects every pixel the scene already covered.
 class Background {
 public:
-    Background(const char* path);
-    void Draw(const Camera &camera);
+    // Loads the cache when it matches the model file and settings; otherwise
+    // loads the model and bakes once its textures have streamed in
+    Background(const char* modelPath, const SkyboxSettings& settings = SkyboxSettings());
+    ~Background();
+    Background(const Background&) = delete;
+    Background& operator=(const Background&) = delete;
+
+    bool IsBaked() const { return cubemap != 0; }
+
+    // GL thread, after the opaque passes and into the scene's framebuffer.
+    // Draws nothing until the bake has run.
+    void Draw(const glm::mat4& view, const glm::mat4& projection);
 
 private:
-    Model model;
-    float scale = 1.0f;
-    Shader shader;
-}; 
\ No newline at end of file
+    static const int kSkyboxUnit = 0;
+
+    std::string modelPath;
+    std::string cachePath;
+    SkyboxSettings settings;
+    uint64_t sourceHash = 0;
+    std::unique_ptr<Model> model;   // Only until the bake
+    int waitedFrames = 0;
+
+    GLuint cubemap = 0;
+    int64_t cubemapBytes = 0;
+    GLuint emptyVAO = 0;
+    std::unique_ptr<Shader> shader;
+
+    uint64_t hashSource() const;
+    bool loadCache();
+    void bake();
+    void createCubemap(const std::vector<unsigned char>* faces);
+};
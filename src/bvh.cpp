@@ -0,0 +1,448 @@
+#include "bvh.h"
+#include "job_system.h"
+#include "simd.h"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <utility>
+
+using namespace simd;
+
+namespace {
+
+const int kBins = 16;
+const uint32_t kMaxLeafTriangles = 16;   // Larger leaves are split even when SAH disagrees
+const uint32_t kMaxDepth = 48;           // Keeps the traversal stack bounded
+const float kTraversalCost = 1.0f;
+const float kIntersectionCost = 1.0f;
+const char kCacheMagic[8] = { 'C', 'Z', 'B', 'V', 'H', 0, 0, 1 };
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void Grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void Grow(const Bounds& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+    float Area() const {
+        glm::vec3 e = max - min;
+        if (e.x < 0.0f) {
+            return 0.0f;
+        }
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+};
+
+struct CacheHeader {
+    char magic[8];
+    uint64_t sourceHash;
+    uint32_t nodeCount;
+    uint32_t triangleCount;
+};
+
+} // namespace
+
+uint64_t TriangleBVH::HashGeometry(const std::vector<float>& vertices, size_t stride, const std::vector<unsigned int>& indices) {
+    // FNV-1a over positions and indices
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+        mix(&vertices[i], 3 * sizeof(float));
+    }
+    mix(indices.data(), indices.size() * sizeof(unsigned int));
+    uint64_t sizes[2] = { vertices.size() / stride, indices.size() };
+    mix(sizes, sizeof(sizes));
+    return hash;
+}
+
+void TriangleBVH::Build(const std::vector<float>& vertices, size_t stride, const std::vector<unsigned int>& indices) {
+    nodes.clear();
+    triangleData.clear();
+    triangleIds.clear();
+    sourceToLeaf.clear();
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    auto position = [&](unsigned int index) {
+        return glm::vec3(vertices[index * stride], vertices[index * stride + 1], vertices[index * stride + 2]);
+    };
+
+    std::vector<Bounds> triangleBounds(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        glm::vec3 a = position(indices[t * 3]);
+        glm::vec3 b = position(indices[t * 3 + 1]);
+        glm::vec3 c = position(indices[t * 3 + 2]);
+        triangleBounds[t].Grow(a);
+        triangleBounds[t].Grow(b);
+        triangleBounds[t].Grow(c);
+        centroids[t] = (a + b + c) / 3.0f;
+    }
+
+    std::vector<uint32_t> order(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        order[t] = static_cast<uint32_t>(t);
+    }
+
+    nodes.reserve(triangleCount * 2);
+    nodes.push_back(Node());
+    nodes[0].leftOrFirst = 0;
+    nodes[0].count = static_cast<uint32_t>(triangleCount);
+
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };  // Node, depth
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back().first;
+        uint32_t depth = stack.back().second;
+        stack.pop_back();
+        uint32_t first = nodes[nodeIndex].leftOrFirst;
+        uint32_t count = nodes[nodeIndex].count;
+
+        Bounds bounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.Grow(triangleBounds[order[i]]);
+            centroidBounds.Grow(centroids[order[i]]);
+        }
+        for (int k = 0; k < 3; k++) {
+            nodes[nodeIndex].boundsMin[k] = bounds.min[k];
+            nodes[nodeIndex].boundsMax[k] = bounds.max[k];
+        }
+        if (count <= 2 || depth >= kMaxDepth) {
+            continue;
+        }
+
+        // Binned SAH over all three axes
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float lo = centroidBounds.min[axis];
+            float extent = centroidBounds.max[axis] - lo;
+            if (extent <= 1e-12f) {
+                continue;
+            }
+            Bounds binBounds[kBins];
+            uint32_t binCount[kBins] = {};
+            float scale = kBins / extent;
+            for (uint32_t i = first; i < first + count; i++) {
+                int bin = std::min(static_cast<int>((centroids[order[i]][axis] - lo) * scale), kBins - 1);
+                binBounds[bin].Grow(triangleBounds[order[i]]);
+                binCount[bin]++;
+            }
+
+            float leftArea[kBins - 1];
+            uint32_t leftCount[kBins - 1];
+            Bounds running;
+            uint32_t runningCount = 0;
+            for (int i = 0; i < kBins - 1; i++) {
+                running.Grow(binBounds[i]);
+                runningCount += binCount[i];
+                leftArea[i] = running.Area();
+                leftCount[i] = runningCount;
+            }
+            running = Bounds();
+            runningCount = 0;
+            for (int i = kBins - 1; i > 0; i--) {
+                running.Grow(binBounds[i]);
+                runningCount += binCount[i];
+                float cost = leftCount[i - 1] * leftArea[i - 1] + runningCount * running.Area();
+                if (leftCount[i - 1] > 0 && runningCount > 0 && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        float leafCost = count * bounds.Area() * kIntersectionCost;
+        float splitCost = kTraversalCost * bounds.Area() + bestCost * kIntersectionCost;
+        uint32_t middle;
+        if (bestAxis >= 0 && (splitCost < leafCost || count > kMaxLeafTriangles)) {
+            float lo = centroidBounds.min[bestAxis];
+            float scale = kBins / (centroidBounds.max[bestAxis] - lo);
+            auto split = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t t) {
+                return std::min(static_cast<int>((centroids[t][bestAxis] - lo) * scale), kBins - 1) < bestSplit;
+            });
+            middle = static_cast<uint32_t>(split - order.begin());
+        } else if (count > kMaxLeafTriangles) {
+            // Degenerate centroids: split by count so leaves stay small
+            middle = first + count / 2;
+            bestAxis = 0;
+        } else {
+            continue;
+        }
+
+        uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[left].leftOrFirst = first;
+        nodes[left].count = middle - first;
+        nodes[left + 1].leftOrFirst = middle;
+        nodes[left + 1].count = first + count - middle;
+        nodes[nodeIndex].leftOrFirst = left;
+        nodes[nodeIndex].count = kInteriorFlag | static_cast<uint32_t>(bestAxis);
+        stack.push_back({ left, depth + 1 });
+        stack.push_back({ left + 1, depth + 1 });
+    }
+    nodes.shrink_to_fit();
+
+    // Copy triangles into leaf order as v0, edge1, edge2
+    triangleData.resize(triangleCount * 9);
+    triangleIds = order;
+    sourceToLeaf.resize(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        uint32_t t = order[i];
+        glm::vec3 a = position(indices[t * 3]);
+        glm::vec3 e1 = position(indices[t * 3 + 1]) - a;
+        glm::vec3 e2 = position(indices[t * 3 + 2]) - a;
+        float* out = &triangleData[i * 9];
+        out[0] = a.x;  out[1] = a.y;  out[2] = a.z;
+        out[3] = e1.x; out[4] = e1.y; out[5] = e1.z;
+        out[6] = e2.x; out[7] = e2.y; out[8] = e2.z;
+        sourceToLeaf[t] = static_cast<uint32_t>(i);
+    }
+}
+
+size_t TriangleBVH::GetMemoryBytes() const {
+    return nodes.capacity() * sizeof(Node) + triangleData.capacity() * sizeof(float) +
+           (triangleIds.capacity() + sourceToLeaf.capacity()) * sizeof(uint32_t);
+}
+
+glm::vec3 TriangleBVH::GetTriangleNormal(uint32_t triangle) const {
+    const float* data = &triangleData[sourceToLeaf[triangle] * 9];
+    return glm::cross(glm::vec3(data[3], data[4], data[5]), glm::vec3(data[6], data[7], data[8]));
+}
+
+bool TriangleBVH::Save(const std::string& path, uint64_t sourceHash) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.good()) {
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.sourceHash = sourceHash;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.triangleCount = static_cast<uint32_t>(triangleIds.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node));
+    file.write(reinterpret_cast<const char*>(triangleData.data()), triangleData.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(triangleIds.data()), triangleIds.size() * sizeof(uint32_t));
+    return file.good();
+}
+
+bool TriangleBVH::Load(const std::string& path, uint64_t sourceHash, size_t triangleCount) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.good()) {
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    CacheHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file.good() || std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+        header.sourceHash != sourceHash || header.triangleCount != triangleCount || header.triangleCount == 0) {
+        return false;
+    }
+    // A binary tree over n triangles has at most 2n - 1 nodes, and the payload must fill the file exactly
+    uint64_t payload = static_cast<uint64_t>(header.nodeCount) * sizeof(Node) +
+                       static_cast<uint64_t>(header.triangleCount) * (9 * sizeof(float) + sizeof(uint32_t));
+    if (header.nodeCount == 0 || header.nodeCount > 2ull * header.triangleCount - 1 ||
+        fileSize != sizeof(header) + payload) {
+        return false;
+    }
+
+    nodes.resize(header.nodeCount);
+    triangleData.resize(static_cast<size_t>(header.triangleCount) * 9);
+    triangleIds.resize(header.triangleCount);
+    file.read(reinterpret_cast<char*>(nodes.data()), nodes.size() * sizeof(Node));
+    file.read(reinterpret_cast<char*>(triangleData.data()), triangleData.size() * sizeof(float));
+    file.read(reinterpret_cast<char*>(triangleIds.data()), triangleIds.size() * sizeof(uint32_t));
+    if (!file.good() || !validate()) {
+        nodes.clear();
+        triangleData.clear();
+        triangleIds.clear();
+        sourceToLeaf.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TriangleBVH::validate() {
+    // Triangle ids must be a permutation
+    const uint32_t unset = 0xffffffffu;
+    uint32_t triangleCount = static_cast<uint32_t>(triangleIds.size());
+    sourceToLeaf.assign(triangleCount, unset);
+    for (uint32_t i = 0; i < triangleCount; i++) {
+        uint32_t id = triangleIds[i];
+        if (id >= triangleCount || sourceToLeaf[id] != unset) {
+            return false;
+        }
+        sourceToLeaf[id] = i;
+    }
+
+    // Every node reached once from the root, children after their parent, leaves
+    // inside the triangle range and no deeper than the traversal stack allows
+    uint32_t nodeCount = static_cast<uint32_t>(nodes.size());
+    std::vector<uint8_t> reached(nodeCount, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };  // Node, depth
+    reached[0] = 1;
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back().first;
+        uint32_t depth = stack.back().second;
+        stack.pop_back();
+        const Node& node = nodes[nodeIndex];
+        if (node.count & kInteriorFlag) {
+            uint32_t left = node.leftOrFirst;
+            if ((node.count & ~kInteriorFlag) > 2 || depth >= kMaxDepth || left <= nodeIndex ||
+                left >= nodeCount - 1 || reached[left] || reached[left + 1]) {
+                return false;
+            }
+            reached[left] = reached[left + 1] = 1;
+            stack.push_back({ left, depth + 1 });
+            stack.push_back({ left + 1, depth + 1 });
+        } else if (static_cast<uint64_t>(node.leftOrFirst) + node.count > triangleCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TriangleBVH::Raycast(const Ray& ray, RayHit& hit) const {
+    RaycastPacket(&ray, &hit, 1);
+    return hit.Hit();
+}
+
+void TriangleBVH::RaycastPacket(const Ray* rays, RayHit* hits, int count) const {
+    for (int lane = 0; lane < count; lane++) {
+        hits[lane] = RayHit();
+    }
+    if (nodes.empty() || count <= 0) {
+        return;
+    }
+
+    // Rays in lanes; unused lanes get a negative range so they never hit
+    float origin[3][4], direction[3][4], inverse[3][4], range[4];
+    for (int lane = 0; lane < 4; lane++) {
+        const Ray& ray = rays[std::min(lane, count - 1)];
+        for (int k = 0; k < 3; k++) {
+            float d = ray.direction[k];
+            if (std::fabs(d) < 1e-20f) {
+                d = d < 0.0f ? -1e-20f : 1e-20f;  // Keeps the slab test finite
+            }
+            origin[k][lane] = ray.origin[k];
+            direction[k][lane] = ray.direction[k];
+            inverse[k][lane] = 1.0f / d;
+        }
+        range[lane] = lane < count ? ray.maxDistance : -1.0f;
+    }
+
+    Float4 o[3], d[3], inv[3];
+    for (int k = 0; k < 3; k++) {
+        o[k] = simd::Load(origin[k]);
+        d[k] = simd::Load(direction[k]);
+        inv[k] = simd::Load(inverse[k]);
+    }
+    Float4 tMax = simd::Load(range);
+    Float4 bestU = Splat(0.0f), bestV = Splat(0.0f);
+    Float4 bestTriangle = Splat(-1.0f);   // Leaf-order index as float; exact below 2^24 triangles
+    Float4 zero = Splat(0.0f), one = Splat(1.0f), epsilon = Splat(1e-9f);
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+
+        // Slab test of all four rays against the node bounds
+        Float4 tNear = zero, tFar = tMax;
+        for (int k = 0; k < 3; k++) {
+            Float4 t1 = (Splat(node.boundsMin[k]) - o[k]) * inv[k];
+            Float4 t2 = (Splat(node.boundsMax[k]) - o[k]) * inv[k];
+            tNear = Max(tNear, Min(t1, t2));
+            tFar = Min(tFar, Max(t1, t2));
+        }
+        if (!MoveMask(LessEqual(tNear, tFar))) {
+            continue;
+        }
+
+        if (node.count & kInteriorFlag) {
+            // Visit the child on the near side of the first active ray first
+            uint32_t axis = node.count & 3;
+            int lane = 0;
+            while (lane < count - 1 && range[lane] < 0.0f) {
+                lane++;
+            }
+            bool negative = direction[axis][lane] < 0.0f;
+            stack[stackSize++] = node.leftOrFirst + (negative ? 0 : 1);
+            stack[stackSize++] = node.leftOrFirst + (negative ? 1 : 0);
+            continue;
+        }
+
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+            // Moller-Trumbore with the triangle broadcast across the ray lanes
+            const float* tri = &triangleData[i * 9];
+            Float4 v0[3] = { Splat(tri[0]), Splat(tri[1]), Splat(tri[2]) };
+            Float4 e1[3] = { Splat(tri[3]), Splat(tri[4]), Splat(tri[5]) };
+            Float4 e2[3] = { Splat(tri[6]), Splat(tri[7]), Splat(tri[8]) };
+
+            Float4 p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+            Float4 det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+            Float4 invDet = one / Select(Greater(Abs(det), epsilon), det, one);
+            Float4 s[3] = { o[0] - v0[0], o[1] - v0[1], o[2] - v0[2] };
+            Float4 u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+            Float4 q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+            Float4 v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+            Float4 t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+
+            Float4 hit = And(Greater(Abs(det), epsilon), LessEqual(zero, u));
+            hit = And(hit, LessEqual(zero, v));
+            hit = And(hit, LessEqual(u + v, one));
+            hit = And(hit, Greater(t, zero));
+            hit = And(hit, Less(t, tMax));
+            if (!MoveMask(hit)) {
+                continue;
+            }
+            tMax = Select(hit, t, tMax);
+            bestU = Select(hit, u, bestU);
+            bestV = Select(hit, v, bestV);
+            bestTriangle = Select(hit, Splat(static_cast<float>(i)), bestTriangle);
+        }
+    }
+
+    float distance[4], u[4], v[4], triangle[4];
+    Store(distance, tMax);
+    Store(u, bestU);
+    Store(v, bestV);
+    Store(triangle, bestTriangle);
+    for (int lane = 0; lane < count; lane++) {
+        if (triangle[lane] >= 0.0f) {
+            hits[lane].distance = distance[lane];
+            hits[lane].triangle = triangleIds[static_cast<uint32_t>(triangle[lane])];
+            hits[lane].u = u[lane];
+            hits[lane].v = v[lane];
+        }
+    }
+}
+
+void TriangleBVH::RaycastBatch(const Ray* rays, RayHit* hits, size_t count) const {
+    size_t packets = (count + 3) / 4;
+    JobSystem::Get().ParallelFor(packets, 32, [&](size_t begin, size_t end) {
+        for (size_t packet = begin; packet < end; packet++) {
+            size_t first = packet * 4;
+            RaycastPacket(rays + first, hits + first, static_cast<int>(std::min<size_t>(4, count - first)));
+        }
+    });
+}
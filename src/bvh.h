@@ -0,0 +1,69 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <limits>
+
+struct Ray {
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);  // Need not be normalized; distances are in its units
+    float maxDistance = std::numeric_limits<float>::max();
+};
+
+struct RayHit {
+    float distance = std::numeric_limits<float>::max();
+    uint32_t triangle = 0xffffffffu;   // Index into the source index buffer / 3
+    float u = 0.0f, v = 0.0f;          // Barycentrics of the hit within the triangle
+    bool Hit() const { return triangle != 0xffffffffu; }
+};
+
+// Bounding volume hierarchy over a triangle mesh for ray casts. Built top-down
+// with binned SAH; nodes are 32 bytes with both children stored next to each
+// other, and leaf triangles are copied into node order so leaves read
+// contiguous memory. Queries trace packets of four rays together, testing
+// each triangle against all four with SIMD.
+class TriangleBVH {
+public:
+    // vertices holds `stride` floats per vertex with the position first
+    void Build(const std::vector<float>& vertices, size_t stride, const std::vector<unsigned int>& indices);
+    bool Empty() const { return nodes.empty(); }
+
+    // Binary cache next to the source asset, keyed by HashGeometry() of the source.
+    // Load rejects files built from other geometry and any whose size, triangle
+    // order or tree does not check out against triangleCount, so a stale or
+    // corrupt cache is rebuilt rather than traversed.
+    static uint64_t HashGeometry(const std::vector<float>& vertices, size_t stride, const std::vector<unsigned int>& indices);
+    bool Save(const std::string& path, uint64_t sourceHash) const;
+    bool Load(const std::string& path, uint64_t sourceHash, size_t triangleCount);
+
+    bool Raycast(const Ray& ray, RayHit& hit) const;
+    // Closest hits for up to four rays traced as one packet
+    void RaycastPacket(const Ray* rays, RayHit* hits, int count) const;
+    // Any number of rays, split into packets across the job system
+    void RaycastBatch(const Ray* rays, RayHit* hits, size_t count) const;
+
+    size_t GetNodeCount() const { return nodes.size(); }
+    size_t GetTriangleCount() const { return triangleIds.size(); }
+    size_t GetMemoryBytes() const;
+
+    // Geometric normal of a hit triangle, unnormalized
+    glm::vec3 GetTriangleNormal(uint32_t triangle) const;
+
+private:
+    struct Node {
+        float boundsMin[3];
+        uint32_t leftOrFirst;   // Interior: left child (right is +1). Leaf: first triangle
+        float boundsMax[3];
+        uint32_t count;         // Leaf: triangle count. Interior: kInteriorFlag | split axis
+    };
+    static const uint32_t kInteriorFlag = 0x80000000u;
+
+    // Checks a loaded tree and triangle order, filling sourceToLeaf
+    bool validate();
+
+    std::vector<Node> nodes;
+    std::vector<float> triangleData;     // v0, edge1, edge2 per triangle, in leaf order
+    std::vector<uint32_t> triangleIds;   // Leaf order -> source triangle
+    std::vector<uint32_t> sourceToLeaf;  // Source triangle -> leaf order
+};
@@ -11,6 +11,7 @@ public:
     void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
     
     glm::vec3 GetPosition() const;
+    glm::vec3 GetFront() const { return Front; }
 
 private:
     glm::vec3 Position;
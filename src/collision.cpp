@@ -0,0 +1,721 @@
+#include "collision.h"
+#include "job_system.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace simd;
+
+namespace {
+
+const uint32_t kNoSlot = 0xffffffffu;
+const size_t kParallelCellThreshold = 256;
+
+// Fills lanes past `count` with the last valid value so padding never produces NaNs
+struct LaneBatch {
+    float values[4];
+    void Pad(int count) {
+        for (int i = count; i < 4; i++) {
+            values[i] = values[count - 1];
+        }
+    }
+};
+
+} // namespace
+
+CollisionWorld::CollisionWorld(const CollisionSettings& settings) : settings(settings) {
+}
+
+ColliderId CollisionWorld::allocate(ColliderShape colliderShape, uint32_t colliderLayer, uint32_t colliderMask, void* data) {
+    ColliderId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = static_cast<ColliderId>(idToSlot.size());
+        idToSlot.push_back(kNoSlot);
+    }
+
+    idToSlot[id] = static_cast<uint32_t>(slotIds.size());
+    slotIds.push_back(id);
+    centerX.push_back(0.0f);
+    centerY.push_back(0.0f);
+    centerZ.push_back(0.0f);
+    boundRadius.push_back(0.0f);
+    for (int i = 0; i < 9; i++) {
+        axes[i].push_back((i % 4 == 0) ? 1.0f : 0.0f);
+    }
+    halfX.push_back(0.0f);
+    halfY.push_back(0.0f);
+    halfZ.push_back(0.0f);
+    shape.push_back(colliderShape);
+    layer.push_back(colliderLayer);
+    mask.push_back(colliderMask);
+    userData.push_back(data);
+    binned.push_back({ 1, 1, 0, 0 });  // Empty range: not in any cell yet
+    dirty.push_back(0);
+    return id;
+}
+
+ColliderId CollisionWorld::AddSphere(const glm::vec3& center, float radius, uint32_t colliderLayer,
+                                     uint32_t colliderMask, void* data) {
+    ColliderId id = allocate(ColliderShape::Sphere, colliderLayer, colliderMask, data);
+    SetSphere(id, center, radius);
+    return id;
+}
+
+ColliderId CollisionWorld::AddBox(const glm::vec3& center, const glm::mat3& boxAxes, const glm::vec3& halfExtents,
+                                  uint32_t colliderLayer, uint32_t colliderMask, void* data) {
+    ColliderId id = allocate(ColliderShape::Box, colliderLayer, colliderMask, data);
+    SetBox(id, center, boxAxes, halfExtents);
+    return id;
+}
+
+void CollisionWorld::Remove(ColliderId id) {
+    if (id >= idToSlot.size() || idToSlot[id] == kNoSlot) {
+        return;
+    }
+    uint32_t slot = idToSlot[id];
+    erase(id, binned[slot]);
+
+    // Swap the last slot into the hole
+    uint32_t last = static_cast<uint32_t>(slotIds.size() - 1);
+    if (slot != last) {
+        ColliderId moved = slotIds[last];
+        slotIds[slot] = moved;
+        idToSlot[moved] = slot;
+        centerX[slot] = centerX[last];
+        centerY[slot] = centerY[last];
+        centerZ[slot] = centerZ[last];
+        boundRadius[slot] = boundRadius[last];
+        for (int i = 0; i < 9; i++) {
+            axes[i][slot] = axes[i][last];
+        }
+        halfX[slot] = halfX[last];
+        halfY[slot] = halfY[last];
+        halfZ[slot] = halfZ[last];
+        shape[slot] = shape[last];
+        layer[slot] = layer[last];
+        mask[slot] = mask[last];
+        userData[slot] = userData[last];
+        binned[slot] = binned[last];
+        dirty[slot] = dirty[last];
+    }
+
+    slotIds.pop_back();
+    centerX.pop_back();
+    centerY.pop_back();
+    centerZ.pop_back();
+    boundRadius.pop_back();
+    for (int i = 0; i < 9; i++) {
+        axes[i].pop_back();
+    }
+    halfX.pop_back();
+    halfY.pop_back();
+    halfZ.pop_back();
+    shape.pop_back();
+    layer.pop_back();
+    mask.pop_back();
+    userData.pop_back();
+    binned.pop_back();
+    dirty.pop_back();
+
+    idToSlot[id] = kNoSlot;
+    freeIds.push_back(id);
+}
+
+void CollisionWorld::markDirty(ColliderId id) {
+    uint32_t slot = idToSlot[id];
+    if (!dirty[slot]) {
+        dirty[slot] = 1;
+        dirtyIds.push_back(id);
+    }
+}
+
+void CollisionWorld::SetSphere(ColliderId id, const glm::vec3& center, float radius) {
+    uint32_t slot = idToSlot[id];
+    centerX[slot] = center.x;
+    centerY[slot] = center.y;
+    centerZ[slot] = center.z;
+    boundRadius[slot] = radius;
+    markDirty(id);
+}
+
+void CollisionWorld::SetBox(ColliderId id, const glm::vec3& center, const glm::mat3& boxAxes, const glm::vec3& halfExtents) {
+    uint32_t slot = idToSlot[id];
+    centerX[slot] = center.x;
+    centerY[slot] = center.y;
+    centerZ[slot] = center.z;
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            axes[column * 3 + row][slot] = boxAxes[column][row];
+        }
+    }
+    halfX[slot] = halfExtents.x;
+    halfY[slot] = halfExtents.y;
+    halfZ[slot] = halfExtents.z;
+    boundRadius[slot] = glm::length(halfExtents);
+    markDirty(id);
+}
+
+void* CollisionWorld::GetUserData(ColliderId id) const {
+    return userData[idToSlot[id]];
+}
+
+glm::vec3 CollisionWorld::GetCenter(ColliderId id) const {
+    uint32_t slot = idToSlot[id];
+    return glm::vec3(centerX[slot], centerY[slot], centerZ[slot]);
+}
+
+CollisionWorld::CellRange CollisionWorld::rangeFor(uint32_t slot) const {
+    float inverseCell = 1.0f / settings.cellSize;
+    float r = boundRadius[slot];
+    return { static_cast<int>(std::floor((centerX[slot] - r) * inverseCell)),
+             static_cast<int>(std::floor((centerZ[slot] - r) * inverseCell)),
+             static_cast<int>(std::floor((centerX[slot] + r) * inverseCell)),
+             static_cast<int>(std::floor((centerZ[slot] + r) * inverseCell)) };
+}
+
+void CollisionWorld::insert(ColliderId id, const CellRange& range) {
+    for (int z = range.minZ; z <= range.maxZ; z++) {
+        for (int x = range.minX; x <= range.maxX; x++) {
+            cells[cellKey(x, z)].push_back(id);
+        }
+    }
+}
+
+void CollisionWorld::erase(ColliderId id, const CellRange& range) {
+    for (int z = range.minZ; z <= range.maxZ; z++) {
+        for (int x = range.minX; x <= range.maxX; x++) {
+            auto cell = cells.find(cellKey(x, z));
+            if (cell == cells.end()) {
+                continue;
+            }
+            std::vector<ColliderId>& ids = cell->second;
+            auto it = std::find(ids.begin(), ids.end(), id);
+            if (it != ids.end()) {
+                *it = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty()) {
+                cells.erase(cell);
+            }
+        }
+    }
+}
+
+void CollisionWorld::Update() {
+    // Incremental rebuild: only colliders that crossed a cell boundary touch the hash
+    for (ColliderId id : dirtyIds) {
+        uint32_t slot = idToSlot[id];
+        if (slot == kNoSlot || !dirty[slot]) {
+            continue;
+        }
+        dirty[slot] = 0;
+        CellRange range = rangeFor(slot);
+        if (!(range == binned[slot])) {
+            erase(id, binned[slot]);
+            insert(id, range);
+            binned[slot] = range;
+        }
+    }
+    dirtyIds.clear();
+
+    std::vector<Pair> sphereSphere, sphereBox, boxBox;
+    findPairs(sphereSphere, sphereBox, boxBox);
+    pairCount = sphereSphere.size() + sphereBox.size() + boxBox.size();
+
+    contacts.clear();
+    testSphereSphere(sphereSphere);
+    testSphereBox(sphereBox);
+    testBoxBox(boxBox);
+}
+
+void CollisionWorld::findPairs(std::vector<Pair>& sphereSphere, std::vector<Pair>& sphereBox, std::vector<Pair>& boxBox) const {
+    struct CellRef {
+        int x, z;
+        const std::vector<ColliderId>* ids;
+    };
+    std::vector<CellRef> occupied;
+    occupied.reserve(cells.size());
+    for (const auto& cell : cells) {
+        if (cell.second.size() >= 2) {
+            occupied.push_back({ static_cast<int>(static_cast<int32_t>(cell.first >> 32)),
+                                 static_cast<int>(static_cast<int32_t>(cell.first & 0xffffffffu)),
+                                 &cell.second });
+        }
+    }
+
+    const size_t grain = 64;
+    size_t chunkCount = (occupied.size() + grain - 1) / grain;
+    std::vector<std::vector<Pair>> chunkPairs[3];
+    for (auto& chunks : chunkPairs) {
+        chunks.resize(chunkCount);
+    }
+
+    auto processCells = [&](size_t begin, size_t end) {
+        size_t chunk = begin / grain;
+        for (size_t c = begin; c < end; c++) {
+            const CellRef& cell = occupied[c];
+            const std::vector<ColliderId>& ids = *cell.ids;
+            for (size_t i = 0; i < ids.size(); i++) {
+                uint32_t a = idToSlot[ids[i]];
+                for (size_t j = i + 1; j < ids.size(); j++) {
+                    uint32_t b = idToSlot[ids[j]];
+                    if (!(layer[a] & mask[b]) || !(layer[b] & mask[a])) {
+                        continue;
+                    }
+                    // A pair sharing several cells is only reported by the first cell of their overlap
+                    const CellRange& ra = binned[a];
+                    const CellRange& rb = binned[b];
+                    if (std::max(ra.minX, rb.minX) != cell.x || std::max(ra.minZ, rb.minZ) != cell.z) {
+                        continue;
+                    }
+                    float reach = boundRadius[a] + boundRadius[b];
+                    if (std::fabs(centerX[a] - centerX[b]) > reach || std::fabs(centerY[a] - centerY[b]) > reach ||
+                        std::fabs(centerZ[a] - centerZ[b]) > reach) {
+                        continue;
+                    }
+
+                    ColliderShape sa = shape[a];
+                    ColliderShape sb = shape[b];
+                    if (sa == ColliderShape::Sphere && sb == ColliderShape::Sphere) {
+                        chunkPairs[0][chunk].push_back({ ids[i], ids[j] });
+                    } else if (sa == ColliderShape::Box && sb == ColliderShape::Box) {
+                        chunkPairs[2][chunk].push_back({ ids[i], ids[j] });
+                    } else if (sa == ColliderShape::Sphere) {
+                        chunkPairs[1][chunk].push_back({ ids[i], ids[j] });
+                    } else {
+                        chunkPairs[1][chunk].push_back({ ids[j], ids[i] });  // Sphere first
+                    }
+                }
+            }
+        }
+    };
+
+    if (occupied.size() < kParallelCellThreshold) {
+        for (size_t begin = 0; begin < occupied.size(); begin += grain) {
+            processCells(begin, std::min(begin + grain, occupied.size()));
+        }
+    } else {
+        JobSystem::Get().ParallelFor(occupied.size(), grain, processCells);
+    }
+
+    std::vector<Pair>* outputs[3] = { &sphereSphere, &sphereBox, &boxBox };
+    for (int type = 0; type < 3; type++) {
+        for (const auto& chunk : chunkPairs[type]) {
+            outputs[type]->insert(outputs[type]->end(), chunk.begin(), chunk.end());
+        }
+    }
+}
+
+void CollisionWorld::testSphereSphere(const std::vector<Pair>& pairs) {
+    for (size_t base = 0; base < pairs.size(); base += 4) {
+        int count = static_cast<int>(std::min<size_t>(4, pairs.size() - base));
+        LaneBatch ax, ay, az, ar, bx, by, bz, br;
+        for (int lane = 0; lane < count; lane++) {
+            uint32_t a = idToSlot[pairs[base + lane].a];
+            uint32_t b = idToSlot[pairs[base + lane].b];
+            ax.values[lane] = centerX[a]; ay.values[lane] = centerY[a]; az.values[lane] = centerZ[a]; ar.values[lane] = boundRadius[a];
+            bx.values[lane] = centerX[b]; by.values[lane] = centerY[b]; bz.values[lane] = centerZ[b]; br.values[lane] = boundRadius[b];
+        }
+        for (LaneBatch* batch : { &ax, &ay, &az, &ar, &bx, &by, &bz, &br }) {
+            batch->Pad(count);
+        }
+
+        Float4 dx = Load(bx.values) - Load(ax.values);
+        Float4 dy = Load(by.values) - Load(ay.values);
+        Float4 dz = Load(bz.values) - Load(az.values);
+        Float4 reach = Load(ar.values) + Load(br.values);
+        Float4 distanceSq = dx * dx + dy * dy + dz * dz;
+        int hits = MoveMask(Less(distanceSq, reach * reach)) & ((1 << count) - 1);
+        if (!hits) {
+            continue;
+        }
+
+        float distance[4], depth[4], nx[4], ny[4], nz[4];
+        Float4 length = Sqrt(distanceSq);
+        Float4 inverse = Splat(1.0f) / Max(length, Splat(1e-6f));
+        Store(distance, length);
+        Store(depth, reach - length);
+        Store(nx, dx * inverse);
+        Store(ny, dy * inverse);
+        Store(nz, dz * inverse);
+        for (int lane = 0; lane < count; lane++) {
+            if (hits & (1 << lane)) {
+                glm::vec3 normal = distance[lane] > 1e-6f ? glm::vec3(nx[lane], ny[lane], nz[lane]) : glm::vec3(0.0f, 1.0f, 0.0f);
+                contacts.push_back({ pairs[base + lane].a, pairs[base + lane].b, normal, depth[lane] });
+            }
+        }
+    }
+}
+
+void CollisionWorld::testSphereBox(const std::vector<Pair>& pairs) {
+    for (size_t base = 0; base < pairs.size(); base += 4) {
+        int count = static_cast<int>(std::min<size_t>(4, pairs.size() - base));
+        LaneBatch sx, sy, sz, sr, bx, by, bz, hx, hy, hz, axis[9];
+        for (int lane = 0; lane < count; lane++) {
+            uint32_t s = idToSlot[pairs[base + lane].a];
+            uint32_t b = idToSlot[pairs[base + lane].b];
+            sx.values[lane] = centerX[s]; sy.values[lane] = centerY[s]; sz.values[lane] = centerZ[s]; sr.values[lane] = boundRadius[s];
+            bx.values[lane] = centerX[b]; by.values[lane] = centerY[b]; bz.values[lane] = centerZ[b];
+            hx.values[lane] = halfX[b]; hy.values[lane] = halfY[b]; hz.values[lane] = halfZ[b];
+            for (int i = 0; i < 9; i++) {
+                axis[i].values[lane] = axes[i][b];
+            }
+        }
+        for (LaneBatch* batch : { &sx, &sy, &sz, &sr, &bx, &by, &bz, &hx, &hy, &hz }) {
+            batch->Pad(count);
+        }
+        for (LaneBatch& batch : axis) {
+            batch.Pad(count);
+        }
+
+        // Sphere center in box space, clamped onto the box
+        Float4 dx = Load(sx.values) - Load(bx.values);
+        Float4 dy = Load(sy.values) - Load(by.values);
+        Float4 dz = Load(sz.values) - Load(bz.values);
+        Float4 half[3] = { Load(hx.values), Load(hy.values), Load(hz.values) };
+        Float4 local[3], clamped[3];
+        Float4 distanceSq = Splat(0.0f);
+        for (int i = 0; i < 3; i++) {
+            local[i] = dx * Load(axis[i * 3].values) + dy * Load(axis[i * 3 + 1].values) + dz * Load(axis[i * 3 + 2].values);
+            clamped[i] = Clamp(local[i], Splat(0.0f) - half[i], half[i]);
+            Float4 outside = local[i] - clamped[i];
+            distanceSq = distanceSq + outside * outside;
+        }
+        Float4 radius = Load(sr.values);
+        int hits = MoveMask(LessEqual(distanceSq, radius * radius)) & ((1 << count) - 1);
+        if (!hits) {
+            continue;
+        }
+
+        float localOut[3][4], halfOut[3][4], distanceOut[4], radiusOut[4];
+        for (int i = 0; i < 3; i++) {
+            Store(localOut[i], local[i]);
+            Store(halfOut[i], half[i]);
+        }
+        Store(distanceOut, Sqrt(distanceSq));
+        Store(radiusOut, radius);
+
+        for (int lane = 0; lane < count; lane++) {
+            if (!(hits & (1 << lane))) {
+                continue;
+            }
+            uint32_t b = idToSlot[pairs[base + lane].b];
+            glm::vec3 boxAxis[3];
+            for (int i = 0; i < 3; i++) {
+                boxAxis[i] = glm::vec3(axes[i * 3][b], axes[i * 3 + 1][b], axes[i * 3 + 2][b]);
+            }
+
+            glm::vec3 normal;
+            float depth;
+            if (distanceOut[lane] > 1e-6f) {
+                // Outside: push along the offset from the closest point
+                glm::vec3 offset(0.0f);
+                for (int i = 0; i < 3; i++) {
+                    float l = localOut[i][lane];
+                    float c = std::min(std::max(l, -halfOut[i][lane]), halfOut[i][lane]);
+                    offset += boxAxis[i] * (l - c);
+                }
+                normal = -offset / distanceOut[lane];
+                depth = radiusOut[lane] - distanceOut[lane];
+            } else {
+                // Center inside the box: leave through the nearest face
+                int best = 0;
+                float bestGap = halfOut[0][lane] - std::fabs(localOut[0][lane]);
+                for (int i = 1; i < 3; i++) {
+                    float gap = halfOut[i][lane] - std::fabs(localOut[i][lane]);
+                    if (gap < bestGap) {
+                        bestGap = gap;
+                        best = i;
+                    }
+                }
+                normal = boxAxis[best] * (localOut[best][lane] >= 0.0f ? -1.0f : 1.0f);
+                depth = radiusOut[lane] + bestGap;
+            }
+            contacts.push_back({ pairs[base + lane].a, pairs[base + lane].b, normal, depth });
+        }
+    }
+}
+
+void CollisionWorld::testBoxBox(const std::vector<Pair>& pairs) {
+    for (size_t base = 0; base < pairs.size(); base += 4) {
+        int count = static_cast<int>(std::min<size_t>(4, pairs.size() - base));
+        LaneBatch center[2][3], half[2][3], axis[2][9];
+        for (int lane = 0; lane < count; lane++) {
+            uint32_t slots[2] = { idToSlot[pairs[base + lane].a], idToSlot[pairs[base + lane].b] };
+            for (int box = 0; box < 2; box++) {
+                uint32_t s = slots[box];
+                center[box][0].values[lane] = centerX[s];
+                center[box][1].values[lane] = centerY[s];
+                center[box][2].values[lane] = centerZ[s];
+                half[box][0].values[lane] = halfX[s];
+                half[box][1].values[lane] = halfY[s];
+                half[box][2].values[lane] = halfZ[s];
+                for (int i = 0; i < 9; i++) {
+                    axis[box][i].values[lane] = axes[i][s];
+                }
+            }
+        }
+
+        Float4 A[3][3], B[3][3], a[3], b[3], t[3];
+        for (int box = 0; box < 2; box++) {
+            for (int i = 0; i < 3; i++) {
+                center[box][i].Pad(count);
+                half[box][i].Pad(count);
+            }
+            for (int i = 0; i < 9; i++) {
+                axis[box][i].Pad(count);
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int k = 0; k < 3; k++) {
+                A[i][k] = Load(axis[0][i * 3 + k].values);
+                B[i][k] = Load(axis[1][i * 3 + k].values);
+            }
+            a[i] = Load(half[0][i].values);
+            b[i] = Load(half[1][i].values);
+        }
+        Float4 d[3];
+        for (int k = 0; k < 3; k++) {
+            d[k] = Load(center[1][k].values) - Load(center[0][k].values);
+        }
+
+        // Separating axis test (Gottschalk): B's axes and the center offset expressed in A's frame
+        Float4 R[3][3], absR[3][3];
+        Float4 epsilon = Splat(1e-6f);
+        for (int i = 0; i < 3; i++) {
+            t[i] = d[0] * A[i][0] + d[1] * A[i][1] + d[2] * A[i][2];
+            for (int j = 0; j < 3; j++) {
+                R[i][j] = A[i][0] * B[j][0] + A[i][1] * B[j][1] + A[i][2] * B[j][2];
+                absR[i][j] = Abs(R[i][j]) + epsilon;
+            }
+        }
+
+        Float4 separated = Splat(0.0f);
+        for (int i = 0; i < 3; i++) {
+            Float4 rb = b[0] * absR[i][0] + b[1] * absR[i][1] + b[2] * absR[i][2];
+            separated = Or(separated, Greater(Abs(t[i]), a[i] + rb));
+        }
+        for (int j = 0; j < 3; j++) {
+            Float4 ra = a[0] * absR[0][j] + a[1] * absR[1][j] + a[2] * absR[2][j];
+            Float4 projection = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+            separated = Or(separated, Greater(Abs(projection), ra + b[j]));
+        }
+        for (int i = 0; i < 3; i++) {
+            int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+            for (int j = 0; j < 3; j++) {
+                int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+                Float4 ra = a[i1] * absR[i2][j] + a[i2] * absR[i1][j];
+                Float4 rb = b[j1] * absR[i][j2] + b[j2] * absR[i][j1];
+                Float4 projection = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+                separated = Or(separated, Greater(Abs(projection), ra + rb));
+            }
+        }
+
+        int hits = ~MoveMask(separated) & ((1 << count) - 1);
+        if (!hits) {
+            continue;
+        }
+
+        for (int lane = 0; lane < count; lane++) {
+            if (!(hits & (1 << lane))) {
+                continue;
+            }
+            // Contact normal from the face axis with the smallest overlap
+            uint32_t sa = idToSlot[pairs[base + lane].a];
+            uint32_t sb = idToSlot[pairs[base + lane].b];
+            glm::vec3 offset(centerX[sb] - centerX[sa], centerY[sb] - centerY[sa], centerZ[sb] - centerZ[sa]);
+            glm::vec3 axesA[3], axesB[3];
+            glm::vec3 halfA(halfX[sa], halfY[sa], halfZ[sa]);
+            glm::vec3 halfB(halfX[sb], halfY[sb], halfZ[sb]);
+            for (int i = 0; i < 3; i++) {
+                axesA[i] = glm::vec3(axes[i * 3][sa], axes[i * 3 + 1][sa], axes[i * 3 + 2][sa]);
+                axesB[i] = glm::vec3(axes[i * 3][sb], axes[i * 3 + 1][sb], axes[i * 3 + 2][sb]);
+            }
+
+            glm::vec3 normal(0.0f, 1.0f, 0.0f);
+            float depth = 1e30f;
+            for (int k = 0; k < 6; k++) {
+                glm::vec3 n = k < 3 ? axesA[k] : axesB[k - 3];
+                float extentA = halfA.x * std::fabs(glm::dot(n, axesA[0])) + halfA.y * std::fabs(glm::dot(n, axesA[1])) +
+                                halfA.z * std::fabs(glm::dot(n, axesA[2]));
+                float extentB = halfB.x * std::fabs(glm::dot(n, axesB[0])) + halfB.y * std::fabs(glm::dot(n, axesB[1])) +
+                                halfB.z * std::fabs(glm::dot(n, axesB[2]));
+                float distance = glm::dot(offset, n);
+                float overlap = extentA + extentB - std::fabs(distance);
+                if (overlap < depth) {
+                    depth = overlap;
+                    normal = distance >= 0.0f ? n : -n;
+                }
+            }
+            contacts.push_back({ pairs[base + lane].a, pairs[base + lane].b, normal, std::max(depth, 0.0f) });
+        }
+    }
+}
+
+void CollisionWorld::QuerySphere(const glm::vec3& center, float radius, std::vector<ColliderId>& out, uint32_t layerMask) const {
+    float inverseCell = 1.0f / settings.cellSize;
+    int minX = static_cast<int>(std::floor((center.x - radius) * inverseCell));
+    int minZ = static_cast<int>(std::floor((center.z - radius) * inverseCell));
+    int maxX = static_cast<int>(std::floor((center.x + radius) * inverseCell));
+    int maxZ = static_cast<int>(std::floor((center.z + radius) * inverseCell));
+
+    std::vector<ColliderId> candidates;
+    auto gather = [&](const std::vector<ColliderId>& ids) {
+        for (ColliderId id : ids) {
+            if (layer[idToSlot[id]] & layerMask) {
+                candidates.push_back(id);
+            }
+        }
+    };
+
+    // Large queries walk the occupied cells instead of every cell in range
+    int64_t rangeCells = static_cast<int64_t>(maxX - minX + 1) * (maxZ - minZ + 1);
+    if (rangeCells > static_cast<int64_t>(cells.size())) {
+        for (const auto& cell : cells) {
+            int x = static_cast<int>(static_cast<int32_t>(cell.first >> 32));
+            int z = static_cast<int>(static_cast<int32_t>(cell.first & 0xffffffffu));
+            if (x >= minX && x <= maxX && z >= minZ && z <= maxZ) {
+                gather(cell.second);
+            }
+        }
+    } else {
+        for (int z = minZ; z <= maxZ; z++) {
+            for (int x = minX; x <= maxX; x++) {
+                auto cell = cells.find(cellKey(x, z));
+                if (cell != cells.end()) {
+                    gather(cell->second);
+                }
+            }
+        }
+    }
+
+    // Colliders spanning several cells were gathered more than once
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    Float4 qx = Splat(center.x), qy = Splat(center.y), qz = Splat(center.z), qr = Splat(radius);
+    for (size_t base = 0; base < candidates.size(); base += 4) {
+        int count = static_cast<int>(std::min<size_t>(4, candidates.size() - base));
+        LaneBatch x, y, z, r;
+        for (int lane = 0; lane < count; lane++) {
+            uint32_t slot = idToSlot[candidates[base + lane]];
+            x.values[lane] = centerX[slot];
+            y.values[lane] = centerY[slot];
+            z.values[lane] = centerZ[slot];
+            r.values[lane] = boundRadius[slot];
+        }
+        x.Pad(count);
+        y.Pad(count);
+        z.Pad(count);
+        r.Pad(count);
+
+        Float4 dx = Load(x.values) - qx;
+        Float4 dy = Load(y.values) - qy;
+        Float4 dz = Load(z.values) - qz;
+        Float4 reach = Load(r.values) + qr;
+        int hits = MoveMask(LessEqual(dx * dx + dy * dy + dz * dz, reach * reach)) & ((1 << count) - 1);
+        for (int lane = 0; lane < count; lane++) {
+            if (hits & (1 << lane)) {
+                out.push_back(candidates[base + lane]);
+            }
+        }
+    }
+}
+
+void CollisionWorld::QueryRay(const Ray& ray, std::vector<ColliderId>& out, uint32_t layerMask) const {
+    std::vector<ColliderId> candidates;
+    auto gather = [&](const std::vector<ColliderId>& ids) {
+        for (ColliderId id : ids) {
+            if (layer[idToSlot[id]] & layerMask) {
+                candidates.push_back(id);
+            }
+        }
+    };
+
+    // Walk the cells under the ray in XZ; long or unbounded rays visit the occupied cells instead
+    float inverseCell = 1.0f / settings.cellSize;
+    float crossings = (std::abs(ray.direction.x) + std::abs(ray.direction.z)) * ray.maxDistance * inverseCell;
+    if (!std::isfinite(crossings) || crossings > static_cast<float>(cells.size())) {
+        for (const auto& cell : cells) {
+            gather(cell.second);
+        }
+    } else {
+        glm::vec3 end = ray.origin + ray.direction * ray.maxDistance;
+        int x = static_cast<int>(std::floor(ray.origin.x * inverseCell));
+        int z = static_cast<int>(std::floor(ray.origin.z * inverseCell));
+        int endX = static_cast<int>(std::floor(end.x * inverseCell));
+        int endZ = static_cast<int>(std::floor(end.z * inverseCell));
+        int stepX = endX > x ? 1 : -1;
+        int stepZ = endZ > z ? 1 : -1;
+        float deltaX = ray.direction.x != 0.0f ? settings.cellSize / std::abs(ray.direction.x) : std::numeric_limits<float>::max();
+        float deltaZ = ray.direction.z != 0.0f ? settings.cellSize / std::abs(ray.direction.z) : std::numeric_limits<float>::max();
+        float nextX = ray.direction.x != 0.0f
+            ? ((x + (stepX > 0 ? 1 : 0)) * settings.cellSize - ray.origin.x) / ray.direction.x
+            : std::numeric_limits<float>::max();
+        float nextZ = ray.direction.z != 0.0f
+            ? ((z + (stepZ > 0 ? 1 : 0)) * settings.cellSize - ray.origin.z) / ray.direction.z
+            : std::numeric_limits<float>::max();
+
+        // Exactly one step per cell boundary, so rounding can never walk past the end cell
+        while (true) {
+            auto cell = cells.find(cellKey(x, z));
+            if (cell != cells.end()) {
+                gather(cell->second);
+            }
+            if (x == endX && z == endZ) {
+                break;
+            }
+            if (z == endZ || (x != endX && nextX < nextZ)) {
+                x += stepX;
+                nextX += deltaX;
+            } else {
+                z += stepZ;
+                nextZ += deltaZ;
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Closest point on the segment to each bounding sphere centre
+    Float4 ox = Splat(ray.origin.x), oy = Splat(ray.origin.y), oz = Splat(ray.origin.z);
+    Float4 dx = Splat(ray.direction.x), dy = Splat(ray.direction.y), dz = Splat(ray.direction.z);
+    float lengthSquared = glm::dot(ray.direction, ray.direction);
+    Float4 inverseLength = Splat(lengthSquared > 0.0f ? 1.0f / lengthSquared : 0.0f);
+    Float4 zero = Splat(0.0f), limit = Splat(ray.maxDistance);
+    for (size_t base = 0; base < candidates.size(); base += 4) {
+        int count = static_cast<int>(std::min<size_t>(4, candidates.size() - base));
+        LaneBatch x, y, z, r;
+        for (int lane = 0; lane < count; lane++) {
+            uint32_t slot = idToSlot[candidates[base + lane]];
+            x.values[lane] = centerX[slot];
+            y.values[lane] = centerY[slot];
+            z.values[lane] = centerZ[slot];
+            r.values[lane] = boundRadius[slot];
+        }
+        x.Pad(count);
+        y.Pad(count);
+        z.Pad(count);
+        r.Pad(count);
+
+        Float4 wx = Load(x.values) - ox;
+        Float4 wy = Load(y.values) - oy;
+        Float4 wz = Load(z.values) - oz;
+        Float4 t = Clamp((wx * dx + wy * dy + wz * dz) * inverseLength, zero, limit);
+        Float4 px = wx - dx * t;
+        Float4 py = wy - dy * t;
+        Float4 pz = wz - dz * t;
+        Float4 radius = Load(r.values);
+        int hits = MoveMask(LessEqual(px * px + py * py + pz * pz, radius * radius)) & ((1 << count) - 1);
+        for (int lane = 0; lane < count; lane++) {
+            if (hits & (1 << lane)) {
+                out.push_back(candidates[base + lane]);
+            }
+        }
+    }
+}
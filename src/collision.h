@@ -0,0 +1,111 @@
+#pragma once
+#include "bvh.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+using ColliderId = uint32_t;
+const ColliderId kInvalidCollider = 0xffffffffu;
+
+namespace CollisionLayer {
+    const uint32_t Unit = 1 << 0;
+    const uint32_t Projectile = 1 << 1;
+    const uint32_t Static = 1 << 2;
+}
+
+enum class ColliderShape : uint8_t { Sphere, Box };
+
+struct Contact {
+    ColliderId a, b;
+    glm::vec3 normal;   // From a towards b
+    float depth;
+};
+
+struct CollisionSettings {
+    float cellSize = 16.0f;   // XZ size of a hash cell; roughly the size of the largest common collider
+};
+
+// Collision detection for units and projectiles. Colliders live in
+// structure-of-arrays storage and are binned into a uniform XZ spatial hash
+// by their bounding spheres; only colliders whose cell range changed are
+// re-binned on Update(). Broadphase pairs are found per cell in parallel and
+// the sphere/box narrowphase runs four pairs at a time with SIMD.
+class CollisionWorld {
+public:
+    explicit CollisionWorld(const CollisionSettings& settings = CollisionSettings());
+
+    // A pair is tested when (layerA & maskB) and (layerB & maskA) are both non-zero
+    ColliderId AddSphere(const glm::vec3& center, float radius,
+                         uint32_t layer = 1, uint32_t mask = 0xffffffffu, void* userData = nullptr);
+    ColliderId AddBox(const glm::vec3& center, const glm::mat3& axes, const glm::vec3& halfExtents,
+                      uint32_t layer = 1, uint32_t mask = 0xffffffffu, void* userData = nullptr);
+    void Remove(ColliderId id);
+
+    void SetSphere(ColliderId id, const glm::vec3& center, float radius);
+    // axes are the box's unit-length local axes in world space
+    void SetBox(ColliderId id, const glm::vec3& center, const glm::mat3& axes, const glm::vec3& halfExtents);
+
+    // Re-bin moved colliders and rebuild the contact list
+    void Update();
+    const std::vector<Contact>& GetContacts() const { return contacts; }
+    size_t GetBroadphasePairCount() const { return pairCount; }
+
+    // Colliders whose bounding sphere overlaps the query sphere, e.g. everything in radar range
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<ColliderId>& out,
+                     uint32_t layerMask = 0xffffffffu) const;
+    // Colliders whose bounding sphere the ray passes through within maxDistance
+    void QueryRay(const Ray& ray, std::vector<ColliderId>& out, uint32_t layerMask = 0xffffffffu) const;
+
+    void* GetUserData(ColliderId id) const;
+    ColliderShape GetShape(ColliderId id) const { return shape[idToSlot[id]]; }
+    glm::vec3 GetCenter(ColliderId id) const;
+    size_t GetColliderCount() const { return slotIds.size(); }
+
+private:
+    struct CellRange {
+        int minX, minZ, maxX, maxZ;
+        bool operator==(const CellRange& other) const {
+            return minX == other.minX && minZ == other.minZ && maxX == other.maxX && maxZ == other.maxZ;
+        }
+    };
+
+    struct Pair {
+        ColliderId a, b;
+    };
+
+    CollisionSettings settings;
+
+    // Dense per-slot data; ids map to slots so removal can swap the last slot in
+    std::vector<ColliderId> slotIds;
+    std::vector<uint32_t> idToSlot;
+    std::vector<ColliderId> freeIds;
+    std::vector<float> centerX, centerY, centerZ, boundRadius;
+    std::vector<float> axes[9];       // Box axes, column-major
+    std::vector<float> halfX, halfY, halfZ;
+    std::vector<ColliderShape> shape;
+    std::vector<uint32_t> layer, mask;
+    std::vector<void*> userData;
+    std::vector<CellRange> binned;
+    std::vector<uint8_t> dirty;
+    std::vector<ColliderId> dirtyIds;
+
+    std::unordered_map<uint64_t, std::vector<ColliderId>> cells;
+
+    size_t pairCount = 0;
+    std::vector<Contact> contacts;
+
+    ColliderId allocate(ColliderShape colliderShape, uint32_t colliderLayer, uint32_t colliderMask, void* data);
+    void markDirty(ColliderId id);
+    CellRange rangeFor(uint32_t slot) const;
+    void insert(ColliderId id, const CellRange& range);
+    void erase(ColliderId id, const CellRange& range);
+    void findPairs(std::vector<Pair>& sphereSphere, std::vector<Pair>& sphereBox, std::vector<Pair>& boxBox) const;
+    void testSphereSphere(const std::vector<Pair>& pairs);
+    void testSphereBox(const std::vector<Pair>& pairs);
+    void testBoxBox(const std::vector<Pair>& pairs);
+
+    static uint64_t cellKey(int x, int z) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+    }
+};
@@ -0,0 +1,448 @@
+#include "debug_draw.h"
+#include "gl_state.h"
+#include "deletion_queue.h"
+#include "memory_tracker.h"
+#include "../external/glm/glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+const char* kAssetName = "debug_draw";
+
+// Glyphs on a 4 x 6 grid, y down: each group of four digits is one stroke x0 y0 x1 y1
+const float kGlyphHeight = 6.0f;
+const float kGlyphAdvance = 6.0f;
+
+const char* glyphStrokes(char c) {
+    switch (c) {
+        case '0': return "0040 4046 4606 0600 0640";
+        case '1': return "2026 1120 1636";
+        case '2': return "0040 4043 4303 0306 0646";
+        case '3': return "0040 4046 4606 1343";
+        case '4': return "0003 0343 4046";
+        case '5': return "4000 0003 0333 3344 4445 4536 3606";
+        case '6': return "4000 0006 0646 4643 4303";
+        case '7': return "0040 4046";
+        case '8': return "0040 4046 4606 0600 0343";
+        case '9': return "4303 0300 0040 4046 4606";
+        case 'A': return "0602 0220 2042 4246 0343";
+        case 'B': return "0006 0030 3041 4142 4233 0333 3344 4445 4536 3606";
+        case 'C': return "4000 0006 0646";
+        case 'D': return "0006 0030 3041 4145 4536 3606";
+        case 'E': return "4000 0006 0646 0333";
+        case 'F': return "4000 0006 0333";
+        case 'G': return "4000 0006 0646 4643 4323";
+        case 'H': return "0006 4046 0343";
+        case 'I': return "0040 2026 0646";
+        case 'J': return "0040 3036 3616 1604";
+        case 'K': return "0006 0340 0346";
+        case 'L': return "0006 0646";
+        case 'M': return "0600 0022 2240 4046";
+        case 'N': return "0600 0046 4640";
+        case 'O': return "0040 4046 4606 0600";
+        case 'P': return "0600 0040 4043 4303";
+        case 'Q': return "0040 4046 4606 0600 2446";
+        case 'R': return "0600 0040 4043 4303 2346";
+        case 'S': return "4000 0003 0343 4346 4606";
+        case 'T': return "0040 2026";
+        case 'U': return "0006 0646 4640";
+        case 'V': return "0026 2640";
+        case 'W': return "0006 0624 2446 4640";
+        case 'X': return "0046 4006";
+        case 'Y': return "0023 4023 2326";
+        case 'Z': return "0040 4006 0646";
+        case '.': return "2526";
+        case ',': return "2516";
+        case ':': return "2122 2425";
+        case ';': return "2122 2516";
+        case '-': return "1333";
+        case '+': return "1333 2234";
+        case '=': return "1232 1434";
+        case '_': return "0646";
+        case '/': return "0640";
+        case '\\': return "0046";
+        case '|': return "2026";
+        case '%': return "0640 0001 4546";
+        case '(': return "2011 1115 1526";
+        case ')': return "2031 3135 3526";
+        case '[': return "3010 1016 1636";
+        case ']': return "1030 3036 3616";
+        case '<': return "4103 0345";
+        case '>': return "0143 4305";
+        case '!': return "2024 2526";
+        case '?': return "0040 4043 4323 2324 2526";
+        case '\'': return "2021";
+        case '"': return "1011 3031";
+        case '#': return "1016 3036 0242 0444";
+        case '*': return "2024 0341 0143";
+        default: return nullptr;
+    }
+}
+
+const char* glyphFor(char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = static_cast<char>(c - 'a' + 'A');
+    }
+    return glyphStrokes(c);
+}
+
+size_t strokeCount(const char* strokes) {
+    size_t digits = 0;
+    for (const char* p = strokes; *p; p++) {
+        digits += *p != ' ';
+    }
+    return digits / 4;
+}
+
+// Clamped to bytes in R, G, B, A memory order, as the normalized attribute reads them
+uint32_t packColor(const glm::vec4& color) {
+    glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    uint8_t bytes[4] = { static_cast<uint8_t>(c.r), static_cast<uint8_t>(c.g),
+                         static_cast<uint8_t>(c.b), static_cast<uint8_t>(c.a) };
+    uint32_t packed;
+    std::copy(bytes, bytes + 4, reinterpret_cast<uint8_t*>(&packed));
+    return packed;
+}
+
+} // namespace
+
+// Two halves: the owning thread appends to `half`, Flush() drains the other
+struct DebugDraw::ThreadBuffer {
+    std::vector<Vertex> lists[2][kListCount];
+    std::atomic<uint32_t> half{0};
+    std::atomic<bool> writing{false};   // Set around every append
+    ThreadBuffer* next = nullptr;
+};
+
+DebugDraw& DebugDraw::Get() {
+    static DebugDraw instance;
+    return instance;
+}
+
+DebugDraw::~DebugDraw() {
+    ThreadBuffer* buffer = threadBuffers.load();
+    while (buffer) {
+        ThreadBuffer* next = buffer->next;
+        delete buffer;
+        buffer = next;
+    }
+}
+
+DebugDraw::ThreadBuffer& DebugDraw::threadBuffer() {
+    // Registered once per thread and kept until shutdown, so Flush() never races a thread exiting
+    thread_local ThreadBuffer* local = nullptr;
+    if (!local) {
+        local = new ThreadBuffer();
+        local->next = threadBuffers.load();
+        while (!threadBuffers.compare_exchange_weak(local->next, local)) {
+        }
+    }
+    return *local;
+}
+
+DebugDraw::Vertex* DebugDraw::beginWrite(ThreadBuffer& buffer, List list, size_t count) {
+    // Sequentially consistent with Flush(): either it sees the flag and waits for
+    // this append, or this append sees the half it switched to
+    buffer.writing.store(true);
+    std::vector<Vertex>& vertices = buffer.lists[buffer.half.load()][list];
+    if (vertices.size() + count > kMaxQueuedVertices) {
+        return nullptr;
+    }
+    size_t first = vertices.size();
+    vertices.resize(first + count);
+    return &vertices[first];
+}
+
+void DebugDraw::endWrite(ThreadBuffer& buffer) {
+    buffer.writing.store(false, std::memory_order_release);
+}
+
+void DebugDraw::Line(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color) {
+    if (!IsEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, WorldLines, 2)) {
+        uint32_t packed = packColor(color);
+        v[0] = { a, packed };
+        v[1] = { b, packed };
+    }
+    endWrite(buffer);
+}
+
+void DebugDraw::Lines(const glm::vec3* points, size_t count, const glm::vec4& color) {
+    count &= ~static_cast<size_t>(1);
+    if (!IsEnabled() || count == 0) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, WorldLines, count)) {
+        uint32_t packed = packColor(color);
+        for (size_t i = 0; i < count; i++) {
+            v[i] = { points[i], packed };
+        }
+    }
+    endWrite(buffer);
+}
+
+void DebugDraw::Box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color) {
+    Box(glm::mat4(1.0f), min, max, color);
+}
+
+void DebugDraw::Box(const glm::mat4& matrix, const glm::vec3& min, const glm::vec3& max, const glm::vec4& color) {
+    // Corner i takes max on the axes whose bit is set; edges join corners one bit apart
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 local((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+        corners[i] = glm::vec3(matrix * glm::vec4(local, 1.0f));
+    }
+    glm::vec3 points[24];
+    int n = 0;
+    for (int i = 0; i < 8; i++) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) {
+                points[n++] = corners[i];
+                points[n++] = corners[i | bit];
+            }
+        }
+    }
+    Lines(points, 24, color);
+}
+
+void DebugDraw::Frustum(const glm::mat4& viewProjection, const glm::vec4& color) {
+    // The clip-space cube carried back into the world
+    glm::mat4 inverse = glm::inverse(viewProjection);
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner = inverse * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+        corners[i] = glm::vec3(corner) / corner.w;
+    }
+    glm::vec3 points[24];
+    int n = 0;
+    for (int i = 0; i < 8; i++) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) {
+                points[n++] = corners[i];
+                points[n++] = corners[i | bit];
+            }
+        }
+    }
+    Lines(points, 24, color);
+}
+
+void DebugDraw::Axes(const glm::mat4& matrix, float length) {
+    glm::vec3 origin(matrix[3]);
+    Line(origin, glm::vec3(matrix * glm::vec4(length, 0.0f, 0.0f, 1.0f)), glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+    Line(origin, glm::vec3(matrix * glm::vec4(0.0f, length, 0.0f, 1.0f)), glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+    Line(origin, glm::vec3(matrix * glm::vec4(0.0f, 0.0f, length, 1.0f)), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+}
+
+void DebugDraw::Line2D(const glm::vec2& a, const glm::vec2& b, const glm::vec4& color) {
+    if (!IsEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, HudLines, 2)) {
+        uint32_t packed = packColor(color);
+        v[0] = { glm::vec3(a, 0.0f), packed };
+        v[1] = { glm::vec3(b, 0.0f), packed };
+    }
+    endWrite(buffer);
+}
+
+void DebugDraw::Rect2D(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) {
+    if (!IsEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, HudLines, 8)) {
+        uint32_t packed = packColor(color);
+        glm::vec3 corners[4] = { glm::vec3(min.x, min.y, 0.0f), glm::vec3(max.x, min.y, 0.0f),
+                                 glm::vec3(max.x, max.y, 0.0f), glm::vec3(min.x, max.y, 0.0f) };
+        for (int i = 0; i < 4; i++) {
+            v[i * 2] = { corners[i], packed };
+            v[i * 2 + 1] = { corners[(i + 1) % 4], packed };
+        }
+    }
+    endWrite(buffer);
+}
+
+void DebugDraw::FillRect2D(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) {
+    if (!IsEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, HudTriangles, 6)) {
+        uint32_t packed = packColor(color);
+        v[0] = { glm::vec3(min.x, min.y, 0.0f), packed };
+        v[1] = { glm::vec3(max.x, min.y, 0.0f), packed };
+        v[2] = { glm::vec3(max.x, max.y, 0.0f), packed };
+        v[3] = v[0];
+        v[4] = v[2];
+        v[5] = { glm::vec3(min.x, max.y, 0.0f), packed };
+    }
+    endWrite(buffer);
+}
+
+void DebugDraw::Circle2D(const glm::vec2& center, float radius, const glm::vec4& color, int segments) {
+    if (!IsEnabled() || segments < 3) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, HudLines, static_cast<size_t>(segments) * 2)) {
+        uint32_t packed = packColor(color);
+        float step = 2.0f * 3.14159265f / segments;
+        glm::vec3 previous(center.x + radius, center.y, 0.0f);
+        for (int i = 1; i <= segments; i++) {
+            glm::vec3 next(center.x + radius * std::cos(step * i), center.y + radius * std::sin(step * i), 0.0f);
+            v[(i - 1) * 2] = { previous, packed };
+            v[(i - 1) * 2 + 1] = { next, packed };
+            previous = next;
+        }
+    }
+    endWrite(buffer);
+}
+
+float DebugDraw::TextWidth(std::string_view text, float height) {
+    if (text.empty()) {
+        return 0.0f;
+    }
+    // The last glyph has no spacing after it
+    return (kGlyphAdvance * text.size() - (kGlyphAdvance - 4.0f)) * height / kGlyphHeight;
+}
+
+void DebugDraw::Text(const glm::vec2& position, std::string_view text, const glm::vec4& color, float height) {
+    if (!IsEnabled()) {
+        return;
+    }
+    size_t strokes = 0;
+    for (char c : text) {
+        if (const char* glyph = glyphFor(c)) {
+            strokes += strokeCount(glyph);
+        }
+    }
+    if (strokes == 0) {
+        return;
+    }
+
+    ThreadBuffer& buffer = threadBuffer();
+    if (Vertex* v = beginWrite(buffer, HudLines, strokes * 2)) {
+        uint32_t packed = packColor(color);
+        float scale = height / kGlyphHeight;
+        float x = position.x;
+        for (char c : text) {
+            const char* glyph = glyphFor(c);
+            for (const char* p = glyph; p && *p; ) {
+                if (*p == ' ') {
+                    p++;
+                    continue;
+                }
+                v[0] = { glm::vec3(x + (p[0] - '0') * scale, position.y + (p[1] - '0') * scale, 0.0f), packed };
+                v[1] = { glm::vec3(x + (p[2] - '0') * scale, position.y + (p[3] - '0') * scale, 0.0f), packed };
+                v += 2;
+                p += 4;
+            }
+            x += kGlyphAdvance * scale;
+        }
+    }
+    endWrite(buffer);
+}
+
+void DebugDraw::create() {
+    if (vertexArray != 0) {
+        return;
+    }
+    shader = std::make_unique<Shader>("shaders/debug.vert", "shaders/debug.frag");
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    GLState::Get().BindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DebugDraw::Flush(const glm::mat4& viewProjection, int width, int height) {
+    // Point every thread at its other half and wait out appends still writing
+    // the old one; threads keep queuing into the new half meanwhile
+    for (ThreadBuffer* buffer = threadBuffers.load(); buffer; buffer = buffer->next) {
+        buffer->half.store(buffer->half.load(std::memory_order_relaxed) ^ 1u);
+        while (buffer->writing.load()) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Merge list by list, so each list is one contiguous range
+    merged.clear();
+    size_t counts[kListCount] = {};
+    for (int list = 0; list < kListCount; list++) {
+        for (ThreadBuffer* buffer = threadBuffers.load(); buffer; buffer = buffer->next) {
+            std::vector<Vertex>& drained = buffer->lists[buffer->half.load(std::memory_order_relaxed) ^ 1u][list];
+            merged.insert(merged.end(), drained.begin(), drained.end());
+            counts[list] += drained.size();
+            drained.clear();
+        }
+    }
+    lastVertexCount = merged.size();
+    if (merged.empty()) {
+        return;
+    }
+
+    // Orphaned every frame, so the upload never waits on last frame's draws
+    create();
+    int64_t bytes = static_cast<int64_t>(merged.size() * sizeof(Vertex));
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (bytes > vertexBytes) {
+        int64_t capacity = std::max<int64_t>(bytes, vertexBytes * 2);
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, vertexBytes);
+        MemoryTracker::Get().Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, capacity);
+        vertexBytes = capacity;
+    }
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, merged.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLState& state = GLState::Get();
+    bool depthTest = state.IsEnabled(GL_DEPTH_TEST);
+    bool blend = state.IsEnabled(GL_BLEND);
+    state.SetEnabled(GL_DEPTH_TEST, false);
+    state.SetEnabled(GL_BLEND, true);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    shader->use();
+    state.BindVertexArray(vertexArray);
+
+    GLint first = 0;
+    if (counts[WorldLines] > 0) {
+        shader->setMat4("transform", viewProjection);
+        glDrawArrays(GL_LINES, first, static_cast<GLsizei>(counts[WorldLines]));
+    }
+    first += static_cast<GLint>(counts[WorldLines]);
+    // Pixels with y down; filled shapes first so lines and text land on top
+    shader->setMat4("transform", glm::ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f));
+    if (counts[HudTriangles] > 0) {
+        glDrawArrays(GL_TRIANGLES, first, static_cast<GLsizei>(counts[HudTriangles]));
+    }
+    first += static_cast<GLint>(counts[HudTriangles]);
+    if (counts[HudLines] > 0) {
+        glDrawArrays(GL_LINES, first, static_cast<GLsizei>(counts[HudLines]));
+    }
+
+    state.SetEnabled(GL_DEPTH_TEST, depthTest);
+    state.SetEnabled(GL_BLEND, blend);
+}
+
+void DebugDraw::Destroy() {
+    if (vertexArray == 0) {
+        return;
+    }
+    DeletionQueue::Get().DeleteVertexArray(vertexArray);
+    DeletionQueue::Get().DeleteBuffer(vertexBuffer, kAssetName, MemoryCategory::Vertex, vertexBytes);
+    glDeleteProgram(shader->ID);
+    shader.reset();
+    vertexArray = vertexBuffer = 0;
+    vertexBytes = 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "shader.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+// Immediate-mode lines and overlays for debugging and the HUD. Any thread may
+// queue shapes at any time: each appends to a buffer of its own without
+// locking, and Flush() merges them all into one streamed vertex buffer drawn
+// with at most three draw calls (world lines, HUD triangles, HUD lines).
+// Everything is drawn over the finished frame at native resolution, after the
+// scene's GPU timing, so queuing thousands of shapes only costs the appends.
+class DebugDraw {
+public:
+    static DebugDraw& Get();
+
+    // While disabled every call returns at once and nothing is queued
+    void SetEnabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // World space, drawn without depth testing
+    void Line(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color);
+    // Consecutive pairs of points, one segment each
+    void Lines(const glm::vec3* points, size_t count, const glm::vec4& color);
+    void Box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color);
+    // Box in model space placed by `matrix`
+    void Box(const glm::mat4& matrix, const glm::vec3& min, const glm::vec3& max, const glm::vec4& color);
+    // The volume a view-projection matrix sees
+    void Frustum(const glm::mat4& viewProjection, const glm::vec4& color);
+    // Red, green and blue along the matrix's x, y and z axes
+    void Axes(const glm::mat4& matrix, float length = 1.0f);
+
+    // HUD, in pixels from the top-left corner of the window
+    void Line2D(const glm::vec2& a, const glm::vec2& b, const glm::vec4& color);
+    void Rect2D(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color);
+    void FillRect2D(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color);
+    void Circle2D(const glm::vec2& center, float radius, const glm::vec4& color, int segments = 32);
+    // Stroke font of digits, capitals (lower case is drawn as capitals) and common
+    // punctuation; position is the top-left corner and height the capital height in pixels
+    void Text(const glm::vec2& position, std::string_view text, const glm::vec4& color, float height = 12.0f);
+    static float TextWidth(std::string_view text, float height = 12.0f);
+
+    // Once per frame on the GL thread, into the current framebuffer: draws and clears
+    // everything queued so far. width and height are the framebuffer's size in pixels.
+    void Flush(const glm::mat4& viewProjection, int width, int height);
+    size_t GetLastVertexCount() const { return lastVertexCount; }
+
+    // Releases the GL objects, e.g. at shutdown
+    void Destroy();
+
+private:
+    struct Vertex {
+        glm::vec3 position;
+        uint32_t color;   // RGBA8
+    };
+
+    // Also the order of the merged ranges and their draws
+    enum List {
+        WorldLines,
+        HudTriangles,
+        HudLines,
+        kListCount
+    };
+
+    struct ThreadBuffer;
+
+    // Per list and thread; shapes beyond it are dropped until the next Flush()
+    static const size_t kMaxQueuedVertices = 1 << 22;
+
+    DebugDraw() = default;
+    ~DebugDraw();
+
+    std::atomic<bool> enabled{true};
+    std::atomic<ThreadBuffer*> threadBuffers{nullptr};   // Lock-free list, one per thread that has drawn
+
+    std::vector<Vertex> merged;
+    size_t lastVertexCount = 0;
+    std::unique_ptr<Shader> shader;
+    GLuint vertexArray = 0, vertexBuffer = 0;
+    int64_t vertexBytes = 0;
+
+    ThreadBuffer& threadBuffer();
+    Vertex* beginWrite(ThreadBuffer& buffer, List list, size_t count);
+    void endWrite(ThreadBuffer& buffer);
+    void create();
+};
@@ -0,0 +1,81 @@
+#include "deletion_queue.h"
+#include "gl_state.h"
+#include <algorithm>
+
+DeletionQueue& DeletionQueue::Get() {
+    static DeletionQueue instance;
+    return instance;
+}
+
+void DeletionQueue::DeleteBuffer(GLuint id, const std::string& asset, MemoryCategory category, int64_t bytes) {
+    Enqueue(ObjectType::Buffer, id, asset, category, bytes);
+}
+
+void DeletionQueue::DeleteTexture(GLuint id, const std::string& asset, int64_t bytes) {
+    Enqueue(ObjectType::Texture, id, asset, MemoryCategory::Texture, bytes);
+}
+
+void DeletionQueue::DeleteVertexArray(GLuint id) {
+    Enqueue(ObjectType::VertexArray, id, std::string(), MemoryCategory::Vertex, 0);
+}
+
+void DeletionQueue::Enqueue(ObjectType type, GLuint id, const std::string& asset, MemoryCategory category, int64_t bytes) {
+    if (id == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back({type, id, asset, category, bytes, frame});
+}
+
+void DeletionQueue::Destroy(const PendingDelete& entry) {
+    switch (entry.type) {
+        case ObjectType::Buffer:
+            glDeleteBuffers(1, &entry.id);
+            break;
+        case ObjectType::Texture:
+            GLState::Get().ForgetTexture(entry.id);
+            glDeleteTextures(1, &entry.id);
+            break;
+        case ObjectType::VertexArray:
+            GLState::Get().ForgetVertexArray(entry.id);
+            glDeleteVertexArrays(1, &entry.id);
+            break;
+    }
+    if (entry.bytes != 0) {
+        MemoryTracker::Get().Remove(entry.asset, entry.category, MemoryDomain::GPU, entry.bytes);
+    }
+}
+
+void DeletionQueue::EndFrame() {
+    std::vector<PendingDelete> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame++;
+        auto split = std::partition(pending.begin(), pending.end(), [&](const PendingDelete& entry) {
+            return frame - entry.frame < kFramesInFlight;
+        });
+        ready.assign(split, pending.end());
+        pending.erase(split, pending.end());
+    }
+
+    for (const auto& entry : ready) {
+        Destroy(entry);
+    }
+}
+
+void DeletionQueue::FlushAll() {
+    std::vector<PendingDelete> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(pending);
+    }
+
+    for (const auto& entry : ready) {
+        Destroy(entry);
+    }
+}
+
+size_t DeletionQueue::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size();
+}
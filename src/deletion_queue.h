@@ -0,0 +1,53 @@
+#pragma once
+#include "memory_tracker.h"
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+// GL objects released by their owners are kept alive for a few frames, since
+// in-flight command buffers may still reference them, and are then deleted on
+// the GL thread from EndFrame(). GPU byte counters are released at the same time.
+class DeletionQueue {
+public:
+    static DeletionQueue& Get();
+
+    void DeleteBuffer(GLuint id, const std::string& asset, MemoryCategory category, int64_t bytes);
+    void DeleteTexture(GLuint id, const std::string& asset, int64_t bytes);
+    void DeleteVertexArray(GLuint id);
+
+    // Call once per frame after swapping buffers
+    void EndFrame();
+    // Delete everything immediately, e.g. at shutdown
+    void FlushAll();
+
+    size_t GetPendingCount() const;
+
+private:
+    enum class ObjectType { Buffer, Texture, VertexArray };
+
+    struct PendingDelete {
+        ObjectType type;
+        GLuint id;
+        std::string asset;
+        MemoryCategory category;
+        int64_t bytes;
+        uint64_t frame;
+    };
+
+    static const uint64_t kFramesInFlight = 3;
+
+    DeletionQueue() = default;
+
+    mutable std::mutex mutex;
+    std::vector<PendingDelete> pending;
+    uint64_t frame = 0;
+
+    void Enqueue(ObjectType type, GLuint id, const std::string& asset, MemoryCategory category, int64_t bytes);
+    void Destroy(const PendingDelete& entry);
+};
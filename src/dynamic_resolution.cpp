@@ -0,0 +1,201 @@
+#include "dynamic_resolution.h"
+#include "gl_state.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(int width, int height, const DynamicResolutionSettings& settings)
+    : settings(settings), width(width), height(height), scale(settings.maxScale), gpuTimeMs(0.0f), queryIndex(0) {
+    glGenQueries(kQueryCount, queries);
+    for (int i = 0; i < kQueryCount; i++) {
+        queryPending[i] = false;
+        queryScale[i] = scale;
+    }
+
+    glGenVertexArrays(1, &emptyVAO);
+    if (settings.sharpness > 0.0f) {
+        upscaleShader = std::make_unique<Shader>("shaders/upscale.vert", "shaders/upscale.frag");
+    }
+
+    createTargets();
+}
+
+DynamicResolution::~DynamicResolution() {
+    destroyTargets();
+    glDeleteQueries(kQueryCount, queries);
+    GLState::Get().ForgetVertexArray(emptyVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void DynamicResolution::Resize(int newWidth, int newHeight) {
+    if (newWidth == width && newHeight == height) {
+        return;
+    }
+    width = newWidth;
+    height = newHeight;
+    destroyTargets();
+    createTargets();
+}
+
+void DynamicResolution::createTargets() {
+    // Targets are sized for the maximum scale; lower scales render into a sub-rectangle
+    int maxWidth = std::max(1, static_cast<int>(std::ceil(width * settings.maxScale)));
+    int maxHeight = std::max(1, static_cast<int>(std::ceil(height * settings.maxScale)));
+
+    glGenRenderbuffers(1, &msColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, msColor);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, settings.samples, GL_RGBA8, maxWidth, maxHeight);
+
+    glGenRenderbuffers(1, &msDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, msDepth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, settings.samples, GL_DEPTH24_STENCIL8, maxWidth, maxHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &msFBO);
+    GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, msFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, msColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, msDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Error: Dynamic resolution MSAA framebuffer is incomplete" << std::endl;
+    }
+
+    glGenTextures(1, &resolveColor);
+    GLState::Get().BindTexture(GL_TEXTURE_2D, resolveColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, maxWidth, maxHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLState::Get().BindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &resolveFBO);
+    GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resolveColor, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Error: Dynamic resolution resolve framebuffer is incomplete" << std::endl;
+    }
+
+    GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::destroyTargets() {
+    GLState& state = GLState::Get();
+    state.ForgetFramebuffer(msFBO);
+    state.ForgetFramebuffer(resolveFBO);
+    state.ForgetTexture(resolveColor);
+    glDeleteFramebuffers(1, &msFBO);
+    glDeleteFramebuffers(1, &resolveFBO);
+    glDeleteRenderbuffers(1, &msColor);
+    glDeleteRenderbuffers(1, &msDepth);
+    glDeleteTextures(1, &resolveColor);
+    msFBO = resolveFBO = msColor = msDepth = resolveColor = 0;
+}
+
+void DynamicResolution::BeginScene() {
+    readTimings();
+
+    renderWidth = std::max(1, static_cast<int>(width * scale));
+    renderHeight = std::max(1, static_cast<int>(height * scale));
+
+    GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, msFBO);
+    GLState::Get().Viewport(0, 0, renderWidth, renderHeight);
+
+    // Skip the timer this frame if the driver has not returned the oldest result yet
+    if (!queryPending[queryIndex]) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+        queryScale[queryIndex] = scale;
+    }
+}
+
+void DynamicResolution::EndScene() {
+    if (!queryPending[queryIndex]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[queryIndex] = true;
+        queryIndex = (queryIndex + 1) % kQueryCount;
+    }
+
+    // Resolve MSAA at render size
+    GLState::Get().BindFramebuffer(GL_READ_FRAMEBUFFER, msFBO);
+    GLState::Get().BindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+    glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    // Upscale into the default framebuffer
+    GLState::Get().BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    GLState::Get().Viewport(0, 0, width, height);
+    if (upscaleShader) {
+        GLState::Get().BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        GLState& state = GLState::Get();
+        bool depthTest = state.IsEnabled(GL_DEPTH_TEST);
+        bool blend = state.IsEnabled(GL_BLEND);
+        state.SetEnabled(GL_DEPTH_TEST, false);
+        state.SetEnabled(GL_BLEND, false);
+
+        int maxWidth = std::max(1, static_cast<int>(std::ceil(width * settings.maxScale)));
+        int maxHeight = std::max(1, static_cast<int>(std::ceil(height * settings.maxScale)));
+
+        upscaleShader->use();
+        upscaleShader->setInt("sceneColor", 0);
+        upscaleShader->setFloat("sharpness", settings.sharpness);
+        upscaleShader->setVec4("sourceRect", glm::vec4(
+            static_cast<float>(renderWidth) / maxWidth,
+            static_cast<float>(renderHeight) / maxHeight,
+            1.0f / maxWidth,
+            1.0f / maxHeight));
+
+        state.BindTexture(0, GL_TEXTURE_2D, resolveColor);
+        state.BindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        state.SetEnabled(GL_DEPTH_TEST, depthTest);
+        state.SetEnabled(GL_BLEND, blend);
+    } else {
+        GLState::Get().BindFramebuffer(GL_READ_FRAMEBUFFER, resolveFBO);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+
+    GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::readTimings() {
+    // Results arrive a few frames late; only read the ones that are ready so we never stall
+    for (int i = 0; i < kQueryCount; i++) {
+        int index = (queryIndex + i) % kQueryCount;
+        if (!queryPending[index]) {
+            continue;
+        }
+
+        GLint available = 0;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+        queryPending[index] = false;
+        gpuTimeMs = static_cast<float>(elapsed) / 1.0e6f;
+        updateScale(gpuTimeMs, queryScale[index]);
+    }
+}
+
+void DynamicResolution::updateScale(float measuredMs, float measuredScale) {
+    if (measuredMs <= 0.0f) {
+        return;
+    }
+
+    // Pixel cost scales with area, so correct the per-axis scale by the square root.
+    // The timing is a few frames old: correct the scale that frame rendered at, not
+    // the current one, or results still in flight push an already moved scale again.
+    float desired = measuredScale * std::sqrt(settings.targetFrameMs / measuredMs);
+    desired = std::min(std::max(desired, settings.minScale), settings.maxScale);
+
+    // Drop quickly when over budget, recover slowly to avoid oscillating
+    float rate = desired < scale ? 0.5f : 0.05f;
+    float next = scale + (desired - scale) * rate;
+    if (std::abs(next - scale) > 0.005f) {
+        scale = next;
+    }
+}
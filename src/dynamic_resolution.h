@@ -0,0 +1,51 @@
+#pragma once
+#include "shader.h"
+#include <memory>
+
+struct DynamicResolutionSettings {
+    float targetFrameMs = 16.0f;  // GPU time budget for the 3D scene
+    float minScale = 0.5f;        // Lowest per-axis render scale
+    float maxScale = 1.0f;        // Highest per-axis render scale
+    int samples = 4;              // MSAA samples of the offscreen target
+    float sharpness = 0.25f;      // 0 = plain filtered blit, > 0 = sharpening pass
+};
+
+// Renders the 3D scene into an offscreen target whose per-axis scale follows
+// the measured GPU time, then upscales it into the default framebuffer.
+// Anything drawn after EndScene() (HUD, debug overlays) stays at native size.
+class DynamicResolution {
+public:
+    DynamicResolution(int width, int height, const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+    ~DynamicResolution();
+
+    void Resize(int width, int height);
+    void BeginScene();
+    void EndScene();
+
+    float GetScale() const { return scale; }
+    float GetGpuTimeMs() const { return gpuTimeMs; }
+
+private:
+    static const int kQueryCount = 4;
+
+    DynamicResolutionSettings settings;
+    int width, height;
+    int renderWidth, renderHeight;
+    float scale;
+    float gpuTimeMs;
+
+    GLuint msFBO = 0, msColor = 0, msDepth = 0;
+    GLuint resolveFBO = 0, resolveColor = 0;
+    GLuint emptyVAO = 0;
+    std::unique_ptr<Shader> upscaleShader;
+
+    GLuint queries[kQueryCount];
+    bool queryPending[kQueryCount];
+    float queryScale[kQueryCount];   // Scale the timed frame rendered at
+    int queryIndex;
+
+    void createTargets();
+    void destroyTargets();
+    void readTimings();
+    void updateScale(float measuredMs, float measuredScale);
+};
@@ -0,0 +1,129 @@
+#include "edges.h"
+#include "../external/glm/glm/glm.hpp"
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+
+namespace {
+
+struct EdgeRecord {
+    unsigned int a, b;        // Original vertex indices from the first face
+    glm::vec3 normal;         // Face normal of the first face
+    glm::vec2 uvA, uvB;       // UVs of the first face at a and b
+    int faceCount = 0;
+    bool feature = false;
+};
+
+// Quantize positions so vertices split at UV/normal seams weld back together.
+struct PositionKey {
+    int32_t x, y, z;
+    bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        return (static_cast<size_t>(k.x) * 73856093u) ^ (static_cast<size_t>(k.y) * 19349663u) ^
+               (static_cast<size_t>(k.z) * 83492791u);
+    }
+};
+
+}
+
+std::vector<unsigned int> BuildFeatureEdges(const std::vector<float>& vertices,
+                                            const std::vector<unsigned int>& indices,
+                                            size_t stride, size_t uvOffset,
+                                            const EdgeSettings& settings) {
+    std::vector<unsigned int> lines;
+    size_t vertexCount = vertices.size() / stride;
+    if (vertexCount == 0 || indices.size() < 3) {
+        return lines;
+    }
+
+    auto position = [&](unsigned int i) {
+        return glm::vec3(vertices[i * stride + 0], vertices[i * stride + 1], vertices[i * stride + 2]);
+    };
+    auto uv = [&](unsigned int i) {
+        return glm::vec2(vertices[i * stride + uvOffset], vertices[i * stride + uvOffset + 1]);
+    };
+
+    // Weld tolerance relative to the mesh extent
+    glm::vec3 minPos = position(0);
+    glm::vec3 maxPos = minPos;
+    for (unsigned int i = 1; i < vertexCount; i++) {
+        minPos = glm::min(minPos, position(i));
+        maxPos = glm::max(maxPos, position(i));
+    }
+    float extent = glm::length(maxPos - minPos);
+    float invCell = extent > 0.0f ? 1.0f / (extent * 1e-5f) : 1.0f;
+
+    std::vector<uint32_t> weld(vertexCount);
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> weldMap;
+    weldMap.reserve(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        glm::vec3 p = position(i) * invCell;
+        PositionKey key{static_cast<int32_t>(std::lround(p.x)),
+                        static_cast<int32_t>(std::lround(p.y)),
+                        static_cast<int32_t>(std::lround(p.z))};
+        auto it = weldMap.emplace(key, static_cast<uint32_t>(weldMap.size())).first;
+        weld[i] = it->second;
+    }
+
+    float creaseCos = std::cos(glm::radians(settings.creaseAngle));
+    std::unordered_map<uint64_t, EdgeRecord> edges;
+    edges.reserve(indices.size());
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        unsigned int tri[3] = {indices[t], indices[t + 1], indices[t + 2]};
+        glm::vec3 n = glm::cross(position(tri[1]) - position(tri[0]), position(tri[2]) - position(tri[0]));
+        float area = glm::length(n);
+        if (area <= 0.0f) {
+            continue;  // Degenerate triangles contribute no adjacency
+        }
+        n /= area;
+
+        for (int e = 0; e < 3; e++) {
+            unsigned int a = tri[e];
+            unsigned int b = tri[(e + 1) % 3];
+            uint32_t wa = weld[a];
+            uint32_t wb = weld[b];
+            if (wa == wb) {
+                continue;
+            }
+            if (wa > wb) {
+                std::swap(wa, wb);
+                std::swap(a, b);
+            }
+            uint64_t key = (static_cast<uint64_t>(wa) << 32) | wb;
+
+            EdgeRecord& edge = edges[key];
+            if (edge.faceCount == 0) {
+                edge.a = a;
+                edge.b = b;
+                edge.normal = n;
+                edge.uvA = uv(a);
+                edge.uvB = uv(b);
+            } else if (edge.faceCount == 1) {
+                if (glm::dot(edge.normal, n) < creaseCos) {
+                    edge.feature = true;
+                }
+                if (settings.uvSeams && (uv(a) != edge.uvA || uv(b) != edge.uvB)) {
+                    edge.feature = true;
+                }
+            } else {
+                edge.feature = true;  // Non-manifold edge
+            }
+            edge.faceCount++;
+        }
+    }
+
+    lines.reserve(edges.size());
+    for (const auto& entry : edges) {
+        const EdgeRecord& edge = entry.second;
+        bool boundary = settings.boundaryEdges && edge.faceCount == 1;
+        if (edge.feature || boundary) {
+            lines.push_back(edge.a);
+            lines.push_back(edge.b);
+        }
+    }
+    return lines;
+}
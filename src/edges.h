@@ -0,0 +1,19 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Feature-edge extraction for the outline look. Edges are found once from the
+// triangle adjacency of a mesh and returned as a GL_LINES index list that
+// points into the mesh's own vertex buffer.
+struct EdgeSettings {
+    float creaseAngle = 30.0f;   // Dihedral angle (degrees) above which an edge is a crease
+    bool boundaryEdges = true;   // Open edges with a single face (silhouette candidates)
+    bool uvSeams = true;         // Edges where the two faces disagree on UVs
+};
+
+// vertices is interleaved with the given stride (in floats); position must be
+// at offset 0 and UVs at uvOffset. Each edge is emitted once.
+std::vector<unsigned int> BuildFeatureEdges(const std::vector<float>& vertices,
+                                            const std::vector<unsigned int>& indices,
+                                            size_t stride, size_t uvOffset,
+                                            const EdgeSettings& settings = EdgeSettings());
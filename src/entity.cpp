@@ -1,29 +1,52 @@
 #include "entity.h"
+#include "model_data.h"
 
-Entity::Entity(Model* model, Shader* shader, const glm::vec3& position,
+glm::mat4 Transform::ToMatrix() const {
+    glm::mat4 matrix = glm::mat4(1.0f);
+    matrix = glm::translate(matrix, position);
+    matrix = glm::rotate(matrix, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    matrix = glm::rotate(matrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    matrix = glm::rotate(matrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    matrix = glm::scale(matrix, scale);
+    return matrix;
+}
+
+Transform Transform::Interpolate(const Transform& a, const Transform& b, float alpha) {
+    Transform result;
+    result.position = glm::mix(a.position, b.position, alpha);
+    result.rotation = glm::mix(a.rotation, b.rotation, alpha);
+    result.scale = glm::mix(a.scale, b.scale, alpha);
+    return result;
+}
+
+Entity::Entity(ModelHandle model, ShaderHandle shader, const ModelData& source, const glm::vec3& position,
                const glm::vec3& rotation, const glm::vec3& scale)
-    : model(model), shader(shader), position(position), rotation(rotation), scale(scale) {
+    : model(model), shader(shader) {
+    transform.position = position;
+    transform.rotation = rotation;
+    transform.scale = scale;
     UpdateModelMatrix();
-}
+    renderPrevious = transform;
+    renderCurrent = transform;
 
-void Entity::Draw() {
-    shader->use();
-    shader->setMat4("model", modelMatrix);
-    model->Draw(*shader);
+    if (source.IsAnimated()) {
+        animator = std::make_unique<Animator>(source.GetSkeleton(), source.GetAnimations());
+        animator->Play(0);
+    }
 }
 
 void Entity::SetPosition(const glm::vec3& newPosition) {
-    position = newPosition;
+    transform.position = newPosition;
     UpdateModelMatrix();
 }
 
 void Entity::SetRotation(const glm::vec3& newRotation) {
-    rotation = newRotation;
+    transform.rotation = newRotation;
     UpdateModelMatrix();
 }
 
 void Entity::SetScale(const glm::vec3& newScale) {
-    scale = newScale;
+    transform.scale = newScale;
     UpdateModelMatrix();
 }
 
@@ -31,11 +54,63 @@ glm::mat4 Entity::GetModelMatrix() const {
     return modelMatrix;
 }
 
+void Entity::PublishState() {
+    renderPrevious = renderCurrent;
+    renderCurrent = transform;
+}
+
+glm::mat4 Entity::GetInterpolatedModelMatrix(float alpha) const {
+    return Transform::Interpolate(renderPrevious, renderCurrent, alpha).ToMatrix();
+}
+
+void Entity::SetCollider(ColliderId id, const glm::vec3& localCenter, const glm::vec3& localHalfExtents) {
+    collider = id;
+    colliderCenter = localCenter;
+    colliderHalfExtents = localHalfExtents;
+    colliderDirty = true;
+}
+
+void Entity::SyncCollider(CollisionWorld& world) {
+    if (collider == kInvalidCollider || !colliderDirty) {
+        return;
+    }
+    colliderDirty = false;
+
+    // Scale moves into the half extents so the box axes stay unit length
+    glm::mat3 axes;
+    glm::vec3 halfExtents;
+    for (int i = 0; i < 3; i++) {
+        glm::vec3 column = glm::vec3(modelMatrix[i]);
+        float length = glm::length(column);
+        axes[i] = length > 0.0f ? column / length : glm::vec3(0.0f);
+        halfExtents[i] = colliderHalfExtents[i] * length;
+    }
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(colliderCenter, 1.0f));
+    world.SetBox(collider, center, axes, halfExtents);
+}
+
+Ray Entity::ToModelSpace(const Ray& worldRay) const {
+    glm::mat4 inverse = glm::inverse(modelMatrix);
+    Ray local;
+    local.origin = glm::vec3(inverse * glm::vec4(worldRay.origin, 1.0f));
+    local.direction = glm::vec3(inverse * glm::vec4(worldRay.direction, 0.0f));
+    local.maxDistance = worldRay.maxDistance;
+    return local;
+}
+
+bool Entity::Raycast(const TriangleBVH& bvh, const Ray& worldRay, RayHit& hit) const {
+    if (bvh.Empty()) {
+        return false;
+    }
+    return bvh.Raycast(ToModelSpace(worldRay), hit);
+}
+
+glm::vec3 Entity::GetWorldNormal(const TriangleBVH& bvh, const RayHit& hit) const {
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+    return glm::normalize(normalMatrix * bvh.GetTriangleNormal(hit.triangle));
+}
+
 void Entity::UpdateModelMatrix() {
-    modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, position);
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-    modelMatrix = glm::scale(modelMatrix, scale);
-} 
\ No newline at end of file
+    modelMatrix = transform.ToMatrix();
+    colliderDirty = true;
+}
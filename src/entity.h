@@ -1,30 +1,93 @@
 #pragma once
-#include "model.h"
-#include "shader.h"
+#include "registry.h"
+#include "collision.h"
+#include "animation.h"
 #include "../external/glm/glm/glm.hpp"
 #include "../external/glm/glm/gtc/matrix_transform.hpp"
+#include <memory>
 
+struct Transform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);  // Euler angles in degrees
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    glm::mat4 ToMatrix() const;
+    static Transform Interpolate(const Transform& a, const Transform& b, float alpha);
+};
+
+// Refers to its model and shader by handle; World and Scene resolve them, and
+// an entity whose model was removed is skipped rather than left dangling. Scene
+// draws it; the shader handle is null for entities that are never drawn.
 class Entity {
 public:
-    Entity(Model* model, Shader* shader, const glm::vec3& position = glm::vec3(0.0f),
+    // `source` is the model `model` refers to, read once for its skeleton
+    Entity(ModelHandle model, ShaderHandle shader, const ModelData& source, const glm::vec3& position = glm::vec3(0.0f),
            const glm::vec3& rotation = glm::vec3(0.0f),
            const glm::vec3& scale = glm::vec3(1.0f));
 
-    void Draw();
+    // Simulation-side state; only touch from the simulation tick
     void SetPosition(const glm::vec3& position);
     void SetRotation(const glm::vec3& rotation);
     void SetScale(const glm::vec3& scale);
-    
+    const Transform& GetTransform() const { return transform; }
+
     glm::mat4 GetModelMatrix() const;
-    Shader* GetShader() const { return shader; }
+    ShaderHandle GetShader() const { return shader; }
+    ModelHandle GetModel() const { return model; }
+
+    // Assigned by World and never reused; identifies the entity in replication
+    uint32_t GetId() const { return id; }
+    void SetId(uint32_t newId) { id = newId; }
+    // The entity's own handle in World
+    EntityHandle GetHandle() const { return handle; }
+    void SetHandle(EntityHandle newHandle) { handle = newHandle; }
+
+    // Static entities never move once placed; set through Scene::SetStatic,
+    // which merges them into static batches
+    bool IsStatic() const { return isStatic; }
+    void SetStatic(bool value) { isStatic = value; }
+    // Render-side: drawn as part of a static batch instead of on its own
+    bool IsBatched() const { return batched; }
+    void SetBatched(bool value) { batched = value; }
+
+    // Box collider in model space, kept in sync with the transform by SyncCollider()
+    void SetCollider(ColliderId id, const glm::vec3& localCenter, const glm::vec3& localHalfExtents);
+    ColliderId GetCollider() const { return collider; }
+    void SyncCollider(CollisionWorld& world);
+
+    // Ray casts against the model's triangles. The model-space ray keeps the
+    // world ray's parameterisation, so hit distances are valid in either space.
+    Ray ToModelSpace(const Ray& worldRay) const;
+    bool Raycast(const TriangleBVH& bvh, const Ray& worldRay, RayHit& hit) const;
+    glm::vec3 GetWorldNormal(const TriangleBVH& bvh, const RayHit& hit) const;
+
+    // Present for animated models; render-side, advanced by Scene::UpdateEffects
+    Animator* GetAnimator() const { return animator.get(); }
+
+    // Render-side state: the last two published ticks, swapped under World's state lock
+    void PublishState();
+    glm::mat4 GetInterpolatedModelMatrix(float alpha) const;
+    const Transform& GetRenderTransform() const { return renderCurrent; }
 
 private:
-    Model* model;
-    Shader* shader;
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 scale;
+    ModelHandle model;
+    ShaderHandle shader;
+    uint32_t id = 0;
+    EntityHandle handle;
+    Transform transform;
     glm::mat4 modelMatrix;
-    
+    bool isStatic = false;
+    bool batched = false;
+
+    ColliderId collider = kInvalidCollider;
+    glm::vec3 colliderCenter = glm::vec3(0.0f);
+    glm::vec3 colliderHalfExtents = glm::vec3(0.0f);
+    bool colliderDirty = false;
+
+    std::unique_ptr<Animator> animator;
+
+    Transform renderPrevious;
+    Transform renderCurrent;
+
     void UpdateModelMatrix();
-}; 
\ No newline at end of file
+};
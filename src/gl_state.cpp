@@ -0,0 +1,240 @@
+#include "gl_state.h"
+
+namespace {
+
+int targetIndex(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_BUFFER: return 2;
+        case GL_TEXTURE_CUBE_MAP: return 3;
+        default: return -1;
+    }
+}
+
+int capabilityIndex(GLenum capability) {
+    switch (capability) {
+        case GL_BLEND: return 0;
+        case GL_DEPTH_TEST: return 1;
+        case GL_CULL_FACE: return 2;
+        default: return -1;
+    }
+}
+
+}
+
+GLState& GLState::Get() {
+    static GLState instance;
+    return instance;
+}
+
+bool GLState::changed(GLuint& cached, GLuint value) {
+    if (cached == value) {
+        stats.skipped++;
+        return false;
+    }
+    cached = value;
+    stats.issued++;
+    return true;
+}
+
+void GLState::UseProgram(GLuint newProgram) {
+    if (changed(program, newProgram)) {
+        glUseProgram(newProgram);
+    }
+}
+
+void GLState::BindVertexArray(GLuint newVertexArray) {
+    if (changed(vertexArray, newVertexArray)) {
+        glBindVertexArray(newVertexArray);
+    }
+}
+
+void GLState::ActiveTexture(int unit) {
+    GLuint cached = static_cast<GLuint>(activeUnit);
+    if (changed(cached, static_cast<GLuint>(unit))) {
+        activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void GLState::BindTexture(int unit, GLenum target, GLuint texture) {
+    int index = targetIndex(target);
+    if (index >= 0 && unit < kTextureUnits && textures[unit][index] == texture) {
+        stats.skipped++;
+        return;
+    }
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture) {
+    int index = targetIndex(target);
+    if (index < 0 || activeUnit < 0 || activeUnit >= kTextureUnits) {
+        stats.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (changed(textures[activeUnit][index], texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer) {
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if ((!read || readFramebuffer == framebuffer) && (!draw || drawFramebuffer == framebuffer)) {
+        stats.skipped++;
+        return;
+    }
+    if (read) {
+        readFramebuffer = framebuffer;
+    }
+    if (draw) {
+        drawFramebuffer = framebuffer;
+    }
+    stats.issued++;
+    glBindFramebuffer(target, framebuffer);
+}
+
+GLuint GLState::GetFramebuffer(GLenum target) const {
+    GLuint cached = target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer;
+    if (cached != kUnknown) {
+        return cached;
+    }
+    GLint binding = 0;
+    glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &binding);
+    return static_cast<GLuint>(binding);
+}
+
+void GLState::SetEnabled(GLenum capability, bool enabled) {
+    int index = capabilityIndex(capability);
+    if (index >= 0) {
+        if (capabilities[index] == static_cast<int8_t>(enabled)) {
+            stats.skipped++;
+            return;
+        }
+        capabilities[index] = static_cast<int8_t>(enabled);
+    }
+    stats.issued++;
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+bool GLState::IsEnabled(GLenum capability) {
+    int index = capabilityIndex(capability);
+    if (index >= 0 && capabilities[index] >= 0) {
+        return capabilities[index] != 0;
+    }
+    // Unknown until first set; ask once and remember
+    bool enabled = glIsEnabled(capability) == GL_TRUE;
+    if (index >= 0) {
+        capabilities[index] = static_cast<int8_t>(enabled);
+    }
+    return enabled;
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination) {
+    if (blendSource == source && blendDestination == destination) {
+        stats.skipped++;
+        return;
+    }
+    blendSource = source;
+    blendDestination = destination;
+    stats.issued++;
+    glBlendFunc(source, destination);
+}
+
+void GLState::DepthMask(bool write) {
+    if (depthWrite == static_cast<int8_t>(write)) {
+        stats.skipped++;
+        return;
+    }
+    depthWrite = static_cast<int8_t>(write);
+    stats.issued++;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::DepthFunc(GLenum function) {
+    if (changed(depthFunction, function)) {
+        glDepthFunc(function);
+    }
+}
+
+void GLState::CullFace(GLenum face) {
+    if (changed(cullFace, face)) {
+        glCullFace(face);
+    }
+}
+
+void GLState::Viewport(int x, int y, int width, int height) {
+    if (viewportKnown && viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height) {
+        stats.skipped++;
+        return;
+    }
+    viewport[0] = x;
+    viewport[1] = y;
+    viewport[2] = width;
+    viewport[3] = height;
+    viewportKnown = true;
+    stats.issued++;
+    glViewport(x, y, width, height);
+}
+
+void GLState::GetViewport(int result[4]) {
+    if (!viewportKnown) {
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        viewportKnown = true;
+    }
+    for (int i = 0; i < 4; i++) {
+        result[i] = viewport[i];
+    }
+}
+
+void GLState::ForgetTexture(GLuint texture) {
+    for (auto& unit : textures) {
+        for (GLuint& bound : unit) {
+            if (bound == texture) {
+                bound = 0;
+            }
+        }
+    }
+}
+
+void GLState::ForgetVertexArray(GLuint deleted) {
+    if (vertexArray == deleted) {
+        vertexArray = 0;
+    }
+}
+
+void GLState::ForgetFramebuffer(GLuint framebuffer) {
+    if (readFramebuffer == framebuffer) {
+        readFramebuffer = 0;
+    }
+    if (drawFramebuffer == framebuffer) {
+        drawFramebuffer = 0;
+    }
+}
+
+void GLState::Invalidate() {
+    program = kUnknown;
+    vertexArray = kUnknown;
+    activeUnit = -1;
+    for (auto& unit : textures) {
+        for (GLuint& bound : unit) {
+            bound = kUnknown;
+        }
+    }
+    readFramebuffer = drawFramebuffer = kUnknown;
+    for (int8_t& capability : capabilities) {
+        capability = -1;
+    }
+    blendSource = blendDestination = kUnknown;
+    depthWrite = -1;
+    depthFunction = kUnknown;
+    cullFace = kUnknown;
+    viewportKnown = false;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+// CPU mirror of the GL state the renderer changes most often: program, vertex
+// array, texture bindings, framebuffers, blend, depth, cull and viewport.
+// Setters drop calls that would not change anything, and getters answer from
+// the mirror instead of glGet, which can stall until the driver catches up.
+// All changes to this state must go through here, on the GL thread.
+class GLState {
+public:
+    static GLState& Get();
+
+    struct Stats {
+        uint64_t issued = 0;
+        uint64_t skipped = 0;
+    };
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+    void ActiveTexture(int unit);
+    // Binds on `unit` and leaves it active
+    void BindTexture(int unit, GLenum target, GLuint texture);
+    // Binds on whichever unit is active, for uploads that don't care which
+    void BindTexture(GLenum target, GLuint texture);
+    // GL_FRAMEBUFFER sets both the read and draw bindings
+    void BindFramebuffer(GLenum target, GLuint framebuffer);
+    GLuint GetFramebuffer(GLenum target) const;
+
+    // GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are mirrored; other capabilities pass through
+    void SetEnabled(GLenum capability, bool enabled);
+    bool IsEnabled(GLenum capability);
+    void BlendFunc(GLenum source, GLenum destination);
+    void DepthMask(bool write);
+    void DepthFunc(GLenum function);
+    void CullFace(GLenum face);
+    void Viewport(int x, int y, int width, int height);
+    void GetViewport(int viewport[4]);
+
+    // GL unbinds objects as they are deleted, and their names get reused
+    void ForgetTexture(GLuint texture);
+    void ForgetVertexArray(GLuint vertexArray);
+    void ForgetFramebuffer(GLuint framebuffer);
+    // After state was changed behind the mirror's back: every setter issues its next call
+    void Invalidate();
+
+    const Stats& GetStats() const { return stats; }
+    void ResetStats() { stats = Stats(); }
+
+private:
+    static const int kTextureUnits = 16;
+    static const int kTextureTargets = 4;   // 2D, 2D array, buffer, cube map
+    static const GLuint kUnknown = 0xffffffffu;
+
+    GLState() { Invalidate(); }
+
+    GLuint program;
+    GLuint vertexArray;
+    int activeUnit;
+    GLuint textures[kTextureUnits][kTextureTargets];
+    GLuint readFramebuffer, drawFramebuffer;
+    int8_t capabilities[3];   // -1 unknown
+    GLenum blendSource, blendDestination;
+    int8_t depthWrite;
+    GLenum depthFunction;
+    GLenum cullFace;
+    int viewport[4];
+    bool viewportKnown;
+    Stats stats;
+
+    bool changed(GLuint& cached, GLuint value);
+};
@@ -0,0 +1,727 @@
+#include "glb_reader.h"
+#include <iostream>
+#include <string_view>
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+const uint32_t kGlbMagic = 0x46546C67;       // "glTF"
+const uint32_t kChunkJson = 0x4E4F534A;      // "JSON"
+const uint32_t kChunkBin = 0x004E4942;       // "BIN\0"
+const int kMaxJsonDepth = 128;
+
+uint32_t readU32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Pull parser over the JSON chunk. Callers walk the objects they care about
+// and Skip() the rest, so unused fields cost a scan but no allocation. The
+// first error sticks and turns every later call into a no-op.
+class JsonReader {
+public:
+    JsonReader(const char* begin, const char* end) : start(begin), p(begin), end(end) {}
+
+    bool Failed() const { return failed; }
+    size_t GetErrorOffset() const { return errorOffset; }
+
+    // Calls member(key) with the reader positioned on each value; it must consume the value
+    template <typename F>
+    void Object(F&& member) {
+        if (!enter('{')) {
+            return;
+        }
+        if (skipSpace() == '}') {
+            p++;
+            depth--;
+            return;
+        }
+        while (!failed) {
+            std::string_view key = rawString();
+            if (!expect(':')) {
+                break;
+            }
+            member(key);
+            char c = skipSpace();
+            if (c == ',') {
+                p++;
+            } else {
+                expect('}');
+                break;
+            }
+        }
+        depth--;
+    }
+
+    // Calls element() with the reader positioned on each value; it must consume the value
+    template <typename F>
+    void Array(F&& element) {
+        if (!enter('[')) {
+            return;
+        }
+        if (skipSpace() == ']') {
+            p++;
+            depth--;
+            return;
+        }
+        while (!failed) {
+            element();
+            char c = skipSpace();
+            if (c == ',') {
+                p++;
+            } else {
+                expect(']');
+                break;
+            }
+        }
+        depth--;
+    }
+
+    double Number() {
+        skipSpace();
+        char buffer[64];
+        size_t length = 0;
+        while (p < end && length + 1 < sizeof(buffer) &&
+               ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+            buffer[length++] = *p++;
+        }
+        buffer[length] = '\0';
+        char* parsed = nullptr;
+        double value = std::strtod(buffer, &parsed);
+        if (length == 0 || parsed != buffer + length) {
+            fail();
+            return 0.0;
+        }
+        return value;
+    }
+
+    int Int() { return static_cast<int>(Number()); }
+    size_t Size() {
+        double value = Number();
+        return value > 0.0 ? static_cast<size_t>(value) : 0;
+    }
+
+    bool Bool() {
+        skipSpace();
+        if (literal("true")) {
+            return true;
+        }
+        if (!literal("false")) {
+            fail();
+        }
+        return false;
+    }
+
+    std::string String() {
+        std::string_view raw = rawString();
+        std::string out;
+        out.reserve(raw.size());
+        for (size_t i = 0; i < raw.size(); i++) {
+            if (raw[i] != '\\' || i + 1 >= raw.size()) {
+                out += raw[i];
+                continue;
+            }
+            char escaped = raw[++i];
+            switch (escaped) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t code = hex4(raw, i + 1);
+                    i += 4;
+                    if (code >= 0xD800 && code < 0xDC00 && i + 6 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+                        uint32_t low = hex4(raw, i + 3);
+                        if (low >= 0xDC00 && low < 0xE000) {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: out += escaped; break;
+            }
+        }
+        return out;
+    }
+
+    std::vector<int> Ints() {
+        std::vector<int> values;
+        Array([&]() { values.push_back(Int()); });
+        return values;
+    }
+
+    // Reads up to `count` numbers; returns how many the array held
+    int Floats(float* out, int count) {
+        int read = 0;
+        Array([&]() {
+            float value = static_cast<float>(Number());
+            if (read < count) {
+                out[read] = value;
+            }
+            read++;
+        });
+        return read;
+    }
+
+    void Skip() {
+        switch (skipSpace()) {
+            case '{': Object([this](std::string_view) { Skip(); }); break;
+            case '[': Array([this]() { Skip(); }); break;
+            case '"': rawString(); break;
+            case 't': case 'f': Bool(); break;
+            case 'n': if (!literal("null")) { fail(); } break;
+            default: Number(); break;
+        }
+    }
+
+private:
+    const char* start;
+    const char* p;
+    const char* end;
+    int depth = 0;
+    bool failed = false;
+    size_t errorOffset = 0;
+
+    void fail() {
+        if (!failed) {
+            failed = true;
+            errorOffset = static_cast<size_t>(p - start);
+        }
+        p = end;
+    }
+
+    char skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+        return p < end ? *p : '\0';
+    }
+
+    bool expect(char c) {
+        if (skipSpace() != c) {
+            fail();
+            return false;
+        }
+        p++;
+        return true;
+    }
+
+    bool enter(char c) {
+        if (++depth > kMaxJsonDepth) {
+            fail();
+        }
+        if (failed || !expect(c)) {
+            depth--;
+            return false;
+        }
+        return true;
+    }
+
+    bool literal(const char* word) {
+        size_t length = std::strlen(word);
+        if (static_cast<size_t>(end - p) < length || std::memcmp(p, word, length) != 0) {
+            return false;
+        }
+        p += length;
+        return true;
+    }
+
+    // Contents between the quotes with escapes left in place
+    std::string_view rawString() {
+        if (!expect('"')) {
+            return std::string_view();
+        }
+        const char* begin = p;
+        while (p < end && *p != '"') {
+            p += (*p == '\\') ? 2 : 1;
+        }
+        if (p >= end) {
+            fail();
+            return std::string_view();
+        }
+        std::string_view value(begin, static_cast<size_t>(p - begin));
+        p++;
+        return value;
+    }
+
+    uint32_t hex4(std::string_view raw, size_t at) {
+        uint32_t code = 0;
+        for (size_t i = at; i < at + 4; i++) {
+            char c = i < raw.size() ? raw[i] : '0';
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                code |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                code |= c - 'A' + 10;
+            }
+        }
+        return code;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+int componentsForType(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+size_t componentSize(int componentType) {
+    switch (componentType) {
+        case kGlbByte:
+        case kGlbUnsignedByte: return 1;
+        case kGlbShort:
+        case kGlbUnsignedShort: return 2;
+        case kGlbUnsignedInt:
+        case kGlbFloat: return 4;
+    }
+    return 0;
+}
+
+// {"index": n, ...} as used by material texture slots
+int textureIndex(JsonReader& json) {
+    int index = -1;
+    json.Object([&](std::string_view key) {
+        if (key == "index") {
+            index = json.Int();
+        } else {
+            json.Skip();
+        }
+    });
+    return index;
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const char* path) {
+    Close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(handle);
+        return false;
+    }
+    fileHandle = handle;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);   // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    // Loading walks the JSON once and the BIN chunk front to back
+    madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(info.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::Close() {
+    if (!data) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool GlbFile::Open(const char* path) {
+    if (!file.Open(path)) {
+        std::cout << "Cannot map GLB file: " << path << std::endl;
+        return false;
+    }
+
+    // 12-byte header, then length-prefixed chunks: JSON first, BIN optional
+    const uint8_t* data = file.GetData();
+    size_t size = file.GetSize();
+    if (size < 20 || readU32(data) != kGlbMagic || readU32(data + 4) != 2) {
+        std::cout << "Not a glTF 2.0 binary file: " << path << std::endl;
+        return false;
+    }
+    size_t total = std::min<size_t>(readU32(data + 8), size);
+
+    const char* json = nullptr;
+    size_t jsonLength = 0;
+    size_t offset = 12;
+    while (offset + 8 <= total) {
+        size_t chunkLength = readU32(data + offset);
+        uint32_t chunkType = readU32(data + offset + 4);
+        offset += 8;
+        if (chunkLength > total - offset) {
+            std::cout << "Truncated chunk in GLB file: " << path << std::endl;
+            return false;
+        }
+        if (chunkType == kChunkJson && !json) {
+            json = reinterpret_cast<const char*>(data + offset);
+            jsonLength = chunkLength;
+        } else if (chunkType == kChunkBin && !bin) {
+            bin = data + offset;
+            binSize = chunkLength;
+        }
+        offset += (chunkLength + 3) & ~static_cast<size_t>(3);
+    }
+    if (!json) {
+        std::cout << "GLB file has no JSON chunk: " << path << std::endl;
+        return false;
+    }
+    return parseJson(json, jsonLength);
+}
+
+bool GlbFile::parseJson(const char* text, size_t length) {
+    JsonReader json(text, text + length);
+
+    auto parseBuffer = [&]() {
+        bool external = false;
+        json.Object([&](std::string_view key) {
+            if (key == "uri") {
+                external = true;
+            }
+            json.Skip();
+        });
+        if (external) {
+            std::cout << "External glTF buffers are not supported" << std::endl;
+        }
+        bufferIsBin.push_back(!external);
+    };
+
+    auto parseBufferView = [&]() {
+        GlbBufferView view;
+        json.Object([&](std::string_view key) {
+            if (key == "buffer") view.buffer = json.Int();
+            else if (key == "byteOffset") view.byteOffset = json.Size();
+            else if (key == "byteLength") view.byteLength = json.Size();
+            else if (key == "byteStride") view.byteStride = json.Size();
+            else json.Skip();
+        });
+        bufferViews.push_back(view);
+    };
+
+    auto parseAccessor = [&]() {
+        GlbAccessor accessor;
+        json.Object([&](std::string_view key) {
+            if (key == "bufferView") accessor.bufferView = json.Int();
+            else if (key == "byteOffset") accessor.byteOffset = json.Size();
+            else if (key == "count") accessor.count = json.Size();
+            else if (key == "componentType") accessor.componentType = json.Int();
+            else if (key == "type") accessor.components = componentsForType(json.String());
+            else if (key == "normalized") accessor.normalized = json.Bool();
+            else json.Skip();   // min/max, sparse and extensions are unused
+        });
+        accessors.push_back(accessor);
+    };
+
+    auto parseImage = [&]() {
+        GlbImage image;
+        json.Object([&](std::string_view key) {
+            if (key == "name") image.name = json.String();
+            else if (key == "mimeType") image.mimeType = json.String();
+            else if (key == "bufferView") image.bufferView = json.Int();
+            else json.Skip();
+        });
+        images.push_back(image);
+    };
+
+    auto parseTexture = [&]() {
+        GlbTexture texture;
+        json.Object([&](std::string_view key) {
+            if (key == "source") texture.source = json.Int();
+            else json.Skip();
+        });
+        textures.push_back(texture);
+    };
+
+    auto parseMaterial = [&]() {
+        GlbMaterial material;
+        json.Object([&](std::string_view key) {
+            if (key == "name") {
+                material.name = json.String();
+            } else if (key == "doubleSided") {
+                material.doubleSided = json.Bool();
+            } else if (key == "occlusionTexture") {
+                material.occlusionTexture = textureIndex(json);
+            } else if (key == "normalTexture") {
+                material.normalTexture = textureIndex(json);
+            } else if (key == "alphaMode") {
+                material.alphaMode = json.String();
+            } else if (key == "alphaCutoff") {
+                material.alphaCutoff = static_cast<float>(json.Number());
+            } else if (key == "pbrMetallicRoughness") {
+                json.Object([&](std::string_view pbrKey) {
+                    if (pbrKey == "baseColorFactor") json.Floats(&material.baseColorFactor[0], 4);
+                    else if (pbrKey == "metallicFactor") material.metallicFactor = static_cast<float>(json.Number());
+                    else if (pbrKey == "roughnessFactor") material.roughnessFactor = static_cast<float>(json.Number());
+                    else if (pbrKey == "baseColorTexture") material.baseColorTexture = textureIndex(json);
+                    else if (pbrKey == "metallicRoughnessTexture") material.metallicRoughnessTexture = textureIndex(json);
+                    else json.Skip();
+                });
+            } else {
+                json.Skip();
+            }
+        });
+        materials.push_back(material);
+    };
+
+    auto parsePrimitive = [&](GlbMesh& mesh) {
+        GlbPrimitive primitive;
+        json.Object([&](std::string_view key) {
+            if (key == "attributes") {
+                json.Object([&](std::string_view semantic) {
+                    primitive.attributes[std::string(semantic)] = json.Int();
+                });
+            } else if (key == "indices") {
+                primitive.indices = json.Int();
+            } else if (key == "material") {
+                primitive.material = json.Int();
+            } else if (key == "mode") {
+                primitive.mode = json.Int();
+            } else {
+                json.Skip();   // Morph targets are unused
+            }
+        });
+        mesh.primitives.push_back(std::move(primitive));
+    };
+
+    auto parseMesh = [&]() {
+        GlbMesh mesh;
+        json.Object([&](std::string_view key) {
+            if (key == "name") mesh.name = json.String();
+            else if (key == "primitives") json.Array([&]() { parsePrimitive(mesh); });
+            else json.Skip();
+        });
+        meshes.push_back(std::move(mesh));
+    };
+
+    auto parseNode = [&]() {
+        GlbNode node;
+        json.Object([&](std::string_view key) {
+            if (key == "name") {
+                node.name = json.String();
+            } else if (key == "children") {
+                node.children = json.Ints();
+            } else if (key == "mesh") {
+                node.mesh = json.Int();
+            } else if (key == "skin") {
+                node.skin = json.Int();
+            } else if (key == "matrix") {
+                float values[16];
+                if (json.Floats(values, 16) == 16) {
+                    node.hasMatrix = true;
+                    for (int i = 0; i < 16; i++) {
+                        node.matrix[i / 4][i % 4] = values[i];
+                    }
+                }
+            } else if (key == "translation") {
+                json.Floats(&node.translation[0], 3);
+            } else if (key == "rotation") {
+                json.Floats(&node.rotation[0], 4);
+            } else if (key == "scale") {
+                json.Floats(&node.scale[0], 3);
+            } else {
+                json.Skip();
+            }
+        });
+        nodes.push_back(std::move(node));
+    };
+
+    auto parseSkin = [&]() {
+        GlbSkin skin;
+        json.Object([&](std::string_view key) {
+            if (key == "joints") skin.joints = json.Ints();
+            else if (key == "inverseBindMatrices") skin.inverseBindMatrices = json.Int();
+            else json.Skip();
+        });
+        skins.push_back(std::move(skin));
+    };
+
+    auto parseAnimation = [&]() {
+        GlbAnimation animation;
+        json.Object([&](std::string_view key) {
+            if (key == "name") {
+                animation.name = json.String();
+            } else if (key == "channels") {
+                json.Array([&]() {
+                    GlbAnimationChannel channel;
+                    json.Object([&](std::string_view channelKey) {
+                        if (channelKey == "sampler") {
+                            channel.sampler = json.Int();
+                        } else if (channelKey == "target") {
+                            json.Object([&](std::string_view targetKey) {
+                                if (targetKey == "node") channel.node = json.Int();
+                                else if (targetKey == "path") channel.path = json.String();
+                                else json.Skip();
+                            });
+                        } else {
+                            json.Skip();
+                        }
+                    });
+                    animation.channels.push_back(std::move(channel));
+                });
+            } else if (key == "samplers") {
+                json.Array([&]() {
+                    GlbAnimationSampler sampler;
+                    json.Object([&](std::string_view samplerKey) {
+                        if (samplerKey == "input") sampler.input = json.Int();
+                        else if (samplerKey == "output") sampler.output = json.Int();
+                        else if (samplerKey == "interpolation") sampler.interpolation = json.String();
+                        else json.Skip();
+                    });
+                    animation.samplers.push_back(std::move(sampler));
+                });
+            } else {
+                json.Skip();
+            }
+        });
+        animations.push_back(std::move(animation));
+    };
+
+    auto parseScene = [&]() {
+        GlbScene scene;
+        json.Object([&](std::string_view key) {
+            if (key == "nodes") scene.nodes = json.Ints();
+            else json.Skip();
+        });
+        scenes.push_back(std::move(scene));
+    };
+
+    json.Object([&](std::string_view key) {
+        if (key == "buffers") json.Array(parseBuffer);
+        else if (key == "bufferViews") json.Array(parseBufferView);
+        else if (key == "accessors") json.Array(parseAccessor);
+        else if (key == "images") json.Array(parseImage);
+        else if (key == "textures") json.Array(parseTexture);
+        else if (key == "materials") json.Array(parseMaterial);
+        else if (key == "meshes") json.Array(parseMesh);
+        else if (key == "nodes") json.Array(parseNode);
+        else if (key == "skins") json.Array(parseSkin);
+        else if (key == "animations") json.Array(parseAnimation);
+        else if (key == "scenes") json.Array(parseScene);
+        else if (key == "scene") defaultScene = json.Int();
+        else json.Skip();   // asset, samplers, cameras, extensions, extras
+    });
+
+    if (json.Failed()) {
+        std::cout << "Invalid glTF JSON at byte " << json.GetErrorOffset() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const uint8_t* GlbFile::GetBufferViewData(int index, size_t& length) const {
+    length = 0;
+    if (index < 0 || index >= static_cast<int>(bufferViews.size())) {
+        return nullptr;
+    }
+    const GlbBufferView& view = bufferViews[index];
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(bufferIsBin.size()) || !bufferIsBin[view.buffer] ||
+        !bin || view.byteOffset > binSize || view.byteLength > binSize - view.byteOffset) {
+        return nullptr;
+    }
+    length = view.byteLength;
+    return bin + view.byteOffset;
+}
+
+GlbAccessorView GlbFile::GetAccessor(int index) const {
+    GlbAccessorView result;
+    if (index < 0 || index >= static_cast<int>(accessors.size())) {
+        std::cout << "Accessor " << index << " does not exist" << std::endl;
+        return result;
+    }
+    const GlbAccessor& accessor = accessors[index];
+    result.count = accessor.count;
+    result.components = accessor.components;
+    result.componentType = accessor.componentType;
+    result.normalized = accessor.normalized;
+    if (accessor.bufferView < 0 || accessor.count == 0) {
+        return result;
+    }
+
+    size_t viewLength = 0;
+    const uint8_t* viewData = GetBufferViewData(accessor.bufferView, viewLength);
+    size_t elementSize = componentSize(accessor.componentType) * accessor.components;
+    size_t stride = viewData ? bufferViews[accessor.bufferView].byteStride : 0;
+    result.stride = stride > 0 ? stride : elementSize;
+    if (!viewData || elementSize == 0 || accessor.byteOffset > viewLength || accessor.count > viewLength ||
+        (accessor.count - 1) * result.stride + elementSize > viewLength - accessor.byteOffset) {
+        std::cout << "Accessor " << index << " exceeds its buffer" << std::endl;
+        result.stride = 0;
+        return result;
+    }
+    result.data = viewData + accessor.byteOffset;
+    return result;
+}
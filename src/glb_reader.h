@@ -0,0 +1,240 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// glTF component types and the only primitive mode the engine draws
+const int kGlbByte = 5120;
+const int kGlbUnsignedByte = 5121;
+const int kGlbShort = 5122;
+const int kGlbUnsignedShort = 5123;
+const int kGlbUnsignedInt = 5125;
+const int kGlbFloat = 5126;
+const int kGlbModeTriangles = 4;
+
+// Read-only mapping of a whole file; pages are loaded by the OS as they are touched
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    const uint8_t* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+struct GlbBufferView {
+    int buffer = 0;
+    size_t byteOffset = 0;
+    size_t byteLength = 0;
+    size_t byteStride = 0;   // 0 means tightly packed
+};
+
+struct GlbAccessor {
+    int bufferView = -1;     // -1 means all zeros
+    size_t byteOffset = 0;
+    size_t count = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+};
+
+// Accessor elements read in place from the mapped BIN chunk. Normalized
+// integers map to [0, 1] or [-1, 1]; a view without data reads as zeros.
+struct GlbAccessorView {
+    const uint8_t* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int components = 0;
+    int componentType = 0;
+    bool normalized = false;
+
+    float Get(size_t element, int component) const {
+        if (!data) {
+            return 0.0f;
+        }
+        const uint8_t* p = data + element * stride;
+        switch (componentType) {
+            case kGlbFloat: {
+                float v;
+                std::memcpy(&v, p + component * sizeof(float), sizeof(v));
+                return v;
+            }
+            case kGlbUnsignedByte: {
+                uint8_t v = p[component];
+                return normalized ? v / 255.0f : v;
+            }
+            case kGlbByte: {
+                int8_t v = static_cast<int8_t>(p[component]);
+                return normalized ? std::max(v / 127.0f, -1.0f) : v;
+            }
+            case kGlbUnsignedShort: {
+                uint16_t v;
+                std::memcpy(&v, p + component * sizeof(v), sizeof(v));
+                return normalized ? v / 65535.0f : v;
+            }
+            case kGlbShort: {
+                int16_t v;
+                std::memcpy(&v, p + component * sizeof(v), sizeof(v));
+                return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+            }
+            case kGlbUnsignedInt: {
+                uint32_t v;
+                std::memcpy(&v, p + component * sizeof(v), sizeof(v));
+                return static_cast<float>(v);
+            }
+        }
+        return 0.0f;
+    }
+
+    // First component as an unsigned integer, for index and joint accessors
+    uint32_t GetIndex(size_t element) const {
+        if (!data) {
+            return 0;
+        }
+        const uint8_t* p = data + element * stride;
+        if (componentType == kGlbUnsignedByte) {
+            return p[0];
+        }
+        if (componentType == kGlbUnsignedShort) {
+            uint16_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+};
+
+struct GlbImage {
+    std::string name;
+    std::string mimeType;
+    int bufferView = -1;     // External URIs are not supported
+};
+
+struct GlbTexture {
+    int source = -1;
+};
+
+struct GlbMaterial {
+    std::string name;
+    glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    int baseColorTexture = -1;          // Texture indices, -1 if unset
+    int metallicRoughnessTexture = -1;
+    int occlusionTexture = -1;
+    int normalTexture = -1;
+    std::string alphaMode = "OPAQUE";   // OPAQUE, MASK or BLEND
+    float alphaCutoff = 0.5f;
+    bool doubleSided = false;
+};
+
+struct GlbPrimitive {
+    std::map<std::string, int> attributes;   // Semantic to accessor
+    int indices = -1;
+    int material = -1;
+    int mode = kGlbModeTriangles;
+};
+
+struct GlbMesh {
+    std::string name;
+    std::vector<GlbPrimitive> primitives;
+};
+
+struct GlbNode {
+    std::string name;
+    std::vector<int> children;
+    int mesh = -1;
+    int skin = -1;
+    bool hasMatrix = false;
+    glm::mat4 matrix = glm::mat4(1.0f);
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);   // Quaternion x, y, z, w
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+struct GlbSkin {
+    std::vector<int> joints;
+    int inverseBindMatrices = -1;
+};
+
+struct GlbAnimationSampler {
+    int input = -1;
+    int output = -1;
+    std::string interpolation = "LINEAR";
+};
+
+struct GlbAnimationChannel {
+    int sampler = -1;
+    int node = -1;
+    std::string path;
+};
+
+struct GlbAnimation {
+    std::string name;
+    std::vector<GlbAnimationChannel> channels;
+    std::vector<GlbAnimationSampler> samplers;
+};
+
+struct GlbScene {
+    std::vector<int> nodes;
+};
+
+// Binary glTF reader. The file is memory-mapped and only the JSON fields the
+// engine uses are parsed; everything else is skipped without allocating.
+// Accessors and images are views into the mapped BIN chunk, so they are only
+// valid while the GlbFile is alive.
+class GlbFile {
+public:
+    GlbFile() = default;
+    GlbFile(const GlbFile&) = delete;
+    GlbFile& operator=(const GlbFile&) = delete;
+
+    // Maps and parses the file; prints the reason and returns false on failure
+    bool Open(const char* path);
+
+    // Invalid accessors print a message and read as zeros
+    GlbAccessorView GetAccessor(int index) const;
+    // Bytes of a buffer view, e.g. an encoded image; nullptr if out of range
+    const uint8_t* GetBufferViewData(int index, size_t& length) const;
+    size_t GetFileSize() const { return file.GetSize(); }
+
+    std::vector<GlbBufferView> bufferViews;
+    std::vector<GlbAccessor> accessors;
+    std::vector<GlbImage> images;
+    std::vector<GlbTexture> textures;
+    std::vector<GlbMaterial> materials;
+    std::vector<GlbMesh> meshes;
+    std::vector<GlbNode> nodes;
+    std::vector<GlbSkin> skins;
+    std::vector<GlbAnimation> animations;
+    std::vector<GlbScene> scenes;
+    int defaultScene = -1;
+
+private:
+    MappedFile file;
+    const uint8_t* bin = nullptr;
+    size_t binSize = 0;
+    std::vector<bool> bufferIsBin;   // Per glTF buffer; only the GLB's own BIN chunk is readable
+
+    bool parseJson(const char* json, size_t length);
+};
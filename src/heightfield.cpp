@@ -0,0 +1,148 @@
+#include "heightfield.h"
+#include "job_system.h"
+#include "memory_tracker.h"
+#include "../external/stb/stb_image.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const char* kAssetName = "terrain";
+
+// Hashed value noise in [0, 1]
+float hashLattice(int x, int z, uint32_t seed) {
+    uint32_t h = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(z) * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return static_cast<float>(h & 0xffffff) / static_cast<float>(0xffffff);
+}
+
+float valueNoise(float x, float z, uint32_t seed) {
+    int x0 = static_cast<int>(std::floor(x));
+    int z0 = static_cast<int>(std::floor(z));
+    float tx = x - x0;
+    float tz = z - z0;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    tz = tz * tz * (3.0f - 2.0f * tz);
+    float a = hashLattice(x0, z0, seed);
+    float b = hashLattice(x0 + 1, z0, seed);
+    float c = hashLattice(x0, z0 + 1, seed);
+    float d = hashLattice(x0 + 1, z0 + 1, seed);
+    return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * tz;
+}
+
+} // namespace
+
+Heightfield::Heightfield(const HeightfieldSettings& settings) : settings(settings) {
+}
+
+Heightfield::~Heightfield() {
+    MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Texture, MemoryDomain::CPU, heights.capacity() * sizeof(float));
+}
+
+bool Heightfield::LoadHeightmap(const char* path) {
+    int width, height, channels;
+    stbi_us* data = stbi_load_16(path, &width, &height, &channels, 1);
+    if (!data) {
+        std::cout << "Error: Failed to load heightmap: " << path << std::endl;
+        return false;
+    }
+    if (width != height || width < 2) {
+        std::cout << "Error: Heightmap must be square: " << path << " (" << width << "x" << height << ")" << std::endl;
+        stbi_image_free(data);
+        return false;
+    }
+
+    MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Texture, MemoryDomain::CPU, heights.capacity() * sizeof(float));
+    resolution = width;
+    heights.assign(static_cast<size_t>(width) * height, 0.0f);
+    for (size_t i = 0; i < heights.size(); i++) {
+        heights[i] = data[i] / 65535.0f * settings.heightScale + settings.heightOffset;
+    }
+    stbi_image_free(data);
+    MemoryTracker::Get().Add(kAssetName, MemoryCategory::Texture, MemoryDomain::CPU, heights.capacity() * sizeof(float));
+
+    std::cout << "Loaded heightmap " << path << " (" << width << "x" << height << ")" << std::endl;
+    return true;
+}
+
+void Heightfield::Generate(int newResolution, uint32_t seed) {
+    MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Texture, MemoryDomain::CPU, heights.capacity() * sizeof(float));
+    resolution = std::max(newResolution, 2);
+    heights.assign(static_cast<size_t>(resolution) * resolution, 0.0f);
+    MemoryTracker::Get().Add(kAssetName, MemoryCategory::Texture, MemoryDomain::CPU, heights.capacity() * sizeof(float));
+
+    const float baseFrequency = 6.0f;
+    const float flatRadius = 0.02f;   // Fractions of the terrain size around the origin
+    const float blendRadius = 0.08f;
+
+    JobSystem::Get().ParallelFor(resolution, 16, [&](size_t begin, size_t end) {
+        for (size_t z = begin; z < end; z++) {
+            for (int x = 0; x < resolution; x++) {
+                float u = static_cast<float>(x) / (resolution - 1);
+                float v = static_cast<float>(z) / (resolution - 1);
+
+                float value = 0.0f;
+                float amplitude = 0.5f;
+                float frequency = baseFrequency;
+                for (int octave = 0; octave < 7; octave++) {
+                    value += valueNoise(u * frequency, v * frequency, seed + octave) * amplitude;
+                    amplitude *= 0.5f;
+                    frequency *= 2.0f;
+                }
+                // Ridges read better than rounded hills at this scale
+                value = value * value;
+
+                // Level the ground around the origin so the battlefield starts on flat terrain
+                float distance = std::sqrt((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f));
+                float t = std::min(std::max((distance - flatRadius) / (blendRadius - flatRadius), 0.0f), 1.0f);
+                t = t * t * (3.0f - 2.0f * t);
+
+                heights[z * resolution + x] = value * t * settings.heightScale + settings.heightOffset;
+            }
+        }
+    });
+}
+
+float Heightfield::GetSample(int x, int z) const {
+    x = std::min(std::max(x, 0), resolution - 1);
+    z = std::min(std::max(z, 0), resolution - 1);
+    return heights[static_cast<size_t>(z) * resolution + x];
+}
+
+bool Heightfield::Contains(float x, float z) const {
+    float half = settings.size * 0.5f;
+    return x >= -half && x <= half && z >= -half && z <= half;
+}
+
+float Heightfield::GetHeight(float x, float z) const {
+    if (heights.empty()) {
+        return settings.heightOffset;
+    }
+    // Corner samples sit exactly on the terrain edges
+    float fx = (x / settings.size + 0.5f) * (resolution - 1);
+    float fz = (z / settings.size + 0.5f) * (resolution - 1);
+    fx = std::min(std::max(fx, 0.0f), static_cast<float>(resolution - 1));
+    fz = std::min(std::max(fz, 0.0f), static_cast<float>(resolution - 1));
+
+    int x0 = static_cast<int>(fx);
+    int z0 = static_cast<int>(fz);
+    float tx = fx - x0;
+    float tz = fz - z0;
+
+    float h00 = GetSample(x0, z0);
+    float h10 = GetSample(x0 + 1, z0);
+    float h01 = GetSample(x0, z0 + 1);
+    float h11 = GetSample(x0 + 1, z0 + 1);
+    float top = h00 + (h10 - h00) * tx;
+    float bottom = h01 + (h11 - h01) * tx;
+    return top + (bottom - top) * tz;
+}
+
+glm::vec3 Heightfield::GetNormal(float x, float z) const {
+    float spacing = settings.size / std::max(resolution - 1, 1);
+    float dx = GetHeight(x + spacing, z) - GetHeight(x - spacing, z);
+    float dz = GetHeight(x, z + spacing) - GetHeight(x, z - spacing);
+    return glm::normalize(glm::vec3(-dx, 2.0f * spacing, -dz));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <cstdint>
+
+struct HeightfieldSettings {
+    float size = 8192.0f;          // Side length in meters, centered on the origin
+    float heightScale = 600.0f;    // Meters for a full-range heightmap sample
+    float heightOffset = 0.0f;
+};
+
+// Ground heights as a square grid of samples. Only CPU data: the simulation
+// and navigation query it directly, and Terrain builds its render data from
+// it, so a headless server loads the same ground without a GL context.
+class Heightfield {
+public:
+    Heightfield(const HeightfieldSettings& settings = HeightfieldSettings());
+    ~Heightfield();
+
+    Heightfield(const Heightfield&) = delete;
+    Heightfield& operator=(const Heightfield&) = delete;
+
+    // 8 or 16 bit grayscale image, square
+    bool LoadHeightmap(const char* path);
+    // Fractal noise with a flattened area around the origin
+    void Generate(int resolution, uint32_t seed);
+
+    // Height queries in world space; safe from any thread once loaded
+    float GetHeight(float x, float z) const;
+    glm::vec3 GetNormal(float x, float z) const;
+    bool Contains(float x, float z) const;
+
+    bool Empty() const { return heights.empty(); }
+    // Samples per side; corner samples sit exactly on the edges
+    int GetResolution() const { return resolution; }
+    // Clamped to the grid
+    float GetSample(int x, int z) const;
+    const std::vector<float>& GetSamples() const { return heights; }
+    float GetSize() const { return settings.size; }
+    const HeightfieldSettings& GetSettings() const { return settings; }
+
+private:
+    HeightfieldSettings settings;
+    int resolution = 0;
+    std::vector<float> heights;
+};
@@ -0,0 +1,454 @@
+#include "indirect_draw.h"
+#include "mesh_pool.h"
+#include "materials.h"
+#include "gl_state.h"
+#include "deletion_queue.h"
+#include "memory_tracker.h"
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* kAssetName = "scene/indirect";
+const size_t kInstancesPerJob = 4096;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Planes as (normal, d) with normals pointing into the frustum
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+}
+
+// Grows `buffer` to hold `bytes` and orphans it, leaving it bound to `target`.
+// Returns true when the storage grew, so views of it must be re-pointed.
+bool reserve(GLenum target, GLuint& buffer, int64_t& capacity, int64_t bytes) {
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+    }
+    glBindBuffer(target, buffer);
+    bool grown = bytes > capacity;
+    if (grown) {
+        int64_t newCapacity = std::max<int64_t>(bytes, capacity * 2);
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, capacity);
+        MemoryTracker::Get().Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, newCapacity);
+        capacity = newCapacity;
+    }
+    glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+    return grown;
+}
+
+} // namespace
+
+int SelectInstanceLod(const DrawInstance& instance, const glm::vec4 planes[6], const glm::vec3& cameraPos,
+                      uint32_t lodCount, float lodDistanceScale) {
+    // Scalar and in the order cull.comp evaluates it, so both paths round alike
+    const glm::mat4& m = instance.model;
+    float center[3], halfExtent[3], worldCenter[3], worldExtent[3];
+    for (int k = 0; k < 3; k++) {
+        center[k] = (instance.boundsMin[k] + instance.boundsMax[k]) * 0.5f;
+        halfExtent[k] = (instance.boundsMax[k] - instance.boundsMin[k]) * 0.5f;
+    }
+    for (int k = 0; k < 3; k++) {
+        worldCenter[k] = m[0][k] * center[0] + m[1][k] * center[1] + m[2][k] * center[2] + m[3][k];
+        worldExtent[k] = std::fabs(m[0][k]) * halfExtent[0] + std::fabs(m[1][k]) * halfExtent[1] +
+                         std::fabs(m[2][k]) * halfExtent[2];
+    }
+
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& plane = planes[i];
+        float distance = plane.x * worldCenter[0] + plane.y * worldCenter[1] + plane.z * worldCenter[2] + plane.w;
+        float reach = std::fabs(plane.x) * worldExtent[0] + std::fabs(plane.y) * worldExtent[1] +
+                      std::fabs(plane.z) * worldExtent[2];
+        if (distance + reach < 0.0f) {
+            return -1;
+        }
+    }
+
+    float toCamera[3] = { worldCenter[0] - cameraPos.x, worldCenter[1] - cameraPos.y, worldCenter[2] - cameraPos.z };
+    float distanceSq = toCamera[0] * toCamera[0] + toCamera[1] * toCamera[1] + toCamera[2] * toCamera[2];
+    float radiusSq = worldExtent[0] * worldExtent[0] + worldExtent[1] * worldExtent[1] + worldExtent[2] * worldExtent[2];
+    float threshold = lodDistanceScale * lodDistanceScale * radiusSq;
+    int lod = 0;
+    while (static_cast<uint32_t>(lod + 1) < lodCount && distanceSq > threshold) {
+        lod++;
+        threshold *= 4.0f;
+    }
+    return lod;
+}
+
+IndirectRenderer::IndirectRenderer() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 3)) {
+        cullShader = std::make_unique<Shader>("shaders/cull.comp");
+        GLint linked = GL_FALSE;
+        glGetProgramiv(cullShader->ID, GL_LINK_STATUS, &linked);
+        gpuCullingAvailable = linked == GL_TRUE;
+    }
+    std::cout << "Indirect draw: " << (gpuCullingAvailable ? "GPU culling" : "CPU culling")
+              << " on GL " << major << "." << minor << std::endl;
+}
+
+IndirectRenderer::~IndirectRenderer() {
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteTexture(instanceTexture, kAssetName, 0);
+    queue.DeleteTexture(instanceIndexTexture, kAssetName, 0);
+    queue.DeleteBuffer(instanceBuffer, kAssetName, MemoryCategory::Vertex, instanceBytes);
+    queue.DeleteBuffer(slotBuffer, kAssetName, MemoryCategory::Vertex, slotBytes);
+    queue.DeleteBuffer(visibleBuffer, kAssetName, MemoryCategory::Vertex, visibleBytes);
+    queue.DeleteBuffer(commandBuffer, kAssetName, MemoryCategory::Vertex, commandBytes);
+    queue.DeleteBuffer(edgeCommandBuffer, kAssetName, MemoryCategory::Vertex, edgeCommandBytes);
+    if (cullShader) {
+        glDeleteProgram(cullShader->ID);
+    }
+}
+
+void IndirectRenderer::Begin() {
+    added.clear();
+    addedGroups.clear();
+    groups.clear();
+    groupIndex.clear();
+}
+
+void IndirectRenderer::Add(const Model* model, const glm::mat4& matrix, int jointOffset, uint32_t features) {
+    if (!model || !model->IsUploaded() || model->GetLodCount() == 0) {
+        return;
+    }
+    features |= ShaderFeature::Instanced;
+    auto inserted = groupIndex.emplace(GroupKey(model, features), static_cast<uint32_t>(groups.size()));
+    if (inserted.second) {
+        groups.push_back({model, features, 0, 0});
+    }
+    uint32_t group = inserted.first->second;
+    groups[group].count++;
+
+    DrawInstance instance;
+    instance.model = matrix;
+    instance.boundsMin = model->GetBoundsMin();
+    instance.materialIndex = static_cast<int32_t>(model->GetMaterialId());
+    instance.boundsMax = model->GetBoundsMax();
+    instance.jointOffset = jointOffset;
+    added.push_back(instance);
+    addedGroups.push_back(group);
+}
+
+void IndirectRenderer::buildSlots() {
+    // Opaque batches first, then double-sided ones that blend over them; within
+    // each, groups sharing a permutation and then texture arrays are adjacent so batches stay few
+    MaterialTable& materialTable = MaterialTable::Get();
+    std::vector<uint32_t> order(groups.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const Model* modelA = groups[a].model;
+        const Model* modelB = groups[b].model;
+        if (modelA->IsDoubleSided() != modelB->IsDoubleSided()) {
+            return modelB->IsDoubleSided();
+        }
+        if (groups[a].features != groups[b].features) {
+            return groups[a].features < groups[b].features;
+        }
+        return materialTable.GetBindingKey(modelA->GetMaterialId()) < materialTable.GetBindingKey(modelB->GetMaterialId());
+    });
+
+    // Counting sort of the instances by model, keeping Add() order within each
+    uint32_t first = 0;
+    for (uint32_t group : order) {
+        groups[group].first = first;
+        first += groups[group].count;
+    }
+    std::vector<uint32_t> cursor(groups.size());
+    for (size_t i = 0; i < groups.size(); i++) {
+        cursor[i] = groups[i].first;
+    }
+    instances.resize(added.size());
+    for (size_t i = 0; i < added.size(); i++) {
+        instances[cursor[addedGroups[i]]++] = added[i];
+    }
+
+    slots.clear();
+    batches.clear();
+    uint32_t visibleOffset = 0;
+    for (uint32_t group : order) {
+        const ModelGroup& entry = groups[group];
+        const Model* model = entry.model;
+        MaterialId material = model->GetMaterialId();
+        bool doubleSided = model->IsDoubleSided();
+        if (batches.empty() || batches.back().doubleSided != doubleSided || batches.back().features != entry.features ||
+            materialTable.GetBindingKey(batches.back().material) != materialTable.GetBindingKey(material)) {
+            batches.push_back({static_cast<uint32_t>(slots.size()), 0, material, doubleSided, entry.features, nullptr});
+        }
+
+        uint32_t lodCount = static_cast<uint32_t>(model->GetLodCount());
+        for (uint32_t lod = 0; lod < lodCount; lod++) {
+            Slot slot;
+            slot.firstInstance = entry.first;
+            slot.instanceCount = entry.count;
+            slot.firstIndex = model->GetLod(lod).first;
+            slot.indexCount = model->GetLod(lod).count;
+            slot.baseVertex = static_cast<int32_t>(model->GetVertices().first);
+            slot.lod = lod;
+            slot.lodCount = lodCount;
+            slot.visibleOffset = visibleOffset;
+            slot.edgeFirstIndex = model->GetEdges().first;
+            slot.edgeIndexCount = model->GetEdges().count;
+            slots.push_back(slot);
+            // Room for every instance at every level; only one level keeps each
+            visibleOffset += entry.count;
+        }
+        batches.back().slotCount += lodCount;
+    }
+    visibleCapacity = visibleOffset;
+}
+
+void IndirectRenderer::upload() {
+    // Instance records: SSBO for the cull shader, float and integer texture views for the vertex shader
+    int64_t bytes = static_cast<int64_t>(instances.size() * sizeof(DrawInstance));
+    bool grown = reserve(GL_TEXTURE_BUFFER, instanceBuffer, instanceBytes, bytes);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, instances.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    if (instanceTexture == 0) {
+        glGenTextures(1, &instanceTexture);
+        glGenTextures(1, &instanceIndexTexture);
+    }
+    GLState::Get().BindTexture(kInstanceUnit, GL_TEXTURE_BUFFER, instanceTexture);
+    if (grown) {
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+    }
+    GLState::Get().BindTexture(kInstanceIndexUnit, GL_TEXTURE_BUFFER, instanceIndexTexture);
+    if (grown) {
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, instanceBuffer);
+    }
+    GLState::Get().ActiveTexture(0);
+
+    reserve(GL_ARRAY_BUFFER, visibleBuffer, visibleBytes, static_cast<int64_t>(visibleCapacity * sizeof(uint32_t)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (gpuCullingUsed) {
+        bytes = static_cast<int64_t>(slots.size() * sizeof(Slot));
+        reserve(GL_SHADER_STORAGE_BUFFER, slotBuffer, slotBytes, bytes);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, slots.data());
+        bytes = static_cast<int64_t>(slots.size() * sizeof(DrawElementsCommand));
+        reserve(GL_SHADER_STORAGE_BUFFER, commandBuffer, commandBytes, bytes);
+        reserve(GL_SHADER_STORAGE_BUFFER, edgeCommandBuffer, edgeCommandBytes, bytes);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+}
+
+void IndirectRenderer::cullOnGpu(const glm::vec4 planes[6], const glm::vec3& cameraPos) {
+    static const char* kPlaneNames[6] = { "frustumPlanes[0]", "frustumPlanes[1]", "frustumPlanes[2]",
+                                          "frustumPlanes[3]", "frustumPlanes[4]", "frustumPlanes[5]" };
+    cullShader->use();
+    for (int i = 0; i < 6; i++) {
+        cullShader->setVec4(kPlaneNames[i], planes[i]);
+    }
+    cullShader->setVec3("cameraPos", cameraPos);
+    cullShader->setFloat("lodDistanceScale", lodDistanceScale);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, slotBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, edgeCommandBuffer);
+    glDispatchCompute(static_cast<GLuint>(slots.size()), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void IndirectRenderer::cullOnCpu(const glm::vec4 planes[6], const glm::vec3& cameraPos) {
+    // Level of each instance once, then each slot keeps its level's instances in order
+    instanceLods.resize(instances.size());
+    for (const ModelGroup& group : groups) {
+        uint32_t lodCount = static_cast<uint32_t>(group.model->GetLodCount());
+        JobSystem::Get().ParallelFor(group.count, kInstancesPerJob, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                size_t index = group.first + i;
+                instanceLods[index] = static_cast<int8_t>(
+                    SelectInstanceLod(instances[index], planes, cameraPos, lodCount, lodDistanceScale));
+            }
+        });
+    }
+
+    commands.resize(slots.size());
+    edgeCommands.resize(slots.size());
+    visible.resize(visibleCapacity);
+    for (size_t s = 0; s < slots.size(); s++) {
+        const Slot& slot = slots[s];
+        uint32_t written = 0;
+        for (uint32_t i = slot.firstInstance; i < slot.firstInstance + slot.instanceCount; i++) {
+            if (instanceLods[i] == static_cast<int>(slot.lod)) {
+                visible[slot.visibleOffset + written++] = i;
+            }
+        }
+        commands[s] = { slot.indexCount, written, slot.firstIndex, slot.baseVertex, slot.visibleOffset };
+        edgeCommands[s] = { slot.edgeIndexCount, written, slot.edgeFirstIndex, slot.baseVertex, slot.visibleOffset };
+        stats.visible += written;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(uint32_t), visible.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void IndirectRenderer::Draw(ShaderVariants& shaders, const std::function<void(Shader&)>& prepare,
+                            const glm::mat4& viewProjection, const glm::vec3& cameraPos) {
+    Clock::time_point start = Clock::now();
+    gpuCullingUsed = gpuCullingAvailable && gpuCullingRequested;
+    stats = IndirectDrawStats();
+    stats.instances = added.size();
+    stats.gpuCulling = gpuCullingUsed;
+
+    buildSlots();
+    stats.slots = slots.size();
+    stats.batches = batches.size();
+    if (slots.empty()) {
+        commands.clear();
+        edgeCommands.clear();
+        visible.clear();
+        return;
+    }
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+    upload();
+    if (gpuCullingUsed) {
+        cullOnGpu(planes, cameraPos);
+    } else {
+        cullOnCpu(planes, cameraPos);
+    }
+
+    // Permutations are few; each gets the frame's uniforms before its first batch
+    preparedShaders.clear();
+    for (Batch& batch : batches) {
+        batch.shader = &shaders.Get(batch.features);
+        if (std::find(preparedShaders.begin(), preparedShaders.end(), batch.shader) == preparedShaders.end()) {
+            preparedShaders.push_back(batch.shader);
+            prepare(*batch.shader);
+            batch.shader->use();
+            batch.shader->setInt("instances", kInstanceUnit);
+            batch.shader->setInt("instanceIndices", kInstanceIndexUnit);
+        }
+    }
+    stats.variants = preparedShaders.size();
+    submit(GL_TRIANGLES, commands, commandBuffer);
+    stats.cpuMs = millisecondsSince(start);
+}
+
+void IndirectRenderer::DrawEdges(Shader& shader) {
+    if (slots.empty()) {
+        return;
+    }
+    shader.use();
+    shader.setInt("instances", kInstanceUnit);
+    shader.setInt("instanceIndices", kInstanceIndexUnit);
+    submit(GL_LINES, edgeCommands, edgeCommandBuffer);
+}
+
+void IndirectRenderer::submit(GLenum mode, const std::vector<DrawElementsCommand>& cpuCommands, GLuint gpuCommands) {
+    MeshPool& pool = MeshPool::Get();
+    pool.Bind();
+    if (gpuCullingUsed) {
+        pool.SetInstanceBuffer(visibleBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCommands);
+    }
+
+    if (mode == GL_TRIANGLES) {
+        for (const Batch& batch : batches) {
+            drawBatch(mode, batch, cpuCommands);
+        }
+    } else {
+        // Lines ignore materials and face culling: everything in one go
+        Batch all = { 0, static_cast<uint32_t>(slots.size()), kInvalidMaterial, false, 0, nullptr };
+        drawBatch(mode, all, cpuCommands);
+    }
+
+    if (gpuCullingUsed) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    pool.SetInstanceBuffer(0);
+
+    // Restore default state
+    GLState::Get().SetEnabled(GL_CULL_FACE, true);
+    GLState::Get().CullFace(GL_BACK);
+    GLState::Get().DepthMask(true);
+    GLState::Get().SetEnabled(GL_BLEND, false);
+}
+
+void IndirectRenderer::drawBatch(GLenum mode, const Batch& batch, const std::vector<DrawElementsCommand>& cpuCommands) {
+    GLState& state = GLState::Get();
+    if (batch.shader) {
+        batch.shader->use();
+    }
+    if (batch.material != kInvalidMaterial) {
+        MaterialTable::Get().BindTextures(batch.material);
+    }
+
+    // Same state as Model::Draw: double-sided materials blend, back faces first
+    int passes = 1;
+    if (batch.doubleSided) {
+        state.SetEnabled(GL_CULL_FACE, false);
+        state.SetEnabled(GL_BLEND, true);
+        state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.SetEnabled(GL_DEPTH_TEST, true);
+        state.DepthMask(false);
+        state.DepthFunc(GL_LESS);
+        passes = 2;
+    } else if (mode == GL_TRIANGLES) {
+        state.SetEnabled(GL_CULL_FACE, true);
+        state.CullFace(GL_BACK);
+        state.DepthMask(true);
+        state.SetEnabled(GL_BLEND, false);
+    }
+
+    for (int pass = 0; pass < passes; pass++) {
+        state.CullFace(passes == 2 && pass == 0 ? GL_FRONT : GL_BACK);
+        if (gpuCullingUsed) {
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT,
+                                        (void*)(static_cast<size_t>(batch.firstSlot) * sizeof(DrawElementsCommand)),
+                                        static_cast<GLsizei>(batch.slotCount), 0);
+            continue;
+        }
+        // No base instance before GL 4.2: the instance attribute is re-pointed per command instead
+        for (uint32_t s = batch.firstSlot; s < batch.firstSlot + batch.slotCount; s++) {
+            const DrawElementsCommand& command = cpuCommands[s];
+            if (command.count == 0 || command.instanceCount == 0) {
+                continue;
+            }
+            MeshPool::Get().SetInstanceBuffer(visibleBuffer, static_cast<size_t>(command.baseInstance) * sizeof(uint32_t));
+            glDrawElementsInstancedBaseVertex(mode, static_cast<GLsizei>(command.count), GL_UNSIGNED_INT,
+                                              (void*)(static_cast<size_t>(command.firstIndex) * sizeof(unsigned int)),
+                                              static_cast<GLsizei>(command.instanceCount), command.baseVertex);
+        }
+    }
+}
+
+void IndirectRenderer::ReadCommands(std::vector<DrawElementsCommand>& outCommands, std::vector<uint32_t>& outVisible) {
+    if (!gpuCullingUsed || slots.empty()) {
+        outCommands = commands;
+        outVisible = visible;
+        return;
+    }
+    outCommands.resize(slots.size());
+    outVisible.resize(visibleCapacity);
+    glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, outCommands.size() * sizeof(DrawElementsCommand), outCommands.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, visibleBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, outVisible.size() * sizeof(uint32_t), outVisible.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include "model.h"
+#include "shader.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+// Per-instance record shared by the cull shader (std430) and the vertex
+// shader, which reads it as six RGBA32F texels
+struct DrawInstance {
+    glm::mat4 model;
+    glm::vec3 boundsMin;
+    int32_t materialIndex;
+    glm::vec3 boundsMax;
+    int32_t jointOffset;
+};
+static_assert(sizeof(DrawInstance) == 96, "DrawInstance must match the std430 layout in cull.comp");
+
+// Layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+struct IndirectDrawStats {
+    size_t instances = 0;
+    size_t visible = 0;      // Only counted on the CPU path; the GPU path never reads back
+    size_t slots = 0;        // Mesh and level of detail pairs
+    size_t batches = 0;      // Multi-draws per pass
+    size_t variants = 0;     // Shader permutations the batches use
+    bool gpuCulling = false;
+    double cpuMs = 0.0;      // Building, uploading and submitting on the CPU, culling included on the CPU path
+};
+
+// Draws many instances of pooled meshes with one multi-draw per material
+// batch. Instances are grouped by model and shader permutation every frame;
+// each group contributes one draw slot per level of detail. Frustum culling, LOD selection and
+// in-order compaction of the surviving instances into per-slot ranges happen
+// in a compute shader that writes the indirect commands, so the CPU never
+// touches an instance after uploading it. Without compute and multi-draw
+// indirect (before GL 4.3) the same selection and compaction run on the CPU
+// and each command is drawn on its own; both paths produce identical commands.
+class IndirectRenderer {
+public:
+    IndirectRenderer();
+    ~IndirectRenderer();
+    IndirectRenderer(const IndirectRenderer&) = delete;
+    IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+    // The GPU path needs GL 4.3; false forces the CPU path
+    void SetGpuCulling(bool enabled) { gpuCullingRequested = enabled; }
+    bool IsGpuCullingAvailable() const { return gpuCullingAvailable; }
+    // Level n > 0 is used beyond lodDistanceScale * 2^(n-1) bounding radii from the camera
+    void SetLodDistanceScale(float scale) { lodDistanceScale = scale; }
+
+    void Begin();
+    // features are the ShaderFeature flags the instance is drawn with; Instanced is implied
+    void Add(const Model* model, const glm::mat4& matrix, int jointOffset = -1, uint32_t features = 0);
+
+    // Culls against the frustum, selects levels of detail and draws each batch
+    // with its permutation of `shaders`, which must read instances as
+    // shaders/vertex.glsl does. `prepare` sets the frame's uniforms and is
+    // called once for every permutation used.
+    void Draw(ShaderVariants& shaders, const std::function<void(Shader&)>& prepare,
+              const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+    // Outline edges of the instances the last Draw() kept, with `shader` reading instances as shaders/edge.vert does
+    void DrawEdges(Shader& shader);
+
+    const IndirectDrawStats& GetStats() const { return stats; }
+    // Commands and visible list of the last Draw(), read back from the GPU on that path; for
+    // verification. Only the first instanceCount entries from each command's baseInstance are meaningful.
+    void ReadCommands(std::vector<DrawElementsCommand>& commands, std::vector<uint32_t>& visible);
+
+private:
+    static const int kInstanceUnit = 13;       // Float view of the instance records
+    static const int kInstanceIndexUnit = 14;  // Integer view of the same buffer
+    static const uint32_t kCullGroupSize = 256;
+
+    // One mesh at one level of detail; mirrors struct Slot in cull.comp
+    struct Slot {
+        uint32_t firstInstance;   // Into the grouped instance records
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t baseVertex;
+        uint32_t lod;
+        uint32_t lodCount;
+        uint32_t visibleOffset;   // First entry in the visible list, the command's baseInstance
+        uint32_t edgeFirstIndex;
+        uint32_t edgeIndexCount;
+    };
+
+    // Consecutive slots sharing a program, texture bindings and face culling state
+    struct Batch {
+        uint32_t firstSlot;
+        uint32_t slotCount;
+        MaterialId material;
+        bool doubleSided;
+        uint32_t features;
+        Shader* shader;   // Null when the caller's program is used
+    };
+
+    struct ModelGroup {
+        const Model* model;
+        uint32_t features;
+        uint32_t count;
+        uint32_t first;
+    };
+
+    using GroupKey = std::pair<const Model*, uint32_t>;
+    struct GroupKeyHash {
+        size_t operator()(const GroupKey& key) const {
+            return std::hash<const Model*>()(key.first) ^ (static_cast<size_t>(key.second) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    bool gpuCullingRequested = true;
+    bool gpuCullingAvailable = false;
+    bool gpuCullingUsed = false;
+    float lodDistanceScale = 8.0f;
+    std::unique_ptr<Shader> cullShader;
+
+    // Frame input in Add() order, then grouped by model and permutation
+    std::vector<uint32_t> addedGroups;
+    std::vector<DrawInstance> added;
+    std::unordered_map<GroupKey, uint32_t, GroupKeyHash> groupIndex;
+    std::vector<ModelGroup> groups;
+    std::vector<DrawInstance> instances;
+    std::vector<Slot> slots;
+    std::vector<Batch> batches;
+    std::vector<Shader*> preparedShaders;
+    uint32_t visibleCapacity = 0;
+
+    // CPU path results
+    std::vector<int8_t> instanceLods;
+    std::vector<DrawElementsCommand> commands;
+    std::vector<DrawElementsCommand> edgeCommands;
+    std::vector<uint32_t> visible;
+
+    GLuint instanceBuffer = 0, instanceTexture = 0, instanceIndexTexture = 0;
+    GLuint slotBuffer = 0, visibleBuffer = 0, commandBuffer = 0, edgeCommandBuffer = 0;
+    int64_t instanceBytes = 0, slotBytes = 0, visibleBytes = 0, commandBytes = 0, edgeCommandBytes = 0;
+    IndirectDrawStats stats;
+
+    void buildSlots();
+    void upload();
+    void cullOnGpu(const glm::vec4 planes[6], const glm::vec3& cameraPos);
+    void cullOnCpu(const glm::vec4 planes[6], const glm::vec3& cameraPos);
+    void submit(GLenum mode, const std::vector<DrawElementsCommand>& cpuCommands, GLuint gpuCommands);
+    void drawBatch(GLenum mode, const Batch& batch, const std::vector<DrawElementsCommand>& cpuCommands);
+};
+
+// Frustum test and LOD choice shared by both paths: -1 when culled.
+// shaders/cull.comp evaluates the same expressions in the same order.
+int SelectInstanceLod(const DrawInstance& instance, const glm::vec4 planes[6], const glm::vec3& cameraPos,
+                      uint32_t lodCount, float lodDistanceScale);
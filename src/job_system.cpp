@@ -0,0 +1,96 @@
+#include "job_system.h"
+#include <memory>
+#include <algorithm>
+
+JobSystem& JobSystem::Get() {
+    static JobSystem instance;
+    return instance;
+}
+
+JobSystem::JobSystem() : stopping(false) {
+    // Leave one core for the render thread
+    unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+    count = count > 1 ? count - 1 : 1;
+    for (unsigned int i = 0; i < count; i++) {
+        workers.emplace_back(&JobSystem::WorkerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::Submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+void JobSystem::WorkerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1) {
+        fn(0, count);
+        return;
+    }
+
+    // Shared so helpers that start after the loop has finished still see valid state
+    struct LoopState {
+        std::function<void(size_t, size_t)> fn;
+        size_t count, grain, chunks;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+    auto state = std::make_shared<LoopState>();
+    state->fn = fn;
+    state->count = count;
+    state->grain = grain;
+    state->chunks = chunks;
+
+    auto runChunks = [](LoopState& s) {
+        size_t chunk;
+        while ((chunk = s.next.fetch_add(1)) < s.chunks) {
+            size_t begin = chunk * s.grain;
+            s.fn(begin, std::min(begin + s.grain, s.count));
+            s.done.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    size_t helpers = std::min(workers.size(), chunks - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        Submit([state, runChunks] { runChunks(*state); });
+    }
+
+    runChunks(*state);
+    while (state->done.load(std::memory_order_acquire) < chunks) {
+        std::this_thread::yield();
+    }
+}
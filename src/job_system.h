@@ -0,0 +1,36 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Shared worker pool for background work (streaming, loading) and data-parallel
+// loops. Submit() is fire-and-forget; ParallelFor() blocks until all chunks are
+// done and the calling thread works on chunks too, so it is safe to call from a job.
+class JobSystem {
+public:
+    static JobSystem& Get();
+
+    void Submit(std::function<void()> job);
+
+    // Calls fn(begin, end) over [0, count) in chunks of at most grain items
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    size_t GetWorkerCount() const { return workers.size(); }
+
+    ~JobSystem();
+
+private:
+    JobSystem();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void WorkerLoop();
+};
@@ -0,0 +1,374 @@
+#include "lights.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "memory_tracker.h"
+#include "deletion_queue.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using namespace simd;
+
+namespace {
+
+const char* kAssetName = "lights";
+const uint32_t kNoSlot = 0xffffffffu;
+const size_t kMaxLights = 0xffff;   // Cluster scratch stores 16-bit light indices
+const int kLightDataUnit = 9;
+const int kClusterUnit = 10;
+const int kIndexUnit = 11;
+
+struct LightRange {
+    int sliceMin, sliceMax;
+    int tileMinX, tileMaxX, tileMinY, tileMaxY;
+    float x, y, z, radius;   // View space
+};
+
+} // namespace
+
+ClusteredLights::ClusteredLights(const ClusterSettings& settings) : settings(settings) {
+    this->settings.tilesX = std::max(this->settings.tilesX, 1);
+    this->settings.tilesY = std::max(this->settings.tilesY, 1);
+    this->settings.slices = std::max(this->settings.slices, 1);
+    this->settings.maxLightsPerCluster = std::max(this->settings.maxLightsPerCluster, 1);
+}
+
+ClusteredLights::~ClusteredLights() {
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteTexture(lightTexture, kAssetName, 0);
+    queue.DeleteTexture(clusterTexture, kAssetName, 0);
+    queue.DeleteTexture(indexTexture, kAssetName, 0);
+    queue.DeleteBuffer(lightBuffer, kAssetName, MemoryCategory::Vertex, lightBufferBytes);
+    queue.DeleteBuffer(clusterBuffer, kAssetName, MemoryCategory::Vertex, clusterBufferBytes);
+    queue.DeleteBuffer(indexBuffer, kAssetName, MemoryCategory::Vertex, indexBufferBytes);
+}
+
+LightId ClusteredLights::AddLight(const PointLight& light) {
+    if (slotIds.size() >= kMaxLights) {
+        std::cout << "Light limit reached, dropping light" << std::endl;
+        return kInvalidLight;
+    }
+
+    LightId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = static_cast<LightId>(idToSlot.size());
+        idToSlot.push_back(kNoSlot);
+    }
+
+    idToSlot[id] = static_cast<uint32_t>(slotIds.size());
+    slotIds.push_back(id);
+    lights.push_back(light);
+    baseIntensity.push_back(light.intensity);
+    fadeRemaining.push_back(0.0f);
+    fadeDuration.push_back(0.0f);
+    return id;
+}
+
+void ClusteredLights::SetLight(LightId id, const PointLight& light) {
+    if (id < idToSlot.size() && idToSlot[id] != kNoSlot) {
+        lights[idToSlot[id]] = light;
+        baseIntensity[idToSlot[id]] = light.intensity;
+    }
+}
+
+void ClusteredLights::RemoveLight(LightId id) {
+    if (id < idToSlot.size() && idToSlot[id] != kNoSlot) {
+        removeSlot(idToSlot[id]);
+    }
+}
+
+void ClusteredLights::AddTransientLight(const PointLight& light, float duration) {
+    LightId id = AddLight(light);
+    if (id != kInvalidLight && duration > 0.0f) {
+        fadeRemaining[idToSlot[id]] = duration;
+        fadeDuration[idToSlot[id]] = duration;
+    }
+}
+
+void ClusteredLights::removeSlot(uint32_t slot) {
+    uint32_t last = static_cast<uint32_t>(slotIds.size() - 1);
+    LightId id = slotIds[slot];
+    if (slot != last) {
+        slotIds[slot] = slotIds[last];
+        lights[slot] = lights[last];
+        baseIntensity[slot] = baseIntensity[last];
+        fadeRemaining[slot] = fadeRemaining[last];
+        fadeDuration[slot] = fadeDuration[last];
+        idToSlot[slotIds[slot]] = slot;
+    }
+    slotIds.pop_back();
+    lights.pop_back();
+    baseIntensity.pop_back();
+    fadeRemaining.pop_back();
+    fadeDuration.pop_back();
+    idToSlot[id] = kNoSlot;
+    freeIds.push_back(id);
+}
+
+void ClusteredLights::Update(float deltaTime) {
+    // Backwards, so swapping the last slot in never skips a light
+    for (size_t i = slotIds.size(); i-- > 0;) {
+        if (fadeDuration[i] <= 0.0f) {
+            continue;
+        }
+        fadeRemaining[i] -= deltaTime;
+        if (fadeRemaining[i] <= 0.0f) {
+            removeSlot(static_cast<uint32_t>(i));
+        } else {
+            lights[i].intensity = baseIntensity[i] * (fadeRemaining[i] / fadeDuration[i]);
+        }
+    }
+}
+
+void ClusteredLights::buildClusterBounds(const glm::mat4& projection) {
+    int tilesX = settings.tilesX, tilesY = settings.tilesY, slices = settings.slices;
+    size_t clusterCount = static_cast<size_t>(tilesX) * tilesY * slices;
+    for (auto* bounds : { &boundsMinX, &boundsMinY, &boundsMinZ, &boundsMaxX, &boundsMaxY, &boundsMaxZ }) {
+        bounds->assign(clusterCount, 0.0f);
+    }
+
+    float logRange = std::log(clusterFar / clusterNear);
+    depthScale = slices / logRange;
+    depthBias = -slices * std::log(clusterNear) / logRange;
+
+    // Directions through the tile corners, scaled so z = -1
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    std::vector<glm::vec3> corners((tilesX + 1) * (tilesY + 1));
+    for (int y = 0; y <= tilesY; y++) {
+        for (int x = 0; x <= tilesX; x++) {
+            glm::vec4 p = inverseProjection * glm::vec4(-1.0f + 2.0f * x / tilesX, -1.0f + 2.0f * y / tilesY, -1.0f, 1.0f);
+            glm::vec3 point = glm::vec3(p) / p.w;
+            corners[y * (tilesX + 1) + x] = point / -point.z;
+        }
+    }
+
+    for (int z = 0; z < slices; z++) {
+        float depthNear = clusterNear * std::pow(clusterFar / clusterNear, static_cast<float>(z) / slices);
+        float depthFar = clusterNear * std::pow(clusterFar / clusterNear, static_cast<float>(z + 1) / slices);
+        for (int y = 0; y < tilesY; y++) {
+            for (int x = 0; x < tilesX; x++) {
+                glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+                for (int corner = 0; corner < 4; corner++) {
+                    glm::vec3 direction = corners[(y + corner / 2) * (tilesX + 1) + x + corner % 2];
+                    lo = glm::min(lo, glm::min(direction * depthNear, direction * depthFar));
+                    hi = glm::max(hi, glm::max(direction * depthNear, direction * depthFar));
+                }
+                size_t cluster = (static_cast<size_t>(z) * tilesY + y) * tilesX + x;
+                boundsMinX[cluster] = lo.x;
+                boundsMinY[cluster] = lo.y;
+                boundsMinZ[cluster] = lo.z;
+                boundsMaxX[cluster] = hi.x;
+                boundsMaxY[cluster] = hi.y;
+                boundsMaxZ[cluster] = hi.z;
+            }
+        }
+    }
+}
+
+void ClusteredLights::Build(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+                            int width, int height) {
+    viewportWidth = std::max(width, 1);
+    viewportHeight = std::max(height, 1);
+    bool projectionChanged = nearPlane != clusterNear || farPlane != clusterFar;
+    for (int c = 0; c < 4 && !projectionChanged; c++) {
+        projectionChanged = projection[c] != clusterProjection[c];
+    }
+    if (projectionChanged) {
+        clusterProjection = projection;
+        clusterNear = nearPlane;
+        clusterFar = farPlane;
+        buildClusterBounds(projection);
+    }
+
+    int tilesX = settings.tilesX, tilesY = settings.tilesY, slices = settings.slices;
+    size_t clusterCount = static_cast<size_t>(tilesX) * tilesY * slices;
+    size_t lightCount = lights.size();
+
+    // Each light's slice and tile range from its view-space bounding box
+    std::vector<LightRange> ranges(lightCount);
+    for (size_t i = 0; i < lightCount; i++) {
+        LightRange& range = ranges[i];
+        glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+        float radius = lights[i].radius;
+        range.x = center.x;
+        range.y = center.y;
+        range.z = center.z;
+        range.radius = radius;
+
+        float depthMin = -center.z - radius, depthMax = -center.z + radius;
+        if (depthMax < clusterNear || depthMin > clusterFar || radius <= 0.0f || lights[i].intensity <= 0.0f) {
+            range.sliceMin = 1;
+            range.sliceMax = 0;
+            continue;
+        }
+        auto sliceOf = [&](float depth) {
+            int slice = static_cast<int>(std::floor(std::log(std::max(depth, clusterNear)) * depthScale + depthBias));
+            return std::min(std::max(slice, 0), slices - 1);
+        };
+        range.sliceMin = sliceOf(depthMin);
+        range.sliceMax = sliceOf(depthMax);
+
+        range.tileMinX = 0;
+        range.tileMaxX = tilesX - 1;
+        range.tileMinY = 0;
+        range.tileMaxY = tilesY - 1;
+        if (depthMin > clusterNear) {
+            // Entirely in front of the camera: the projected box corners bound the sphere on screen
+            glm::vec2 lo(1.0f), hi(-1.0f);
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 p = center + glm::vec3((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius,
+                                                 (corner & 4) ? radius : -radius);
+                glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+                glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+                lo = glm::vec2(std::min(lo.x, ndc.x), std::min(lo.y, ndc.y));
+                hi = glm::vec2(std::max(hi.x, ndc.x), std::max(hi.y, ndc.y));
+            }
+            if (lo.x > 1.0f || lo.y > 1.0f || hi.x < -1.0f || hi.y < -1.0f) {
+                range.sliceMin = 1;
+                range.sliceMax = 0;
+                continue;
+            }
+            auto tileOf = [](float ndc, int tiles) {
+                int tile = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+                return std::min(std::max(tile, 0), tiles - 1);
+            };
+            range.tileMinX = tileOf(lo.x, tilesX);
+            range.tileMaxX = tileOf(hi.x, tilesX);
+            range.tileMinY = tileOf(lo.y, tilesY);
+            range.tileMaxY = tileOf(hi.y, tilesY);
+        }
+    }
+
+    // One depth slice per job; every cluster is written by exactly one job
+    int maxPerCluster = settings.maxLightsPerCluster;
+    clusterCounts.assign(clusterCount, 0);
+    clusterScratch.resize(clusterCount * maxPerCluster);
+    JobSystem::Get().ParallelFor(static_cast<size_t>(slices), 1, [&](size_t begin, size_t end) {
+        for (size_t z = begin; z < end; z++) {
+            int slice = static_cast<int>(z);
+            for (size_t i = 0; i < lightCount; i++) {
+                const LightRange& range = ranges[i];
+                if (slice < range.sliceMin || slice > range.sliceMax) {
+                    continue;
+                }
+                Float4 cx = Splat(range.x), cy = Splat(range.y), cz = Splat(range.z);
+                Float4 radiusSquared = Splat(range.radius * range.radius);
+                Float4 zero = Splat(0.0f);
+
+                for (int y = range.tileMinY; y <= range.tileMaxY; y++) {
+                    size_t row = (static_cast<size_t>(slice) * tilesY + y) * tilesX;
+                    for (int x = range.tileMinX; x <= range.tileMaxX; x += 4) {
+                        // Sphere against four cluster boxes; lanes past the row end reuse its last cluster
+                        float lane[6][4];
+                        int lanes = std::min(4, range.tileMaxX - x + 1);
+                        for (int l = 0; l < 4; l++) {
+                            size_t cluster = row + x + std::min(l, lanes - 1);
+                            lane[0][l] = boundsMinX[cluster];
+                            lane[1][l] = boundsMinY[cluster];
+                            lane[2][l] = boundsMinZ[cluster];
+                            lane[3][l] = boundsMaxX[cluster];
+                            lane[4][l] = boundsMaxY[cluster];
+                            lane[5][l] = boundsMaxZ[cluster];
+                        }
+                        Float4 dx = Max(Max(Load(lane[0]) - cx, cx - Load(lane[3])), zero);
+                        Float4 dy = Max(Max(Load(lane[1]) - cy, cy - Load(lane[4])), zero);
+                        Float4 dz = Max(Max(Load(lane[2]) - cz, cz - Load(lane[5])), zero);
+                        int hits = MoveMask(LessEqual(dx * dx + dy * dy + dz * dz, radiusSquared)) & ((1 << lanes) - 1);
+                        for (int l = 0; l < lanes; l++) {
+                            size_t cluster = row + x + l;
+                            if ((hits & (1 << l)) && clusterCounts[cluster] < static_cast<uint32_t>(maxPerCluster)) {
+                                clusterScratch[cluster * maxPerCluster + clusterCounts[cluster]++] = static_cast<uint16_t>(i);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // Compact the per-cluster lists into one index buffer
+    clusterRanges.resize(clusterCount * 2);
+    indices.clear();
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        clusterRanges[cluster * 2] = static_cast<uint32_t>(indices.size());
+        clusterRanges[cluster * 2 + 1] = clusterCounts[cluster];
+        const uint16_t* list = &clusterScratch[cluster * maxPerCluster];
+        indices.insert(indices.end(), list, list + clusterCounts[cluster]);
+    }
+    indexCount = indices.size();
+    if (indices.empty()) {
+        indices.push_back(0);   // Texture buffers need storage even when nothing is lit
+    }
+
+    lightTexels.resize(std::max<size_t>(lightCount, 1) * 8, 0.0f);
+    for (size_t i = 0; i < lightCount; i++) {
+        const PointLight& light = lights[i];
+        float* texel = &lightTexels[i * 8];
+        texel[0] = light.position.x;
+        texel[1] = light.position.y;
+        texel[2] = light.position.z;
+        texel[3] = light.radius;
+        texel[4] = light.color.r * light.intensity;
+        texel[5] = light.color.g * light.intensity;
+        texel[6] = light.color.b * light.intensity;
+        texel[7] = 0.0f;
+    }
+
+    // Dedicated units, so material textures bound per draw never displace them
+    upload(lightBuffer, lightTexture, lightBufferBytes, GL_RGBA32F, kLightDataUnit, lightTexels.data(),
+           static_cast<int64_t>(lightTexels.size() * sizeof(float)));
+    upload(clusterBuffer, clusterTexture, clusterBufferBytes, GL_RG32UI, kClusterUnit, clusterRanges.data(),
+           static_cast<int64_t>(clusterRanges.size() * sizeof(uint32_t)));
+    upload(indexBuffer, indexTexture, indexBufferBytes, GL_R32UI, kIndexUnit, indices.data(),
+           static_cast<int64_t>(indices.size() * sizeof(uint32_t)));
+    GLState::Get().ActiveTexture(0);
+}
+
+void ClusteredLights::upload(GLuint& buffer, GLuint& texture, int64_t& capacity, GLenum format, int unit,
+                             const void* data, int64_t bytes) {
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+    }
+
+    // Orphan and refill; the texture view is re-pointed only when the storage grows
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    bool grown = bytes > capacity;
+    if (grown) {
+        int64_t newCapacity = std::max<int64_t>(bytes, capacity * 2);
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, capacity);
+        MemoryTracker::Get().Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, newCapacity);
+        capacity = newCapacity;
+    }
+    glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    GLState::Get().BindTexture(unit, GL_TEXTURE_BUFFER, texture);
+    if (grown) {
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    }
+}
+
+void ClusteredLights::Bind(Shader& shader) const {
+    shader.use();
+    shader.setInt("lightData", kLightDataUnit);
+    shader.setInt("lightClusters", kClusterUnit);
+    shader.setInt("lightIndices", kIndexUnit);
+    shader.setInt("clusterTilesX", settings.tilesX);
+    shader.setInt("clusterTilesY", settings.tilesY);
+    shader.setInt("clusterSlices", settings.slices);
+    shader.setVec4("clusterParams", glm::vec4(static_cast<float>(viewportWidth) / settings.tilesX,
+                                              static_cast<float>(viewportHeight) / settings.tilesY,
+                                              depthScale, depthBias));
+    shader.setFloat("clusterNear", clusterNear);
+    shader.setFloat("clusterFar", clusterFar);
+    shader.setVec3("sunDirection", glm::normalize(settings.sunDirection));
+    shader.setVec3("sunColor", settings.sunColor);
+    shader.setVec3("ambientColor", settings.ambientColor);
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "shader.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+using LightId = uint32_t;
+const LightId kInvalidLight = 0xffffffffu;
+
+struct PointLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    float radius = 10.0f;              // Light reaches zero at this distance
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+};
+
+struct ClusterSettings {
+    int tilesX = 16;
+    int tilesY = 9;
+    int slices = 24;                   // Exponential depth slices between the clip planes
+    int maxLightsPerCluster = 64;      // Caps the per-pixel cost in the worst cluster
+    glm::vec3 sunDirection = glm::vec3(0.4f, 0.8f, 0.3f);
+    glm::vec3 sunColor = glm::vec3(0.8f);
+    glm::vec3 ambientColor = glm::vec3(0.35f);
+};
+
+// Clustered forward lighting. The view frustum is divided into a grid of
+// tiles by exponential depth slices; each frame the point lights are binned
+// into the clusters they touch on the job system, one depth slice per job,
+// testing four clusters per light with SIMD. Light data, per-cluster ranges
+// and the light index list go to texture buffers that the lit shaders read,
+// so a pixel only evaluates the lights of its own cluster.
+class ClusteredLights {
+public:
+    ClusteredLights(const ClusterSettings& settings = ClusterSettings());
+    ~ClusteredLights();
+
+    ClusteredLights(const ClusteredLights&) = delete;
+    ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+    LightId AddLight(const PointLight& light);
+    void SetLight(LightId id, const PointLight& light);
+    void RemoveLight(LightId id);
+    // Fire-and-forget light that fades out over `duration` seconds, e.g. a muzzle flash
+    void AddTransientLight(const PointLight& light, float duration);
+
+    // Fades and expires transient lights
+    void Update(float deltaTime);
+
+    // Bin lights for this camera and upload the result; call once per frame before drawing
+    void Build(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+               int viewportWidth, int viewportHeight);
+    // Point a lit shader at the buffers and set its cluster uniforms
+    void Bind(Shader& shader) const;
+
+    size_t GetLightCount() const { return slotIds.size(); }
+    size_t GetAssignedIndexCount() const { return indexCount; }
+
+private:
+    ClusterSettings settings;
+
+    // Dense per-slot light data; ids map to slots so removal can swap the last slot in
+    std::vector<LightId> slotIds;
+    std::vector<uint32_t> idToSlot;
+    std::vector<LightId> freeIds;
+    std::vector<PointLight> lights;
+    std::vector<float> baseIntensity;
+    std::vector<float> fadeRemaining, fadeDuration;   // Duration 0 for permanent lights
+
+    // View-space cluster bounds, rebuilt when the projection or clip planes change
+    glm::mat4 clusterProjection = glm::mat4(0.0f);
+    float clusterNear = 0.0f, clusterFar = 0.0f;
+    std::vector<float> boundsMinX, boundsMinY, boundsMinZ, boundsMaxX, boundsMaxY, boundsMaxZ;
+    float depthScale = 0.0f, depthBias = 0.0f;   // slice = log(depth) * scale + bias
+    int viewportWidth = 1, viewportHeight = 1;
+
+    // Per-frame binning results
+    std::vector<uint32_t> clusterRanges;   // Offset and count per cluster
+    std::vector<uint32_t> clusterCounts;
+    std::vector<uint16_t> clusterScratch;  // maxLightsPerCluster slots per cluster
+    std::vector<uint32_t> indices;
+    std::vector<float> lightTexels;
+    size_t indexCount = 0;
+
+    GLuint lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+    GLuint lightTexture = 0, clusterTexture = 0, indexTexture = 0;
+    int64_t lightBufferBytes = 0, clusterBufferBytes = 0, indexBufferBytes = 0;
+
+    void removeSlot(uint32_t slot);
+    void buildClusterBounds(const glm::mat4& projection);
+    void upload(GLuint& buffer, GLuint& texture, int64_t& capacity, GLenum format, int unit, const void* data, int64_t bytes);
+};
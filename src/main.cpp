@@ -13,6 +13,21 @@
 #include <iostream>
 #include "entity.h"
 #include "scene.h"
+#include "dynamic_resolution.h"
+#include "simulation.h"
+#include "memory_tracker.h"
+#include "deletion_queue.h"
+#include "texture_streamer.h"
+#include "gl_state.h"
+#include "mesh_pool.h"
+#include "debug_draw.h"
+#include "world_partition.h"
+#include "terrain.h"
+#include "replication.h"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
 
 Camera camera(glm::vec3(0.0f, 0.2f, 5.0f));
 float lastFrameTime = 0.0f;
@@ -20,91 +35,7 @@ float lastX = 400.0f;
 float lastY = 300.0f;
 bool firstMouse = true;
 float deltaTime = 0.0f;
-
-void drawDebugAxes(const glm::mat4& projection, const glm::mat4& view) {
-    static GLuint axisVAO = 0;
-    static GLuint axisVBO = 0;
-    static Shader* axisShader = nullptr;
-
-    if (axisVAO == 0) {
-        // Create axis shader
-        const char* axisVertexShader = R"(
-            #version 330 core
-            layout (location = 0) in vec3 aPos;
-            layout (location = 1) in vec3 aColor;
-            uniform mat4 projection;
-            uniform mat4 view;
-            out vec3 Color;
-            void main() {
-                Color = aColor;
-                gl_Position = projection * view * vec4(aPos, 1.0);
-            }
-        )";
-
-        const char* axisFragmentShader = R"(
-            #version 330 core
-            in vec3 Color;
-            out vec4 FragColor;
-            void main() {
-                FragColor = vec4(Color, 1.0);
-            }
-        )";
-
-        // Axis vertices: position and color
-        float axisVertices[] = {
-            // positions      // colors
-            0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,  // X axis start (red)
-            1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,  // X axis end
-            0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,  // Y axis start (green)
-            0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,  // Y axis end
-            0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,  // Z axis start (blue)
-            0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f   // Z axis end
-        };
-
-        // Create and setup axis buffers
-        glGenVertexArrays(1, &axisVAO);
-        glGenBuffers(1, &axisVBO);
-        
-        glBindVertexArray(axisVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, axisVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(axisVertices), axisVertices, GL_STATIC_DRAW);
-        
-        // Position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        // Color attribute
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        // Create shader program
-        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &axisVertexShader, NULL);
-        glCompileShader(vertexShader);
-
-        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &axisFragmentShader, NULL);
-        glCompileShader(fragmentShader);
-
-        GLuint shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-
-        axisShader = new Shader(shaderProgram);
-    }
-
-    // Draw axes
-    axisShader->use();
-    axisShader->setMat4("projection", projection);
-    axisShader->setMat4("view", view);
-
-    glBindVertexArray(axisVAO);
-    glDrawArrays(GL_LINES, 0, 6);
-    glBindVertexArray(0);
-}
+bool showDebugOverlay = false;
 
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -118,10 +49,88 @@ void processInput(GLFWwindow *window) {
         camera.ProcessKeyboard('A', deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard('D', deltaTime);
+
+    // F1 dumps per-asset memory counters
+    static bool dumpKeyDown = false;
+    bool dumpPressed = glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS;
+    if (dumpPressed && !dumpKeyDown) {
+        MemoryTracker::Get().Dump(std::cout);
+        const GLState::Stats& stats = GLState::Get().GetStats();
+        std::cout << "GL state calls: " << stats.issued << " issued, " << stats.skipped << " skipped" << std::endl;
+    }
+    dumpKeyDown = dumpPressed;
+
+    // F3 toggles the debug overlay: axes, culling bounds and frame statistics
+    static bool overlayKeyDown = false;
+    bool overlayPressed = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+    if (overlayPressed && !overlayKeyDown) {
+        showDebugOverlay = !showDebugOverlay;
+    }
+    overlayKeyDown = overlayPressed;
+}
+
+// Reticle, a radar around the camera and, with the overlay on, frame statistics.
+// tankMatrix is the tank's render transform, never its simulation-side matrix.
+void drawHud(const Scene& scene, const Entity* tank, const glm::mat4& tankMatrix, int width, int height) {
+    DebugDraw& debug = DebugDraw::Get();
+    const glm::vec4 hudColor(0.4f, 1.0f, 0.5f, 0.9f);
+
+    glm::vec2 center(width * 0.5f, height * 0.5f);
+    debug.Line2D(center - glm::vec2(14.0f, 0.0f), center - glm::vec2(5.0f, 0.0f), hudColor);
+    debug.Line2D(center + glm::vec2(5.0f, 0.0f), center + glm::vec2(14.0f, 0.0f), hudColor);
+    debug.Line2D(center - glm::vec2(0.0f, 14.0f), center - glm::vec2(0.0f, 5.0f), hudColor);
+    debug.Line2D(center + glm::vec2(0.0f, 5.0f), center + glm::vec2(0.0f, 14.0f), hudColor);
+
+    // Radar: ground plane around the camera, the view direction pointing up
+    const float radarRadius = 70.0f;
+    const float radarRange = 40.0f;
+    glm::vec2 radarCenter(radarRadius + 20.0f, height - radarRadius - 20.0f);
+    debug.FillRect2D(radarCenter - glm::vec2(radarRadius), radarCenter + glm::vec2(radarRadius), glm::vec4(0.0f, 0.1f, 0.0f, 0.5f));
+    debug.Circle2D(radarCenter, radarRadius, hudColor, 48);
+    debug.Line2D(radarCenter, radarCenter - glm::vec2(0.0f, radarRadius), glm::vec4(hudColor.r, hudColor.g, hudColor.b, 0.3f));
+    glm::vec3 front = camera.GetFront();
+    glm::vec2 forward = glm::length(glm::vec2(front.x, front.z)) > 0.0f ? glm::normalize(glm::vec2(front.x, front.z)) : glm::vec2(0.0f, -1.0f);
+    glm::vec2 right(-forward.y, forward.x);
+    glm::vec3 offset = glm::vec3(tankMatrix[3]) - camera.GetPosition();
+    glm::vec2 blip(glm::dot(glm::vec2(offset.x, offset.z), right), -glm::dot(glm::vec2(offset.x, offset.z), forward));
+    blip *= radarRadius / radarRange;
+    if (glm::length(blip) > radarRadius) {
+        blip = glm::normalize(blip) * radarRadius;
+    }
+    debug.FillRect2D(radarCenter + blip - glm::vec2(3.0f), radarCenter + blip + glm::vec2(3.0f), glm::vec4(1.0f, 0.3f, 0.2f, 1.0f));
+
+    if (!showDebugOverlay) {
+        return;
+    }
+    if (const Model* tankModel = scene.GetModel(tank->GetModel())) {
+        debug.Box(tankMatrix, tankModel->GetBoundsMin(), tankModel->GetBoundsMax(), glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+    }
+
+    const IndirectDrawStats& draws = scene.GetIndirectDrawStats();
+    const OcclusionStats& occlusion = scene.GetOcclusionStats();
+    const StaticBatchStats& staticBatches = scene.GetStaticBatchStats();
+    char line[128];
+    float y = 20.0f;
+    std::snprintf(line, sizeof(line), "FRAME %.2f MS", deltaTime * 1000.0f);
+    debug.Text(glm::vec2(20.0f, y), line, hudColor);
+    y += 20.0f;
+    std::snprintf(line, sizeof(line), "INSTANCES %zu SLOTS %zu BATCHES %zu VARIANTS %zu %s", draws.instances, draws.slots,
+                  draws.batches, draws.variants, draws.gpuCulling ? "GPU" : "CPU");
+    debug.Text(glm::vec2(20.0f, y), line, hudColor);
+    y += 20.0f;
+    std::snprintf(line, sizeof(line), "OCCLUSION %zu TESTED %zu HIDDEN", occlusion.tested, occlusion.culled);
+    debug.Text(glm::vec2(20.0f, y), line, hudColor);
+    y += 20.0f;
+    std::snprintf(line, sizeof(line), "STATIC %zu ENTITIES %zu CELLS %zu CHUNKS", staticBatches.entities,
+                  staticBatches.cells, staticBatches.chunks);
+    debug.Text(glm::vec2(20.0f, y), line, hudColor);
+    y += 20.0f;
+    std::snprintf(line, sizeof(line), "DEBUG VERTICES %zu", DebugDraw::Get().GetLastVertexCount());
+    debug.Text(glm::vec2(20.0f, y), line, hudColor);
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    GLState::Get().Viewport(0, 0, width, height);
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
@@ -143,7 +152,28 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
-int main() {
+int main(int argc, char** argv) {
+    bool threadedSimulation = false;
+    bool cpuCulling = false;
+    bool meshBackground = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--threaded-sim") == 0) {
+            threadedSimulation = true;
+        } else if (std::strcmp(argv[i], "--cpu-culling") == 0) {
+            // Draw through the indirect renderer's fallback path even where compute is available
+            cpuCulling = true;
+        } else if (std::strcmp(argv[i], "--mesh-background") == 0) {
+            // Draw the background model every frame instead of its baked skybox
+            meshBackground = true;
+        } else if (std::strcmp(argv[i], "--replication-loopback") == 0) {
+            // Headless: --replication-loopback [units] [clients] [ticks]
+            size_t units = i + 1 < argc ? std::strtoul(argv[i + 1], nullptr, 10) : 2000;
+            size_t clients = i + 2 < argc ? std::strtoul(argv[i + 2], nullptr, 10) : 8;
+            uint32_t ticks = i + 3 < argc ? static_cast<uint32_t>(std::strtoul(argv[i + 3], nullptr, 10)) : 600;
+            return RunReplicationLoopback(units > 0 ? units : 2000, clients > 0 ? clients : 8, ticks > 0 ? ticks : 600);
+        }
+    }
+
     if (!glfwInit()) {
         std::cout << "Failed to initialize GLFW" << std::endl;
         return -1;
@@ -162,8 +192,9 @@ int main() {
     #endif
 #endif
 
-    // Enable multisampling
-    glfwWindowHint(GLFW_SAMPLES, 4);  // 4x MSAA
+    // No MSAA on the window itself; the scene is multisampled in the
+    // dynamic resolution target and blitted/upscaled into this framebuffer
+    glfwWindowHint(GLFW_SAMPLES, 0);
     
     GLFWwindow* window = glfwCreateWindow(1200, 1200, "GLB Viewer", NULL, NULL);
     if (!window) {
@@ -191,13 +222,13 @@ int main() {
     // Set viewport size
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
-    glViewport(0, 0, width, height);
+    GLState::Get().Viewport(0, 0, width, height);
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    GLState::Get().SetEnabled(GL_DEPTH_TEST, true);
 
     // Disable face culling to render both sides
-    glDisable(GL_CULL_FACE);
+    GLState::Get().SetEnabled(GL_CULL_FACE, false);
     // Or if you want to explicitly set the culling mode:
     // glEnable(GL_CULL_FACE);
     // glCullFace(GL_NONE);
@@ -206,10 +237,10 @@ int main() {
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     // After enabling depth test
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::Get().SetEnabled(GL_BLEND, true);
+    GLState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Enable multisampling
+    // Enable multisampling (applies to the offscreen MSAA target)
     glEnable(GL_MULTISAMPLE);
     
     // Enable line/edge antialiasing
@@ -221,41 +252,97 @@ int main() {
         
         // Add shaders first
         std::cout << "\nLoading Shaders:" << std::endl;
-        scene.AddShader("background", "shaders/gltf.vert", "shaders/gltf.frag");
-        scene.AddShader("standard", "shaders/vertex.glsl", "shaders/fragment.glsl");
+        scene.AddShader("background", "shaders/gltf.vert", "shaders/gltf.frag",
+                        ShaderFeature::AlphaTest | ShaderFeature::Skinned);
+        scene.AddShader("standard", "shaders/vertex.glsl", "shaders/fragment.glsl",
+                        ShaderFeature::AlphaTest | ShaderFeature::NormalMap | ShaderFeature::UniformScale |
+                        ShaderFeature::Skinned | ShaderFeature::Instanced);
+        scene.AddShader("edges", "shaders/edge.vert", "shaders/edge.frag");
+        scene.AddShader("terrain", "shaders/terrain.vert", "shaders/terrain.frag");
+        scene.AddShader("particles", "shaders/particle.vert", "shaders/particle.frag");
+        
+        // Heightfield ground; fall back to generated terrain when no heightmap ships
+        std::cout << "\nLoading Terrain:" << std::endl;
+        auto ground = std::make_shared<Heightfield>();
+        if (!ground->LoadHeightmap("assets/terrain/battlefield_height.png")) {
+            ground->Generate(2048, 1337);
+        }
+        float groundHeight = ground->GetHeight(0.0f, 0.0f);
+        scene.SetTerrain(std::make_unique<Terrain>(ground));
+        scene.SetClipPlanes(0.1f, 6000.0f);
+        scene.SetGpuCulling(!cpuCulling);
+
+        // Flow-field navigation over the battlefield around the origin; the first
+        // Update() builds the portal graph here rather than in the first tick
+        auto navigation = std::make_unique<NavigationGrid>(glm::vec2(0.0f), 2048.0f);
+        navigation->BuildFromTerrain(*ground);
+        navigation->Update();
+        scene.SetNavigation(std::move(navigation));
         
         // Add models
         std::cout << "\nLoading Models:" << std::endl;
-        scene.AddModel("background", "assets/models/bz_background.glb");
         scene.AddModel("tank", "assets/models/tank.glb");
         
         std::cout << "\nCreating Entities:" << std::endl;
         
-        // Create background first
-        Entity* background = scene.CreateEntity("background", "background",
-            glm::vec3(0.0f),           // Position at origin
-            glm::vec3(0.0f, 0.0f, 0.0f),  // Rotate to face up
-            glm::vec3(0.25f));         // Scale to 0.25
-        
-        if (!background) {
-            throw std::runtime_error("Failed to create background entity");
+        // Background first: baked into a cached cubemap, or the camera-locked mesh
+        if (meshBackground) {
+            scene.AddModel("background", "assets/models/bz_background.glb");
+            Entity* background = scene.CreateEntity("background", "background",
+                glm::vec3(0.0f),           // Position at origin
+                glm::vec3(0.0f, 0.0f, 0.0f),  // Rotate to face up
+                glm::vec3(0.25f));         // Scale to 0.25
+            
+            if (!background) {
+                throw std::runtime_error("Failed to create background entity");
+            }
+            
+            // Print debug info
+            std::cout << "Background entity created with:" << std::endl;
+            std::cout << "Position: 0, 0, 0" << std::endl;
+            std::cout << "Rotation: -90, 0, 0" << std::endl;
+            std::cout << "Scale: 0.25" << std::endl;
+        } else {
+            SkyboxSettings sky;
+            sky.scale = 0.25f;
+            scene.SetSkybox(std::make_unique<Background>("assets/models/bz_background.glb", sky));
         }
         
-        // Print debug info
-        std::cout << "Background entity created with:" << std::endl;
-        std::cout << "Position: 0, 0, 0" << std::endl;
-        std::cout << "Rotation: -90, 0, 0" << std::endl;
-        std::cout << "Scale: 0.25" << std::endl;
-        
         // Then create tank
         Entity* tank = scene.CreateEntity("tank", "standard",
-            glm::vec3(0.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, groundHeight, 0.0f),
             glm::vec3(-90.0f, 0.0f, 0.0f),
             glm::vec3(0.1f));
         
         if (!tank) {
             throw std::runtime_error("Failed to create tank entity");
         }
+        scene.AddBoxCollider(tank);
+
+        // Tank effects; the model is Z-up, so the top of its bounds is max Z
+        const Model* tankModel = scene.GetModel(tank->GetModel());
+        glm::vec3 tankCenter = (tankModel->GetBoundsMin() + tankModel->GetBoundsMax()) * 0.5f;
+        EmitterSettings exhaust = EmitterSettings::Smoke();
+        exhaust.offset = glm::vec3(tankCenter.x, tankModel->GetBoundsMin().y, tankModel->GetBoundsMax().z);
+        scene.GetParticles().CreateEmitter(exhaust, tank);
+        EmitterSettings muzzle = EmitterSettings::MuzzleFlash();
+        muzzle.offset = glm::vec3(tankCenter.x, tankModel->GetBoundsMax().y, tankModel->GetBoundsMax().z);
+        muzzle.velocity = glm::vec3(0.0f, 6.0f, 0.0f);
+        EmitterId muzzleFlash = scene.GetParticles().CreateEmitter(muzzle, tank);
+
+        DynamicResolutionSettings resolutionSettings;
+        resolutionSettings.targetFrameMs = 14.0f;  // Leave headroom for HUD and swap under 60 Hz
+        DynamicResolution dynamicResolution(width, height, resolutionSettings);
+
+        // Fixed 60 Hz simulation, decoupled from the render frame rate
+        Simulation simulation(scene, 60.0f);
+        if (threadedSimulation) {
+            simulation.StartThread();
+        }
+
+        // Cells of the battlefield stream in and out around the camera
+        WorldPartition world(scene);
+        world.LoadManifest("assets/world/battlefield.world");
 
         while (!glfwWindowShouldClose(window)) {
             // Calculate delta time
@@ -265,19 +352,87 @@ int main() {
 
             processInput(window);
             
+            glfwGetFramebufferSize(window, &width, &height);
+            dynamicResolution.Resize(width, height);
+            
+            world.Update(camera.GetPosition());
+            simulation.Advance(deltaTime);
+            // The simulation thread may be writing the tank's transform; read what was published
+            glm::mat4 tankMatrix = scene.GetRenderMatrix(tank->GetHandle(), simulation.GetAlpha());
+
+            // Space fires the main gun; F2 sets off an explosion near the tank
+            static bool fireKeyDown = false, blastKeyDown = false;
+            bool firePressed = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+            bool blastPressed = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
+            if (firePressed && !fireKeyDown) {
+                scene.GetParticles().Burst(muzzleFlash, 48);
+                PointLight flash;
+                flash.position = glm::vec3(tankMatrix * glm::vec4(muzzle.offset, 1.0f));
+                flash.radius = 8.0f;
+                flash.color = glm::vec3(1.0f, 0.6f, 0.25f);
+                flash.intensity = 20.0f;
+                scene.GetLights().AddTransientLight(flash, 0.1f);
+            }
+            if (blastPressed && !blastKeyDown) {
+                glm::vec3 blastPos(std::sin(currentTime) * 2.0f, groundHeight + 0.2f, std::cos(currentTime) * 2.0f);
+                EmitterId blast = scene.GetParticles().CreateEmitter(EmitterSettings::Explosion(), nullptr,
+                                                                     glm::translate(glm::mat4(1.0f), blastPos));
+                scene.GetParticles().Burst(blast, 600);
+                PointLight fireball;
+                fireball.position = blastPos + glm::vec3(0.0f, 1.0f, 0.0f);
+                fireball.radius = 25.0f;
+                fireball.color = glm::vec3(1.0f, 0.5f, 0.15f);
+                fireball.intensity = 60.0f;
+                scene.GetLights().AddTransientLight(fireball, 0.6f);
+            }
+            fireKeyDown = firePressed;
+            blastKeyDown = blastPressed;
+
+            // F4 sends the tank to the ground under the camera
+            static bool moveKeyDown = false;
+            bool movePressed = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+            if (movePressed && !moveKeyDown) {
+                MoveOrder order;
+                order.destination = camera.GetPosition();
+                order.yawAxis = 2;   // Z-up model stood up by its -90 degree X rotation
+                scene.MoveTo(tank, order);
+            }
+            moveKeyDown = movePressed;
+            scene.UpdateEffects(deltaTime);
+            
+            if (showDebugOverlay) {
+                DebugDraw::Get().Axes(glm::mat4(1.0f));
+            }
+            scene.SetDebugBounds(showDebugOverlay);
+            
+            // 3D scene at dynamic resolution
+            dynamicResolution.BeginScene();
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            scene.Draw(camera, simulation.GetAlpha());
+            dynamicResolution.EndScene();
+            
+            // Apply streamed mips and schedule new ones from this frame's requests
+            TextureStreamer::Get().Update();
             
-            scene.Update(deltaTime);
-            scene.Draw(camera);
+            // HUD and debug overlays at native resolution, outside the scene's GPU timing
+            drawHud(scene, tank, tankMatrix, width, height);
+            DebugDraw::Get().Flush(scene.GetProjection() * camera.GetViewMatrix(), width, height);
             
             glfwSwapBuffers(window);
             glfwPollEvents();
+            
+            DeletionQueue::Get().EndFrame();
         }
     }
     catch (const std::exception& e) {
         std::cout << "Error: " << e.what() << std::endl;
     }
 
+    // Scene is gone; release its GPU objects while the context is still current
+    MeshPool::Get().Destroy();
+    DebugDraw::Get().Destroy();
+    DeletionQueue::Get().FlushAll();
+
     glfwTerminate();
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <cstdint>
+
+// Material description shared by model loading and rendering. Plain data with
+// no GL types, so CPU-only builds can parse materials without a context.
+
+// One streamed image: a layer of a GL_TEXTURE_2D_ARRAY shared by every image
+// of the same size, so draws with different materials can keep one binding
+struct TextureLayer {
+    uint32_t array = 0;   // 0 when the image could not be created
+    int layer = -1;
+
+    bool IsValid() const { return array != 0; }
+};
+
+using MaterialId = uint32_t;
+const MaterialId kInvalidMaterial = 0xffffffffu;
+
+// glTF alpha modes; masked and blended materials get the alpha test permutation
+enum class AlphaMode {
+    Opaque,
+    Mask,
+    Blend
+};
+
+struct Material {
+    glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    bool doubleSided = false;
+    glm::vec3 emissiveFactor = glm::vec3(0.0f);
+    AlphaMode alphaMode = AlphaMode::Opaque;
+    float alphaCutoff = 0.5f;   // Texels below it are discarded unless the mode is Opaque
+
+    TextureLayer albedo;
+    TextureLayer metallicRoughness;
+    TextureLayer normal;
+};
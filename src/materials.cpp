@@ -0,0 +1,122 @@
+#include "materials.h"
+#include "gl_state.h"
+#include "memory_tracker.h"
+#include <algorithm>
+
+namespace {
+
+const char* kAssetName = "materials";
+
+}
+
+MaterialTable& MaterialTable::Get() {
+    static MaterialTable instance;
+    return instance;
+}
+
+MaterialId MaterialTable::Add(const Material& material) {
+    MaterialId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        materials[id] = material;
+    } else {
+        id = static_cast<MaterialId>(materials.size());
+        materials.push_back(material);
+    }
+    dirty = true;
+    return id;
+}
+
+void MaterialTable::Remove(MaterialId id) {
+    if (id < materials.size()) {
+        materials[id] = Material();
+        freeIds.push_back(id);
+    }
+}
+
+void MaterialTable::Upload() {
+    if (!dirty) {
+        return;
+    }
+    dirty = false;
+
+    // Texel 0: base color factor; texel 1: metallic, roughness, albedo layer, metallic-roughness layer (-1 for none);
+    // texel 2: normal map layer, alpha cutoff
+    texels.assign(std::max<size_t>(materials.size(), 1) * 12, 0.0f);
+    for (size_t i = 0; i < materials.size(); i++) {
+        const Material& material = materials[i];
+        float* texel = &texels[i * 12];
+        texel[0] = material.baseColorFactor.x;
+        texel[1] = material.baseColorFactor.y;
+        texel[2] = material.baseColorFactor.z;
+        texel[3] = material.baseColorFactor.w;
+        texel[4] = material.metallicFactor;
+        texel[5] = material.roughnessFactor;
+        texel[6] = material.albedo.IsValid() ? static_cast<float>(material.albedo.layer) : -1.0f;
+        texel[7] = material.metallicRoughness.IsValid() ? static_cast<float>(material.metallicRoughness.layer) : -1.0f;
+        texel[8] = material.normal.IsValid() ? static_cast<float>(material.normal.layer) : -1.0f;
+        texel[9] = material.alphaCutoff;
+    }
+
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+    }
+    int64_t bytes = static_cast<int64_t>(texels.size() * sizeof(float));
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    bool grown = bytes > bufferBytes;
+    if (grown) {
+        int64_t capacity = std::max<int64_t>(bytes, bufferBytes * 2);
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, bufferBytes);
+        MemoryTracker::Get().Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, capacity);
+        bufferBytes = capacity;
+        glBufferData(GL_TEXTURE_BUFFER, bufferBytes, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, texels.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    GLState::Get().BindTexture(kTableUnit, GL_TEXTURE_BUFFER, texture);
+    if (grown) {
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    }
+    GLState::Get().ActiveTexture(0);
+}
+
+void MaterialTable::Bind(Shader& shader) const {
+    shader.use();
+    shader.setInt("materials", kTableUnit);
+    shader.setInt("albedoMaps", kAlbedoUnit);
+    shader.setInt("metallicRoughnessMaps", kMetallicRoughnessUnit);
+    shader.setInt("normalMaps", kNormalUnit);
+}
+
+void MaterialTable::BindTextures(MaterialId id) {
+    if (id >= materials.size()) {
+        return;
+    }
+    // Slots without an image are not sampled, so whatever is bound there can stay;
+    // the state cache drops binds of the array that is already there
+    const Material& material = materials[id];
+    if (material.albedo.IsValid()) {
+        GLState::Get().BindTexture(kAlbedoUnit, GL_TEXTURE_2D_ARRAY, TextureStreamer::Get().GetTexture(material.albedo.array));
+    }
+    if (material.metallicRoughness.IsValid()) {
+        GLState::Get().BindTexture(kMetallicRoughnessUnit, GL_TEXTURE_2D_ARRAY,
+                                   TextureStreamer::Get().GetTexture(material.metallicRoughness.array));
+    }
+    if (material.normal.IsValid()) {
+        GLState::Get().BindTexture(kNormalUnit, GL_TEXTURE_2D_ARRAY, TextureStreamer::Get().GetTexture(material.normal.array));
+    }
+}
+
+uint64_t MaterialTable::GetBindingKey(MaterialId id) const {
+    if (id >= materials.size()) {
+        return 0;
+    }
+    // Texture names are small integers, so 21 bits each keep the three apart
+    TextureStreamer& streamer = TextureStreamer::Get();
+    return (static_cast<uint64_t>(streamer.GetTexture(materials[id].albedo.array)) << 42) |
+           (static_cast<uint64_t>(streamer.GetTexture(materials[id].metallicRoughness.array)) << 21) |
+           streamer.GetTexture(materials[id].normal.array);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "material.h"
+#include "texture_streamer.h"
+#include "shader.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+// Every loaded material in one table that the lit shaders index by id.
+// Factors and texture layers live in a texture buffer, so switching material
+// between draws is one integer uniform, and texture bindings only change
+// when consecutive draws use images from different texture arrays.
+class MaterialTable {
+public:
+    static MaterialTable& Get();
+
+    MaterialId Add(const Material& material);
+    void Remove(MaterialId id);
+    const Material& GetMaterial(MaterialId id) const { return materials[id]; }
+
+    // Once per frame before drawing: uploads changed entries
+    void Upload();
+    // Point a material shader at the table and the texture array units
+    void Bind(Shader& shader) const;
+    // Bind the arrays holding a material's images
+    void BindTextures(MaterialId id);
+    // Draws sorted by this key share their texture bindings
+    uint64_t GetBindingKey(MaterialId id) const;
+
+private:
+    static const int kAlbedoUnit = 0;
+    static const int kMetallicRoughnessUnit = 1;
+    static const int kNormalUnit = 2;
+    static const int kTableUnit = 12;
+
+    MaterialTable() = default;
+
+    std::vector<Material> materials;
+    std::vector<MaterialId> freeIds;
+    std::vector<float> texels;   // Three RGBA32F texels per material
+    bool dirty = false;
+
+    GLuint buffer = 0, texture = 0;
+    int64_t bufferBytes = 0;
+};
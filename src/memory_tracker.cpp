@@ -0,0 +1,89 @@
+#include "memory_tracker.h"
+#include <iomanip>
+
+int64_t AssetMemory::Total(MemoryDomain domain) const {
+    int64_t total = 0;
+    for (int c = 0; c < static_cast<int>(MemoryCategory::Count); c++) {
+        total += bytes[static_cast<int>(domain)][c];
+    }
+    return total;
+}
+
+MemoryTracker& MemoryTracker::Get() {
+    static MemoryTracker instance;
+    return instance;
+}
+
+void MemoryTracker::Add(const std::string& asset, MemoryCategory category, MemoryDomain domain, int64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    assets[asset].bytes[static_cast<int>(domain)][static_cast<int>(category)] += bytes;
+    totals.bytes[static_cast<int>(domain)][static_cast<int>(category)] += bytes;
+}
+
+void MemoryTracker::Remove(const std::string& asset, MemoryCategory category, MemoryDomain domain, int64_t bytes) {
+    Add(asset, category, domain, -bytes);
+
+    // Forget assets that no longer hold anything
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = assets.find(asset);
+    if (it != assets.end() && it->second.Total(MemoryDomain::CPU) == 0 && it->second.Total(MemoryDomain::GPU) == 0) {
+        assets.erase(it);
+    }
+}
+
+AssetMemory MemoryTracker::GetAsset(const std::string& asset) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = assets.find(asset);
+    return it != assets.end() ? it->second : AssetMemory();
+}
+
+int64_t MemoryTracker::GetTotal(MemoryDomain domain, MemoryCategory category) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals.Get(domain, category);
+}
+
+int64_t MemoryTracker::GetTotal(MemoryDomain domain) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals.Total(domain);
+}
+
+const char* MemoryTracker::CategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::Vertex:  return "vertex";
+        case MemoryCategory::Index:   return "index";
+        case MemoryCategory::Texture: return "texture";
+        case MemoryCategory::Staging: return "staging";
+        case MemoryCategory::Collision: return "collision";
+        default:                      return "unknown";
+    }
+}
+
+void MemoryTracker::Dump(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto kb = [](int64_t bytes) { return static_cast<double>(bytes) / 1024.0; };
+    auto printRow = [&](const std::string& name, const AssetMemory& memory) {
+        out << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1);
+        for (int d = 0; d < static_cast<int>(MemoryDomain::Count); d++) {
+            for (int c = 0; c < static_cast<int>(MemoryCategory::Count); c++) {
+                out << std::setw(13) << kb(memory.bytes[d][c]);
+            }
+        }
+        out << std::endl;
+    };
+
+    out << "\nMemory usage (KB):" << std::endl;
+    out << std::left << std::setw(40) << "asset" << std::right;
+    for (const char* domain : {"cpu ", "gpu "}) {
+        for (int c = 0; c < static_cast<int>(MemoryCategory::Count); c++) {
+            out << std::setw(13) << (std::string(domain) + CategoryName(static_cast<MemoryCategory>(c)));
+        }
+    }
+    out << std::endl;
+
+    for (const auto& entry : assets) {
+        printRow(entry.first, entry.second);
+    }
+    printRow("TOTAL", totals);
+    out << std::defaultfloat;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <cstdint>
+
+enum class MemoryCategory { Vertex, Index, Texture, Staging, Collision, Count };
+enum class MemoryDomain { CPU, GPU, Count };
+
+// Byte counters for one asset, indexed by domain and category
+struct AssetMemory {
+    int64_t bytes[static_cast<int>(MemoryDomain::Count)][static_cast<int>(MemoryCategory::Count)] = {};
+
+    int64_t Get(MemoryDomain domain, MemoryCategory category) const {
+        return bytes[static_cast<int>(domain)][static_cast<int>(category)];
+    }
+    int64_t Total(MemoryDomain domain) const;
+};
+
+// Process-wide accounting of CPU and GPU memory per asset. Counters are
+// updated by the code that allocates or frees the memory and can be queried
+// or dumped at any time.
+class MemoryTracker {
+public:
+    static MemoryTracker& Get();
+
+    void Add(const std::string& asset, MemoryCategory category, MemoryDomain domain, int64_t bytes);
+    void Remove(const std::string& asset, MemoryCategory category, MemoryDomain domain, int64_t bytes);
+
+    AssetMemory GetAsset(const std::string& asset) const;
+    int64_t GetTotal(MemoryDomain domain, MemoryCategory category) const;
+    int64_t GetTotal(MemoryDomain domain) const;
+
+    void Dump(std::ostream& out) const;
+
+    static const char* CategoryName(MemoryCategory category);
+
+private:
+    MemoryTracker() = default;
+
+    mutable std::mutex mutex;
+    std::map<std::string, AssetMemory> assets;
+    AssetMemory totals;
+};
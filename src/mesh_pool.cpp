@@ -0,0 +1,250 @@
+#include "mesh_pool.h"
+#include "gl_state.h"
+#include "deletion_queue.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+const char* kAssetName = "mesh_pool";
+
+} // namespace
+
+MeshPool& MeshPool::Get() {
+    static MeshPool instance;
+    return instance;
+}
+
+bool MeshPool::FreeList::Allocate(uint32_t count, uint32_t& first) {
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (ranges[i].second >= count) {
+            first = ranges[i].first;
+            ranges[i].first += count;
+            ranges[i].second -= count;
+            if (ranges[i].second == 0) {
+                ranges.erase(ranges.begin() + i);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshPool::FreeList::Free(uint32_t first, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(first, 0u));
+    // Merge with the neighbours this range touches
+    if (next != ranges.end() && first + count == next->first) {
+        next->first = first;
+        next->second += count;
+    } else {
+        next = ranges.insert(next, std::make_pair(first, count));
+    }
+    if (next != ranges.begin()) {
+        auto previous = next - 1;
+        if (previous->first + previous->second == next->first) {
+            previous->second += next->second;
+            ranges.erase(next);
+        }
+    }
+}
+
+void MeshPool::FreeList::Grow(uint32_t oldCapacity, uint32_t newCapacity) {
+    Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+void MeshPool::create() {
+    if (vertexArray != 0) {
+        return;
+    }
+    glGenVertexArrays(1, &vertexArray);
+
+    const uint32_t zero = 0;
+    glGenBuffers(1, &defaultInstanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, defaultInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(zero), &zero, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    instanceBuffer = defaultInstanceBuffer;
+
+    growVertices(kInitialVertices);
+    growIndices(kInitialIndices);
+}
+
+GLuint MeshPool::resize(GLuint buffer, int64_t oldBytes, int64_t newBytes, MemoryCategory category) {
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+    MemoryTracker::Get().Add(kAssetName, category, MemoryDomain::GPU, newBytes);
+    if (buffer != 0) {
+        // Copied on the GPU; the old buffer lives on until in-flight frames are done with it
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        DeletionQueue::Get().DeleteBuffer(buffer, kAssetName, category, oldBytes);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return grown;
+}
+
+void MeshPool::growVertices(size_t needed) {
+    size_t capacity = std::max(needed, vertexCapacity * 2);
+    std::cout << "Mesh pool: " << capacity << " vertices" << std::endl;
+    vertexBuffer = resize(vertexBuffer, static_cast<int64_t>(vertexCapacity) * kVertexFloats * sizeof(float),
+                          static_cast<int64_t>(capacity) * kVertexFloats * sizeof(float), MemoryCategory::Vertex);
+    skinBuffer = resize(skinBuffer, static_cast<int64_t>(vertexCapacity) * kSkinVertexBytes,
+                        static_cast<int64_t>(capacity) * kSkinVertexBytes, MemoryCategory::Vertex);
+    freeVertices.Grow(static_cast<uint32_t>(vertexCapacity), static_cast<uint32_t>(capacity));
+    vertexCapacity = capacity;
+    setupVertexArray();
+}
+
+void MeshPool::growIndices(size_t needed) {
+    size_t capacity = std::max(needed, indexCapacity * 2);
+    std::cout << "Mesh pool: " << capacity << " indices" << std::endl;
+    indexBuffer = resize(indexBuffer, static_cast<int64_t>(indexCapacity) * sizeof(unsigned int),
+                         static_cast<int64_t>(capacity) * sizeof(unsigned int), MemoryCategory::Index);
+    freeIndices.Grow(static_cast<uint32_t>(indexCapacity), static_cast<uint32_t>(capacity));
+    indexCapacity = capacity;
+    setupVertexArray();
+}
+
+void MeshPool::setupVertexArray() {
+    if (vertexBuffer == 0 || indexBuffer == 0) {
+        return;   // Still being created
+    }
+    GLState::Get().BindVertexArray(vertexArray);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kVertexFloats * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, kVertexFloats * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, kVertexFloats * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    // Rigid meshes have zeros here; shaders only read it with a joint palette
+    glBindBuffer(GL_ARRAY_BUFFER, skinBuffer);
+    glVertexAttribIPointer(3, 4, GL_UNSIGNED_SHORT, kSkinVertexBytes, (void*)0);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, kSkinVertexBytes, (void*)(4 * sizeof(uint16_t)));
+    glEnableVertexAttribArray(4);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glVertexAttribIPointer(kInstanceAttribute, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)instanceOffset);
+    glVertexAttribDivisor(kInstanceAttribute, 1);
+    glEnableVertexAttribArray(kInstanceAttribute);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+}
+
+MeshVertices MeshPool::AddVertices(const float* vertices, size_t count, const uint16_t* joints, const uint8_t* weights) {
+    create();
+    MeshVertices range;
+    if (count == 0) {
+        return range;
+    }
+    while (!freeVertices.Allocate(static_cast<uint32_t>(count), range.first)) {
+        growVertices(vertexCapacity + count);
+    }
+    range.count = static_cast<uint32_t>(count);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(range.first) * kVertexFloats * sizeof(float),
+                    count * kVertexFloats * sizeof(float), vertices);
+
+    // Interleave joints and weights; rigid meshes get zeros so stale data never leaks in
+    std::vector<uint8_t> skin(count * kSkinVertexBytes, 0);
+    if (joints && weights) {
+        for (size_t i = 0; i < count; i++) {
+            std::copy(reinterpret_cast<const uint8_t*>(joints + i * 4),
+                      reinterpret_cast<const uint8_t*>(joints + i * 4 + 4), &skin[i * kSkinVertexBytes]);
+            std::copy(weights + i * 4, weights + i * 4 + 4, &skin[i * kSkinVertexBytes + 4 * sizeof(uint16_t)]);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, skinBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(range.first) * kSkinVertexBytes, skin.size(), skin.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return range;
+}
+
+MeshIndices MeshPool::AddIndices(const unsigned int* indices, size_t count) {
+    create();
+    MeshIndices range;
+    if (count == 0) {
+        return range;
+    }
+    while (!freeIndices.Allocate(static_cast<uint32_t>(count), range.first)) {
+        growIndices(indexCapacity + count);
+    }
+    range.count = static_cast<uint32_t>(count);
+
+    // Through the copy binding, so the vertex array's element buffer is left alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range.first) * sizeof(unsigned int),
+                    count * sizeof(unsigned int), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return range;
+}
+
+void MeshPool::Remove(const MeshVertices& range) {
+    freeVertices.Free(range.first, range.count);
+}
+
+void MeshPool::Remove(const MeshIndices& range) {
+    freeIndices.Free(range.first, range.count);
+}
+
+void MeshPool::Bind() {
+    create();
+    GLState::Get().BindVertexArray(vertexArray);
+}
+
+void MeshPool::SetInstanceBuffer(GLuint buffer, size_t offset) {
+    create();
+    if (buffer == 0) {
+        buffer = defaultInstanceBuffer;
+        offset = 0;
+    }
+    if (buffer == instanceBuffer && offset == instanceOffset) {
+        return;
+    }
+    instanceBuffer = buffer;
+    instanceOffset = offset;
+    GLState::Get().BindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glVertexAttribIPointer(kInstanceAttribute, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)instanceOffset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshPool::DrawElements(GLenum mode, const MeshIndices& indices, const MeshVertices& vertices) {
+    if (indices.count == 0) {
+        return;
+    }
+    Bind();
+    glDrawElementsBaseVertex(mode, static_cast<GLsizei>(indices.count), GL_UNSIGNED_INT,
+                             (void*)(static_cast<size_t>(indices.first) * sizeof(unsigned int)),
+                             static_cast<GLint>(vertices.first));
+}
+
+void MeshPool::Destroy() {
+    if (vertexArray == 0) {
+        return;
+    }
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteVertexArray(vertexArray);
+    queue.DeleteBuffer(vertexBuffer, kAssetName, MemoryCategory::Vertex,
+                       static_cast<int64_t>(vertexCapacity) * kVertexFloats * sizeof(float));
+    queue.DeleteBuffer(skinBuffer, kAssetName, MemoryCategory::Vertex, static_cast<int64_t>(vertexCapacity) * kSkinVertexBytes);
+    queue.DeleteBuffer(indexBuffer, kAssetName, MemoryCategory::Index,
+                       static_cast<int64_t>(indexCapacity) * sizeof(unsigned int));
+    queue.DeleteBuffer(defaultInstanceBuffer, kAssetName, MemoryCategory::Vertex, 0);
+    vertexArray = vertexBuffer = skinBuffer = indexBuffer = defaultInstanceBuffer = instanceBuffer = 0;
+    instanceOffset = 0;
+    vertexCapacity = indexCapacity = 0;
+    freeVertices.ranges.clear();
+    freeIndices.ranges.clear();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "memory_tracker.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+// Vertices of one model: draws pass `first` as the base vertex
+struct MeshVertices {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// Index range into the shared index buffer, relative to the model's vertices
+struct MeshIndices {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// Geometry of every model in one vertex buffer, one skin stream and one index
+// buffer behind a single vertex array, so any set of meshes can be drawn
+// without rebinding, including by one indirect multi-draw. Ranges come from
+// first-fit free lists; buffers double and are copied on the GPU when full.
+// Attribute 5 is a per-instance uint read from the buffer set with
+// SetInstanceBuffer(), for renderers that index per-instance data by it.
+class MeshPool {
+public:
+    static MeshPool& Get();
+
+    static const int kVertexFloats = 8;   // Position, normal, texture coordinates
+    static const int kSkinVertexBytes = 4 * sizeof(uint16_t) + 4;
+    static const GLuint kInstanceAttribute = 5;
+
+    // joints and weights hold four entries per vertex, or are null for rigid meshes
+    MeshVertices AddVertices(const float* vertices, size_t count, const uint16_t* joints, const uint8_t* weights);
+    MeshIndices AddIndices(const unsigned int* indices, size_t count);
+    void Remove(const MeshVertices& range);
+    void Remove(const MeshIndices& range);
+
+    void Bind();
+    // Source of the instance attribute; offset in bytes to the first instance drawn.
+    // Buffer 0 restores the default, a single zero for non-instanced draws.
+    void SetInstanceBuffer(GLuint buffer, size_t offset = 0);
+
+    void DrawElements(GLenum mode, const MeshIndices& indices, const MeshVertices& vertices);
+
+    size_t GetVertexCapacity() const { return vertexCapacity; }
+    size_t GetIndexCapacity() const { return indexCapacity; }
+
+    // Releases the GL objects, e.g. at shutdown
+    void Destroy();
+
+private:
+    // Sorted, coalesced free ranges of one buffer, in elements
+    struct FreeList {
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;   // First and count
+
+        bool Allocate(uint32_t count, uint32_t& first);
+        void Free(uint32_t first, uint32_t count);
+        void Grow(uint32_t oldCapacity, uint32_t newCapacity);
+    };
+
+    static const size_t kInitialVertices = 64 * 1024;
+    static const size_t kInitialIndices = 256 * 1024;
+
+    MeshPool() = default;
+
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0, skinBuffer = 0, indexBuffer = 0;
+    GLuint defaultInstanceBuffer = 0;
+    GLuint instanceBuffer = 0;
+    size_t instanceOffset = 0;
+    size_t vertexCapacity = 0, indexCapacity = 0;
+    FreeList freeVertices, freeIndices;
+
+    void create();
+    void growVertices(size_t needed);
+    void growIndices(size_t needed);
+    void setupVertexArray();
+    static GLuint resize(GLuint buffer, int64_t oldBytes, int64_t newBytes, MemoryCategory category);
+};
@@ -1,48 +1,73 @@
 #pragma once
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-#define TINYGLTF_NO_EXTERNAL_IMAGE
-#define TINYGLTF_NO_STB_IMAGE
-#define TINYGLTF_NO_INCLUDE_STB_IMAGE
-#define TINYGLTF_NO_INCLUDE_STB_IMAGE_WRITE
-
-#include "../external/tinygltf/tiny_gltf.h"
+#include "model_data.h"
 #include "shader.h"
+#include "materials.h"
+#include "mesh_pool.h"
 #include <vector>
 #include <string>
-#include <filesystem>
 #include "../external/glm/glm/glm.hpp"
-#include <map>
+#include <cstdint>
 
-class Model {
+// ModelData uploaded for drawing: mesh pool ranges, streamed textures and a
+// material table entry. Needs the GL thread for Upload() and Draw().
+class Model : public ModelData {
 public:
-    Model(const char* path);
+    // keepCpuData retains vertices/indices after upload for CPU-side users.
+    // With uploadNow = false only the file is parsed (safe on a worker thread)
+    // and Upload() must be called later on the GL thread.
+    Model(const char* path, bool keepCpuData = false, bool uploadNow = true);
+    // Geometry merged elsewhere (see StaticBatcher), drawn with a copy of
+    // `source`'s material. Uploads at once; the textures stay source's, so
+    // it must not outlive source.
+    Model(const std::string& name, MeshData mesh, const Model& source);
+    ~Model();
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    void Upload();
+    bool IsUploaded() const { return uploaded; }
+    size_t GetPendingUploadBytes() const;
+
     void Draw(Shader &shader);
 
+    // Ask the texture streamer for mips matching the model's on-screen size
+    void RequestTextureDetail(float projectedPixels);
+    // Whether the detail RequestTextureDetail() asks for has streamed in
+    bool HasTextureDetail(float projectedPixels) const;
+    // Index into MaterialTable once uploaded; draws sorted by its binding key share textures
+    MaterialId GetMaterialId() const { return materialId; }
+
+    // Ranges in the mesh pool once uploaded. Meshes named "*_LOD<n>" in the file
+    // become level n; level 0 is the full mesh and the one Draw() uses.
+    const MeshVertices& GetVertices() const { return meshVertices; }
+    int GetLodCount() const { return static_cast<int>(lods.size()); }
+    const MeshIndices& GetLod(int level) const { return lods[level]; }
+    const MeshIndices& GetEdges() const { return edgeRange; }
+    bool IsDoubleSided() const { return material.doubleSided; }
+
+    // The ShaderFeature flags the material and mesh need: alpha test for masked
+    // and blended materials, normal map when one loaded, skinning for animated models
+    uint32_t GetShaderFeatures() const;
+
 private:
     struct Texture {
-        GLuint id;
+        TextureLayer layer;
         std::string type;
         std::string path;  // For debugging
+        int width = 0;
+        int height = 0;
     };
 
-    struct Material {
-        glm::vec4 baseColorFactor = glm::vec4(1.0f);
-        float metallicFactor = 1.0f;
-        float roughnessFactor = 1.0f;
-        bool doubleSided = false;
-        glm::vec3 emissiveFactor = glm::vec3(0.0f);
-        
-        std::vector<Texture> textures;
-        std::map<std::string, GLuint> textureMap;  // Maps texture types to texture IDs
-    };
+    bool keepCpuData;
+    bool uploaded;
 
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
     std::vector<Texture> textures;
-    GLuint VAO, VBO, EBO;
-    Material material;  // Add material member
-    
-    void loadModel(const char* path);
+    std::vector<Texture> gpuTextures;  // Every streamed texture this model created, released in the destructor
+    MeshVertices meshVertices;
+    std::vector<MeshIndices> lods;
+    MeshIndices edgeRange;
+    MaterialId materialId = kInvalidMaterial;  // Registered with the material table on upload
+
     void setupMesh();
-    GLuint loadTexture(const tinygltf::Image& image);
+    TextureLayer createTexture(PendingTexture& pending);
 }; 
\ No newline at end of file
@@ -0,0 +1,696 @@
+#include "../external/stb/stb_image.h"
+#include "model_data.h"
+#include "edges.h"
+#include "memory_tracker.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Occluder proxies are marked by name in the authoring tool, on the mesh or its node
+bool isOccluderName(const std::string& name) {
+    const std::string suffix = "_occluder";
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Level of detail from a "_LOD<n>" suffix on the mesh or node name; 0 without one
+int lodLevel(const std::string& name) {
+    size_t marker = name.rfind("_LOD");
+    if (marker == std::string::npos || marker + 4 >= name.size()) {
+        return 0;
+    }
+    for (size_t i = marker + 4; i < name.size(); i++) {
+        if (name[i] < '0' || name[i] > '9') {
+            return 0;
+        }
+    }
+    return std::min(std::atoi(name.c_str() + marker + 4), 15);
+}
+
+} // namespace
+
+ModelData::ModelData(const char* path, bool renderData)
+    : name(path), renderData(renderData), boundsMin(0.0f), boundsMax(0.0f) {
+    loadModel(path);
+}
+
+ModelData::ModelData(const std::string& name, MeshData mesh)
+    : name(name), renderData(true), boundsMin(mesh.boundsMin), boundsMax(mesh.boundsMax) {
+    vertices = std::move(mesh.vertices);
+    indices = std::move(mesh.indices);
+    lodIndices = std::move(mesh.lodIndices);
+    edgeIndices = std::move(mesh.edgeIndices);
+    occluder = std::move(mesh.occluder);
+
+    MemoryTracker& tracker = MemoryTracker::Get();
+    tracker.Add(name, MemoryCategory::Vertex, MemoryDomain::CPU, vertices.capacity() * sizeof(float));
+    tracker.Add(name, MemoryCategory::Index, MemoryDomain::CPU, indexBytes());
+    tracker.Add(name, MemoryCategory::Collision, MemoryDomain::CPU, bvh.GetMemoryBytes() + occluderBytes());
+}
+
+ModelData::~ModelData() {
+    for (const auto& entry : pendingTextures) {
+        MemoryTracker::Get().Remove(name, MemoryCategory::Staging, MemoryDomain::CPU,
+                                    entry.second.encoded.size());
+    }
+    MemoryTracker::Get().Remove(name, MemoryCategory::Collision, MemoryDomain::CPU, bvh.GetMemoryBytes() + occluderBytes());
+
+    releaseCpuData();
+}
+
+void ModelData::releaseCpuData() {
+    MemoryTracker& tracker = MemoryTracker::Get();
+    tracker.Remove(name, MemoryCategory::Vertex, MemoryDomain::CPU,
+                   vertices.capacity() * sizeof(float) + skinJoints.capacity() * sizeof(uint16_t) + skinWeights.capacity());
+    tracker.Remove(name, MemoryCategory::Index, MemoryDomain::CPU, indexBytes());
+
+    std::vector<float>().swap(vertices);
+    std::vector<uint16_t>().swap(skinJoints);
+    std::vector<uint8_t>().swap(skinWeights);
+    std::vector<unsigned int>().swap(indices);
+    std::vector<unsigned int>().swap(edgeIndices);
+    std::vector<std::vector<unsigned int>>().swap(lodIndices);
+}
+
+bool ModelData::AppendTransformed(const glm::mat4& matrix, MeshData& out) const {
+    if (vertices.empty() || animated) {
+        return false;
+    }
+    // Normals take the inverse transpose, so non-uniform scale keeps them perpendicular
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+    unsigned int base = static_cast<unsigned int>(out.vertices.size() / 8);
+    out.vertices.reserve(out.vertices.size() + vertices.size());
+    for (size_t i = 0; i + 8 <= vertices.size(); i += 8) {
+        glm::vec3 p = glm::vec3(matrix * glm::vec4(vertices[i], vertices[i + 1], vertices[i + 2], 1.0f));
+        glm::vec3 n = normalMatrix * glm::vec3(vertices[i + 3], vertices[i + 4], vertices[i + 5]);
+        float length = glm::length(n);
+        if (length > 0.0f) {
+            n /= length;
+        }
+        out.vertices.insert(out.vertices.end(), { p.x, p.y, p.z, n.x, n.y, n.z, vertices[i + 6], vertices[i + 7] });
+        out.boundsMin = glm::min(out.boundsMin, p);
+        out.boundsMax = glm::max(out.boundsMax, p);
+    }
+
+    auto appendIndices = [base](const std::vector<unsigned int>& source, std::vector<unsigned int>& target) {
+        target.reserve(target.size() + source.size());
+        for (unsigned int index : source) {
+            target.push_back(base + index);
+        }
+    };
+    appendIndices(indices, out.indices);
+    if (out.lodIndices.size() < lodIndices.size()) {
+        out.lodIndices.resize(lodIndices.size());
+    }
+    for (size_t level = 0; level < lodIndices.size(); level++) {
+        appendIndices(lodIndices[level], out.lodIndices[level]);
+    }
+    appendIndices(edgeIndices, out.edgeIndices);
+
+    uint32_t occluderBase = static_cast<uint32_t>(out.occluder.positions.size());
+    for (const glm::vec3& position : occluder.positions) {
+        out.occluder.positions.push_back(glm::vec3(matrix * glm::vec4(position, 1.0f)));
+    }
+    for (uint32_t index : occluder.indices) {
+        out.occluder.indices.push_back(occluderBase + index);
+    }
+    return true;
+}
+
+int64_t ModelData::indexBytes() const {
+    size_t count = indices.capacity() + edgeIndices.capacity();
+    for (const auto& lod : lodIndices) {
+        count += lod.capacity();
+    }
+    return static_cast<int64_t>(count * sizeof(unsigned int));
+}
+
+void ModelData::loadModel(const char* path) {
+    // The file is mapped rather than read; accessors below point straight into it
+    GlbFile glb;
+    if (!glb.Open(path)) {
+        std::cout << "Error: Cannot load model file at: " << path << std::endl;
+        std::cout << "Current working directory: " << std::filesystem::current_path() << std::endl;
+        return;
+    }
+
+    // Mapped pages only stay resident until this function returns
+    int64_t stagingBytes = static_cast<int64_t>(glb.GetFileSize());
+    MemoryTracker::Get().Add(name, MemoryCategory::Staging, MemoryDomain::CPU, stagingBytes);
+
+    // Encoded bytes of an image inside the BIN chunk, with its size from the image header.
+    // Decoding is deferred to the texture streamer's worker threads.
+    auto imageInfo = [&](int imageIndex, const uint8_t*& bytes, size_t& size, int& width, int& height, int& channels) {
+        bytes = nullptr;
+        size = 0;
+        width = height = channels = 0;
+        if (imageIndex < 0 || imageIndex >= static_cast<int>(glb.images.size())) {
+            return false;
+        }
+        bytes = glb.GetBufferViewData(glb.images[imageIndex].bufferView, size);
+        return bytes && size > 0 &&
+               stbi_info_from_memory(bytes, static_cast<int>(size), &width, &height, &channels) &&
+               width > 0 && height > 0;
+    };
+    auto imageForTexture = [&](int textureIndex) {
+        if (textureIndex < 0 || textureIndex >= static_cast<int>(glb.textures.size())) {
+            return -1;
+        }
+        return glb.textures[textureIndex].source;
+    };
+
+    // Queue each image once for Upload(), even if several material slots reference it.
+    // This is the only copy of the image bytes; it lives until the streamer decodes it.
+    auto textureForImage = [&](int imageIndex, const std::string& slot) {
+        if (!renderData) {
+            return;
+        }
+        auto it = pendingTextures.find(imageIndex);
+        if (it == pendingTextures.end()) {
+            const uint8_t* bytes;
+            size_t size;
+            int width, height, channels;
+            if (!imageInfo(imageIndex, bytes, size, width, height, channels)) {
+                std::cout << "Invalid image data, skipping texture" << std::endl;
+                return;
+            }
+            PendingTexture& pending = pendingTextures[imageIndex];
+            pending.width = width;
+            pending.height = height;
+            pending.encoded.assign(bytes, bytes + size);
+            it = pendingTextures.find(imageIndex);
+        }
+        it->second.slots.push_back(slot);
+    };
+
+    // Node hierarchy first: meshes are placed by their nodes, and clips target them
+    std::vector<int> nodeMap, nodeSource;
+    loadSkeleton(glb, nodeMap, nodeSource);
+    if (renderData) {
+        loadAnimations(glb, nodeMap);
+        animated = !animations.empty() || !glb.skins.empty();
+    }
+    loadMeshes(glb, nodeMap, nodeSource);
+    std::cout << "Nodes: " << skeleton.GetNodeCount() << ", animations: " << animations.size() << std::endl;
+
+    // Object-space bounds for culling and screen-size estimates
+    if (!vertices.empty()) {
+        boundsMin = boundsMax = glm::vec3(vertices[0], vertices[1], vertices[2]);
+        for (size_t i = 8; i < vertices.size(); i += 8) {
+            glm::vec3 p(vertices[i], vertices[i + 1], vertices[i + 2]);
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+    }
+
+    // Print debug info
+    std::cout << "\nModel Statistics:" << std::endl;
+    std::cout << "Total vertices: " << vertices.size() / 8 << std::endl;
+    std::cout << "Total indices: " << indices.size() << std::endl;
+    std::cout << "Levels of detail: " << lodIndices.size() + 1 << std::endl;
+    std::cout << "Number of meshes: " << glb.meshes.size() << std::endl;
+
+    // Add debug output after loading
+    std::cout << "Model loaded successfully!" << std::endl;
+    std::cout << "Number of textures: " << pendingTextures.size() << std::endl;
+
+    // Add vertex data debug output
+    if (vertices.size() >= 8 && indices.size() >= 3) {
+        std::cout << "\nFirst vertex data:" << std::endl;
+        for(int i = 0; i < 8; i++) {
+            std::cout << vertices[i] << " ";
+        }
+        std::cout << "\nFirst three indices:" << std::endl;
+        for(int i = 0; i < 3; i++) {
+            std::cout << indices[i] << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    // Load textures if they exist
+    for (const auto& mesh : glb.meshes) {
+        for (const auto& primitive : mesh.primitives) {
+            if (renderData && primitive.material >= 0 && primitive.material < static_cast<int>(glb.materials.size())) {
+                const auto& material = glb.materials[primitive.material];
+                
+                std::cout << "\nMaterial Debug:" << std::endl;
+                std::cout << "Material index: " << primitive.material << std::endl;
+                
+                // Print all available textures in the material
+                if (material.baseColorTexture >= 0) {
+                    int source = imageForTexture(material.baseColorTexture);
+                    const uint8_t* bytes;
+                    size_t size;
+                    int width, height, channels;
+                    bool valid = imageInfo(source, bytes, size, width, height, channels);
+                    
+                    std::cout << "\nTexture Loading Debug:" << std::endl;
+                    std::cout << "Texture index: " << material.baseColorTexture << std::endl;
+                    std::cout << "Image source: " << source << std::endl;
+                    std::cout << "Image dimensions: " << width << "x" << height << std::endl;
+                    std::cout << "Image components: " << channels << std::endl;
+                    std::cout << "Image data size: " << size << std::endl;
+                    
+                    if (valid) {
+                        textureForImage(source, "texture_diffuse1");
+                        std::cout << "Queued diffuse texture for upload" << std::endl;
+                    } else {
+                        std::cout << "Invalid image data, skipping texture" << std::endl;
+                    }
+                } else {
+                    std::cout << "No base color texture" << std::endl;
+                }
+                
+                if (material.occlusionTexture >= 0) {
+                    textureForImage(imageForTexture(material.occlusionTexture), "texture_ambient1");
+                    std::cout << "Queued ambient occlusion texture" << std::endl;
+                } else {
+                    std::cout << "No occlusion texture" << std::endl;
+                }
+                
+                // Print base color factor
+                const auto& baseColor = material.baseColorFactor;
+                std::cout << "Base color factor: "
+                          << baseColor[0] << ", "
+                          << baseColor[1] << ", "
+                          << baseColor[2] << ", "
+                          << baseColor[3] << std::endl;
+                
+                // Print all available images
+                std::cout << "Number of images in model: " << glb.images.size() << std::endl;
+                for (size_t i = 0; i < glb.images.size(); i++) {
+                    const uint8_t* bytes;
+                    size_t size;
+                    int width, height, channels;
+                    imageInfo(static_cast<int>(i), bytes, size, width, height, channels);
+                    std::cout << "Image " << i << ": "
+                              << "Size: " << width << "x" << height
+                              << ", Components: " << channels
+                              << ", Data size: " << size << std::endl;
+                }
+            }
+        }
+    }
+
+    // Extract outline edges once; they are static for the lifetime of the model
+    if (renderData) {
+        edgeIndices = BuildFeatureEdges(vertices, indices, 8, 6);
+        std::cout << "Feature edges: " << edgeIndices.size() / 2 << std::endl;
+    }
+
+    // The BVH is cached next to the model and rebuilt whenever the geometry changes
+    uint64_t geometryHash = TriangleBVH::HashGeometry(vertices, 8, indices);
+    std::string bvhPath = name + ".bvh";
+    if (!bvh.Load(bvhPath, geometryHash, indices.size() / 3)) {
+        bvh.Build(vertices, 8, indices);
+        if (!bvh.Save(bvhPath, geometryHash)) {
+            std::cout << "Failed to write BVH cache: " << bvhPath << std::endl;
+        }
+    }
+    MemoryTracker::Get().Add(name, MemoryCategory::Collision, MemoryDomain::CPU, bvh.GetMemoryBytes() + occluderBytes());
+    std::cout << "BVH nodes: " << bvh.GetNodeCount() << std::endl;
+
+    if (glb.materials.size() > 0) {
+        const auto& glTFMaterial = glb.materials[0];  // Use first material
+        
+        std::cout << "\nMaterial Debug:" << std::endl;
+        
+        // Load double-sided property
+        material.doubleSided = glTFMaterial.doubleSided;
+        std::cout << "Double Sided: " << (material.doubleSided ? "true" : "false") << std::endl;
+        
+        // Load base color factor
+        material.baseColorFactor = glTFMaterial.baseColorFactor;
+        std::cout << "Base Color Factor: "
+                  << material.baseColorFactor.r << ", "
+                  << material.baseColorFactor.g << ", "
+                  << material.baseColorFactor.b << ", "
+                  << material.baseColorFactor.a << std::endl;
+        
+        // Load metallic factor
+        material.metallicFactor = glTFMaterial.metallicFactor;
+        std::cout << "Metallic Factor: " << material.metallicFactor << std::endl;
+        
+        // Load roughness factor
+        material.roughnessFactor = glTFMaterial.roughnessFactor;
+        std::cout << "Roughness Factor: " << material.roughnessFactor << std::endl;
+        
+        // Blended materials still drop nearly clear texels, so they never cover what is behind them
+        if (glTFMaterial.alphaMode == "MASK") {
+            material.alphaMode = AlphaMode::Mask;
+            material.alphaCutoff = glTFMaterial.alphaCutoff;
+        } else if (glTFMaterial.alphaMode == "BLEND") {
+            material.alphaMode = AlphaMode::Blend;
+            material.alphaCutoff = 0.1f;
+        }
+        std::cout << "Alpha Mode: " << glTFMaterial.alphaMode << std::endl;
+        
+        // Load textures with proper format
+        if (glTFMaterial.baseColorTexture >= 0) {
+            textureForImage(imageForTexture(glTFMaterial.baseColorTexture), "albedoMap");
+        }
+        
+        if (glTFMaterial.metallicRoughnessTexture >= 0) {
+            textureForImage(imageForTexture(glTFMaterial.metallicRoughnessTexture), "metallicRoughnessMap");
+        }
+        
+        if (glTFMaterial.normalTexture >= 0) {
+            textureForImage(imageForTexture(glTFMaterial.normalTexture), "normalMap");
+        }
+    }
+
+    // Only the queued texture sources outlive this function; the mapping closes on return
+    int64_t pendingBytes = 0;
+    for (const auto& entry : pendingTextures) {
+        pendingBytes += entry.second.encoded.size();
+    }
+    MemoryTracker& tracker = MemoryTracker::Get();
+    tracker.Remove(name, MemoryCategory::Staging, MemoryDomain::CPU, stagingBytes - pendingBytes);
+    tracker.Add(name, MemoryCategory::Vertex, MemoryDomain::CPU,
+                vertices.capacity() * sizeof(float) + skinJoints.capacity() * sizeof(uint16_t) + skinWeights.capacity());
+    tracker.Add(name, MemoryCategory::Index, MemoryDomain::CPU, indexBytes());
+
+    // Nothing but the BVH ever reads the geometry without a renderer
+    if (!renderData) {
+        releaseCpuData();
+    }
+}
+
+void ModelData::loadSkeleton(const GlbFile& glb, std::vector<int>& nodeMap, std::vector<int>& nodeSource) {
+    // Roots come from the default scene, or every unparented node if the file has none
+    std::vector<int> roots;
+    if (!glb.scenes.empty()) {
+        int sceneIndex = glb.defaultScene >= 0 && glb.defaultScene < static_cast<int>(glb.scenes.size()) ? glb.defaultScene : 0;
+        roots = glb.scenes[sceneIndex].nodes;
+    } else {
+        std::vector<bool> isChild(glb.nodes.size(), false);
+        for (const auto& node : glb.nodes) {
+            for (int child : node.children) {
+                if (child >= 0 && child < static_cast<int>(glb.nodes.size())) {
+                    isChild[child] = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < glb.nodes.size(); i++) {
+            if (!isChild[i]) {
+                roots.push_back(static_cast<int>(i));
+            }
+        }
+    }
+
+    // Depth-first so every parent precedes its children
+    nodeMap.assign(glb.nodes.size(), -1);
+    nodeSource.clear();
+    std::vector<std::pair<int, int>> stack;   // glTF node, skeleton parent
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+        stack.push_back({ *it, -1 });
+    }
+    while (!stack.empty()) {
+        auto [source, parent] = stack.back();
+        stack.pop_back();
+        if (source < 0 || source >= static_cast<int>(glb.nodes.size()) || nodeMap[source] >= 0) {
+            continue;
+        }
+
+        const auto& node = glb.nodes[source];
+        int index = static_cast<int>(skeleton.parents.size());
+        nodeMap[source] = index;
+        nodeSource.push_back(source);
+
+        glm::vec3 translation = node.translation, scale = node.scale;
+        glm::vec4 rotation = node.rotation;
+        if (node.hasMatrix) {
+            DecomposeTransform(node.matrix, translation, rotation, scale);
+        }
+
+        skeleton.parents.push_back(parent);
+        skeleton.names.push_back(node.name);
+        skeleton.restTranslation.push_back(translation);
+        skeleton.restRotation.push_back(rotation);
+        skeleton.restScale.push_back(scale);
+
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+            stack.push_back({ *it, index });
+        }
+    }
+
+    if (!skeleton.parents.empty()) {
+        skeleton.rootInverse = glm::inverse(ComposeTransform(skeleton.restTranslation[0], skeleton.restRotation[0],
+                                                             skeleton.restScale[0]));
+    }
+}
+
+void ModelData::loadAnimations(const GlbFile& glb, const std::vector<int>& nodeMap) {
+    for (size_t a = 0; a < glb.animations.size(); a++) {
+        const auto& gltfAnimation = glb.animations[a];
+        AnimationClip clip;
+        clip.name = gltfAnimation.name.empty() ? "animation" + std::to_string(a) : gltfAnimation.name;
+
+        for (const auto& gltfChannel : gltfAnimation.channels) {
+            if (gltfChannel.node < 0 || gltfChannel.node >= static_cast<int>(nodeMap.size()) ||
+                nodeMap[gltfChannel.node] < 0 || gltfChannel.sampler < 0 ||
+                gltfChannel.sampler >= static_cast<int>(gltfAnimation.samplers.size())) {
+                continue;
+            }
+
+            AnimationChannel channel;
+            channel.node = static_cast<uint32_t>(nodeMap[gltfChannel.node]);
+            if (gltfChannel.path == "translation") {
+                channel.path = AnimationPath::Translation;
+            } else if (gltfChannel.path == "rotation") {
+                channel.path = AnimationPath::Rotation;
+            } else if (gltfChannel.path == "scale") {
+                channel.path = AnimationPath::Scale;
+            } else {
+                continue;  // Morph target weights are not supported
+            }
+
+            const auto& sampler = gltfAnimation.samplers[gltfChannel.sampler];
+            if (sampler.interpolation == "STEP") {
+                channel.interpolation = AnimationInterpolation::Step;
+            } else if (sampler.interpolation == "CUBICSPLINE") {
+                channel.interpolation = AnimationInterpolation::CubicSpline;
+            }
+
+            // Keys are read straight from the mapped file into the channel
+            GlbAccessorView times = glb.GetAccessor(sampler.input);
+            GlbAccessorView values = glb.GetAccessor(sampler.output);
+            size_t keysPerTime = channel.interpolation == AnimationInterpolation::CubicSpline ? 3 : 1;
+            if (times.components != 1 || values.components < 3 || values.count != times.count * keysPerTime) {
+                std::cout << "Skipping malformed channel in animation " << clip.name << std::endl;
+                continue;
+            }
+
+            channel.times.resize(times.count);
+            for (size_t i = 0; i < times.count; i++) {
+                channel.times[i] = times.Get(i, 0);
+            }
+            channel.values.resize(values.count, glm::vec4(0.0f));
+            for (size_t i = 0; i < values.count; i++) {
+                for (int c = 0; c < std::min(values.components, 4); c++) {
+                    channel.values[i][c] = values.Get(i, c);
+                }
+            }
+            if (!channel.times.empty()) {
+                clip.duration = std::max(clip.duration, channel.times.back());
+            }
+            clip.channels.push_back(std::move(channel));
+        }
+
+        std::cout << "Animation " << clip.name << ": " << clip.channels.size() << " channels, "
+                  << clip.duration << "s" << std::endl;
+        animations.push_back(std::move(clip));
+    }
+}
+
+void ModelData::loadMeshes(const GlbFile& glb, const std::vector<int>& nodeMap, const std::vector<int>& nodeSource) {
+    std::vector<glm::mat4> restTransforms = skeleton.ComputeRestTransforms();
+    std::vector<int> skinSlots(glb.skins.size(), -1);
+
+    for (size_t node = 0; node < nodeSource.size(); node++) {
+        const auto& gltfNode = glb.nodes[nodeSource[node]];
+        if (gltfNode.mesh < 0 || gltfNode.mesh >= static_cast<int>(glb.meshes.size())) {
+            continue;
+        }
+        const auto& mesh = glb.meshes[gltfNode.mesh];
+        std::cout << "Processing mesh " << mesh.name << " with " << mesh.primitives.size() << " primitives" << std::endl;
+
+        if (isOccluderName(mesh.name) || isOccluderName(gltfNode.name)) {
+            loadOccluder(glb, mesh, restTransforms[node]);
+            continue;
+        }
+
+        // Coarser levels share the vertex stream and get their own index ranges
+        int lod = std::max(lodLevel(mesh.name), lodLevel(gltfNode.name));
+        if (lod > 0 && !renderData) {
+            continue;
+        }
+        if (lod > static_cast<int>(lodIndices.size())) {
+            lodIndices.resize(lod);
+        }
+        std::vector<unsigned int>& meshIndices = lod == 0 ? indices : lodIndices[lod - 1];
+
+        // Rigid meshes are baked into model space at rest and follow their node
+        // through one palette slot. Skinned meshes stay in bind space, moved
+        // into model space, and use one slot per joint.
+        glm::mat4 bake;
+        int skinSlot = -1;
+        uint16_t rigidSlot = 0;
+        const GlbSkin* skin = nullptr;
+        if (gltfNode.skin >= 0 && gltfNode.skin < static_cast<int>(glb.skins.size()) &&
+            !glb.skins[gltfNode.skin].joints.empty()) {
+            skin = &glb.skins[gltfNode.skin];
+            if (skinSlots[gltfNode.skin] < 0) {
+                skinSlots[gltfNode.skin] = static_cast<int>(skeleton.slotNodes.size());
+                GlbAccessorView inverseBind;
+                if (skin->inverseBindMatrices >= 0) {
+                    inverseBind = glb.GetAccessor(skin->inverseBindMatrices);
+                }
+                glm::mat4 rootRest = glm::inverse(skeleton.rootInverse);
+                for (size_t j = 0; j < skin->joints.size(); j++) {
+                    glm::mat4 offset(1.0f);
+                    if (inverseBind.components == 16 && j < inverseBind.count) {
+                        for (int i = 0; i < 16; i++) {
+                            offset[i / 4][i % 4] = inverseBind.Get(j, i);
+                        }
+                    }
+                    int joint = skin->joints[j];
+                    bool known = joint >= 0 && joint < static_cast<int>(nodeMap.size()) && nodeMap[joint] >= 0;
+                    skeleton.slotNodes.push_back(known ? static_cast<uint32_t>(nodeMap[joint]) : 0);
+                    skeleton.slotOffsets.push_back(offset * rootRest);
+                }
+            }
+            skinSlot = skinSlots[gltfNode.skin];
+            bake = skeleton.rootInverse;
+        } else {
+            bake = restTransforms[node];
+            rigidSlot = static_cast<uint16_t>(skeleton.slotNodes.size());
+            skeleton.slotNodes.push_back(static_cast<uint32_t>(node));
+            skeleton.slotOffsets.push_back(glm::inverse(bake));
+        }
+        glm::mat3 normalBake = glm::transpose(glm::inverse(glm::mat3(bake)));
+
+        for (const auto& primitive : mesh.primitives) {
+            auto position = primitive.attributes.find("POSITION");
+            if (primitive.mode != kGlbModeTriangles || position == primitive.attributes.end()) {
+                continue;
+            }
+
+            // Views into the mapped BIN chunk; each vertex is converted once, straight into `vertices`
+            GlbAccessorView positions = glb.GetAccessor(position->second);
+            if (positions.components != 3) {
+                continue;
+            }
+            size_t count = positions.count;
+            GlbAccessorView normals, texcoords, joints, weights;
+            auto attribute = [&](const char* attributeName, GlbAccessorView& out, int expected) {
+                auto it = primitive.attributes.find(attributeName);
+                if (it != primitive.attributes.end()) {
+                    GlbAccessorView view = glb.GetAccessor(it->second);
+                    if (view.data && view.components == expected && view.count == count) {
+                        out = view;
+                    }
+                }
+            };
+            attribute("NORMAL", normals, 3);
+            attribute("TEXCOORD_0", texcoords, 2);
+            if (skin) {
+                attribute("JOINTS_0", joints, 4);
+                attribute("WEIGHTS_0", weights, 4);
+            }
+
+            size_t startIndex = vertices.size() / 8;
+            vertices.reserve(vertices.size() + count * 8);
+            for (size_t i = 0; i < count; i++) {
+                glm::vec3 p = glm::vec3(bake * glm::vec4(positions.Get(i, 0), positions.Get(i, 1), positions.Get(i, 2), 1.0f));
+                glm::vec3 n(0.0f, 1.0f, 0.0f);
+                if (normals.data) {
+                    n = glm::normalize(normalBake * glm::vec3(normals.Get(i, 0), normals.Get(i, 1), normals.Get(i, 2)));
+                }
+                vertices.insert(vertices.end(), { p.x, p.y, p.z, n.x, n.y, n.z,
+                                                  texcoords.Get(i, 0), texcoords.Get(i, 1) });
+            }
+
+            if (animated) {
+                skinJoints.reserve(skinJoints.size() + count * 4);
+                skinWeights.reserve(skinWeights.size() + count * 4);
+                for (size_t i = 0; i < count; i++) {
+                    if (skin && joints.data && weights.data) {
+                        // Quantize to bytes that still sum to exactly 255
+                        float weight[4];
+                        for (int k = 0; k < 4; k++) {
+                            weight[k] = weights.Get(i, k);
+                        }
+                        float total = weight[0] + weight[1] + weight[2] + weight[3];
+                        int quantized[4], sum = 0, largest = 0;
+                        for (int k = 0; k < 4; k++) {
+                            int joint = std::min(static_cast<int>(joints.Get(i, k)), static_cast<int>(skin->joints.size()) - 1);
+                            skinJoints.push_back(static_cast<uint16_t>(skinSlot + std::max(joint, 0)));
+                            quantized[k] = total > 0.0f ? static_cast<int>(weight[k] / total * 255.0f + 0.5f) : (k == 0 ? 255 : 0);
+                            sum += quantized[k];
+                            if (quantized[k] > quantized[largest]) {
+                                largest = k;
+                            }
+                        }
+                        quantized[largest] += 255 - sum;
+                        for (int k = 0; k < 4; k++) {
+                            skinWeights.push_back(static_cast<uint8_t>(quantized[k]));
+                        }
+                    } else {
+                        uint16_t slot = skin ? static_cast<uint16_t>(skinSlot) : rigidSlot;
+                        skinJoints.insert(skinJoints.end(), { slot, 0, 0, 0 });
+                        skinWeights.insert(skinWeights.end(), { 255, 0, 0, 0 });
+                    }
+                }
+            }
+
+            if (primitive.indices >= 0) {
+                GlbAccessorView view = glb.GetAccessor(primitive.indices);
+                meshIndices.reserve(meshIndices.size() + view.count);
+                for (size_t i = 0; i < view.count; i++) {
+                    meshIndices.push_back(view.GetIndex(i) + static_cast<unsigned int>(startIndex));  // Offset indices for this primitive
+                }
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    meshIndices.push_back(static_cast<unsigned int>(startIndex + i));
+                }
+            }
+        }
+    }
+}
+
+void ModelData::loadOccluder(const GlbFile& glb, const GlbMesh& mesh, const glm::mat4& bake) {
+    for (const auto& primitive : mesh.primitives) {
+        auto position = primitive.attributes.find("POSITION");
+        if (primitive.mode != kGlbModeTriangles || position == primitive.attributes.end()) {
+            continue;
+        }
+        GlbAccessorView positions = glb.GetAccessor(position->second);
+        if (positions.components != 3) {
+            continue;
+        }
+        uint32_t startIndex = static_cast<uint32_t>(occluder.positions.size());
+        for (size_t i = 0; i < positions.count; i++) {
+            occluder.positions.push_back(glm::vec3(bake * glm::vec4(positions.Get(i, 0), positions.Get(i, 1), positions.Get(i, 2), 1.0f)));
+        }
+        if (primitive.indices >= 0) {
+            GlbAccessorView view = glb.GetAccessor(primitive.indices);
+            for (size_t i = 0; i < view.count; i++) {
+                occluder.indices.push_back(view.GetIndex(i) + startIndex);
+            }
+        } else {
+            for (size_t i = 0; i < positions.count; i++) {
+                occluder.indices.push_back(startIndex + static_cast<uint32_t>(i));
+            }
+        }
+    }
+    std::cout << "Occluder mesh " << mesh.name << ": " << occluder.indices.size() / 3 << " triangles" << std::endl;
+}
+
+int64_t ModelData::occluderBytes() const {
+    return static_cast<int64_t>(occluder.positions.capacity() * sizeof(glm::vec3) +
+                                occluder.indices.capacity() * sizeof(uint32_t));
+}
+
@@ -0,0 +1,102 @@
+#pragma once
+#include "glb_reader.h"
+#include "bvh.h"
+#include "animation.h"
+#include "material.h"
+#include "occlusion.h"
+#include <vector>
+#include <string>
+#include "../external/glm/glm/glm.hpp"
+#include <map>
+#include <cstdint>
+#include <limits>
+
+// CPU geometry in ModelData's layout: eight floats per vertex (position,
+// normal, texture coordinates) and indices into them
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<std::vector<unsigned int>> lodIndices;   // Levels 1 and up, as in ModelData
+    std::vector<unsigned int> edgeIndices;
+    OccluderMesh occluder;
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+};
+
+// The CPU side of a .glb model: bounds, collision BVH, occluder, skeleton and
+// the geometry and texture sources a renderer uploads. Needs no GL context;
+// Model adds the GPU resources on top of it.
+class ModelData {
+public:
+    // With renderData = false only what the simulation uses is kept: bounds,
+    // BVH, occluder and skeleton. Textures, edges, coarser LODs and clips are
+    // skipped and the geometry is released once the BVH is built.
+    explicit ModelData(const char* path, bool renderData = true);
+    virtual ~ModelData();
+    ModelData(const ModelData&) = delete;
+    ModelData& operator=(const ModelData&) = delete;
+
+    const glm::vec3& GetBoundsMin() const { return boundsMin; }
+    const glm::vec3& GetBoundsMax() const { return boundsMax; }
+    float GetBoundingRadius() const { return glm::length(boundsMax - boundsMin) * 0.5f; }
+
+    // Triangle hierarchy in model space for hit-scan and picking; kept after upload
+    const TriangleBVH& GetBVH() const { return bvh; }
+    // Meshes named "*_occluder" in the file, in model space. They are not drawn;
+    // entities using the model hide what is behind them. Empty for most models.
+    const OccluderMesh& GetOccluder() const { return occluder; }
+
+    // Node hierarchy and clips; CPU-side geometry above is the rest pose
+    const Skeleton& GetSkeleton() const { return skeleton; }
+    const std::vector<AnimationClip>& GetAnimations() const { return animations; }
+    // Animated models carry per-vertex joints and must be drawn with a joint palette
+    bool IsAnimated() const { return animated; }
+
+    // Appends the full-detail geometry, its coarser levels, edges and occluder
+    // transformed by `matrix`, growing out's bounds. False when the CPU data was
+    // released or the model is animated, leaving `out` untouched.
+    bool AppendTransformed(const glm::mat4& matrix, MeshData& out) const;
+
+protected:
+    // Geometry built elsewhere, e.g. merged from other models; no file is read
+    ModelData(const std::string& name, MeshData mesh);
+
+    // Texture source parsed by loadModel, waiting for Model::Upload()
+    struct PendingTexture {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> encoded;
+        std::vector<std::string> slots;
+    };
+
+    std::string name;
+    bool renderData;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::map<int, PendingTexture> pendingTextures;  // Keyed by glTF image index
+    std::vector<unsigned int> edgeIndices;  // GL_LINES pairs into vertices
+    std::vector<std::vector<unsigned int>> lodIndices;  // Levels 1 and up; empty for levels the file lacks
+    TriangleBVH bvh;
+    OccluderMesh occluder;
+
+    Skeleton skeleton;
+    std::vector<AnimationClip> animations;
+    bool animated = false;
+    std::vector<uint16_t> skinJoints;    // Four palette slots per vertex
+    std::vector<uint8_t> skinWeights;    // Four normalized weights per vertex
+    Material material;
+
+    void releaseCpuData();
+    int64_t indexBytes() const;
+
+private:
+    void loadModel(const char* path);
+    void loadSkeleton(const GlbFile& glb, std::vector<int>& nodeMap, std::vector<int>& nodeSource);
+    void loadAnimations(const GlbFile& glb, const std::vector<int>& nodeMap);
+    void loadMeshes(const GlbFile& glb, const std::vector<int>& nodeMap, const std::vector<int>& nodeSource);
+    void loadOccluder(const GlbFile& glb, const GlbMesh& mesh, const glm::mat4& bake);
+    int64_t occluderBytes() const;
+};
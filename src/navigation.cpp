@@ -0,0 +1,697 @@
+#include "navigation.h"
+#include "heightfield.h"
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace {
+
+const float kInfinity = std::numeric_limits<float>::infinity();
+const float kDiagonal = 1.41421356f;
+
+// Direction codes 0-7 step to a neighbouring cell, counter-clockwise from +X;
+// y is the grid row, which runs along world +Z
+const int kStepX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+const int kStepY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+const uint8_t kGoal = 8;
+const uint8_t kNone = 9;
+
+const uint8_t kSidePosX = 0;
+const uint8_t kSidePosY = 2;
+const uint8_t kSideNegX = 4;
+const uint8_t kSideNegY = 6;
+
+// Seed offsets closer than this are the same, so rounding never rebuilds a tile
+const float kSeedTolerance = 1e-3f;
+
+struct QueueEntry {
+    float value;
+    uint32_t cell;
+    bool operator>(const QueueEntry& other) const { return value > other.value; }
+};
+using MinQueue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+
+} // namespace
+
+NavigationGrid::NavigationGrid(const glm::vec2& center, float size, const NavigationSettings& settings)
+    : settings(settings) {
+    int cells = std::max(1, static_cast<int>(std::ceil(size / settings.cellSize)));
+    sectorsX = sectorsY = (cells + settings.sectorSize - 1) / settings.sectorSize;
+    width = sectorsX * settings.sectorSize;
+    height = sectorsY * settings.sectorSize;
+    origin = center - glm::vec2(width, height) * (settings.cellSize * 0.5f);
+
+    baseCost.assign(static_cast<size_t>(width) * height, 1);
+    cost = baseCost;
+    sectors.resize(static_cast<size_t>(sectorsX) * sectorsY);
+    sectorDirty.assign(sectors.size(), 1);
+    stats.sectors = sectors.size();
+}
+
+void NavigationGrid::BuildFromTerrain(const Heightfield& terrain) {
+    float maxTangent = std::tan(glm::radians(settings.maxSlopeDegrees));
+    float half = settings.cellSize * 0.5f;
+
+    JobSystem::Get().ParallelFor(static_cast<size_t>(height), 16, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            for (int x = 0; x < width; x++) {
+                float wx = origin.x + (x + 0.5f) * settings.cellSize;
+                float wz = origin.y + (y + 0.5f) * settings.cellSize;
+                uint8_t& cell = baseCost[y * width + x];
+                if (!terrain.Contains(wx, wz)) {
+                    cell = kBlocked;
+                    continue;
+                }
+                // Gradient from the cell's corners, so ridges narrower than the cell still count
+                float h00 = terrain.GetHeight(wx - half, wz - half);
+                float h10 = terrain.GetHeight(wx + half, wz - half);
+                float h01 = terrain.GetHeight(wx - half, wz + half);
+                float h11 = terrain.GetHeight(wx + half, wz + half);
+                float gx = ((h10 - h00) + (h11 - h01)) * 0.5f / settings.cellSize;
+                float gz = ((h01 - h00) + (h11 - h10)) * 0.5f / settings.cellSize;
+                float tangent = std::sqrt(gx * gx + gz * gz);
+                if (tangent > maxTangent) {
+                    cell = kBlocked;
+                    continue;
+                }
+                float steepness = tangent / maxTangent;
+                float value = 1.0f + settings.slopeCost * steepness * steepness;
+                cell = static_cast<uint8_t>(std::min(254.0f, std::round(value)));
+            }
+        }
+    });
+
+    std::fill(sectorDirty.begin(), sectorDirty.end(), 1);
+    anyDirty = true;
+}
+
+ObstacleId NavigationGrid::AddObstacle(const glm::vec2& min, const glm::vec2& max) {
+    ObstacleId id;
+    if (!freeObstacles.empty()) {
+        id = freeObstacles.back();
+        freeObstacles.pop_back();
+        obstacles[id] = { min, max, true };
+    } else {
+        id = static_cast<ObstacleId>(obstacles.size());
+        obstacles.push_back({ min, max, true });
+    }
+    markDirty(min, max);
+    return id;
+}
+
+void NavigationGrid::RemoveObstacle(ObstacleId id) {
+    if (id >= obstacles.size() || !obstacles[id].alive) {
+        return;
+    }
+    obstacles[id].alive = false;
+    freeObstacles.push_back(id);
+    markDirty(obstacles[id].min, obstacles[id].max);
+}
+
+void NavigationGrid::markDirty(const glm::vec2& min, const glm::vec2& max) {
+    float sectorMeters = settings.sectorSize * settings.cellSize;
+    glm::vec2 padding(settings.obstaclePadding);
+    glm::vec2 low = (min - padding - origin) / sectorMeters;
+    glm::vec2 high = (max + padding - origin) / sectorMeters;
+    int x0 = std::max(0, static_cast<int>(std::floor(low.x)));
+    int y0 = std::max(0, static_cast<int>(std::floor(low.y)));
+    int x1 = std::min(sectorsX - 1, static_cast<int>(std::floor(high.x)));
+    int y1 = std::min(sectorsY - 1, static_cast<int>(std::floor(high.y)));
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            sectorDirty[y * sectorsX + x] = 1;
+            anyDirty = true;
+        }
+    }
+}
+
+bool NavigationGrid::cellAt(const glm::vec3& position, int& x, int& y) const {
+    x = static_cast<int>(std::floor((position.x - origin.x) / settings.cellSize));
+    y = static_cast<int>(std::floor((position.z - origin.y) / settings.cellSize));
+    return x >= 0 && y >= 0 && x < width && y < height;
+}
+
+bool NavigationGrid::IsWalkable(const glm::vec3& position) const {
+    int x, y;
+    return cellAt(position, x, y) && cost[cellIndex(x, y)] != kBlocked;
+}
+
+void NavigationGrid::rebuildCosts(uint32_t sector) {
+    int size = settings.sectorSize;
+    int x0 = static_cast<int>(sector % sectorsX) * size;
+    int y0 = static_cast<int>(sector / sectorsX) * size;
+    for (int y = y0; y < y0 + size; y++) {
+        std::copy_n(&baseCost[cellIndex(x0, y)], size, &cost[cellIndex(x0, y)]);
+    }
+
+    // Blocks every cell the padded footprint overlaps
+    glm::vec2 padding(settings.obstaclePadding);
+    for (const Obstacle& obstacle : obstacles) {
+        if (!obstacle.alive) {
+            continue;
+        }
+        glm::vec2 low = (obstacle.min - padding - origin) / settings.cellSize;
+        glm::vec2 high = (obstacle.max + padding - origin) / settings.cellSize;
+        int cx0 = std::max(x0, static_cast<int>(std::floor(low.x)));
+        int cy0 = std::max(y0, static_cast<int>(std::floor(low.y)));
+        int cx1 = std::min(x0 + size, static_cast<int>(std::ceil(high.x)));
+        int cy1 = std::min(y0 + size, static_cast<int>(std::ceil(high.y)));
+        for (int y = cy0; y < cy1; y++) {
+            for (int x = cx0; x < cx1; x++) {
+                cost[cellIndex(x, y)] = kBlocked;
+            }
+        }
+    }
+}
+
+void NavigationGrid::rebuildPortals() {
+    // Sector lists come out in a fixed order (-Y, -X, +X, +Y edges, each along
+    // the edge), so a sector whose edges did not change keeps its cached paths
+    nodes.clear();
+    for (Sector& sector : sectors) {
+        sector.nodes.clear();
+    }
+
+    int size = settings.sectorSize;
+    auto addRuns = [&](uint32_t sector, uint32_t neighbour, uint32_t firstCell, uint32_t crossStep,
+                       uint32_t alongStep, uint8_t side) {
+        int run = 0;
+        auto flush = [&](int end) {
+            uint32_t start = firstCell + (end - run) * alongStep;
+            uint32_t first = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({ sector, first + 1, start, static_cast<uint16_t>(run), 0, side });
+            nodes.push_back({ neighbour, first, start + crossStep, static_cast<uint16_t>(run), 0,
+                              static_cast<uint8_t>((side + 4) & 7) });
+            run = 0;
+        };
+        for (int i = 0; i < size; i++) {
+            uint32_t cell = firstCell + i * alongStep;
+            if (cost[cell] != kBlocked && cost[cell + crossStep] != kBlocked) {
+                run++;
+                if (run == settings.portalCells) {
+                    flush(i + 1);
+                }
+            } else if (run > 0) {
+                flush(i);
+            }
+        }
+        if (run > 0) {
+            flush(size);
+        }
+    };
+
+    for (int sy = 0; sy < sectorsY; sy++) {
+        for (int sx = 0; sx < sectorsX; sx++) {
+            uint32_t sector = sy * sectorsX + sx;
+            if (sx + 1 < sectorsX) {
+                addRuns(sector, sector + 1, cellIndex(sx * size + size - 1, sy * size), 1, width, kSidePosX);
+            }
+            if (sy + 1 < sectorsY) {
+                addRuns(sector, sector + sectorsX, cellIndex(sx * size, sy * size + size - 1), width, 1, kSidePosY);
+            }
+        }
+    }
+
+    // Bucket by sector in the stable order: a sector's -Y and -X sides were
+    // created by earlier sectors, its +X and +Y sides by itself
+    std::vector<std::vector<uint32_t>> sides[4];
+    for (auto& list : sides) {
+        list.resize(sectors.size());
+    }
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        int order = nodes[i].side == kSideNegY ? 0 : nodes[i].side == kSideNegX ? 1 : nodes[i].side == kSidePosX ? 2 : 3;
+        sides[order][nodes[i].sector].push_back(i);
+    }
+    for (uint32_t s = 0; s < sectors.size(); s++) {
+        for (auto& list : sides) {
+            for (uint32_t node : list[s]) {
+                nodes[node].local = static_cast<uint16_t>(sectors[s].nodes.size());
+                sectors[s].nodes.push_back(node);
+            }
+        }
+    }
+    stats.portals = nodes.size();
+}
+
+void NavigationGrid::integrate(uint32_t sector, const uint32_t* seedCells, const float* seedValues, size_t seedCount,
+                               std::vector<float>& values, std::vector<int8_t>* parents) const {
+    int size = settings.sectorSize;
+    int x0 = static_cast<int>(sector % sectorsX) * size;
+    int y0 = static_cast<int>(sector / sectorsX) * size;
+    values.assign(static_cast<size_t>(size) * size, kInfinity);
+    if (parents) {
+        parents->assign(values.size(), -1);
+    }
+
+    // Costs of the sector with a blocked border, so neighbour tests need no bounds checks
+    int padded = size + 2;
+    thread_local std::vector<uint8_t> costs;
+    thread_local std::vector<QueueEntry> heap;
+    costs.assign(static_cast<size_t>(padded) * padded, kBlocked);
+    for (int ly = 0; ly < size; ly++) {
+        std::copy_n(&cost[cellIndex(x0, y0 + ly)], size, &costs[(ly + 1) * padded + 1]);
+    }
+    int offsets[8];
+    for (int direction = 0; direction < 8; direction++) {
+        offsets[direction] = kStepY[direction] * padded + kStepX[direction];
+    }
+
+    // Seeds are grid indices; the heap holds padded local indices
+    heap.clear();
+    auto push = [](float value, uint32_t cell) {
+        heap.push_back({ value, cell });
+        std::push_heap(heap.begin(), heap.end(), std::greater<QueueEntry>());
+    };
+    for (size_t i = 0; i < seedCount; i++) {
+        int lx = static_cast<int>(seedCells[i] % width) - x0;
+        int ly = static_cast<int>(seedCells[i] / width) - y0;
+        uint32_t local = ly * size + lx;
+        if (seedValues[i] < values[local]) {
+            values[local] = seedValues[i];
+            push(seedValues[i], (ly + 1) * padded + lx + 1);
+        }
+    }
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<QueueEntry>());
+        QueueEntry entry = heap.back();
+        heap.pop_back();
+        int lx = static_cast<int>(entry.cell % padded) - 1;
+        int ly = static_cast<int>(entry.cell / padded) - 1;
+        if (entry.value > values[ly * size + lx]) {
+            continue;
+        }
+        for (int direction = 0; direction < 8; direction++) {
+            uint32_t neighbour = entry.cell + offsets[direction];
+            if (costs[neighbour] == kBlocked) {
+                continue;
+            }
+            bool diagonal = (direction & 1) != 0;
+            // No cutting corners past blocked cells
+            if (diagonal && (costs[entry.cell + kStepX[direction]] == kBlocked ||
+                             costs[entry.cell + kStepY[direction] * padded] == kBlocked)) {
+                continue;
+            }
+            float value = entry.value + costs[neighbour] * (diagonal ? kDiagonal : 1.0f);
+            uint32_t next = (ly + kStepY[direction]) * size + lx + kStepX[direction];
+            if (value < values[next]) {
+                values[next] = value;
+                if (parents) {
+                    // Back towards the cell it was reached from
+                    (*parents)[next] = static_cast<int8_t>((direction + 4) & 7);
+                }
+                push(value, neighbour);
+            }
+        }
+    }
+}
+
+void NavigationGrid::rebuildPaths(uint32_t index) {
+    Sector& sector = sectors[index];
+    size_t count = sector.nodes.size();
+    sector.paths.assign(count * count, kInfinity);
+
+    std::vector<uint32_t> seeds;
+    std::vector<float> zeros;
+    std::vector<float> values;
+    int size = settings.sectorSize;
+    uint32_t x0 = (index % sectorsX) * size;
+    uint32_t y0 = (index / sectorsX) * size;
+    for (size_t from = 0; from < count; from++) {
+        const PortalNode& node = nodes[sector.nodes[from]];
+        uint32_t step = (node.side == kSidePosX || node.side == kSideNegX) ? width : 1;
+        seeds.clear();
+        for (uint32_t i = 0; i < node.length; i++) {
+            seeds.push_back(node.firstCell + i * step);
+        }
+        zeros.assign(seeds.size(), 0.0f);
+        integrate(index, seeds.data(), zeros.data(), seeds.size(), values, nullptr);
+
+        for (size_t to = 0; to < count; to++) {
+            const PortalNode& target = nodes[sector.nodes[to]];
+            uint32_t targetStep = (target.side == kSidePosX || target.side == kSideNegX) ? width : 1;
+            float best = kInfinity;
+            for (uint32_t i = 0; i < target.length; i++) {
+                uint32_t cell = target.firstCell + i * targetStep;
+                best = std::min(best, values[(cell / width - y0) * size + (cell % width - x0)]);
+            }
+            sector.paths[from * count + to] = best;
+        }
+    }
+}
+
+std::shared_ptr<const FlowField> NavigationGrid::RequestField(const glm::vec3& goal) {
+    int x, y;
+    if (!cellAt(goal, x, y)) {
+        return nullptr;
+    }
+    uint32_t cell = static_cast<uint32_t>(cellIndex(x, y));
+    auto it = fields.find(cell);
+    if (it != fields.end()) {
+        it->second->lastUse = ++useCounter;
+        return it->second;
+    }
+
+    auto field = std::make_shared<FlowField>();
+    field->goal = goal;
+    field->goalCell = cell;
+    field->lastUse = ++useCounter;
+    field->directions.assign(cost.size(), kNone);
+    field->tiles.resize(sectors.size());
+    field->tileValid.assign(sectors.size(), 0);
+    fields.emplace(cell, field);
+    stats.fields = fields.size();
+    return field;
+}
+
+void NavigationGrid::solvePortals(FlowField& field) const {
+    field.nodeDistances.assign(nodes.size(), kInfinity);
+    field.nodeExits.assign(nodes.size(), 0);
+
+    // A goal inside an obstacle moves to the nearest open cell of its sector
+    int size = settings.sectorSize;
+    int gx = static_cast<int>(field.goalCell % width);
+    int gy = static_cast<int>(field.goalCell / width);
+    uint32_t goalSector = (gy / size) * sectorsX + (gx / size);
+    field.targetCell = field.goalCell;
+    if (cost[field.goalCell] == kBlocked) {
+        int bestDistance = std::numeric_limits<int>::max();
+        int x0 = (gx / size) * size, y0 = (gy / size) * size;
+        for (int y = y0; y < y0 + size; y++) {
+            for (int x = x0; x < x0 + size; x++) {
+                int distance = (x - gx) * (x - gx) + (y - gy) * (y - gy);
+                if (cost[cellIndex(x, y)] != kBlocked && distance < bestDistance) {
+                    bestDistance = distance;
+                    field.targetCell = static_cast<uint32_t>(cellIndex(x, y));
+                }
+            }
+        }
+        if (bestDistance == std::numeric_limits<int>::max()) {
+            return;
+        }
+    }
+
+    // Cost from the goal sector's portal sides to the goal
+    std::vector<float> values;
+    float zero = 0.0f;
+    integrate(goalSector, &field.targetCell, &zero, 1, values, nullptr);
+
+    MinQueue queue;
+    uint32_t x0 = (goalSector % sectorsX) * size;
+    uint32_t y0 = (goalSector / sectorsX) * size;
+    for (uint32_t index : sectors[goalSector].nodes) {
+        const PortalNode& node = nodes[index];
+        uint32_t step = (node.side == kSidePosX || node.side == kSideNegX) ? width : 1;
+        float best = kInfinity;
+        for (uint32_t i = 0; i < node.length; i++) {
+            uint32_t cell = node.firstCell + i * step;
+            best = std::min(best, values[(cell / width - y0) * size + (cell % width - x0)]);
+        }
+        if (best < kInfinity) {
+            field.nodeDistances[index] = best;
+            queue.push({ best, index });
+        }
+    }
+
+    // Dijkstra towards the goal: crossing an opening costs the far side's cells,
+    // moving within a sector the cached local path
+    while (!queue.empty()) {
+        QueueEntry entry = queue.top();
+        queue.pop();
+        if (entry.value > field.nodeDistances[entry.cell]) {
+            continue;
+        }
+        const PortalNode& node = nodes[entry.cell];
+
+        uint32_t step = (node.side == kSidePosX || node.side == kSideNegX) ? width : 1;
+        float crossing = cost[node.firstCell + (node.length / 2) * step];
+        float across = entry.value + crossing;
+        if (across < field.nodeDistances[node.opposite]) {
+            field.nodeDistances[node.opposite] = across;
+            field.nodeExits[node.opposite] = 1;
+            queue.push({ across, node.opposite });
+        }
+
+        const Sector& sector = sectors[node.sector];
+        size_t count = sector.nodes.size();
+        for (size_t from = 0; from < count; from++) {
+            uint32_t other = sector.nodes[from];
+            float value = entry.value + sector.paths[from * count + node.local];
+            if (value < field.nodeDistances[other]) {
+                field.nodeDistances[other] = value;
+                field.nodeExits[other] = 0;
+                queue.push({ value, other });
+            }
+        }
+    }
+}
+
+void NavigationGrid::buildTile(FlowField& field, uint32_t index) const {
+    const Sector& sector = sectors[index];
+    int size = settings.sectorSize;
+    uint32_t x0 = (index % sectorsX) * size;
+    uint32_t y0 = (index / sectorsX) * size;
+
+    std::vector<uint32_t> seedCells;
+    std::vector<float> seedValues;
+    std::vector<uint8_t> seedCodes;
+    for (uint32_t node : field.tiles[index].nodes) {
+        const PortalNode& portal = nodes[sector.nodes[node]];
+        uint32_t step = (portal.side == kSidePosX || portal.side == kSideNegX) ? width : 1;
+        for (uint32_t i = 0; i < portal.length; i++) {
+            seedCells.push_back(portal.firstCell + i * step);
+            seedValues.push_back(field.nodeDistances[sector.nodes[node]]);
+            seedCodes.push_back(portal.side);
+        }
+    }
+    uint32_t goalSector = ((field.targetCell / width) / size) * sectorsX + (field.targetCell % width) / size;
+    if (index == goalSector && cost[field.targetCell] != kBlocked) {
+        seedCells.push_back(field.targetCell);
+        seedValues.push_back(0.0f);
+        seedCodes.push_back(kGoal);
+    }
+
+    std::vector<float> values;
+    std::vector<int8_t> parents;
+    integrate(index, seedCells.data(), seedValues.data(), seedCells.size(), values, &parents);
+
+    // Seeds keep their own code unless a cheaper seed reached them
+    std::vector<uint8_t> codes(values.size(), kNone);
+    std::vector<float> bestSeed(values.size(), kInfinity);
+    for (size_t i = 0; i < seedCells.size(); i++) {
+        uint32_t local = (seedCells[i] / width - y0) * size + (seedCells[i] % width - x0);
+        if (seedValues[i] < bestSeed[local]) {
+            bestSeed[local] = seedValues[i];
+            codes[local] = seedCodes[i];
+        }
+    }
+    for (int ly = 0; ly < size; ly++) {
+        uint8_t* row = &field.directions[cellIndex(x0, y0 + ly)];
+        for (int lx = 0; lx < size; lx++) {
+            uint32_t local = ly * size + lx;
+            if (values[local] == kInfinity) {
+                row[lx] = kNone;
+            } else if (parents[local] >= 0) {
+                row[lx] = static_cast<uint8_t>(parents[local]);
+            } else {
+                row[lx] = codes[local];
+            }
+        }
+    }
+}
+
+void NavigationGrid::Update() {
+    auto start = std::chrono::steady_clock::now();
+    JobSystem& jobs = JobSystem::Get();
+    stats.rebuiltSectors = 0;
+    stats.rebuiltTiles = 0;
+
+    // Costs of dirty sectors, then portals everywhere (a cheap scan of the
+    // sector edges) and local paths of the sectors whose edges may have moved
+    std::vector<uint8_t> affected(sectors.size(), 0);
+    bool portalsChanged = anyDirty;
+    if (anyDirty) {
+        std::vector<uint32_t> dirty;
+        for (uint32_t s = 0; s < sectors.size(); s++) {
+            if (!sectorDirty[s]) {
+                continue;
+            }
+            dirty.push_back(s);
+            int sx = static_cast<int>(s % sectorsX), sy = static_cast<int>(s / sectorsX);
+            affected[s] = 1;
+            if (sx > 0) affected[s - 1] = 1;
+            if (sx + 1 < sectorsX) affected[s + 1] = 1;
+            if (sy > 0) affected[s - sectorsX] = 1;
+            if (sy + 1 < sectorsY) affected[s + sectorsX] = 1;
+        }
+        jobs.ParallelFor(dirty.size(), 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                rebuildCosts(dirty[i]);
+            }
+        });
+
+        rebuildPortals();
+
+        std::vector<uint32_t> rebuild;
+        for (uint32_t s = 0; s < sectors.size(); s++) {
+            if (affected[s]) {
+                rebuild.push_back(s);
+            }
+        }
+        jobs.ParallelFor(rebuild.size(), 4, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                rebuildPaths(rebuild[i]);
+            }
+        });
+
+        stats.rebuiltSectors = dirty.size();
+        std::fill(sectorDirty.begin(), sectorDirty.end(), 0);
+        anyDirty = false;
+    }
+
+    // New fields, and every field when the portal graph changed, solve the
+    // portal graph; a tile is rebuilt when its sector changed or its exits did
+    std::vector<FlowField*> solve;
+    for (auto& entry : fields) {
+        if (portalsChanged || !entry.second->ready) {
+            solve.push_back(entry.second.get());
+        }
+    }
+    std::vector<std::vector<uint32_t>> tileLists(solve.size());
+    jobs.ParallelFor(solve.size(), 1, [&](size_t begin, size_t end) {
+        FlowField::TileSeeds seeds;
+        for (size_t f = begin; f < end; f++) {
+            FlowField& field = *solve[f];
+            uint32_t previousTarget = field.targetCell;
+            solvePortals(field);
+            for (uint32_t s = 0; s < sectors.size(); s++) {
+                const Sector& sector = sectors[s];
+                seeds.nodes.clear();
+                seeds.offsets.clear();
+                float lowest = kInfinity;
+                for (uint32_t local = 0; local < sector.nodes.size(); local++) {
+                    uint32_t node = sector.nodes[local];
+                    if (field.nodeExits[node] && field.nodeDistances[node] < kInfinity) {
+                        seeds.nodes.push_back(local);
+                        seeds.offsets.push_back(field.nodeDistances[node]);
+                        lowest = std::min(lowest, field.nodeDistances[node]);
+                    }
+                }
+                for (float& offset : seeds.offsets) {
+                    offset -= lowest;
+                }
+
+                FlowField::TileSeeds& current = field.tiles[s];
+                bool same = field.tileValid[s] && !affected[s] && seeds.nodes == current.nodes &&
+                            field.targetCell == previousTarget;
+                for (size_t i = 0; same && i < seeds.offsets.size(); i++) {
+                    same = std::fabs(seeds.offsets[i] - current.offsets[i]) <= kSeedTolerance * std::max(1.0f, seeds.offsets[i]);
+                }
+                if (!same) {
+                    std::swap(current, seeds);
+                    field.tileValid[s] = 1;
+                    tileLists[f].push_back(s);
+                }
+            }
+        }
+    });
+
+    struct TileJob {
+        FlowField* field;
+        uint32_t sector;
+    };
+    std::vector<TileJob> tileJobs;
+    for (size_t f = 0; f < solve.size(); f++) {
+        for (uint32_t s : tileLists[f]) {
+            tileJobs.push_back({ solve[f], s });
+        }
+        solve[f]->lastRebuiltTiles = tileLists[f].size();
+    }
+    jobs.ParallelFor(tileJobs.size(), 8, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            buildTile(*tileJobs[i].field, tileJobs[i].sector);
+        }
+    });
+    for (FlowField* field : solve) {
+        field->ready = true;
+    }
+    stats.rebuiltTiles = tileJobs.size();
+
+    evictFields();
+    stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void NavigationGrid::evictFields() {
+    // Fields still held by units are kept even beyond the limit
+    while (fields.size() > settings.maxCachedFields) {
+        auto oldest = fields.end();
+        for (auto it = fields.begin(); it != fields.end(); ++it) {
+            if (it->second.use_count() == 1 && (oldest == fields.end() || it->second->lastUse < oldest->second->lastUse)) {
+                oldest = it;
+            }
+        }
+        if (oldest == fields.end()) {
+            break;
+        }
+        fields.erase(oldest);
+    }
+    stats.fields = fields.size();
+}
+
+bool NavigationGrid::Sample(const FlowField& field, const glm::vec3& position, glm::vec2& direction) const {
+    if (!field.ready) {
+        return false;
+    }
+    float fx = (position.x - origin.x) / settings.cellSize - 0.5f;
+    float fy = (position.z - origin.y) / settings.cellSize - 0.5f;
+    int x0 = static_cast<int>(std::floor(fx));
+    int y0 = static_cast<int>(std::floor(fy));
+    float tx = fx - x0, ty = fy - y0;
+
+    glm::vec2 toGoal(field.goal.x - position.x, field.goal.z - position.z);
+    float goalDistance = glm::length(toGoal);
+    glm::vec2 goalDirection = goalDistance > 1e-4f ? toGoal / goalDistance : glm::vec2(0.0f);
+
+    // Bilinear blend of the four nearest cells' directions smooths the
+    // 45 degree steps; closed cells contribute nothing
+    glm::vec2 sum(0.0f);
+    for (int i = 0; i < 4; i++) {
+        int x = x0 + (i & 1), y = y0 + (i >> 1);
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            continue;
+        }
+        float weight = ((i & 1) ? tx : 1.0f - tx) * ((i >> 1) ? ty : 1.0f - ty);
+        uint8_t code = field.directions[cellIndex(x, y)];
+        if (code < 8) {
+            glm::vec2 step(static_cast<float>(kStepX[code]), static_cast<float>(kStepY[code]));
+            sum += step * (weight / glm::length(step));
+        } else if (code == kGoal) {
+            sum += goalDirection * weight;
+        }
+    }
+
+    int cx, cy;
+    if (!cellAt(position, cx, cy)) {
+        return false;
+    }
+    uint8_t own = field.directions[cellIndex(cx, cy)];
+    if (own == kGoal) {
+        sum = goalDirection;
+    } else if (own == kNone && glm::length(sum) < 1e-4f) {
+        return false;
+    }
+    float length = glm::length(sum);
+    if (length < 1e-4f) {
+        if (own >= 8) {
+            return false;
+        }
+        sum = glm::vec2(static_cast<float>(kStepX[own]), static_cast<float>(kStepY[own]));
+        length = glm::length(sum);
+    }
+    direction = sum / length;
+    return true;
+}
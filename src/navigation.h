@@ -0,0 +1,164 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+class Heightfield;
+
+using ObstacleId = uint32_t;
+const ObstacleId kInvalidObstacle = 0xffffffffu;
+
+struct NavigationSettings {
+    float cellSize = 4.0f;           // Meters per grid cell
+    int sectorSize = 16;             // Cells per sector side
+    int portalCells = 2;             // Longer openings between sectors are split, so paths cross them where they should
+    float maxSlopeDegrees = 35.0f;   // Steeper cells are impassable
+    float slopeCost = 4.0f;          // Extra cost of a cell at the maximum slope, on top of 1
+    float obstaclePadding = 2.0f;    // Obstacles are grown by this many meters, roughly a unit's radius
+    size_t maxCachedFields = 32;     // Unused fields beyond this are dropped, least recently requested first
+};
+
+struct NavigationStats {
+    size_t sectors = 0;
+    size_t portals = 0;           // Portal sides, two per opening between sectors
+    size_t fields = 0;
+    size_t rebuiltSectors = 0;    // Cost and portals recomputed by the last Update()
+    size_t rebuiltTiles = 0;      // Flow field sectors recomputed by the last Update()
+    double updateMs = 0.0;
+};
+
+// Directions towards one goal cell for every cell of a NavigationGrid.
+// Shared by all units heading to that goal; sampling never allocates.
+class FlowField {
+public:
+    // False until the grid's next Update() has computed it
+    bool IsReady() const { return ready; }
+    const glm::vec3& GetGoal() const { return goal; }
+    // Sector tiles recomputed the last time the field changed
+    size_t GetLastRebuiltTiles() const { return lastRebuiltTiles; }
+
+private:
+    friend class NavigationGrid;
+
+    // A sector's seeds: the portal sides its flow leaves through, with their
+    // distance to the goal relative to the closest one. Tiles are only rebuilt
+    // when these change or the sector itself does.
+    struct TileSeeds {
+        std::vector<uint32_t> nodes;
+        std::vector<float> offsets;
+    };
+
+    glm::vec3 goal = glm::vec3(0.0f);
+    uint32_t goalCell = 0;
+    uint32_t targetCell = 0;             // goalCell, or the nearest open cell when it is blocked
+    bool ready = false;
+    uint64_t lastUse = 0;
+    size_t lastRebuiltTiles = 0;
+    std::vector<uint8_t> directions;     // Per cell, one of NavigationGrid's direction codes
+    std::vector<float> nodeDistances;    // Per portal side, cost to the goal
+    std::vector<uint8_t> nodeExits;      // Per portal side, 1 when the best path crosses it
+    std::vector<TileSeeds> tiles;        // Per sector
+    std::vector<uint8_t> tileValid;      // Per sector, 0 when the tile must be rebuilt
+};
+
+// Flow-field navigation over a grid of cells with traversal costs derived
+// from the terrain's slope and from obstacle footprints. The grid is split
+// into sectors; openings between neighbouring sectors become portals, and the
+// cost between every pair of portals inside a sector is cached. A field for a
+// goal runs Dijkstra over the small portal graph, then fills each sector's
+// cells with directions from a local integration pass seeded at the portals
+// its flow leaves through. Sectors are independent once the portal costs are
+// known, so fields are filled in parallel, and a changed obstacle only
+// rebuilds the sectors it touches plus the tiles whose exits changed. Units
+// read one direction per tick however many share the field.
+//
+// Not thread-safe: like CollisionWorld, only touch it from the simulation tick
+// or while the simulation is not running. Sample() may run on many threads at once.
+class NavigationGrid {
+public:
+    // Square area of `size` meters centred on `center` (world XZ), rounded up to whole sectors
+    NavigationGrid(const glm::vec2& center, float size, const NavigationSettings& settings = NavigationSettings());
+
+    // Base costs from the terrain's slope; cells outside the terrain are impassable.
+    // Without a call every cell costs 1.
+    void BuildFromTerrain(const Heightfield& terrain);
+
+    // Impassable footprint on the XZ plane, applied by the next Update()
+    ObstacleId AddObstacle(const glm::vec2& min, const glm::vec2& max);
+    void RemoveObstacle(ObstacleId id);
+
+    // The field towards the cell containing `goal`, cached per goal cell. New
+    // fields are computed by the next Update(); a field stays valid while held.
+    std::shared_ptr<const FlowField> RequestField(const glm::vec3& goal);
+
+    // Applies obstacle changes to dirty sectors and computes new and affected fields
+    void Update();
+
+    // Unit direction of travel on the XZ plane at `position`, blended between
+    // the four nearest cells. False when the field is not ready or no path
+    // leads from here; in the goal cell the direction points at the goal itself.
+    bool Sample(const FlowField& field, const glm::vec3& position, glm::vec2& direction) const;
+
+    bool IsWalkable(const glm::vec3& position) const;
+    glm::vec2 GetOrigin() const { return origin; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    const NavigationSettings& GetSettings() const { return settings; }
+    const NavigationStats& GetStats() const { return stats; }
+
+private:
+    static constexpr uint8_t kBlocked = 255;
+
+    // One side of an opening between two sectors: a run of cells along the sector edge
+    struct PortalNode {
+        uint32_t sector;
+        uint32_t opposite;      // The other side of the opening
+        uint32_t firstCell;     // Grid index of the run's first cell
+        uint16_t length;
+        uint16_t local;         // Index in its sector's node list
+        uint8_t side;           // Direction code pointing across the opening
+    };
+
+    struct Sector {
+        std::vector<uint32_t> nodes;   // Portal sides in this sector, in a stable order
+        std::vector<float> paths;      // nodes.size()^2 local costs, row = from
+    };
+
+    struct Obstacle {
+        glm::vec2 min, max;
+        bool alive;
+    };
+
+    NavigationSettings settings;
+    glm::vec2 origin;
+    int width, height;
+    int sectorsX, sectorsY;
+    std::vector<uint8_t> baseCost;
+    std::vector<uint8_t> cost;
+    std::vector<PortalNode> nodes;
+    std::vector<Sector> sectors;
+    std::vector<uint8_t> sectorDirty;
+    bool anyDirty = true;
+
+    std::vector<Obstacle> obstacles;
+    std::vector<ObstacleId> freeObstacles;
+
+    std::unordered_map<uint32_t, std::shared_ptr<FlowField>> fields;
+    uint64_t useCounter = 0;
+    NavigationStats stats;
+
+    int cellIndex(int x, int y) const { return y * width + x; }
+    bool cellAt(const glm::vec3& position, int& x, int& y) const;
+    void markDirty(const glm::vec2& min, const glm::vec2& max);
+    void rebuildCosts(uint32_t sector);
+    void rebuildPortals();
+    void rebuildPaths(uint32_t sector);
+    void integrate(uint32_t sector, const uint32_t* seedCells, const float* seedValues, size_t seedCount,
+                   std::vector<float>& values, std::vector<int8_t>* parents) const;
+    void solvePortals(FlowField& field) const;
+    void buildTile(FlowField& field, uint32_t sector) const;
+    void evictFields();
+};
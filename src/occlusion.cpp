@@ -0,0 +1,404 @@
+#include "occlusion.h"
+#include "job_system.h"
+#include "simd.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Triangles are clipped to a band around the screen rather than its edges,
+// which keeps edge functions small without clipping most triangles
+const float kGuardBand = 2.0f;
+
+// Boxes are pulled this fraction closer so a surface never hides its own bounds
+const float kDepthBias = 1.0e-3f;
+
+enum OutCode : uint32_t {
+    kOutNear = 1u << 0,
+    kOutLeft = 1u << 1,
+    kOutRight = 1u << 2,
+    kOutBottom = 1u << 3,
+    kOutTop = 1u << 4,
+    kOutScreen = kOutNear | kOutLeft | kOutRight | kOutBottom | kOutTop,
+    kOutGuard = 1u << 5,
+    kOutFar = 1u << 6,     // Only tested for occludees; occluders past the far plane still hide nothing visible
+};
+
+uint32_t outCode(const glm::vec4& clip) {
+    uint32_t code = 0;
+    code |= clip.z < -clip.w ? kOutNear : 0u;
+    code |= clip.x < -clip.w ? kOutLeft : 0u;
+    code |= clip.x > clip.w ? kOutRight : 0u;
+    code |= clip.y < -clip.w ? kOutBottom : 0u;
+    code |= clip.y > clip.w ? kOutTop : 0u;
+    float guard = kGuardBand * clip.w;
+    code |= (clip.x < -guard || clip.x > guard || clip.y < -guard || clip.y > guard) ? kOutGuard : 0u;
+    return code;
+}
+
+// Sutherland-Hodgman against one plane; inside where dot(plane, v) >= 0
+int clipPolygon(const glm::vec4& plane, const glm::vec4* in, int count, glm::vec4* out) {
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        const glm::vec4& a = in[i];
+        const glm::vec4& b = in[(i + 1) % count];
+        float da = glm::dot(plane, a);
+        float db = glm::dot(plane, b);
+        if (da >= 0.0f) {
+            out[written++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            out[written++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    return written;
+}
+
+const float kLaneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(int width, int height) {
+    tilesX = std::max((width + kTileWidth - 1) / kTileWidth, 1);
+    tilesY = std::max((height + kTileHeight - 1) / kTileHeight, 1);
+    this->width = tilesX * kTileWidth;
+    this->height = tilesY * kTileHeight;
+    depth.assign(static_cast<size_t>(this->width) * this->height, 0.0f);
+    tileBins.resize(static_cast<size_t>(tilesX) * tilesY);
+}
+
+void OcclusionCuller::Begin(const glm::mat4& newViewProjection) {
+    viewProjection = newViewProjection;
+    occluders.clear();
+    std::fill(depth.begin(), depth.end(), 0.0f);
+    stats = OcclusionStats();
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const glm::mat4& modelMatrix) {
+    if (!mesh.Empty()) {
+        occluders.push_back({ &mesh, viewProjection * modelMatrix, 0 });
+    }
+}
+
+void OcclusionCuller::Rasterize() {
+    Clock::time_point start = Clock::now();
+
+    // Vertices are transformed once, then triangles set up from them. Large
+    // occluders are split so both steps spread over the workers.
+    size_t vertexCount = 0;
+    size_t jobCount = 0;
+    vertexSlices.clear();
+    for (size_t i = 0; i < occluders.size(); i++) {
+        Occluder& occluder = occluders[i];
+        occluder.firstVertex = vertexCount;
+        size_t positionCount = occluder.mesh->positions.size();
+        for (size_t first = 0; first < positionCount; first += kVerticesPerJob) {
+            vertexSlices.push_back({ i, first, std::min(kVerticesPerJob, positionCount - first) });
+        }
+        vertexCount += positionCount;
+
+        size_t indexCount = occluder.mesh->indices.size() / 3 * 3;
+        for (size_t first = 0; first < indexCount; first += kTrianglesPerJob * 3) {
+            if (jobCount == setupJobs.size()) {
+                setupJobs.emplace_back();
+            }
+            SetupJob& job = setupJobs[jobCount++];
+            job.indices = { i, first, std::min(kTrianglesPerJob * 3, indexCount - first) };
+            job.triangles.clear();
+        }
+    }
+    clipVertices.resize(vertexCount);
+    clipCodes.resize(vertexCount);
+    JobSystem::Get().ParallelFor(vertexSlices.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            transformVertices(vertexSlices[i]);
+        }
+    });
+    JobSystem::Get().ParallelFor(jobCount, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            setupTriangles(setupJobs[i]);
+        }
+    });
+
+    // Bin by tile; every tile is then owned by one job and needs no locking
+    for (auto& bin : tileBins) {
+        bin.clear();
+    }
+    for (size_t i = 0; i < jobCount; i++) {
+        for (const ScreenTriangle& triangle : setupJobs[i].triangles) {
+            for (int ty = triangle.minY / kTileHeight; ty <= triangle.maxY / kTileHeight; ty++) {
+                for (int tx = triangle.minX / kTileWidth; tx <= triangle.maxX / kTileWidth; tx++) {
+                    tileBins[ty * tilesX + tx].push_back(&triangle);
+                }
+            }
+        }
+        stats.triangles += setupJobs[i].triangles.size();
+    }
+    JobSystem::Get().ParallelFor(tileBins.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++) {
+            rasterizeTile(static_cast<int>(tile));
+        }
+    });
+
+    stats.occluders = occluders.size();
+    stats.rasterMs = millisecondsSince(start);
+}
+
+void OcclusionCuller::transformVertices(const Slice& slice) {
+    const Occluder& occluder = occluders[slice.occluder];
+    const glm::vec3* positions = occluder.mesh->positions.data();
+    for (size_t i = slice.first; i < slice.first + slice.count; i++) {
+        glm::vec4 clip = occluder.modelViewProjection * glm::vec4(positions[i], 1.0f);
+        clipVertices[occluder.firstVertex + i] = clip;
+        clipCodes[occluder.firstVertex + i] = outCode(clip);
+    }
+}
+
+void OcclusionCuller::setupTriangles(SetupJob& job) const {
+    const Occluder& occluder = occluders[job.indices.occluder];
+    const std::vector<uint32_t>& indices = occluder.mesh->indices;
+    size_t positionCount = occluder.mesh->positions.size();
+    const glm::vec4* vertices = &clipVertices[occluder.firstVertex];
+    const uint32_t* vertexCodes = &clipCodes[occluder.firstVertex];
+
+    for (size_t i = job.indices.first; i < job.indices.first + job.indices.count; i += 3) {
+        uint32_t i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+        if (i0 >= positionCount || i1 >= positionCount || i2 >= positionCount) {
+            continue;
+        }
+        uint32_t codes[3] = { vertexCodes[i0], vertexCodes[i1], vertexCodes[i2] };
+        if ((codes[0] & codes[1] & codes[2] & kOutScreen) != 0) {
+            continue;
+        }
+        const glm::vec4 clip[3] = { vertices[i0], vertices[i1], vertices[i2] };
+        if (((codes[0] | codes[1] | codes[2]) & (kOutNear | kOutGuard)) == 0) {
+            addClipped(clip, 3, job.triangles);
+            continue;
+        }
+
+        // Near plane, then the guard band
+        const glm::vec4 planes[5] = {
+            glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+            glm::vec4(1.0f, 0.0f, 0.0f, kGuardBand),
+            glm::vec4(-1.0f, 0.0f, 0.0f, kGuardBand),
+            glm::vec4(0.0f, 1.0f, 0.0f, kGuardBand),
+            glm::vec4(0.0f, -1.0f, 0.0f, kGuardBand),
+        };
+        glm::vec4 polygon[2][8];
+        int count = 3;
+        std::copy(clip, clip + 3, polygon[0]);
+        int current = 0;
+        for (const glm::vec4& plane : planes) {
+            count = clipPolygon(plane, polygon[current], count, polygon[current ^ 1]);
+            current ^= 1;
+            if (count < 3) {
+                break;
+            }
+        }
+        if (count >= 3) {
+            addClipped(polygon[current], count, job.triangles);
+        }
+    }
+}
+
+void OcclusionCuller::addClipped(const glm::vec4* clip, int count, std::vector<ScreenTriangle>& out) const {
+    // Pixel coordinates with 1/w; y runs up like clip space
+    glm::vec3 screen[8];
+    for (int i = 0; i < count; i++) {
+        float invW = 1.0f / clip[i].w;
+        screen[i] = glm::vec3((clip[i].x * invW * 0.5f + 0.5f) * width,
+                              (clip[i].y * invW * 0.5f + 0.5f) * height, invW);
+    }
+
+    for (int i = 1; i + 1 < count; i++) {
+        const glm::vec3 v[3] = { screen[0], screen[i], screen[i + 1] };
+        double area = (static_cast<double>(v[1].x) - v[0].x) * (static_cast<double>(v[2].y) - v[0].y) -
+                      (static_cast<double>(v[2].x) - v[0].x) * (static_cast<double>(v[1].y) - v[0].y);
+        if (std::fabs(area) < 1.0e-6) {
+            continue;
+        }
+
+        // Pixels whose centers fall within the triangle's bounds
+        float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+        float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+        float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+        float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+        ScreenTriangle triangle;
+        triangle.minX = std::max(static_cast<int>(std::ceil(minX - 0.5f)), 0);
+        triangle.maxX = std::min(static_cast<int>(std::floor(maxX - 0.5f)), width - 1);
+        triangle.minY = std::max(static_cast<int>(std::ceil(minY - 0.5f)), 0);
+        triangle.maxY = std::min(static_cast<int>(std::floor(maxY - 0.5f)), height - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            continue;
+        }
+
+        // Edge functions are positive inside whichever way the triangle winds;
+        // occluders are drawn two-sided because they need not be closed
+        double sign = area > 0.0 ? 1.0 : -1.0;
+        for (int e = 0; e < 3; e++) {
+            const glm::vec3& a = v[e];
+            const glm::vec3& b = v[(e + 1) % 3];
+            double edgeA = static_cast<double>(a.y) - b.y;
+            double edgeB = static_cast<double>(b.x) - a.x;
+            double edgeC = static_cast<double>(a.x) * b.y - static_cast<double>(b.x) * a.y;
+            triangle.edgeA[e] = static_cast<float>(edgeA * sign);
+            triangle.edgeB[e] = static_cast<float>(edgeB * sign);
+            triangle.edgeC[e] = static_cast<float>(edgeC * sign);
+        }
+
+        double dz1 = static_cast<double>(v[1].z) - v[0].z, dz2 = static_cast<double>(v[2].z) - v[0].z;
+        double dx1 = static_cast<double>(v[1].x) - v[0].x, dx2 = static_cast<double>(v[2].x) - v[0].x;
+        double dy1 = static_cast<double>(v[1].y) - v[0].y, dy2 = static_cast<double>(v[2].y) - v[0].y;
+        double depthA = (dz1 * dy2 - dz2 * dy1) / area;
+        double depthB = (dx1 * dz2 - dx2 * dz1) / area;
+        // The plane is written at the furthest point of each pixel rather than its
+        // center, so a pixel never claims to be closer than any part of it is
+        double depthC = v[0].z - depthA * v[0].x - depthB * v[0].y - 0.5 * (std::fabs(depthA) + std::fabs(depthB));
+        triangle.depthA = static_cast<float>(depthA);
+        triangle.depthB = static_cast<float>(depthB);
+        triangle.depthC = static_cast<float>(depthC);
+        triangle.depthMin = std::min(v[0].z, std::min(v[1].z, v[2].z));
+        out.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeTile(int tile) {
+    int tileMinX = (tile % tilesX) * kTileWidth;
+    int tileMinY = (tile / tilesX) * kTileHeight;
+    int tileMaxX = tileMinX + kTileWidth - 1;
+    int tileMaxY = tileMinY + kTileHeight - 1;
+    const simd::Float4 zero = simd::Splat(0.0f);
+    const simd::Float4 laneOffsets = simd::Load(kLaneOffsets);
+
+    for (const ScreenTriangle* triangle : tileBins[tile]) {
+        // Rows start on a four-pixel boundary; tiles are whole groups of four
+        int minX = std::max(triangle->minX, tileMinX) & ~3;
+        int maxX = std::min(triangle->maxX, tileMaxX);
+        int minY = std::max(triangle->minY, tileMinY);
+        int maxY = std::min(triangle->maxY, tileMaxY);
+
+        simd::Float4 edgeA[3], edgeStep[3];
+        for (int e = 0; e < 3; e++) {
+            edgeA[e] = simd::Splat(triangle->edgeA[e]);
+            edgeStep[e] = simd::Splat(triangle->edgeA[e] * 4.0f);
+        }
+        simd::Float4 depthMin = simd::Splat(triangle->depthMin);
+        simd::Float4 depthA = simd::Splat(triangle->depthA);
+        simd::Float4 depthStep = simd::Splat(triangle->depthA * 4.0f);
+        simd::Float4 startX = simd::Splat(static_cast<float>(minX)) + laneOffsets;
+
+        for (int y = minY; y <= maxY; y++) {
+            float centerY = y + 0.5f;
+            simd::Float4 edge[3];
+            for (int e = 0; e < 3; e++) {
+                edge[e] = edgeA[e] * startX + simd::Splat(triangle->edgeB[e] * centerY + triangle->edgeC[e]);
+            }
+            simd::Float4 z = depthA * startX + simd::Splat(triangle->depthB * centerY + triangle->depthC);
+
+            float* row = &depth[static_cast<size_t>(y) * width];
+            for (int x = minX; x <= maxX; x += 4) {
+                simd::Float4 inside = simd::And(simd::And(simd::LessEqual(zero, edge[0]), simd::LessEqual(zero, edge[1])),
+                                                simd::LessEqual(zero, edge[2]));
+                if (simd::MoveMask(inside) != 0) {
+                    simd::Float4 current = simd::Load(row + x);
+                    simd::Float4 written = simd::Max(current, simd::Max(z, depthMin));
+                    simd::Store(row + x, simd::Select(inside, written, current));
+                }
+                for (int e = 0; e < 3; e++) {
+                    edge[e] = edge[e] + edgeStep[e];
+                }
+                z = z + depthStep;
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelMatrix) const {
+    // Corners as one transformed corner plus the transformed box edges
+    glm::mat4 modelViewProjection = viewProjection * modelMatrix;
+    glm::vec4 origin = modelViewProjection * glm::vec4(boundsMin, 1.0f);
+    glm::vec4 edgeX = modelViewProjection[0] * (boundsMax.x - boundsMin.x);
+    glm::vec4 edgeY = modelViewProjection[1] * (boundsMax.y - boundsMin.y);
+    glm::vec4 edgeZ = modelViewProjection[2] * (boundsMax.z - boundsMin.z);
+    glm::vec4 corners[8] = {
+        origin, origin + edgeX, origin + edgeY, origin + edgeX + edgeY,
+        origin + edgeZ, origin + edgeX + edgeZ, origin + edgeY + edgeZ, origin + edgeX + edgeY + edgeZ,
+    };
+    uint32_t allOut = ~0u, anyOut = 0;
+    for (const glm::vec4& corner : corners) {
+        uint32_t code = outCode(corner);
+        code |= corner.z > corner.w ? kOutFar : 0u;
+        allOut &= code;
+        anyOut |= code;
+    }
+    if ((allOut & (kOutScreen | kOutFar)) != 0) {
+        return false;
+    }
+    if ((anyOut & kOutNear) != 0) {
+        return true;
+    }
+
+    float minX = static_cast<float>(width), maxX = 0.0f;
+    float minY = static_cast<float>(height), maxY = 0.0f;
+    float nearest = 0.0f;
+    for (const glm::vec4& corner : corners) {
+        float invW = 1.0f / corner.w;
+        float x = (corner.x * invW * 0.5f + 0.5f) * width;
+        float y = (corner.y * invW * 0.5f + 0.5f) * height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::max(nearest, invW);
+    }
+
+    // Every pixel the rectangle touches and one more ring. Coverage is sampled
+    // at pixel centers, so an occluder silhouette can claim up to a pixel it
+    // does not cover; the ring reaches an open pixel beyond it.
+    int pixelMinX = std::max(static_cast<int>(std::floor(minX)) - 1, 0);
+    int pixelMaxX = std::min(static_cast<int>(std::floor(maxX)) + 1, width - 1);
+    int pixelMinY = std::max(static_cast<int>(std::floor(minY)) - 1, 0);
+    int pixelMaxY = std::min(static_cast<int>(std::floor(maxY)) + 1, height - 1);
+    if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) {
+        return false;
+    }
+
+    simd::Float4 boxDepth = simd::Splat(nearest * (1.0f + kDepthBias));
+    int groupMinX = pixelMinX & ~3;
+    for (int y = pixelMinY; y <= pixelMaxY; y++) {
+        const float* row = &depth[static_cast<size_t>(y) * width];
+        for (int x = groupMinX; x <= pixelMaxX; x += 4) {
+            int firstLane = std::max(pixelMinX - x, 0);
+            int lastLane = std::min(pixelMaxX - x, 3);
+            int lanes = ((1 << (lastLane + 1)) - 1) & ~((1 << firstLane) - 1);
+            // Any pixel whose occluder is further than the box's nearest corner lets it show
+            if ((simd::MoveMask(simd::Less(simd::Load(row + x), boxDepth)) & lanes) != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionCuller::TestBoxes(const OccludeeBox* boxes, size_t count, uint8_t* visible) {
+    Clock::time_point start = Clock::now();
+    JobSystem::Get().ParallelFor(count, 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            visible[i] = IsVisible(boxes[i].boundsMin, boxes[i].boundsMax, *boxes[i].modelMatrix) ? 1 : 0;
+        }
+    });
+    size_t culled = 0;
+    for (size_t i = 0; i < count; i++) {
+        culled += visible[i] ? 0 : 1;
+    }
+    stats.tested += count;
+    stats.culled += culled;
+    stats.testMs += millisecondsSince(start);
+}
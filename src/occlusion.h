@@ -0,0 +1,110 @@
+#pragma once
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Low-poly stand-in used only for occlusion. It must lie inside the surface
+// it stands in for, or it will hide things that are visible.
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    bool Empty() const { return indices.empty(); }
+};
+
+// Box to test, in the space `modelMatrix` maps to world
+struct OccludeeBox {
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    const glm::mat4* modelMatrix = nullptr;
+};
+
+struct OcclusionStats {
+    size_t occluders = 0;
+    size_t triangles = 0;     // Occluder triangles that reached the depth buffer, after clipping
+    size_t tested = 0;
+    size_t culled = 0;        // Off screen or fully behind occluders
+    double rasterMs = 0.0;
+    double testMs = 0.0;
+};
+
+// Occlusion culling against a low-resolution depth buffer rasterized on the
+// CPU, so tests never wait on the GPU. Occluder triangles are transformed,
+// clipped and binned into screen tiles, then tiles are rasterized in parallel
+// four pixels at a time. The buffer holds 1/w, which interpolates linearly in
+// screen space; larger is closer. A box is hidden when every pixel its screen
+// rectangle touches holds an occluder closer than the box's nearest corner.
+class OcclusionCuller {
+public:
+    // Rounded up to whole tiles
+    OcclusionCuller(int width = 256, int height = 128);
+
+    // Clears the depth buffer and drops last frame's occluders
+    void Begin(const glm::mat4& viewProjection);
+    // The mesh is referenced, not copied, and must stay alive until Rasterize()
+    void AddOccluder(const OccluderMesh& mesh, const glm::mat4& modelMatrix);
+    void Rasterize();
+
+    // False when the box is off screen or hidden; boxes crossing the near plane are always visible
+    bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelMatrix) const;
+    // IsVisible over many boxes in parallel; visible[i] is 1 or 0
+    void TestBoxes(const OccludeeBox* boxes, size_t count, uint8_t* visible);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    // Row-major 1/w, bottom row first; 0 where nothing was drawn
+    const std::vector<float>& GetDepth() const { return depth; }
+    const OcclusionStats& GetStats() const { return stats; }
+
+private:
+    static constexpr int kTileWidth = 32;
+    static constexpr int kTileHeight = 16;
+    static constexpr size_t kVerticesPerJob = 1024;
+    static constexpr size_t kTrianglesPerJob = 512;
+
+    struct Occluder {
+        const OccluderMesh* mesh;
+        glm::mat4 modelViewProjection;
+        size_t firstVertex;     // Into clipVertices
+    };
+
+    // A range of one occluder's vertices or indices, handled by one job
+    struct Slice {
+        size_t occluder;
+        size_t first;
+        size_t count;
+    };
+
+    // Triangle set up for rasterization: three edge functions and the 1/w
+    // plane in pixel coordinates, and its clamped pixel bounds
+    struct ScreenTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        float depthMin;         // Furthest vertex; the plane is never written beyond it
+        int minX, minY, maxX, maxY;
+    };
+
+    struct SetupJob {
+        Slice indices;
+        std::vector<ScreenTriangle> triangles;
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    std::vector<float> depth;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+
+    std::vector<Occluder> occluders;
+    std::vector<Slice> vertexSlices;
+    std::vector<glm::vec4> clipVertices;
+    std::vector<uint32_t> clipCodes;
+    std::vector<SetupJob> setupJobs;
+    std::vector<std::vector<const ScreenTriangle*>> tileBins;
+    OcclusionStats stats;
+
+    void transformVertices(const Slice& slice);
+    void setupTriangles(SetupJob& job) const;
+    void addClipped(const glm::vec4* clip, int count, std::vector<ScreenTriangle>& out) const;
+    void rasterizeTile(int tile);
+};
@@ -0,0 +1,484 @@
+#include "particles.h"
+#include "gl_state.h"
+#include "entity.h"
+#include "job_system.h"
+#include "memory_tracker.h"
+#include "deletion_queue.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+using namespace simd;
+
+namespace {
+
+const char* kAssetName = "particles";
+const size_t kSimulateChunk = 4096;
+const int kDepthBins = 64;
+
+uint32_t packColor(float r, float g, float b, float a) {
+    auto channel = [](float value) {
+        return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+
+} // namespace
+
+EmitterSettings EmitterSettings::MuzzleFlash() {
+    EmitterSettings settings;
+    settings.material = ParticleMaterial::Additive;
+    settings.maxParticles = 128;
+    settings.lifetimeMin = 0.05f;
+    settings.lifetimeMax = 0.12f;
+    settings.velocity = glm::vec3(0.0f, 0.0f, 6.0f);
+    settings.velocitySpread = 1.5f;
+    settings.drag = 4.0f;
+    settings.sizeStart = 0.35f;
+    settings.sizeEnd = 0.05f;
+    settings.colorStart = glm::vec4(1.0f, 0.85f, 0.45f, 1.0f);
+    settings.colorEnd = glm::vec4(1.0f, 0.35f, 0.05f, 0.0f);
+    return settings;
+}
+
+EmitterSettings EmitterSettings::Smoke() {
+    EmitterSettings settings;
+    settings.material = ParticleMaterial::AlphaBlend;
+    settings.maxParticles = 2048;
+    settings.rate = 40.0f;
+    settings.lifetimeMin = 2.0f;
+    settings.lifetimeMax = 4.0f;
+    settings.spawnRadius = 0.05f;
+    settings.velocity = glm::vec3(0.0f, 0.6f, 0.0f);
+    settings.velocitySpread = 0.25f;
+    settings.acceleration = glm::vec3(0.0f, 0.3f, 0.0f);
+    settings.drag = 0.6f;
+    settings.sizeStart = 0.15f;
+    settings.sizeEnd = 1.2f;
+    settings.colorStart = glm::vec4(0.35f, 0.35f, 0.35f, 0.5f);
+    settings.colorEnd = glm::vec4(0.55f, 0.55f, 0.55f, 0.0f);
+    return settings;
+}
+
+EmitterSettings EmitterSettings::Explosion() {
+    EmitterSettings settings;
+    settings.material = ParticleMaterial::Additive;
+    settings.maxParticles = 4096;
+    settings.duration = 0.0f;  // Burst only; removed once the burst has burned out
+    settings.lifetimeMin = 0.3f;
+    settings.lifetimeMax = 0.9f;
+    settings.spawnRadius = 0.3f;
+    settings.velocitySpread = 8.0f;
+    settings.acceleration = glm::vec3(0.0f, -4.0f, 0.0f);
+    settings.drag = 3.0f;
+    settings.sizeStart = 0.6f;
+    settings.sizeEnd = 0.1f;
+    settings.colorStart = glm::vec4(1.0f, 0.9f, 0.5f, 1.0f);
+    settings.colorEnd = glm::vec4(0.8f, 0.2f, 0.05f, 0.0f);
+    return settings;
+}
+
+struct ParticleSystem::Emitter {
+    EmitterId id;
+    EmitterSettings settings;
+    const Entity* entity;
+    glm::mat4 transform;
+    float age = 0.0f;
+    float spawnAccumulator = 0.0f;
+    int pendingBurst = 0;
+    bool destroyed = false;
+    uint32_t rng;
+
+    // Structure-of-arrays pool; live particles are packed in [0, count)
+    size_t count = 0;
+    size_t capacity;
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> particleAge, inverseLifetime;
+
+    float Random() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return static_cast<float>(rng & 0xffffff) / static_cast<float>(0xffffff);
+    }
+
+    bool Finished() const {
+        bool expired = destroyed || (settings.duration >= 0.0f && age > settings.duration);
+        return expired && count == 0 && pendingBurst == 0;
+    }
+};
+
+ParticleSystem::ParticleSystem() {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &instanceVBO);
+
+    GLState::Get().BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    GLState::Get().BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ParticleSystem::~ParticleSystem() {
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteVertexArray(VAO);
+    queue.DeleteBuffer(instanceVBO, kAssetName, MemoryCategory::Vertex, instanceCapacity);
+    for (const auto& emitter : emitters) {
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::CPU,
+                                    emitter->capacity * 8 * sizeof(float));
+    }
+}
+
+EmitterId ParticleSystem::CreateEmitter(const EmitterSettings& settings, const Entity* attachTo, const glm::mat4& transform) {
+    auto emitter = std::make_unique<Emitter>();
+    emitter->id = nextId++;
+    emitter->settings = settings;
+    emitter->entity = attachTo;
+    emitter->transform = transform;
+    emitter->rng = 0x9e3779b9u ^ (emitter->id * 2654435761u);
+
+    // Pad to whole SIMD lanes so kernels never need a scalar tail
+    emitter->capacity = (static_cast<size_t>(std::max(settings.maxParticles, 1)) + 3) & ~static_cast<size_t>(3);
+    for (std::vector<float>* array : { &emitter->positionX, &emitter->positionY, &emitter->positionZ,
+                                       &emitter->velocityX, &emitter->velocityY, &emitter->velocityZ,
+                                       &emitter->particleAge, &emitter->inverseLifetime }) {
+        array->assign(emitter->capacity, 0.0f);
+    }
+    MemoryTracker::Get().Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::CPU, emitter->capacity * 8 * sizeof(float));
+
+    emitters.push_back(std::move(emitter));
+    return emitters.back()->id;
+}
+
+ParticleSystem::Emitter* ParticleSystem::find(EmitterId id) {
+    for (auto& emitter : emitters) {
+        if (emitter->id == id) {
+            return emitter.get();
+        }
+    }
+    return nullptr;
+}
+
+void ParticleSystem::DestroyEmitter(EmitterId id) {
+    if (Emitter* emitter = find(id)) {
+        emitter->destroyed = true;
+        emitter->entity = nullptr;
+    }
+}
+
+void ParticleSystem::Burst(EmitterId id, int count) {
+    if (Emitter* emitter = find(id)) {
+        emitter->pendingBurst += count;
+    }
+}
+
+void ParticleSystem::SetEmitterTransform(EmitterId id, const glm::mat4& transform) {
+    if (Emitter* emitter = find(id)) {
+        emitter->transform = transform;
+    }
+}
+
+void ParticleSystem::DetachEntity(const Entity* entity) {
+    for (auto& emitter : emitters) {
+        if (emitter->entity == entity) {
+            emitter->entity = nullptr;
+            emitter->destroyed = true;
+        }
+    }
+}
+
+void ParticleSystem::UpdateAttachments() {
+    for (auto& emitter : emitters) {
+        if (emitter->entity) {
+            emitter->transform = emitter->entity->GetRenderTransform().ToMatrix();
+        }
+    }
+}
+
+size_t ParticleSystem::GetLiveCount() const {
+    size_t total = 0;
+    for (const auto& emitter : emitters) {
+        total += emitter->count;
+    }
+    return total;
+}
+
+void ParticleSystem::spawn(Emitter& emitter, int count) {
+    const EmitterSettings& settings = emitter.settings;
+    glm::vec3 origin = glm::vec3(emitter.transform * glm::vec4(settings.offset, 1.0f));
+
+    // Velocities follow the emitter's orientation but not its scale
+    glm::mat3 rotation;
+    for (int i = 0; i < 3; i++) {
+        glm::vec3 axis = glm::vec3(emitter.transform[i]);
+        float length = glm::length(axis);
+        rotation[i] = length > 0.0f ? axis / length : glm::vec3(0.0f);
+    }
+    glm::vec3 baseVelocity = rotation * settings.velocity;
+
+    count = std::min(count, static_cast<int>(settings.maxParticles - emitter.count));
+    for (int n = 0; n < count; n++) {
+        size_t i = emitter.count++;
+        glm::vec3 jitter(emitter.Random() * 2.0f - 1.0f, emitter.Random() * 2.0f - 1.0f, emitter.Random() * 2.0f - 1.0f);
+        glm::vec3 spread(emitter.Random() * 2.0f - 1.0f, emitter.Random() * 2.0f - 1.0f, emitter.Random() * 2.0f - 1.0f);
+        glm::vec3 position = origin + jitter * settings.spawnRadius;
+        glm::vec3 velocity = baseVelocity + spread * settings.velocitySpread;
+        float lifetime = settings.lifetimeMin + (settings.lifetimeMax - settings.lifetimeMin) * emitter.Random();
+
+        emitter.positionX[i] = position.x;
+        emitter.positionY[i] = position.y;
+        emitter.positionZ[i] = position.z;
+        emitter.velocityX[i] = velocity.x;
+        emitter.velocityY[i] = velocity.y;
+        emitter.velocityZ[i] = velocity.z;
+        emitter.particleAge[i] = 0.0f;
+        emitter.inverseLifetime[i] = 1.0f / std::max(lifetime, 0.001f);
+    }
+}
+
+void ParticleSystem::simulate(Emitter& emitter, size_t begin, size_t end, float deltaTime) {
+    const EmitterSettings& settings = emitter.settings;
+    Float4 dt = Splat(deltaTime);
+    Float4 damping = Splat(std::max(1.0f - settings.drag * deltaTime, 0.0f));
+    Float4 accelerationX = Splat(settings.acceleration.x * deltaTime);
+    Float4 accelerationY = Splat(settings.acceleration.y * deltaTime);
+    Float4 accelerationZ = Splat(settings.acceleration.z * deltaTime);
+
+    for (size_t i = begin; i < end; i += 4) {
+        Float4 vx = Load(&emitter.velocityX[i]) * damping + accelerationX;
+        Float4 vy = Load(&emitter.velocityY[i]) * damping + accelerationY;
+        Float4 vz = Load(&emitter.velocityZ[i]) * damping + accelerationZ;
+        Store(&emitter.velocityX[i], vx);
+        Store(&emitter.velocityY[i], vy);
+        Store(&emitter.velocityZ[i], vz);
+        Store(&emitter.positionX[i], Load(&emitter.positionX[i]) + vx * dt);
+        Store(&emitter.positionY[i], Load(&emitter.positionY[i]) + vy * dt);
+        Store(&emitter.positionZ[i], Load(&emitter.positionZ[i]) + vz * dt);
+        Store(&emitter.particleAge[i], Load(&emitter.particleAge[i]) + dt);
+    }
+}
+
+void ParticleSystem::compact(Emitter& emitter) {
+    // Swap dead particles with the last live one; order does not matter
+    size_t i = 0;
+    while (i < emitter.count) {
+        if (emitter.particleAge[i] * emitter.inverseLifetime[i] < 1.0f) {
+            i++;
+            continue;
+        }
+        size_t last = --emitter.count;
+        emitter.positionX[i] = emitter.positionX[last];
+        emitter.positionY[i] = emitter.positionY[last];
+        emitter.positionZ[i] = emitter.positionZ[last];
+        emitter.velocityX[i] = emitter.velocityX[last];
+        emitter.velocityY[i] = emitter.velocityY[last];
+        emitter.velocityZ[i] = emitter.velocityZ[last];
+        emitter.particleAge[i] = emitter.particleAge[last];
+        emitter.inverseLifetime[i] = emitter.inverseLifetime[last];
+    }
+}
+
+void ParticleSystem::Update(float deltaTime) {
+    // Retire finished emitters
+    for (size_t i = 0; i < emitters.size();) {
+        if (emitters[i]->Finished()) {
+            MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::CPU,
+                                        emitters[i]->capacity * 8 * sizeof(float));
+            emitters[i] = std::move(emitters.back());
+            emitters.pop_back();
+        } else {
+            i++;
+        }
+    }
+    if (emitters.empty()) {
+        return;
+    }
+
+    JobSystem& jobs = JobSystem::Get();
+
+    // Spawn: each emitter has its own RNG, so emitters are independent
+    jobs.ParallelFor(emitters.size(), 8, [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; e++) {
+            Emitter& emitter = *emitters[e];
+            emitter.age += deltaTime;
+            int count = emitter.pendingBurst;
+            emitter.pendingBurst = 0;
+
+            bool emitting = !emitter.destroyed && (emitter.settings.duration < 0.0f || emitter.age <= emitter.settings.duration);
+            if (emitting && emitter.settings.rate > 0.0f) {
+                emitter.spawnAccumulator += emitter.settings.rate * deltaTime;
+                int continuous = static_cast<int>(emitter.spawnAccumulator);
+                emitter.spawnAccumulator -= continuous;
+                count += continuous;
+            }
+            if (count > 0) {
+                spawn(emitter, count);
+            }
+        }
+    });
+
+    // Simulate: split big pools so one large explosion still spreads over all workers
+    struct Chunk {
+        Emitter* emitter;
+        size_t begin, end;
+    };
+    std::vector<Chunk> chunks;
+    for (auto& emitter : emitters) {
+        size_t padded = (emitter->count + 3) & ~static_cast<size_t>(3);
+        for (size_t begin = 0; begin < padded; begin += kSimulateChunk) {
+            chunks.push_back({ emitter.get(), begin, std::min(begin + kSimulateChunk, padded) });
+        }
+    }
+    jobs.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            simulate(*chunks[c].emitter, chunks[c].begin, chunks[c].end, deltaTime);
+        }
+    });
+
+    jobs.ParallelFor(emitters.size(), 8, [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; e++) {
+            compact(*emitters[e]);
+        }
+    });
+}
+
+void ParticleSystem::Draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos) {
+    size_t materialCount = static_cast<size_t>(ParticleMaterial::Count);
+    size_t materialOffset[static_cast<size_t>(ParticleMaterial::Count) + 1] = {};
+    std::vector<size_t> emitterOffset(emitters.size());
+
+    // Instances are grouped by material so each material is one contiguous range
+    size_t total = 0;
+    for (size_t m = 0; m < materialCount; m++) {
+        materialOffset[m] = total;
+        for (size_t e = 0; e < emitters.size(); e++) {
+            if (static_cast<size_t>(emitters[e]->settings.material) == m) {
+                emitterOffset[e] = total;
+                total += emitters[e]->count;
+            }
+        }
+    }
+    materialOffset[materialCount] = total;
+    if (total == 0) {
+        return;
+    }
+    if (scratch.size() < total) {
+        scratch.resize(total);
+        sorted.resize(total);
+        bins.resize(total);
+    }
+
+    // Size and color are interpolated over each particle's normalized age
+    JobSystem::Get().ParallelFor(emitters.size(), 4, [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; e++) {
+            const Emitter& emitter = *emitters[e];
+            const EmitterSettings& settings = emitter.settings;
+            ParticleInstance* out = scratch.data() + emitterOffset[e];
+            Float4 one = Splat(1.0f);
+            Float4 sizeStart = Splat(settings.sizeStart), sizeDelta = Splat(settings.sizeEnd - settings.sizeStart);
+            Float4 colorStart[4], colorDelta[4];
+            for (int c = 0; c < 4; c++) {
+                colorStart[c] = Splat(settings.colorStart[c]);
+                colorDelta[c] = Splat(settings.colorEnd[c] - settings.colorStart[c]);
+            }
+
+            for (size_t i = 0; i < emitter.count; i += 4) {
+                Float4 t = Min(Load(&emitter.particleAge[i]) * Load(&emitter.inverseLifetime[i]), one);
+                float size[4], color[4][4];
+                Store(size, sizeStart + sizeDelta * t);
+                for (int c = 0; c < 4; c++) {
+                    Store(color[c], colorStart[c] + colorDelta[c] * t);
+                }
+                size_t lanes = std::min<size_t>(4, emitter.count - i);
+                for (size_t lane = 0; lane < lanes; lane++) {
+                    out[i + lane] = { emitter.positionX[i + lane], emitter.positionY[i + lane], emitter.positionZ[i + lane],
+                                      size[lane], packColor(color[0][lane], color[1][lane], color[2][lane], color[3][lane]) };
+                }
+            }
+        }
+    });
+
+    // Alpha blended particles: counting sort into depth bins, far to near
+    size_t alphaBegin = materialOffset[static_cast<size_t>(ParticleMaterial::AlphaBlend)];
+    size_t alphaEnd = materialOffset[static_cast<size_t>(ParticleMaterial::AlphaBlend) + 1];
+    if (alphaEnd > alphaBegin) {
+        glm::vec3 forward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+        float maxDepth = 1e-3f;
+        for (size_t i = alphaBegin; i < alphaEnd; i++) {
+            float depth = glm::dot(glm::vec3(scratch[i].x, scratch[i].y, scratch[i].z) - cameraPos, forward);
+            maxDepth = std::max(maxDepth, depth);
+        }
+        size_t counts[kDepthBins] = {};
+        float binScale = (kDepthBins - 1) / maxDepth;
+        for (size_t i = alphaBegin; i < alphaEnd; i++) {
+            float depth = glm::dot(glm::vec3(scratch[i].x, scratch[i].y, scratch[i].z) - cameraPos, forward);
+            int bin = kDepthBins - 1 - std::min(std::max(static_cast<int>(depth * binScale), 0), kDepthBins - 1);
+            bins[i] = static_cast<uint8_t>(bin);
+            counts[bin]++;
+        }
+        size_t cursor = alphaBegin;
+        for (int bin = 0; bin < kDepthBins; bin++) {
+            size_t binCount = counts[bin];
+            counts[bin] = cursor;
+            cursor += binCount;
+        }
+        for (size_t i = alphaBegin; i < alphaEnd; i++) {
+            sorted[counts[bins[i]]++] = scratch[i];
+        }
+        std::copy(sorted.begin() + alphaBegin, sorted.begin() + alphaEnd, scratch.begin() + alphaBegin);
+    }
+
+    // Stream this frame's instances; orphaning avoids waiting on last frame's draws
+    int64_t bytes = static_cast<int64_t>(total * sizeof(ParticleInstance));
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (bytes > instanceCapacity) {
+        int64_t newCapacity = std::max<int64_t>(bytes, instanceCapacity * 2);
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, instanceCapacity);
+        MemoryTracker::Get().Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, newCapacity);
+        instanceCapacity = newCapacity;
+    }
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, scratch.data());
+
+    shader.use();
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+
+    // Earlier passes leave blending off; restore whatever the caller had afterwards
+    GLState& state = GLState::Get();
+    bool blend = state.IsEnabled(GL_BLEND);
+    state.SetEnabled(GL_BLEND, true);
+    state.DepthMask(false);
+    state.BindVertexArray(VAO);
+
+    // Smoke first, then additive fire on top
+    const ParticleMaterial drawOrder[] = { ParticleMaterial::AlphaBlend, ParticleMaterial::Additive };
+    for (ParticleMaterial material : drawOrder) {
+        size_t m = static_cast<size_t>(material);
+        size_t count = materialOffset[m + 1] - materialOffset[m];
+        if (count == 0) {
+            continue;
+        }
+        size_t offset = materialOffset[m] * sizeof(ParticleInstance);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offset);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleInstance),
+                              (void*)(offset + offsetof(ParticleInstance, color)));
+
+        if (material == ParticleMaterial::Additive) {
+            state.BlendFunc(GL_SRC_ALPHA, GL_ONE);
+        } else {
+            state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.SetEnabled(GL_BLEND, blend);
+    state.DepthMask(true);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "shader.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+class Entity;
+
+using EmitterId = uint32_t;
+
+enum class ParticleMaterial { Additive, AlphaBlend, Count };
+
+struct EmitterSettings {
+    ParticleMaterial material = ParticleMaterial::AlphaBlend;
+    int maxParticles = 1024;          // Pool size, allocated once when the emitter is created
+    float rate = 0.0f;                // Particles per second
+    float duration = -1.0f;           // Seconds of continuous emission; negative emits forever
+    float lifetimeMin = 1.0f, lifetimeMax = 2.0f;
+    glm::vec3 offset = glm::vec3(0.0f);       // Spawn point in the attached entity's space
+    float spawnRadius = 0.0f;
+    glm::vec3 velocity = glm::vec3(0.0f);     // Entity space
+    float velocitySpread = 0.0f;
+    glm::vec3 acceleration = glm::vec3(0.0f); // World space, e.g. gravity or buoyancy
+    float drag = 0.0f;
+    float sizeStart = 0.1f, sizeEnd = 0.1f;
+    glm::vec4 colorStart = glm::vec4(1.0f), colorEnd = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+    static EmitterSettings MuzzleFlash();
+    static EmitterSettings Smoke();
+    static EmitterSettings Explosion();
+};
+
+// Particle effects for muzzle flashes, smoke and explosions. Each emitter owns
+// a fixed structure-of-arrays pool that is simulated four particles at a time
+// on the job system. Drawing streams one instance per particle into a shared
+// buffer and issues a single instanced billboard draw per material; alpha
+// blended particles are binned back to front by depth instead of fully sorted.
+class ParticleSystem {
+public:
+    ParticleSystem();
+    ~ParticleSystem();
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    // Emitters either follow an entity or sit at a fixed world transform
+    EmitterId CreateEmitter(const EmitterSettings& settings, const Entity* attachTo = nullptr,
+                            const glm::mat4& transform = glm::mat4(1.0f));
+    // Stops emission; the emitter is removed once its particles have died
+    void DestroyEmitter(EmitterId id);
+    void Burst(EmitterId id, int count);
+    void SetEmitterTransform(EmitterId id, const glm::mat4& transform);
+
+    // Entities are going away: their emitters stop and finish in place
+    void DetachEntity(const Entity* entity);
+    // Refresh transforms of attached emitters from the entities' render state;
+    // the caller must hold the lock that guards that state
+    void UpdateAttachments();
+
+    void Update(float deltaTime);
+    void Draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+
+    size_t GetLiveCount() const;
+
+private:
+    struct Emitter;
+
+    struct ParticleInstance {
+        float x, y, z, size;
+        uint32_t color;   // RGBA8
+    };
+
+    std::vector<std::unique_ptr<Emitter>> emitters;
+    EmitterId nextId = 1;
+
+    GLuint VAO = 0, instanceVBO = 0;
+    int64_t instanceCapacity = 0;   // Bytes allocated for instanceVBO
+    std::vector<ParticleInstance> scratch;
+    std::vector<ParticleInstance> sorted;
+    std::vector<uint8_t> bins;
+
+    Emitter* find(EmitterId id);
+    void spawn(Emitter& emitter, int count);
+    static void simulate(Emitter& emitter, size_t begin, size_t end, float deltaTime);
+    static void compact(Emitter& emitter);
+};
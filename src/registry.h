@@ -0,0 +1,156 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+
+// 32-bit reference to an entry of a Registry<T>: the low 20 bits index a slot,
+// the high 12 bits carry the slot's generation when the handle was issued.
+// Removing an entry bumps its slot's generation, so every handle still
+// pointing at it resolves to null instead of whatever reuses the slot. The
+// generation wraps after 4095 reuses of one slot. Zero is never issued.
+template <typename T>
+class Handle {
+public:
+    static const uint32_t kIndexBits = 20;
+    static const uint32_t kIndexMask = (1u << kIndexBits) - 1;
+    static const uint32_t kGenerationMask = (1u << (32 - kIndexBits)) - 1;
+
+    Handle() = default;
+    Handle(uint32_t index, uint32_t generation) : value((generation << kIndexBits) | index) {}
+
+    bool IsValid() const { return value != 0; }
+    uint32_t GetIndex() const { return value & kIndexMask; }
+    uint32_t GetGeneration() const { return value >> kIndexBits; }
+    uint32_t GetValue() const { return value; }
+
+    bool operator==(const Handle& other) const { return value == other.value; }
+    bool operator!=(const Handle& other) const { return value != other.value; }
+
+private:
+    uint32_t value = 0;
+};
+
+class ModelData;
+class ShaderVariants;
+class Entity;
+
+using ModelHandle = Handle<ModelData>;
+using ShaderHandle = Handle<ShaderVariants>;
+using EntityHandle = Handle<Entity>;
+
+// Owns resources in a dense array and hands out generational handles to them.
+// Get() is an index and a generation compare; names are only hashed by Add()
+// and Find(), so callers look a name up once and keep the handle. Entries never
+// move in memory while they are alive, but removal moves the last entry into
+// the hole, so dense order is not insertion order.
+template <typename T>
+class Registry {
+public:
+    using HandleType = Handle<T>;
+
+    // Replaces, and so invalidates the handles of, an entry with the same name.
+    // Returns the null handle once every index the handle can hold is in use.
+    HandleType Add(const std::string& name, std::unique_ptr<T> item) {
+        if (!name.empty()) {
+            Remove(Find(name));
+        }
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            // Index kIndexMask + 1 would spill into the generation bits
+            if (slots.size() > HandleType::kIndexMask) {
+                std::cout << "Error: Registry is full (" << slots.size() << " entries)" << std::endl;
+                return HandleType();
+            }
+            index = static_cast<uint32_t>(slots.size());
+            slots.push_back({ 0, 1 });
+        }
+        Slot& slot = slots[index];
+        slot.dense = static_cast<uint32_t>(items.size());
+        HandleType handle(index, slot.generation);
+        items.push_back(std::move(item));
+        handles.push_back(handle);
+        names.push_back(name);
+        if (!name.empty()) {
+            byName[name] = handle;
+        }
+        return handle;
+    }
+    HandleType Add(std::unique_ptr<T> item) { return Add(std::string(), std::move(item)); }
+
+    // False for stale handles. Constant time: the last entry moves into the hole.
+    bool Remove(HandleType handle) {
+        if (!Contains(handle)) {
+            return false;
+        }
+        Slot& slot = slots[handle.GetIndex()];
+        uint32_t dense = slot.dense;
+        if (!names[dense].empty()) {
+            byName.erase(names[dense]);
+        }
+        size_t last = items.size() - 1;
+        if (dense != last) {
+            items[dense] = std::move(items[last]);
+            handles[dense] = handles[last];
+            names[dense] = std::move(names[last]);
+            slots[handles[dense].GetIndex()].dense = dense;
+        }
+        items.pop_back();
+        handles.pop_back();
+        names.pop_back();
+
+        slot.generation = (slot.generation + 1) & HandleType::kGenerationMask;
+        if (slot.generation == 0) {
+            slot.generation = 1;
+        }
+        freeSlots.push_back(handle.GetIndex());
+        return true;
+    }
+
+    bool Contains(HandleType handle) const {
+        uint32_t index = handle.GetIndex();
+        return handle.IsValid() && index < slots.size() && slots[index].generation == handle.GetGeneration();
+    }
+    // Null for stale and null handles
+    T* Get(HandleType handle) const {
+        return Contains(handle) ? items[slots[handle.GetIndex()].dense].get() : nullptr;
+    }
+
+    // Null handle when no entry has the name
+    HandleType Find(const std::string& name) const {
+        auto it = byName.find(name);
+        return it != byName.end() ? it->second : HandleType();
+    }
+    const std::string& GetName(HandleType handle) const {
+        static const std::string empty;
+        return Contains(handle) ? names[slots[handle.GetIndex()].dense] : empty;
+    }
+
+    // Dense iteration; removals reorder it
+    size_t Size() const { return items.size(); }
+    T& operator[](size_t dense) const { return *items[dense]; }
+    HandleType GetHandle(size_t dense) const { return handles[dense]; }
+    // Position in the dense array, or Size() for stale handles
+    size_t GetDenseIndex(HandleType handle) const {
+        return Contains(handle) ? slots[handle.GetIndex()].dense : items.size();
+    }
+
+private:
+    struct Slot {
+        uint32_t dense;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<std::unique_ptr<T>> items;
+    std::vector<HandleType> handles;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, HandleType> byName;
+};
@@ -0,0 +1,784 @@
+#include "replication.h"
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint32_t kSnapshotHistory = 32;   // Baselines kept per client; older acks fall back to a full snapshot
+const size_t kMaxDatagram = 1500;
+const size_t kPacketHeaderBytes = 1 + 5 + 5 + 5 + 5;   // Type, sequence, baseline, tick, entry count
+const size_t kMaxClients = 64;
+
+const uint8_t kPacketSnapshot = 1;
+const uint8_t kPacketAck = 2;
+
+// Entry flags: removal, or new entity followed by the components that differ from the baseline
+const uint8_t kEntryRemoved = 1 << 0;
+const uint8_t kEntryNew = 1 << 1;
+const uint8_t kEntryPosition = 1 << 2;   // Three bits, one per axis
+const uint8_t kEntryRotation = 1 << 5;   // Three bits, one per axis
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+class PacketWriter {
+public:
+    explicit PacketWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void U8(uint8_t value) { out.push_back(value); }
+    void Varint(uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+    // Zigzag so small negative deltas stay small
+    void Signed(int32_t value) { Varint((static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31)); }
+    void Float(float value) {
+        uint8_t bytes[sizeof(float)];
+        std::memcpy(bytes, &value, sizeof(bytes));
+        out.insert(out.end(), bytes, bytes + sizeof(bytes));
+    }
+
+private:
+    std::vector<uint8_t>& out;
+};
+
+// Bounds-checked reader; any overrun marks the packet as malformed
+class PacketReader {
+public:
+    PacketReader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    bool Failed() const { return failed; }
+    bool AtEnd() const { return p == end; }
+
+    uint8_t U8() {
+        if (p >= end) {
+            failed = true;
+            return 0;
+        }
+        return *p++;
+    }
+    uint32_t Varint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = U8();
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+    int32_t Signed() {
+        uint32_t value = Varint();
+        return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+    float Float() {
+        if (end - p < static_cast<ptrdiff_t>(sizeof(float))) {
+            failed = true;
+            return 0.0f;
+        }
+        float value;
+        std::memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return value;
+    }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+    bool failed = false;
+};
+
+QuantizedEntity quantize(const ReplicatedEntity& entity, float positionStep) {
+    QuantizedEntity result;
+    result.id = entity.id;
+    result.type = entity.type;
+    const double limit = static_cast<double>(std::numeric_limits<int32_t>::max());
+    for (int axis = 0; axis < 3; axis++) {
+        double steps = std::round(static_cast<double>(entity.position[axis]) / positionStep);
+        result.position[axis] = static_cast<int32_t>(std::max(-limit, std::min(limit, steps)));
+        double turns = entity.rotation[axis] / 360.0;
+        turns -= std::floor(turns);
+        result.rotation[axis] = static_cast<uint16_t>(static_cast<uint32_t>(std::lround(turns * 65536.0)) & 0xffff);
+    }
+    return result;
+}
+
+ReplicatedEntity dequantize(const QuantizedEntity& entity, float positionStep) {
+    ReplicatedEntity result;
+    result.id = entity.id;
+    result.type = entity.type;
+    for (int axis = 0; axis < 3; axis++) {
+        result.position[axis] = entity.position[axis] * positionStep;
+        result.rotation[axis] = entity.rotation[axis] * (360.0f / 65536.0f);
+    }
+    return result;
+}
+
+bool sameState(const QuantizedEntity& a, const QuantizedEntity& b) {
+    return a.type == b.type &&
+           a.position[0] == b.position[0] && a.position[1] == b.position[1] && a.position[2] == b.position[2] &&
+           a.rotation[0] == b.rotation[0] && a.rotation[1] == b.rotation[1] && a.rotation[2] == b.rotation[2];
+}
+
+// One entry against its baseline; `base` is null for entities the client does not have
+void writeEntry(PacketWriter& writer, uint32_t previousId, const QuantizedEntity* base, const QuantizedEntity& state) {
+    QuantizedEntity zero;
+    bool isNew = !base || base->type != state.type;
+    const QuantizedEntity& from = isNew ? zero : *base;
+
+    uint8_t flags = isNew ? kEntryNew : 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (state.position[axis] != from.position[axis]) {
+            flags |= kEntryPosition << axis;
+        }
+        if (state.rotation[axis] != from.rotation[axis]) {
+            flags |= kEntryRotation << axis;
+        }
+    }
+
+    writer.Varint(state.id - previousId);
+    writer.U8(flags);
+    if (isNew) {
+        writer.Varint(state.type);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        if (flags & (kEntryPosition << axis)) {
+            // Wrapping difference, so any two positions have a delta
+            writer.Signed(static_cast<int32_t>(static_cast<uint32_t>(state.position[axis]) -
+                                               static_cast<uint32_t>(from.position[axis])));
+        }
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        if (flags & (kEntryRotation << axis)) {
+            writer.Signed(static_cast<int16_t>(static_cast<uint16_t>(state.rotation[axis] - from.rotation[axis])));
+        }
+    }
+}
+
+void writeRemoval(PacketWriter& writer, uint32_t previousId, uint32_t id) {
+    writer.Varint(id - previousId);
+    writer.U8(kEntryRemoved);
+}
+
+uint32_t bucketFor(int32_t cellX, int32_t cellZ) {
+    return static_cast<uint32_t>(cellX) * 73856093u ^ static_cast<uint32_t>(cellZ) * 19349663u;
+}
+
+} // namespace
+
+struct ReplicationServer::Client {
+    NetAddress address;
+    glm::vec3 viewer = glm::vec3(0.0f);
+    uint32_t nextSequence = 1;
+    uint32_t ackedSequence = 0;   // 0 until the first ack; snapshots are then sent in full
+    uint32_t lastHeardTick = 0;
+
+    // What the client holds after each sent snapshot, sorted by id; acked ones are baselines
+    struct SentView {
+        uint32_t sequence = 0;
+        std::vector<QuantizedEntity> entities;
+    };
+    SentView views[kSnapshotHistory];
+
+    // Accumulated priority of changed entities that did not fit the budget, sorted by id
+    std::vector<std::pair<uint32_t, float>> priorities;
+
+    // Per-tick scratch, kept to avoid reallocating
+    struct Change {
+        uint32_t id;
+        int32_t snapshotIndex;   // -1 for removals
+        int32_t baseIndex;       // -1 for entities new to the client
+        float priority;
+    };
+    std::vector<uint32_t> relevant;
+    std::vector<Change> changes;
+    std::vector<Change> selected;
+    std::vector<std::pair<uint32_t, float>> nextPriorities;
+    std::vector<uint8_t> scratch;
+    std::vector<uint8_t> packet;
+    size_t entitiesSent = 0;
+    size_t entitiesDeferred = 0;
+};
+
+ReplicationServer::ReplicationServer(const ReplicationSettings& settings) : settings(settings) {
+}
+
+ReplicationServer::~ReplicationServer() {
+    Stop();
+}
+
+bool ReplicationServer::Start() {
+    if (!socket.Open(settings.port)) {
+        return false;
+    }
+    std::cout << "Replication server listening on UDP port " << socket.GetPort() << std::endl;
+    return true;
+}
+
+void ReplicationServer::Stop() {
+    socket.Close();
+    clients.clear();
+}
+
+void ReplicationServer::Poll() {
+    uint8_t buffer[kMaxDatagram];
+    NetAddress from;
+    while (size_t size = socket.Receive(from, buffer, sizeof(buffer))) {
+        // Acks double as hellos and keep-alives: [type][acked sequence][viewer xyz]
+        PacketReader reader(buffer, size);
+        if (reader.U8() != kPacketAck) {
+            continue;
+        }
+        uint32_t ack = reader.Varint();
+        glm::vec3 viewer;
+        for (int axis = 0; axis < 3; axis++) {
+            viewer[axis] = reader.Float();
+        }
+        if (reader.Failed() || !std::isfinite(viewer.x) || !std::isfinite(viewer.y) || !std::isfinite(viewer.z)) {
+            continue;
+        }
+        // Untrusted: far-off viewers would overflow the cell coordinates in gatherRelevant
+        viewer = glm::clamp(viewer, glm::vec3(-settings.worldExtent), glm::vec3(settings.worldExtent));
+
+        auto it = std::find_if(clients.begin(), clients.end(),
+                               [&](const std::unique_ptr<Client>& c) { return c->address == from; });
+        if (it == clients.end()) {
+            if (clients.size() >= kMaxClients) {
+                continue;
+            }
+            clients.push_back(std::make_unique<Client>());
+            clients.back()->address = from;
+            it = clients.end() - 1;
+            std::cout << "Replication client connected from port " << from.port << std::endl;
+        }
+
+        Client& client = **it;
+        client.viewer = viewer;
+        client.lastHeardTick = currentTick;
+        // Only acks of snapshots still in the history can become the baseline
+        if (ack > client.ackedSequence && ack < client.nextSequence &&
+            client.views[ack % kSnapshotHistory].sequence == ack) {
+            client.ackedSequence = ack;
+        }
+    }
+}
+
+void ReplicationServer::SendSnapshots(uint32_t tick, const std::vector<ReplicatedEntity>& entities) {
+    currentTick = tick;
+    stats = ReplicationStats();
+
+    Clock::time_point captureStart = Clock::now();
+    capture(entities);
+    stats.captureMs = millisecondsSince(captureStart);
+
+    clients.erase(std::remove_if(clients.begin(), clients.end(), [&](const std::unique_ptr<Client>& client) {
+        if (tick - client->lastHeardTick <= settings.clientTimeoutTicks) {
+            return false;
+        }
+        std::cout << "Replication client on port " << client->address.port << " timed out" << std::endl;
+        return true;
+    }), clients.end());
+
+    // Clients only read the shared snapshot, so they encode in parallel
+    Clock::time_point encodeStart = Clock::now();
+    JobSystem::Get().ParallelFor(clients.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            encodeClient(*clients[i]);
+        }
+    });
+    stats.encodeMs = millisecondsSince(encodeStart);
+
+    for (const auto& client : clients) {
+        socket.Send(client->address, client->packet.data(), client->packet.size());
+        stats.bytesSent += client->packet.size();
+        stats.entitiesSent += client->entitiesSent;
+        stats.entitiesDeferred += client->entitiesDeferred;
+    }
+    stats.clients = clients.size();
+}
+
+void ReplicationServer::capture(const std::vector<ReplicatedEntity>& entities) {
+    JobSystem& jobs = JobSystem::Get();
+    snapshot.resize(entities.size());
+    jobs.ParallelFor(entities.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            snapshot[i] = quantize(entities[i], settings.positionStep);
+        }
+    });
+    auto byId = [](const QuantizedEntity& a, const QuantizedEntity& b) { return a.id < b.id; };
+    if (!std::is_sorted(snapshot.begin(), snapshot.end(), byId)) {
+        std::sort(snapshot.begin(), snapshot.end(), byId);
+    }
+
+    // Bucket the XZ grid cells with a counting sort, one bucket per entity rounded up to a power of two
+    uint32_t bucketCount = 1;
+    while (bucketCount < snapshot.size()) {
+        bucketCount <<= 1;
+    }
+    snapshotPositions.resize(snapshot.size());
+    entityBuckets.resize(snapshot.size());
+    jobs.ParallelFor(snapshot.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 position = dequantize(snapshot[i], settings.positionStep).position;
+            snapshotPositions[i] = position;
+            entityBuckets[i] = bucketFor(static_cast<int32_t>(std::floor(position.x / settings.cellSize)),
+                                         static_cast<int32_t>(std::floor(position.z / settings.cellSize))) & (bucketCount - 1);
+        }
+    });
+    bucketStarts.assign(bucketCount + 1, 0);
+    for (uint32_t bucket : entityBuckets) {
+        bucketStarts[bucket + 1]++;
+    }
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        bucketStarts[i + 1] += bucketStarts[i];
+    }
+    bucketEntries.resize(snapshot.size());
+    std::vector<uint32_t> cursor(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        bucketEntries[cursor[entityBuckets[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+void ReplicationServer::gatherRelevant(const glm::vec3& viewer, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (snapshot.empty()) {
+        return;
+    }
+    uint32_t mask = static_cast<uint32_t>(bucketStarts.size() - 2);
+    float radius = settings.relevanceRadius;
+    int32_t minX = static_cast<int32_t>(std::floor((viewer.x - radius) / settings.cellSize));
+    int32_t maxX = static_cast<int32_t>(std::floor((viewer.x + radius) / settings.cellSize));
+    int32_t minZ = static_cast<int32_t>(std::floor((viewer.z - radius) / settings.cellSize));
+    int32_t maxZ = static_cast<int32_t>(std::floor((viewer.z + radius) / settings.cellSize));
+    auto gatherBucket = [&](uint32_t bucket) {
+        for (uint32_t e = bucketStarts[bucket]; e < bucketStarts[bucket + 1]; e++) {
+            uint32_t index = bucketEntries[e];
+            glm::vec3 offset = snapshotPositions[index] - viewer;
+            if (glm::dot(offset, offset) <= radius * radius) {
+                out.push_back(index);
+            }
+        }
+    };
+    // A span with more cells than buckets would visit buckets repeatedly: scan each once instead
+    uint64_t cellCount = static_cast<uint64_t>(static_cast<int64_t>(maxX) - minX + 1) *
+                         static_cast<uint64_t>(static_cast<int64_t>(maxZ) - minZ + 1);
+    if (cellCount > mask + 1u) {
+        for (uint32_t bucket = 0; bucket <= mask; bucket++) {
+            gatherBucket(bucket);
+        }
+    } else {
+        for (int32_t x = minX; x <= maxX; x++) {
+            for (int32_t z = minZ; z <= maxZ; z++) {
+                gatherBucket(bucketFor(x, z) & mask);
+            }
+        }
+    }
+    // Cells sharing a bucket are visited once per cell
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+
+    // Crowded areas keep the nearest units, so per-client cost stays bounded
+    if (out.size() > settings.maxRelevantEntities) {
+        auto distance = [&](uint32_t index) {
+            glm::vec3 offset = snapshotPositions[index] - viewer;
+            return glm::dot(offset, offset);
+        };
+        std::nth_element(out.begin(), out.begin() + settings.maxRelevantEntities, out.end(),
+                         [&](uint32_t a, uint32_t b) { return distance(a) < distance(b); });
+        out.resize(settings.maxRelevantEntities);
+        std::sort(out.begin(), out.end());
+    }
+    // Sorted snapshot indices are in id order
+}
+
+void ReplicationServer::encodeClient(Client& client) {
+    using Change = Client::Change;
+    uint32_t sequence = client.nextSequence++;
+    client.entitiesSent = 0;
+    client.entitiesDeferred = 0;
+
+    // Delta against the newest snapshot the client acknowledged, if it is still in the history
+    static const std::vector<QuantizedEntity> kEmpty;
+    const std::vector<QuantizedEntity>* base = &kEmpty;
+    uint32_t baselineDelta = 0;
+    uint32_t acked = client.ackedSequence;
+    if (acked != 0 && sequence - acked < kSnapshotHistory && client.views[acked % kSnapshotHistory].sequence == acked) {
+        base = &client.views[acked % kSnapshotHistory].entities;
+        baselineDelta = sequence - acked;
+    }
+
+    // Walk the baseline, the relevant set and the carried priorities together, all sorted by id
+    gatherRelevant(client.viewer, client.relevant);
+    client.changes.clear();
+    client.nextPriorities.clear();
+    size_t b = 0, r = 0, p = 0;
+    auto carried = [&](uint32_t id) {
+        while (p < client.priorities.size() && client.priorities[p].first < id) {
+            p++;
+        }
+        return p < client.priorities.size() && client.priorities[p].first == id ? client.priorities[p].second : 0.0f;
+    };
+    while (b < base->size() || r < client.relevant.size()) {
+        if (b < base->size() && (r >= client.relevant.size() || (*base)[b].id < snapshot[client.relevant[r]].id)) {
+            // Destroyed or out of range; removals are tiny, so they go first
+            uint32_t id = (*base)[b].id;
+            client.changes.push_back({ id, -1, static_cast<int32_t>(b), 1000.0f + carried(id) });
+            b++;
+            continue;
+        }
+
+        uint32_t index = client.relevant[r];
+        const QuantizedEntity& state = snapshot[index];
+        bool inBase = b < base->size() && (*base)[b].id == state.id;
+        if (!inBase || !sameState((*base)[b], state)) {
+            // Near units and units that waited longer win the budget
+            float distance = glm::length(snapshotPositions[index] - client.viewer);
+            float weight = 1.0f - 0.9f * std::min(distance / settings.relevanceRadius, 1.0f);
+            client.changes.push_back({ state.id, static_cast<int32_t>(index), inBase ? static_cast<int32_t>(b) : -1,
+                                       carried(state.id) + weight });
+        }
+        if (inBase) {
+            b++;
+        }
+        r++;
+    }
+
+    // Fill the budget in priority order; entry sizes are bounded by encoding with an absolute id
+    std::sort(client.changes.begin(), client.changes.end(),
+              [](const Change& x, const Change& y) { return x.priority > y.priority; });
+    client.selected.clear();
+    size_t budget = settings.bytesPerClientTick > kPacketHeaderBytes ? settings.bytesPerClientTick - kPacketHeaderBytes : 0;
+    size_t used = 0;
+    for (const Change& change : client.changes) {
+        client.scratch.clear();
+        PacketWriter sizer(client.scratch);
+        if (change.snapshotIndex < 0) {
+            writeRemoval(sizer, 0, change.id);
+        } else {
+            writeEntry(sizer, 0, change.baseIndex >= 0 ? &(*base)[change.baseIndex] : nullptr, snapshot[change.snapshotIndex]);
+        }
+        if (used + client.scratch.size() <= budget) {
+            used += client.scratch.size();
+            client.selected.push_back(change);
+        } else {
+            client.nextPriorities.push_back({ change.id, change.priority });
+        }
+    }
+    std::sort(client.selected.begin(), client.selected.end(),
+              [](const Change& x, const Change& y) { return x.id < y.id; });
+    std::sort(client.nextPriorities.begin(), client.nextPriorities.end());
+    client.priorities.swap(client.nextPriorities);
+    client.entitiesSent = client.selected.size();
+    client.entitiesDeferred = client.priorities.size();
+
+    client.packet.clear();
+    PacketWriter writer(client.packet);
+    writer.U8(kPacketSnapshot);
+    writer.Varint(sequence);
+    writer.Varint(baselineDelta);
+    writer.Varint(currentTick);
+    writer.Varint(static_cast<uint32_t>(client.selected.size()));
+    uint32_t previousId = 0;
+    for (const Change& change : client.selected) {
+        if (change.snapshotIndex < 0) {
+            writeRemoval(writer, previousId, change.id);
+        } else {
+            writeEntry(writer, previousId, change.baseIndex >= 0 ? &(*base)[change.baseIndex] : nullptr,
+                       snapshot[change.snapshotIndex]);
+        }
+        previousId = change.id;
+    }
+
+    // Record what the client will hold once this arrives: the baseline with the selected changes applied
+    Client::SentView& view = client.views[sequence % kSnapshotHistory];
+    view.sequence = sequence;
+    view.entities.clear();
+    size_t s = 0;
+    for (b = 0; b < base->size() || s < client.selected.size();) {
+        if (s < client.selected.size() && (b >= base->size() || client.selected[s].id <= (*base)[b].id)) {
+            const Change& change = client.selected[s++];
+            if (change.snapshotIndex >= 0) {
+                view.entities.push_back(snapshot[change.snapshotIndex]);
+            }
+            if (b < base->size() && change.id == (*base)[b].id) {
+                b++;
+            }
+        } else {
+            view.entities.push_back((*base)[b++]);
+        }
+    }
+}
+
+ReplicationClient::ReplicationClient(const ReplicationSettings& settings) : settings(settings), views(kSnapshotHistory) {
+}
+
+ReplicationClient::~ReplicationClient() {
+    Disconnect();
+}
+
+bool ReplicationClient::Connect(const char* host, uint16_t port) {
+    if (!NetAddress::Parse(host, port, server)) {
+        std::cout << "Invalid replication server address: " << host << std::endl;
+        return false;
+    }
+    if (!socket.Open(0)) {
+        return false;
+    }
+    sendAck();   // Hello
+    return true;
+}
+
+void ReplicationClient::Disconnect() {
+    socket.Close();
+    for (auto& view : views) {
+        view.sequence = 0;
+        view.entities.clear();
+    }
+    latestSequence = 0;
+    entities.clear();
+}
+
+void ReplicationClient::Poll() {
+    if (!socket.IsOpen()) {
+        return;
+    }
+    uint8_t buffer[kMaxDatagram];
+    NetAddress from;
+    while (size_t size = socket.Receive(from, buffer, sizeof(buffer))) {
+        if (from != server) {
+            continue;
+        }
+        bytesReceived += size;
+        if (!applySnapshot(buffer, size)) {
+            std::cout << "Dropped malformed replication snapshot" << std::endl;
+        }
+    }
+    // Sent every poll, so it also serves as the keep-alive and viewer update
+    sendAck();
+}
+
+bool ReplicationClient::applySnapshot(const uint8_t* data, size_t size) {
+    PacketReader reader(data, size);
+    if (reader.U8() != kPacketSnapshot) {
+        return false;
+    }
+    uint32_t sequence = reader.Varint();
+    uint32_t baselineDelta = reader.Varint();
+    uint32_t tick = reader.Varint();
+    uint32_t entryCount = reader.Varint();
+    if (reader.Failed() || sequence == 0 || baselineDelta >= kSnapshotHistory) {
+        return false;
+    }
+
+    // The baseline must be a snapshot this client still holds
+    static const std::vector<QuantizedEntity> kEmpty;
+    const std::vector<QuantizedEntity>* base = &kEmpty;
+    if (baselineDelta != 0) {
+        uint32_t baseline = sequence - baselineDelta;
+        const ReceivedView& view = views[baseline % kSnapshotHistory];
+        if (view.sequence != baseline) {
+            return true;   // Baseline already overwritten; a later snapshot will use a newer one
+        }
+        base = &view.entities;
+    }
+
+    std::vector<QuantizedEntity> result;
+    result.reserve(base->size() + entryCount);
+    size_t b = 0;
+    uint32_t id = 0;
+    for (uint32_t e = 0; e < entryCount && !reader.Failed(); e++) {
+        id += reader.Varint();
+        uint8_t flags = reader.U8();
+        while (b < base->size() && (*base)[b].id < id) {
+            result.push_back((*base)[b++]);
+        }
+        bool inBase = b < base->size() && (*base)[b].id == id;
+        if (flags & kEntryRemoved) {
+            if (inBase) {
+                b++;
+            }
+            continue;
+        }
+
+        QuantizedEntity state;
+        if (flags & kEntryNew) {
+            state.type = static_cast<uint16_t>(reader.Varint());
+        } else if (inBase) {
+            state = (*base)[b];
+        } else {
+            return false;   // Delta against an entity the baseline does not have
+        }
+        state.id = id;
+        for (int axis = 0; axis < 3; axis++) {
+            if (flags & (kEntryPosition << axis)) {
+                state.position[axis] = static_cast<int32_t>(static_cast<uint32_t>(state.position[axis]) +
+                                                            static_cast<uint32_t>(reader.Signed()));
+            }
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            if (flags & (kEntryRotation << axis)) {
+                state.rotation[axis] = static_cast<uint16_t>(state.rotation[axis] + reader.Signed());
+            }
+        }
+        result.push_back(state);
+        if (inBase) {
+            b++;
+        }
+    }
+    if (reader.Failed() || !reader.AtEnd()) {
+        return false;
+    }
+    result.insert(result.end(), base->begin() + b, base->end());
+
+    // Keep it as a possible baseline, unless the slot already holds something newer
+    ReceivedView& slot = views[sequence % kSnapshotHistory];
+    if (slot.sequence < sequence) {
+        slot.sequence = sequence;
+        slot.entities = result;
+    }
+    if (sequence > latestSequence) {
+        latestSequence = sequence;
+        serverTick = tick;
+        entities.resize(result.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            entities[i] = dequantize(result[i], settings.positionStep);
+        }
+    }
+    return true;
+}
+
+void ReplicationClient::sendAck() {
+    std::vector<uint8_t> packet;
+    PacketWriter writer(packet);
+    writer.U8(kPacketAck);
+    writer.Varint(latestSequence);
+    for (int axis = 0; axis < 3; axis++) {
+        writer.Float(viewer[axis]);
+    }
+    socket.Send(server, packet.data(), packet.size());
+}
+
+int RunReplicationLoopback(size_t unitCount, size_t clientCount, uint32_t ticks) {
+    ReplicationSettings settings;
+    settings.port = 0;   // Ephemeral, so several harnesses can run at once
+
+    ReplicationServer server(settings);
+    if (!server.Start()) {
+        return 1;
+    }
+
+    // Constant density, one unit per 400 square meters, so the world grows with the unit count
+    std::mt19937 random(1337);
+    float side = std::sqrt(static_cast<float>(unitCount)) * 20.0f;
+    std::uniform_real_distribution<float> coordinate(-side * 0.5f, side * 0.5f);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::vector<ReplicatedEntity> units(unitCount);
+    std::vector<float> speeds(unitCount);
+    for (size_t i = 0; i < unitCount; i++) {
+        units[i].id = static_cast<uint32_t>(i + 1);
+        units[i].type = static_cast<uint16_t>(i % 3);
+        units[i].position = glm::vec3(coordinate(random), 0.0f, coordinate(random));
+        units[i].rotation = glm::vec3(0.0f, angle(random), 0.0f);
+        speeds[i] = (i % 10 < 3) ? 0.0f : 4.0f + static_cast<float>(i % 7);   // 30% parked
+    }
+
+    // Viewers stand still at spread-out unit start positions
+    std::vector<std::unique_ptr<ReplicationClient>> clients;
+    std::vector<glm::vec3> viewers;
+    for (size_t i = 0; i < clientCount; i++) {
+        clients.push_back(std::make_unique<ReplicationClient>(settings));
+        if (!clients.back()->Connect("127.0.0.1", server.GetPort())) {
+            return 1;
+        }
+        viewers.push_back(unitCount > 0 ? units[(i * 7919) % unitCount].position : glm::vec3(0.0f));
+        clients.back()->SetViewer(viewers.back());
+    }
+
+    std::cout << "Replication loopback: " << unitCount << " units, " << clientCount << " clients, "
+              << settings.bytesPerClientTick << " bytes per client tick" << std::endl;
+    const float tickDelta = 1.0f / 60.0f;
+    double totalBytes = 0.0, totalEncodeMs = 0.0, totalCaptureMs = 0.0;
+    uint32_t measuredTicks = 0;
+    uint32_t settleTicks = 240;
+    for (uint32_t tick = 1; tick <= ticks + settleTicks; tick++) {
+        // Units drive and turn slowly; they park for the settle phase so clients can converge
+        bool moving = tick <= ticks;
+        for (size_t i = 0; moving && i < unitCount; i++) {
+            ReplicatedEntity& unit = units[i];
+            if (speeds[i] == 0.0f) {
+                continue;
+            }
+            unit.rotation.y = std::fmod(unit.rotation.y + 20.0f * tickDelta, 360.0f);
+            float heading = glm::radians(unit.rotation.y);
+            unit.position += glm::vec3(std::sin(heading), 0.0f, std::cos(heading)) * speeds[i] * tickDelta;
+        }
+
+        server.Poll();
+        server.SendSnapshots(tick, units);
+        for (auto& client : clients) {
+            client->Poll();
+        }
+
+        const ReplicationStats& stats = server.GetStats();
+        if (moving && tick > 60) {
+            totalBytes += stats.bytesSent;
+            totalEncodeMs += stats.encodeMs;
+            totalCaptureMs += stats.captureMs;
+            measuredTicks++;
+        }
+        if (moving && tick % 120 == 0) {
+            size_t perClient = stats.clients > 0 ? stats.bytesSent / stats.clients : 0;
+            std::cout << "tick " << tick << ": " << stats.clients << " clients, " << perClient << " bytes/client, "
+                      << stats.entitiesSent << " updates sent, " << stats.entitiesDeferred << " deferred, capture "
+                      << stats.captureMs << " ms, encode " << stats.encodeMs << " ms" << std::endl;
+        }
+    }
+
+    // Every client should now hold exactly the units within its radius, at quantized precision
+    int failures = 0;
+    for (size_t i = 0; i < clients.size(); i++) {
+        const auto& received = clients[i]->GetEntities();
+        size_t expected = 0;
+        for (const auto& unit : units) {
+            glm::vec3 q = dequantize(quantize(unit, settings.positionStep), settings.positionStep).position;
+            glm::vec3 offset = q - viewers[i];
+            if (glm::dot(offset, offset) <= settings.relevanceRadius * settings.relevanceRadius) {
+                expected++;
+            }
+        }
+        expected = std::min(expected, settings.maxRelevantEntities);
+        size_t matched = 0;
+        for (const auto& entity : received) {
+            const ReplicatedEntity& unit = units[entity.id - 1];
+            if (glm::length(entity.position - unit.position) <= settings.positionStep && entity.type == unit.type) {
+                matched++;
+            }
+        }
+        if (matched != received.size() || received.size() != expected) {
+            std::cout << "Client mismatch: " << received.size() << " received, " << matched << " matched, "
+                      << expected << " expected" << std::endl;
+            failures++;
+        }
+    }
+
+    double ticksMeasured = std::max<uint32_t>(measuredTicks, 1);
+    std::cout << "Average per client tick: " << totalBytes / ticksMeasured / std::max<size_t>(clientCount, 1)
+              << " bytes, encode " << totalEncodeMs / ticksMeasured / std::max<size_t>(clientCount, 1)
+              << " ms; capture " << totalCaptureMs / ticksMeasured << " ms per tick" << std::endl;
+    std::cout << (failures == 0 ? "All clients converged" : "Some clients did not converge") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
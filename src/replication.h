@@ -0,0 +1,134 @@
+#pragma once
+#include "udp_socket.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Network view of one entity. Ids are stable for the entity's lifetime and
+// type tells the client which model to show.
+struct ReplicatedEntity {
+    uint32_t id = 0;
+    uint16_t type = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);   // Euler angles in degrees
+};
+
+struct ReplicationSettings {
+    uint16_t port = 27015;
+    float positionStep = 1.0f / 256.0f;    // Quantization of positions in world units
+    size_t bytesPerClientTick = 1200;      // Snapshot budget per client; one datagram under the MTU
+    float relevanceRadius = 250.0f;        // Entities further from a client's viewer are not sent
+    float cellSize = 50.0f;                // Grid used to find entities near a viewer
+    float worldExtent = 8192.0f;           // Reported viewers are clamped to this far from the origin per axis
+    size_t maxRelevantEntities = 1024;     // Nearest entities kept per client when the radius holds more
+    uint32_t clientTimeoutTicks = 300;     // Ticks without an ack before a client is dropped
+};
+
+struct ReplicationStats {
+    size_t clients = 0;
+    size_t bytesSent = 0;          // All clients, last tick
+    size_t entitiesSent = 0;       // Entity updates and removals written, last tick
+    size_t entitiesDeferred = 0;   // Changed but over budget, carried to a later tick
+    double captureMs = 0.0;        // Quantizing and indexing the snapshot, shared by all clients
+    double encodeMs = 0.0;         // Delta encoding for all clients
+};
+
+// Entity state quantized for the wire; equal states encode to nothing
+struct QuantizedEntity {
+    uint32_t id = 0;
+    uint16_t type = 0;
+    int32_t position[3] = { 0, 0, 0 };
+    uint16_t rotation[3] = { 0, 0, 0 };
+};
+
+// Server half of snapshot replication over UDP. Every tick the entity set is
+// quantized once, then each client gets a datagram that delta-encodes the
+// entities near its viewer against the last snapshot it acknowledged. Under
+// the per-client byte budget, changed entities go out in order of a priority
+// that grows each tick they wait and shrinks with distance, so far units
+// update less often but never starve. Per-client work only touches the
+// entities within its relevance radius, capped at maxRelevantEntities.
+class ReplicationServer {
+public:
+    ReplicationServer(const ReplicationSettings& settings = ReplicationSettings());
+    ~ReplicationServer();
+
+    bool Start();
+    void Stop();
+
+    // Accepts new clients and their acks; call once per tick before SendSnapshots
+    void Poll();
+    // Snapshots `entities` as tick `tick` and sends every client its delta
+    void SendSnapshots(uint32_t tick, const std::vector<ReplicatedEntity>& entities);
+
+    size_t GetClientCount() const { return clients.size(); }
+    uint16_t GetPort() const { return socket.GetPort(); }
+    const ReplicationStats& GetStats() const { return stats; }
+
+private:
+    struct Client;
+
+    ReplicationSettings settings;
+    UdpSocket socket;
+    std::vector<std::unique_ptr<Client>> clients;
+    ReplicationStats stats;
+    uint32_t currentTick = 0;
+
+    // This tick's snapshot, sorted by id, and a grid over it. Grid cells are
+    // hashed into buckets; entities of colliding cells fail the distance test.
+    std::vector<QuantizedEntity> snapshot;
+    std::vector<glm::vec3> snapshotPositions;
+    std::vector<uint32_t> entityBuckets;
+    std::vector<uint32_t> bucketStarts;   // Offsets into bucketEntries, one past the end for the last bucket
+    std::vector<uint32_t> bucketEntries;  // Snapshot indices grouped by bucket
+
+    void capture(const std::vector<ReplicatedEntity>& entities);
+    void gatherRelevant(const glm::vec3& viewer, std::vector<uint32_t>& out) const;
+    void encodeClient(Client& client);
+};
+
+// Client half: applies snapshots on top of the baseline the server used,
+// acks them and reports the viewer position used for relevance.
+class ReplicationClient {
+public:
+    ReplicationClient(const ReplicationSettings& settings = ReplicationSettings());
+    ~ReplicationClient();
+
+    bool Connect(const char* host, uint16_t port);
+    void Disconnect();
+
+    void SetViewer(const glm::vec3& position) { viewer = position; }
+    // Applies every snapshot that arrived and acks the newest
+    void Poll();
+
+    // Latest replicated state, dequantized, sorted by id
+    const std::vector<ReplicatedEntity>& GetEntities() const { return entities; }
+    uint32_t GetServerTick() const { return serverTick; }
+    size_t GetBytesReceived() const { return bytesReceived; }
+
+private:
+    struct ReceivedView {
+        uint32_t sequence = 0;
+        std::vector<QuantizedEntity> entities;
+    };
+
+    ReplicationSettings settings;
+    UdpSocket socket;
+    NetAddress server;
+    glm::vec3 viewer = glm::vec3(0.0f);
+
+    std::vector<ReceivedView> views;   // Ring of recent snapshots, the baselines the server may use
+    uint32_t latestSequence = 0;
+    uint32_t serverTick = 0;
+    size_t bytesReceived = 0;
+    std::vector<ReplicatedEntity> entities;
+
+    bool applySnapshot(const uint8_t* data, size_t size);
+    void sendAck();
+};
+
+// Runs a server and `clientCount` clients over 127.0.0.1 with `unitCount`
+// synthetic moving units. Prints bytes per tick and encode time, and checks
+// that every client converges on the server state. Returns a process exit code.
+int RunReplicationLoopback(size_t unitCount, size_t clientCount, uint32_t ticks);
@@ -1,18 +1,49 @@
 #include "scene.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "deletion_queue.h"
+#include "debug_draw.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
 
 Scene::Scene() : aspectRatio(800.0f/600.0f) {
-    projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 1000.0f);
+    projection = glm::perspective(glm::radians(45.0f), aspectRatio, nearPlane, farPlane);
 }
 
-void Scene::AddShader(const std::string& name, const char* vertPath, const char* fragPath) {
+Scene::~Scene() {
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteTexture(jointTexture, "scene/joints", 0);
+    queue.DeleteBuffer(jointBuffer, "scene/joints", MemoryCategory::Vertex, jointBufferBytes);
+}
+
+ShaderHandle Scene::AddShader(const std::string& name, const char* vertPath, const char* fragPath, uint32_t features) {
     std::cout << "Adding shader: " << name << " from: " << vertPath << " and " << fragPath << std::endl;
-    shaders[name] = std::make_unique<Shader>(vertPath, fragPath);
+    auto shader = std::make_unique<ShaderVariants>(vertPath, fragPath, features);
+    std::lock_guard<std::mutex> simLock(simMutex);
+    ShaderHandle handle = shaders.Add(name, std::move(shader));
+    if (name == "background") {
+        backgroundShader = handle;
+    } else if (name == "standard") {
+        litShader = handle;
+    } else if (name == "terrain") {
+        terrainShader = handle;
+    } else if (name == "edges") {
+        edgeShader = handle;
+    } else if (name == "particles") {
+        particleShader = handle;
+    }
+    return handle;
 }
 
-void Scene::AddModel(const std::string& name, const char* path) {
+ModelHandle Scene::AddModel(const std::string& name, const char* path) {
     std::cout << "Adding model: " << name << " from path: " << path << std::endl;
-    models[name] = std::make_unique<Model>(path);
+    return AddModel(name, std::make_unique<Model>(path));
+}
+
+ModelHandle Scene::AddModel(const std::string& name, std::unique_ptr<Model> model) {
+    return World::AddModel(name, std::move(model));
 }
 
 Entity* Scene::CreateEntity(const std::string& modelName, const std::string& shaderName,
@@ -20,66 +51,345 @@ Entity* Scene::CreateEntity(const std::string& modelName, const std::string& sha
                           const glm::vec3& scale) {
     std::cout << "Creating entity with model: " << modelName << " and shader: " << shaderName << std::endl;
     
-    auto model = models.find(modelName);
-    auto shader = shaders.find(shaderName);
+    ModelHandle model = models.Find(modelName);
+    ShaderHandle shader = shaders.Find(shaderName);
     
-    if (model == models.end()) {
+    if (!model.IsValid()) {
         std::cout << "Error: Model '" << modelName << "' not found!" << std::endl;
         return nullptr;
     }
-    if (shader == shaders.end()) {
+    if (!shader.IsValid()) {
         std::cout << "Error: Shader '" << shaderName << "' not found!" << std::endl;
         return nullptr;
     }
-    
-    entities.push_back(std::make_unique<Entity>(
-        model->second.get(),
-        shader->second.get(),
-        position, rotation, scale
-    ));
-    return entities.back().get();
+    return CreateEntity(model, shader, position, rotation, scale);
+}
+
+Entity* Scene::CreateEntity(ModelHandle model, ShaderHandle shader,
+                          const glm::vec3& position, const glm::vec3& rotation,
+                          const glm::vec3& scale) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    std::lock_guard<std::mutex> stateLock(stateMutex);
+    if (!shaders.Contains(shader)) {
+        std::cout << "Error: Stale shader handle for new entity" << std::endl;
+        return nullptr;
+    }
+    return createEntity(model, shader, position, rotation, scale);
+}
+
+void Scene::onDestroyEntity(Entity& entity) {
+    particles.DetachEntity(&entity);
+    if (entity.IsStatic()) {
+        staticBatches.Remove(entity);
+    }
+}
+
+void Scene::SetStatic(Entity* entity, bool isStatic) {
+    std::lock_guard<std::mutex> stateLock(stateMutex);
+    if (entity->IsStatic() == isStatic) {
+        return;
+    }
+    entity->SetStatic(isStatic);
+    // Chunks are drawn by the indirect renderer, so only its entities are merged
+    if (!isStatic) {
+        staticBatches.Remove(*entity);
+    } else if (entity->GetShader() == litShader) {
+        staticBatches.Add(*entity);
+    }
+}
+
+void Scene::SetTerrain(std::unique_ptr<Terrain> newTerrain) {
+    terrain = std::move(newTerrain);
+    SetHeightfield(terrain ? terrain->GetHeightfield() : nullptr);
+}
+
+void Scene::UpdateEffects(float deltaTime) {
+    {
+        // Emitters follow the latest published entity transforms
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        particles.UpdateAttachments();
+    }
+    particles.Update(deltaTime);
+    lights.Update(deltaTime);
+
+    // Animators are independent, so a frame's worth of units evaluate in parallel
+    JobSystem::Get().ParallelFor(entities.Size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (Animator* animator = entities[i].GetAnimator()) {
+                animator->Advance(deltaTime);
+            }
+        }
+    });
+}
+
+void Scene::uploadJoints() {
+    jointMatrices.clear();
+    jointOffsets.assign(entities.Size(), -1);
+    for (size_t i = 0; i < entities.Size(); i++) {
+        if (const Animator* animator = entities[i].GetAnimator()) {
+            jointOffsets[i] = static_cast<int>(jointMatrices.size());
+            const auto& palette = animator->GetPalette();
+            jointMatrices.insert(jointMatrices.end(), palette.begin(), palette.end());
+        }
+    }
+    if (jointMatrices.empty()) {
+        return;
+    }
+
+    if (jointBuffer == 0) {
+        glGenBuffers(1, &jointBuffer);
+        glGenTextures(1, &jointTexture);
+    }
+
+    // Orphan and refill; the texture view is re-pointed only when the storage grows
+    int64_t bytes = static_cast<int64_t>(jointMatrices.size() * sizeof(glm::mat4));
+    glBindBuffer(GL_TEXTURE_BUFFER, jointBuffer);
+    bool grown = bytes > jointBufferBytes;
+    if (grown) {
+        int64_t newCapacity = std::max<int64_t>(bytes, jointBufferBytes * 2);
+        MemoryTracker::Get().Remove("scene/joints", MemoryCategory::Vertex, MemoryDomain::GPU, jointBufferBytes);
+        MemoryTracker::Get().Add("scene/joints", MemoryCategory::Vertex, MemoryDomain::GPU, newCapacity);
+        jointBufferBytes = newCapacity;
+    }
+    glBufferData(GL_TEXTURE_BUFFER, jointBufferBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, jointMatrices.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    GLState::Get().BindTexture(kJointTextureUnit, GL_TEXTURE_BUFFER, jointTexture);
+    if (grown) {
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, jointBuffer);
+    }
+    GLState::Get().ActiveTexture(0);
+}
+
+void Scene::cullOccluded(const glm::mat4& view, const glm::vec3& cameraPos) {
+    occlusion.Begin(projection * view);
+    if (terrain) {
+        terrain->BuildOccluder(cameraPos, kTerrainOccluderRadius, terrainOccluder);
+        occlusion.AddOccluder(terrainOccluder, glm::mat4(1.0f));
+    }
+    for (size_t i : drawOrder) {
+        occlusion.AddOccluder(drawModels[i]->GetOccluder(), drawMatrices[i]);
+    }
+    occlusion.Rasterize();
+
+    // Model bounds against the depth buffer; hidden entities drop out of every pass below
+    occludeeBoxes.resize(drawOrder.size());
+    occludeeVisible.resize(drawOrder.size());
+    for (size_t j = 0; j < drawOrder.size(); j++) {
+        const Model* model = drawModels[drawOrder[j]];
+        occludeeBoxes[j].boundsMin = model->GetBoundsMin();
+        occludeeBoxes[j].boundsMax = model->GetBoundsMax();
+        occludeeBoxes[j].modelMatrix = &drawMatrices[drawOrder[j]];
+    }
+    occlusion.TestBoxes(occludeeBoxes.data(), occludeeBoxes.size(), occludeeVisible.data());
+    if (debugBounds) {
+        for (size_t j = 0; j < occludeeBoxes.size(); j++) {
+            DebugDraw::Get().Box(*occludeeBoxes[j].modelMatrix, occludeeBoxes[j].boundsMin, occludeeBoxes[j].boundsMax,
+                                 occludeeVisible[j] ? glm::vec4(0.2f, 1.0f, 0.2f, 1.0f) : glm::vec4(1.0f, 0.2f, 0.2f, 1.0f));
+        }
+    }
+    size_t kept = 0;
+    for (size_t j = 0; j < drawOrder.size(); j++) {
+        if (occludeeVisible[j]) {
+            drawOrder[kept++] = drawOrder[j];
+        }
+    }
+    drawOrder.resize(kept);
 }
 
-void Scene::Update(float deltaTime) {
-    // Update scene logic here
+uint32_t Scene::drawFeatures(const Model& model, const glm::mat4& matrix, int jointOffset) {
+    uint32_t features = model.GetShaderFeatures();
+    if (jointOffset < 0) {
+        features &= ~ShaderFeature::Skinned;
+    }
+    // Transforms are rotation times scale, so equal column lengths mean one scale factor.
+    // Joint palettes may scale on their own, so skinned draws keep the inverse transpose.
+    float x = glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0]));
+    float y = glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1]));
+    float z = glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]));
+    float tolerance = 1e-4f * std::max(x, std::max(y, z));
+    if (!(features & ShaderFeature::Skinned) && std::fabs(x - y) <= tolerance && std::fabs(x - z) <= tolerance) {
+        features |= ShaderFeature::UniformScale;
+    }
+    return features;
 }
 
-void Scene::Draw(const Camera& camera) {
+void Scene::Draw(const Camera& camera, float alpha) {
     glm::mat4 view = camera.GetViewMatrix();
     glm::vec3 cameraPos = camera.GetPosition();
     
     // Update viewport dimensions
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    int viewport[4];
+    GLState::Get().GetViewport(viewport);
     aspectRatio = static_cast<float>(viewport[2]) / viewport[3];
-    projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 1000.0f);
+    projection = glm::perspective(glm::radians(45.0f), aspectRatio, nearPlane, farPlane);
+    lights.Build(view, projection, nearPlane, farPlane, viewport[2], viewport[3]);
+    
+    // Snapshot interpolated transforms so the simulation can keep ticking while we submit
+    {
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        drawMatrices.resize(entities.Size());
+        drawModels.resize(entities.Size());
+        for (size_t i = 0; i < entities.Size(); i++) {
+            drawMatrices[i] = entities[i].GetInterpolatedModelMatrix(alpha);
+            drawModels[i] = GetModel(entities[i].GetModel());
+        }
+        staticBatches.Update(entities, [this](ModelHandle model) -> const Model* { return GetModel(model); });
+    }
+    size_t entityCount = drawMatrices.size();
+    for (Model* chunk : staticBatches.GetChunks()) {
+        drawMatrices.push_back(glm::mat4(1.0f));
+        drawModels.push_back(chunk);
+    }
+    uploadJoints();
+    jointOffsets.resize(drawModels.size(), -1);
+    MaterialTable& materialTable = MaterialTable::Get();
+    materialTable.Upload();
+    
+    // Texture streaming: request mips from each entity's projected screen size.
+    // Batched entities keep requesting for their model, whose textures their chunk uses.
+    float pixelsPerUnit = viewport[3] / std::tan(glm::radians(45.0f) * 0.5f);
+    ShaderVariants* background = shaders.Get(backgroundShader);
+    for (size_t i = 0; i < entityCount; i++) {
+        Entity& entity = entities[i];
+        Model* model = drawModels[i];
+        if (!model) {
+            continue;
+        }
+        if (entity.GetShader() == backgroundShader) {
+            // Camera-locked backdrop always fills the view
+            model->RequestTextureDetail(static_cast<float>(viewport[3]));
+            continue;
+        }
+        const glm::mat4& matrix = drawMatrices[i];
+        float scale = std::max(glm::length(glm::vec3(matrix[0])),
+                               std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+        float radius = model->GetBoundingRadius() * scale;
+        float distance = std::max(glm::length(glm::vec3(drawMatrices[i][3]) - cameraPos), 0.01f);
+        model->RequestTextureDetail(radius / distance * pixelsPerUnit);
+    }
     
     // Draw background entities first with special depth settings
-    glDepthMask(GL_FALSE);  // Don't write to depth buffer
-    for (const auto& entity : entities) {
-        auto shader = entity->GetShader();
-        if (shader->ID == shaders["background"]->ID) {
-            // Update background position to match camera
-            entity->SetPosition(cameraPos);
+    GLState::Get().DepthMask(false);  // Don't write to depth buffer
+    for (size_t i = 0; i < entityCount; i++) {
+        Entity& entity = entities[i];
+        if (background && drawModels[i] && entity.GetShader() == backgroundShader) {
+            // Background follows the camera; this is render-only and never touches sim state
+            Transform backgroundTransform = entity.GetRenderTransform();
+            backgroundTransform.position = cameraPos;
+            glm::mat4 matrix = backgroundTransform.ToMatrix();
             
-            shader->use();
-            shader->setMat4("projection", projection);
-            shader->setMat4("view", view);
-            shader->setVec3("viewPos", cameraPos);
-            entity->Draw();
+            Shader& shader = background->Get(drawFeatures(*drawModels[i], matrix, jointOffsets[i]));
+            materialTable.Bind(shader);
+            shader.setMat4("projection", projection);
+            shader.setMat4("view", view);
+            shader.setVec3("viewPos", cameraPos);
+            shader.setInt("jointMatrices", kJointTextureUnit);
+            shader.setMat4("model", matrix);
+            shader.setInt("jointOffset", jointOffsets[i]);
+            drawModels[i]->Draw(shader);
         }
     }
-    glDepthMask(GL_TRUE);  // Re-enable depth writing
+    GLState::Get().DepthMask(true);  // Re-enable depth writing
     
-    // Then draw other entities
-    for (const auto& entity : entities) {
-        auto shader = entity->GetShader();
-        if (shader->ID != shaders["background"]->ID) {
-            shader->use();
-            shader->setMat4("projection", projection);
-            shader->setMat4("view", view);
-            shader->setVec3("viewPos", cameraPos);
-            entity->Draw();
+    // Terrain next, so it occludes whatever lies behind hills
+    ShaderVariants* terrainVariants = shaders.Get(terrainShader);
+    if (terrain && terrainVariants) {
+        Shader& shader = terrainVariants->Get();
+        lights.Bind(shader);
+        terrain->Draw(shader, view, projection, cameraPos);
+    }
+    
+    // Then draw other entities, grouped so consecutive draws share program and texture arrays
+    drawOrder.clear();
+    for (size_t i = 0; i < entityCount; i++) {
+        if (drawModels[i] && !entities[i].IsBatched() && entities[i].GetShader() != backgroundShader &&
+            shaders.Contains(entities[i].GetShader())) {
+            drawOrder.push_back(i);
+        }
+    }
+    if (shaders.Contains(litShader)) {
+        for (size_t i = entityCount; i < drawModels.size(); i++) {
+            drawOrder.push_back(i);
+        }
+    }
+    if (occlusionCulling) {
+        cullOccluded(view, cameraPos);
+    }
+
+    // Lit entities and static chunks go to the indirect renderer, which culls and draws
+    // them in a few multi-draws; anything with its own shader is drawn one by one. Every
+    // draw uses the permutation of its shader with just the features it needs.
+    ShaderVariants* lit = shaders.Get(litShader);
+    drawVariants.resize(drawModels.size());
+    indirect.Begin();
+    size_t kept = 0;
+    for (size_t i : drawOrder) {
+        uint32_t features = drawFeatures(*drawModels[i], drawMatrices[i], jointOffsets[i]);
+        if (i >= entityCount || entities[i].GetShader() == litShader) {
+            indirect.Add(drawModels[i], drawMatrices[i], jointOffsets[i], features);
+        } else {
+            drawVariants[i] = &shaders.Get(entities[i].GetShader())->Get(features);
+            drawOrder[kept++] = i;
         }
     }
+    drawOrder.resize(kept);
+    if (lit) {
+        indirect.Draw(*lit, [&](Shader& shader) {
+            lights.Bind(shader);
+            materialTable.Bind(shader);
+            shader.setMat4("projection", projection);
+            shader.setMat4("view", view);
+            shader.setVec3("viewPos", cameraPos);
+            shader.setInt("jointMatrices", kJointTextureUnit);
+        }, projection * view, cameraPos);
+    }
+
+    std::sort(drawOrder.begin(), drawOrder.end(), [&](size_t a, size_t b) {
+        GLuint programA = drawVariants[a]->ID, programB = drawVariants[b]->ID;
+        if (programA != programB) {
+            return programA < programB;
+        }
+        return materialTable.GetBindingKey(drawModels[a]->GetMaterialId()) <
+               materialTable.GetBindingKey(drawModels[b]->GetMaterialId());
+    });
+    GLuint currentProgram = 0;
+    for (size_t i : drawOrder) {
+        Shader& shader = *drawVariants[i];
+        if (shader.ID != currentProgram) {
+            currentProgram = shader.ID;
+            shader.use();
+            shader.setMat4("projection", projection);
+            shader.setMat4("view", view);
+            shader.setVec3("viewPos", cameraPos);
+            shader.setInt("jointMatrices", kJointTextureUnit);
+        }
+        shader.setMat4("model", drawMatrices[i]);
+        shader.setInt("jointOffset", jointOffsets[i]);
+        drawModels[i]->Draw(shader);
+    }
+    
+    // Outline pass: precomputed feature edges of the lit entities drawn as lines over the shaded meshes
+    if (ShaderVariants* edges = shaders.Get(edgeShader)) {
+        Shader& shader = edges->Get();
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setInt("jointMatrices", kJointTextureUnit);
+        
+        GLState::Get().DepthFunc(GL_LEQUAL);
+        indirect.DrawEdges(shader);
+        GLState::Get().DepthFunc(GL_LESS);
+    }
+    
+    // Skybox after every opaque pass, so early depth testing skips the covered pixels
+    if (skybox) {
+        skybox->Draw(view, projection);
+    }
+    
+    // Particles last: they test against the scene's depth but never write it
+    if (ShaderVariants* particleVariants = shaders.Get(particleShader)) {
+        particles.Draw(particleVariants->Get(), view, projection, cameraPos);
+    }
 } 
\ No newline at end of file
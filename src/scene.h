@@ -1,33 +1,133 @@
 #pragma once
-#include "entity.h"
+#include "world.h"
+#include "model.h"
 #include "camera.h"
+#include "terrain.h"
+#include "background.h"
+#include "particles.h"
+#include "lights.h"
+#include "occlusion.h"
+#include "indirect_draw.h"
+#include "static_batch.h"
+#include "registry.h"
 #include <vector>
 #include <memory>
-#include <unordered_map>
 #include <string>
 
-class Scene {
+// A World with everything needed to draw it: uploaded models, shaders,
+// terrain, effects and the render passes. The simulation itself (Update,
+// movement, collision, ray casts) is World's and runs the same headless.
+class Scene : public World {
 public:
     Scene();
-    
-    // Resource management
-    void AddShader(const std::string& name, const char* vertPath, const char* fragPath);
-    void AddModel(const std::string& name, const char* path);
-    
+    ~Scene();
+
+    // Resource management. Names are looked up once here; keep the returned
+    // handles rather than resolving names per frame.
+    // features: the ShaderFeature flags the sources understand; each draw gets the
+    // permutation with just the ones its model and transform need
+    ShaderHandle AddShader(const std::string& name, const char* vertPath, const char* fragPath, uint32_t features = 0);
+    // Scenes only hold uploaded models, never bare ModelData. Entities still
+    // using a removed model stop drawing until destroyed.
+    ModelHandle AddModel(const std::string& name, const char* path);
+    ModelHandle AddModel(const std::string& name, std::unique_ptr<Model> model);
+    ShaderHandle FindShader(const std::string& name) const { return shaders.Find(name); }
+    // Null for stale handles
+    Model* GetModel(ModelHandle model) const { return static_cast<Model*>(models.Get(model)); }
+    ShaderVariants* GetShader(ShaderHandle shader) const { return shaders.Get(shader); }
+
     // Entity management
+    Entity* CreateEntity(ModelHandle model, ShaderHandle shader,
+                        const glm::vec3& position = glm::vec3(0.0f),
+                        const glm::vec3& rotation = glm::vec3(0.0f),
+                        const glm::vec3& scale = glm::vec3(1.0f));
     Entity* CreateEntity(const std::string& modelName, const std::string& shaderName,
                         const glm::vec3& position = glm::vec3(0.0f),
                         const glm::vec3& rotation = glm::vec3(0.0f),
                         const glm::vec3& scale = glm::vec3(1.0f));
-    
-    void Update(float deltaTime);
-    void Draw(const Camera& camera);
+
+    // Static entities never move. Those drawn with the "standard" shader whose
+    // model keeps its CPU data (Model's keepCpuData) are merged by cell and
+    // model into world-space chunks, culled and drawn as a few draws per cell.
+    void SetStatic(Entity* entity, bool isStatic);
+    const StaticBatchStats& GetStaticBatchStats() const { return staticBatches.GetStats(); }
+
+    // Particle effects, dynamic lights and skeletal animation run on the render thread at the frame rate
+    ParticleSystem& GetParticles() { return particles; }
+    ClusteredLights& GetLights() { return lights; }
+    void UpdateEffects(float deltaTime);
+
+    // Optional heightfield ground, drawn with the "terrain" shader; also the World's heightfield
+    void SetTerrain(std::unique_ptr<Terrain> newTerrain);
+    const Terrain* GetTerrain() const { return terrain.get(); }
+
+    // Optional baked environment, drawn after the opaque passes wherever they
+    // left the far plane. Replaces entities with the "background" shader.
+    void SetSkybox(std::unique_ptr<Background> newSkybox) { skybox = std::move(newSkybox); }
+
+    // Projection of the last Draw()
+    const glm::mat4& GetProjection() const { return projection; }
+    void SetClipPlanes(float nearDistance, float farDistance) { nearPlane = nearDistance; farPlane = farDistance; }
+
+    // Entities hidden behind terrain or occluder meshes (see Model::GetOccluder) are skipped in Draw
+    void SetOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+    const OcclusionStats& GetOcclusionStats() const { return occlusion.GetStats(); }
+    // Queues every occlusion-tested entity's bounds with DebugDraw: green when kept, red when hidden
+    void SetDebugBounds(bool enabled) { debugBounds = enabled; }
+
+    // Entities using the "standard" shader are culled and drawn by the indirect
+    // renderer, on the GPU where GL 4.3 is available; false forces its CPU path
+    void SetGpuCulling(bool enabled) { indirect.SetGpuCulling(enabled); }
+    const IndirectDrawStats& GetIndirectDrawStats() const { return indirect.GetStats(); }
+
+    // alpha interpolates between the last two published ticks
+    void Draw(const Camera& camera, float alpha = 1.0f);
+
+protected:
+    void onDestroyEntity(Entity& entity) override;
 
 private:
-    std::unordered_map<std::string, std::unique_ptr<Model>> models;
-    std::unordered_map<std::string, std::unique_ptr<Shader>> shaders;
-    std::vector<std::unique_ptr<Entity>> entities;
-    
+    Registry<ShaderVariants> shaders;
+
+    // Shaders the passes in Draw() look for, resolved by name in AddShader
+    ShaderHandle backgroundShader, litShader, terrainShader, edgeShader, particleShader;
+
+    std::unique_ptr<Terrain> terrain;
+    std::unique_ptr<Background> skybox;
+    ParticleSystem particles;
+    ClusteredLights lights;
+
+    StaticBatcher staticBatches;
+
+    // Entities first, then the static chunks with identity matrices
+    std::vector<glm::mat4> drawMatrices;
+    std::vector<Model*> drawModels;   // Resolved once per frame; null once the model is removed
+    std::vector<size_t> drawOrder;   // Main pass grouped by shader and texture bindings
+    std::vector<Shader*> drawVariants;   // Permutation each entity in drawOrder is drawn with
+    IndirectRenderer indirect;
+
+    // Terrain within the radius is rasterized as an occluder every frame
+    static constexpr float kTerrainOccluderRadius = 1500.0f;
+    OcclusionCuller occlusion;
+    bool occlusionCulling = true;
+    bool debugBounds = false;
+    OccluderMesh terrainOccluder;
+    std::vector<OccludeeBox> occludeeBoxes;
+    std::vector<uint8_t> occludeeVisible;
+
+    // Joint palettes of every animated entity, uploaded once per frame as one texture buffer
+    static const int kJointTextureUnit = 8;
+    GLuint jointBuffer = 0, jointTexture = 0;
+    int64_t jointBufferBytes = 0;
+    std::vector<glm::mat4> jointMatrices;
+    std::vector<int> jointOffsets;
+
     glm::mat4 projection;
     float aspectRatio;
-}; 
\ No newline at end of file
+    float nearPlane = 0.1f;
+    float farPlane = 1000.0f;
+
+    void uploadJoints();
+    void cullOccluded(const glm::mat4& view, const glm::vec3& cameraPos);
+    static uint32_t drawFeatures(const Model& model, const glm::mat4& matrix, int jointOffset);
+};
@@ -0,0 +1,176 @@
+#include "world.h"
+#include "heightfield.h"
+#include "navigation.h"
+#include "replication.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+// Dedicated server: hosts matches without GL, GLFW or a window. Every match is
+// a World with its own units, navigation and replication port. The ground is
+// loaded once and shared, models are parsed for their collision data only, and
+// all matches tick round-robin on one thread, so a core hosts as many matches
+// as fit in its tick budget.
+
+namespace {
+
+struct ServerSettings {
+    uint16_t port = 27015;      // Match i listens on port + i
+    int matches = 1;
+    int units = 64;             // Bot-driven tanks per match
+    float tickRate = 60.0f;
+    uint32_t ticks = 0;         // Stop after this many ticks; 0 runs until killed
+};
+
+struct Match {
+    World world;
+    std::unique_ptr<ReplicationServer> replication;
+    std::vector<EntityHandle> units;
+    std::vector<ReplicatedEntity> snapshot;
+    std::mt19937 random;
+};
+
+const float kBattlefieldSize = 2048.0f;   // Navigation area around the origin, as in the client
+const size_t kSquadSize = 16;             // Units ordered to the same place, sharing one flow field
+
+glm::vec3 randomPoint(std::mt19937& random, const Heightfield& ground) {
+    std::uniform_real_distribution<float> coordinate(-kBattlefieldSize * 0.4f, kBattlefieldSize * 0.4f);
+    float x = coordinate(random);
+    float z = coordinate(random);
+    return glm::vec3(x, ground.GetHeight(x, z), z);
+}
+
+std::unique_ptr<Match> createMatch(int index, const ServerSettings& settings,
+                                   const std::shared_ptr<const Heightfield>& ground) {
+    auto match = std::make_unique<Match>();
+    match->random.seed(1337 + index);
+    World& world = match->world;
+    world.SetHeightfield(ground);
+
+    auto navigation = std::make_unique<NavigationGrid>(glm::vec2(0.0f), kBattlefieldSize);
+    navigation->BuildFromTerrain(*ground);
+    navigation->Update();
+    world.SetNavigation(std::move(navigation));
+
+    ModelHandle tank = world.AddModel("tank", "assets/models/tank.glb");
+    for (int i = 0; i < settings.units; i++) {
+        Entity* unit = world.CreateEntity(tank, randomPoint(match->random, *ground),
+                                          glm::vec3(-90.0f, 0.0f, 0.0f), glm::vec3(0.1f));
+        if (!unit) {
+            return nullptr;
+        }
+        world.AddBoxCollider(unit);
+        match->units.push_back(unit->GetHandle());
+    }
+
+    ReplicationSettings replication;
+    replication.port = static_cast<uint16_t>(settings.port + index);
+    match->replication = std::make_unique<ReplicationServer>(replication);
+    if (!match->replication->Start()) {
+        std::cout << "Error: Match " << index << " cannot listen on port " << replication.port << std::endl;
+        return nullptr;
+    }
+    return match;
+}
+
+// Bot squads pick a new destination every twenty seconds, staggered so orders spread over ticks
+void orderUnits(Match& match, uint32_t tick, const ServerSettings& settings, const Heightfield& ground) {
+    uint32_t period = static_cast<uint32_t>(settings.tickRate * 20.0f);
+    for (size_t squad = 0; squad * kSquadSize < match.units.size(); squad++) {
+        if ((tick + squad * 97) % period != 1) {
+            continue;
+        }
+        MoveOrder order;
+        order.destination = randomPoint(match.random, ground);
+        order.yawAxis = 2;   // Z-up model stood up by its -90 degree X rotation
+        for (size_t i = squad * kSquadSize; i < std::min(match.units.size(), (squad + 1) * kSquadSize); i++) {
+            if (Entity* unit = match.world.GetEntity(match.units[i])) {
+                match.world.MoveTo(unit, order);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ServerSettings settings;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--port") == 0) {
+            settings.port = static_cast<uint16_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--matches") == 0) {
+            settings.matches = std::max(std::atoi(argv[i + 1]), 1);
+        } else if (std::strcmp(argv[i], "--units") == 0) {
+            settings.units = std::max(std::atoi(argv[i + 1]), 0);
+        } else if (std::strcmp(argv[i], "--tick-rate") == 0) {
+            settings.tickRate = std::max(static_cast<float>(std::atof(argv[i + 1])), 1.0f);
+        } else if (std::strcmp(argv[i], "--ticks") == 0) {
+            settings.ticks = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+        } else {
+            std::cout << "Usage: combatzone_server [--port N] [--matches N] [--units N] [--tick-rate HZ] [--ticks N]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // Same ground as the client: the shipped heightmap, or the same generated terrain
+    auto ground = std::make_shared<Heightfield>();
+    if (!ground->LoadHeightmap("assets/terrain/battlefield_height.png")) {
+        ground->Generate(2048, 1337);
+    }
+
+    std::vector<std::unique_ptr<Match>> matches;
+    for (int i = 0; i < settings.matches; i++) {
+        std::unique_ptr<Match> match = createMatch(i, settings, ground);
+        if (!match) {
+            return 1;
+        }
+        matches.push_back(std::move(match));
+    }
+    std::cout << "Hosting " << matches.size() << " matches of " << settings.units << " units on ports "
+              << settings.port << "-" << settings.port + matches.size() - 1 << " at "
+              << settings.tickRate << " Hz" << std::endl;
+
+    using Clock = std::chrono::steady_clock;
+    const float tickDelta = 1.0f / settings.tickRate;
+    const auto tickPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(tickDelta));
+    const uint32_t reportTicks = static_cast<uint32_t>(settings.tickRate * 5.0f);
+    auto nextTick = Clock::now();
+    double busyMs = 0.0, worstMs = 0.0;
+    for (uint32_t tick = 1; settings.ticks == 0 || tick <= settings.ticks; tick++) {
+        auto start = Clock::now();
+        for (auto& match : matches) {
+            orderUnits(*match, tick, settings, *ground);
+            match->world.Update(tickDelta);
+            match->replication->Poll();
+            match->world.CaptureReplicatedEntities(match->snapshot);
+            match->replication->SendSnapshots(tick, match->snapshot);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        busyMs += ms;
+        worstMs = std::max(worstMs, ms);
+
+        if (tick % reportTicks == 0) {
+            size_t clients = 0;
+            for (const auto& match : matches) {
+                clients += match->replication->GetClientCount();
+            }
+            std::cout << "tick " << tick << ": " << busyMs / reportTicks << " ms average, " << worstMs
+                      << " ms worst of " << tickDelta * 1000.0f << " ms budget, " << clients << " clients" << std::endl;
+            busyMs = worstMs = 0.0;
+        }
+
+        // Late ticks run back to back rather than being skipped, so the simulation stays deterministic
+        nextTick += tickPeriod;
+        if (nextTick > Clock::now()) {
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+    return 0;
+}
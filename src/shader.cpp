@@ -1,10 +1,44 @@
 #include "shader.h"
+#include "gl_state.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+namespace {
+
+const struct {
+    uint32_t feature;
+    const char* define;
+} kFeatureDefines[] = {
+    { ShaderFeature::AlphaTest, "ALPHA_TEST" },
+    { ShaderFeature::NormalMap, "NORMAL_MAP" },
+    { ShaderFeature::UniformScale, "UNIFORM_SCALE" },
+    { ShaderFeature::Skinned, "SKINNED" },
+    { ShaderFeature::Instanced, "INSTANCED" },
+};
+
+// Defines go after #version, which must come first; #line keeps error line numbers matching the file
+std::string withFeatures(const std::string& code, uint32_t features) {
+    if (features == 0) {
+        return code;
+    }
+    std::string defines;
+    for (const auto& entry : kFeatureDefines) {
+        if (features & entry.feature) {
+            defines += std::string("#define ") + entry.define + "\n";
+        }
+    }
+    size_t lineEnd = code.find('\n');
+    if (code.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos) {
+        return defines + "#line 1\n" + code;
+    }
+    return code.substr(0, lineEnd + 1) + defines + "#line 2\n" + code.substr(lineEnd + 1);
+}
+
+} // namespace
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, uint32_t features) {
     std::string vertexCode;
     std::string fragmentCode;
     std::ifstream vShaderFile;
@@ -17,8 +51,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     fShaderStream << fShaderFile.rdbuf();
     vShaderFile.close();
     fShaderFile.close();
-    vertexCode = vShaderStream.str();
-    fragmentCode = fShaderStream.str();
+    vertexCode = withFeatures(vShaderStream.str(), features);
+    fragmentCode = withFeatures(fShaderStream.str(), features);
 
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -44,28 +78,73 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     glDeleteShader(fragment);
 }
 
+Shader::Shader(const char* computePath) {
+    std::ifstream file(computePath);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string computeCode = stream.str();
+    const char* cShaderCode = computeCode.c_str();
+
+    GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
+
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    checkCompileErrors(ID, "PROGRAM");
+
+    glDeleteShader(compute);
+}
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath, uint32_t supportedFeatures)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), supported(supportedFeatures) {}
+
+Shader& ShaderVariants::Get(uint32_t features) {
+    features &= supported;
+    auto it = variants.find(features);
+    if (it == variants.end()) {
+        std::cout << "Compiling " << vertexPath << " + " << fragmentPath << " variant " << features << std::endl;
+        it = variants.emplace(features, std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), features)).first;
+    }
+    return *it->second;
+}
+
 void Shader::use() {
-    glUseProgram(ID);
+    GLState::Get().UseProgram(ID);
+}
+
+GLint Shader::location(const std::string &name) const {
+    auto it = uniformLocations.find(name);
+    if (it == uniformLocations.end()) {
+        it = uniformLocations.emplace(name, glGetUniformLocation(ID, name.c_str())).first;
+    }
+    return it->second;
 }
 
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(location(name), value);
+}
+
+void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
+    glUniform2fv(location(name), 1, &value[0]);
 }
 
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(location(name), 1, &value[0]);
 }
 
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform4fv(location(name), 1, &value[0]);
 }
 
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(location(name), value);
 }
 
 void Shader::checkCompileErrors(GLuint shader, std::string type) {
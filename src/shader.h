@@ -1,5 +1,8 @@
 #pragma once
 #include <string>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
 
 #ifdef USE_GLES2
     #include <GLES2/gl2.h>
@@ -9,18 +12,54 @@
 
 #include "../external/glm/glm/glm.hpp"
 
+// Compile-time permutations: each flag a program is built with becomes a
+// #define after the #version line, so features a draw does not use cost nothing
+namespace ShaderFeature {
+    const uint32_t AlphaTest = 1 << 0;      // ALPHA_TEST: discard below the material's alpha cutoff
+    const uint32_t NormalMap = 1 << 1;      // NORMAL_MAP: perturb normals with the material's normal map
+    const uint32_t UniformScale = 1 << 2;   // UNIFORM_SCALE: normals skip the inverse transpose
+    const uint32_t Skinned = 1 << 3;        // SKINNED: blend the joint palette
+    const uint32_t Instanced = 1 << 4;      // INSTANCED: model and material from IndirectRenderer's instance records
+}
+
 class Shader {
 public:
-    Shader(const char* vertexPath, const char* fragmentPath);
+    Shader(const char* vertexPath, const char* fragmentPath, uint32_t features = 0);
+    // Compute program; needs GL 4.3
+    explicit Shader(const char* computePath);
     Shader(GLuint programId) : ID(programId) {}
     void use();
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
     void setInt(const std::string &name, int value) const;
+    void setVec2(const std::string &name, const glm::vec2 &value) const;
     void setVec3(const std::string &name, const glm::vec3 &value) const;
     void setVec4(const std::string &name, const glm::vec4 &value) const;
     void setFloat(const std::string &name, float value) const;
     
     GLuint ID;
 private:
+    // Uniform locations never change after linking, so each name is looked up once
+    mutable std::unordered_map<std::string, GLint> uniformLocations;
+
+    GLint location(const std::string &name) const;
     void checkCompileErrors(GLuint shader, std::string type);
+};
+
+// One vertex and fragment source pair, compiled once per feature set it is
+// drawn with. Flags the sources do not understand are dropped from the key,
+// so they never produce duplicate programs.
+class ShaderVariants {
+public:
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, uint32_t supportedFeatures = 0);
+
+    // Compiled on first use
+    Shader& Get(uint32_t features = 0);
+    uint32_t GetSupportedFeatures() const { return supported; }
+    size_t GetVariantCount() const { return variants.size(); }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    uint32_t supported;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
 }; 
\ No newline at end of file
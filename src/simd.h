@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// Minimal 4-wide float vector over SSE2, NEON (AArch64) or plain scalars.
+// Comparisons return lane masks (all bits set or clear) stored as Float4.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define SIMD_NEON 1
+#endif
+
+namespace simd {
+
+struct Float4 {
+#if defined(SIMD_SSE2)
+    __m128 v;
+#elif defined(SIMD_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+#if defined(SIMD_SSE2)
+
+inline Float4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void Store(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+inline Float4 Splat(float x) { return { _mm_set1_ps(x) }; }
+inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Float4 operator/(Float4 a, Float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Float4 Min(Float4 a, Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Float4 Max(Float4 a, Float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Float4 Sqrt(Float4 a) { return { _mm_sqrt_ps(a.v) }; }
+inline Float4 Abs(Float4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline Float4 Less(Float4 a, Float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Float4 LessEqual(Float4 a, Float4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline Float4 Greater(Float4 a, Float4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline Float4 And(Float4 a, Float4 b) { return { _mm_and_ps(a.v, b.v) }; }
+inline Float4 Or(Float4 a, Float4 b) { return { _mm_or_ps(a.v, b.v) }; }
+inline Float4 AndNot(Float4 mask, Float4 a) { return { _mm_andnot_ps(mask.v, a.v) }; }
+inline Float4 Select(Float4 mask, Float4 a, Float4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+inline int MoveMask(Float4 mask) { return _mm_movemask_ps(mask.v); }
+
+#elif defined(SIMD_NEON)
+
+inline Float4 Load(const float* p) { return { vld1q_f32(p) }; }
+inline void Store(float* p, Float4 a) { vst1q_f32(p, a.v); }
+inline Float4 Splat(float x) { return { vdupq_n_f32(x) }; }
+inline Float4 operator+(Float4 a, Float4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { vmulq_f32(a.v, b.v) }; }
+inline Float4 operator/(Float4 a, Float4 b) { return { vdivq_f32(a.v, b.v) }; }
+inline Float4 Min(Float4 a, Float4 b) { return { vminq_f32(a.v, b.v) }; }
+inline Float4 Max(Float4 a, Float4 b) { return { vmaxq_f32(a.v, b.v) }; }
+inline Float4 Sqrt(Float4 a) { return { vsqrtq_f32(a.v) }; }
+inline Float4 Abs(Float4 a) { return { vabsq_f32(a.v) }; }
+inline Float4 Less(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)) }; }
+inline Float4 LessEqual(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcleq_f32(a.v, b.v)) }; }
+inline Float4 Greater(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)) }; }
+inline Float4 And(Float4 a, Float4 b) {
+    return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) };
+}
+inline Float4 Or(Float4 a, Float4 b) {
+    return { vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) };
+}
+inline Float4 AndNot(Float4 mask, Float4 a) {
+    return { vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(mask.v))) };
+}
+inline Float4 Select(Float4 mask, Float4 a, Float4 b) { return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) }; }
+inline int MoveMask(Float4 mask) {
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask.v), 31);
+    return static_cast<int>(vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) |
+                            (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3));
+}
+
+#else
+
+namespace detail {
+inline float maskValue(bool set) {
+    uint32_t bits = set ? 0xffffffffu : 0u;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+inline uint32_t bitsOf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+inline float fromBits(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+} // namespace detail
+
+#define SIMD_LANES(expr) Float4 r; for (int i = 0; i < 4; i++) { r.v[i] = (expr); } return r
+
+inline Float4 Load(const float* p) { SIMD_LANES(p[i]); }
+inline void Store(float* p, Float4 a) { for (int i = 0; i < 4; i++) { p[i] = a.v[i]; } }
+inline Float4 Splat(float x) { SIMD_LANES(x); }
+inline Float4 operator+(Float4 a, Float4 b) { SIMD_LANES(a.v[i] + b.v[i]); }
+inline Float4 operator-(Float4 a, Float4 b) { SIMD_LANES(a.v[i] - b.v[i]); }
+inline Float4 operator*(Float4 a, Float4 b) { SIMD_LANES(a.v[i] * b.v[i]); }
+inline Float4 operator/(Float4 a, Float4 b) { SIMD_LANES(a.v[i] / b.v[i]); }
+inline Float4 Min(Float4 a, Float4 b) { SIMD_LANES(a.v[i] < b.v[i] ? a.v[i] : b.v[i]); }
+inline Float4 Max(Float4 a, Float4 b) { SIMD_LANES(a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+inline Float4 Sqrt(Float4 a) { SIMD_LANES(std::sqrt(a.v[i])); }
+inline Float4 Abs(Float4 a) { SIMD_LANES(std::fabs(a.v[i])); }
+inline Float4 Less(Float4 a, Float4 b) { SIMD_LANES(detail::maskValue(a.v[i] < b.v[i])); }
+inline Float4 LessEqual(Float4 a, Float4 b) { SIMD_LANES(detail::maskValue(a.v[i] <= b.v[i])); }
+inline Float4 Greater(Float4 a, Float4 b) { SIMD_LANES(detail::maskValue(a.v[i] > b.v[i])); }
+inline Float4 And(Float4 a, Float4 b) { SIMD_LANES(detail::fromBits(detail::bitsOf(a.v[i]) & detail::bitsOf(b.v[i]))); }
+inline Float4 Or(Float4 a, Float4 b) { SIMD_LANES(detail::fromBits(detail::bitsOf(a.v[i]) | detail::bitsOf(b.v[i]))); }
+inline Float4 AndNot(Float4 mask, Float4 a) { SIMD_LANES(detail::fromBits(~detail::bitsOf(mask.v[i]) & detail::bitsOf(a.v[i]))); }
+inline Float4 Select(Float4 mask, Float4 a, Float4 b) { SIMD_LANES(detail::bitsOf(mask.v[i]) ? a.v[i] : b.v[i]); }
+inline int MoveMask(Float4 mask) {
+    int bits = 0;
+    for (int i = 0; i < 4; i++) {
+        bits |= static_cast<int>(detail::bitsOf(mask.v[i]) >> 31) << i;
+    }
+    return bits;
+}
+
+#undef SIMD_LANES
+
+#endif
+
+inline Float4 Clamp(Float4 x, Float4 lo, Float4 hi) { return Min(Max(x, lo), hi); }
+
+} // namespace simd
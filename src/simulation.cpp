@@ -0,0 +1,89 @@
+#include "simulation.h"
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+Simulation::Simulation(World& world, float tickRate)
+    : world(world), tickDelta(1.0f / tickRate), accumulator(0.0f), maxTicksPerFrame(5),
+      running(false), tickCount(0), lastTickNanos(0) {
+}
+
+Simulation::~Simulation() {
+    StopThread();
+}
+
+void Simulation::Tick() {
+    world.Update(tickDelta);
+    tickCount++;
+    lastTickNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+void Simulation::Advance(float frameDelta) {
+    if (running) {
+        return;  // The simulation thread owns ticking
+    }
+
+    // Clamp long stalls (debugger, window drag) so we don't spiral trying to catch up
+    accumulator += std::min(frameDelta, 0.25f);
+
+    int ticks = 0;
+    while (accumulator >= tickDelta && ticks < maxTicksPerFrame) {
+        Tick();
+        accumulator -= tickDelta;
+        ticks++;
+    }
+
+    // Still behind after the cap: drop the backlog instead of slowing the simulation further
+    if (accumulator >= tickDelta) {
+        accumulator = std::fmod(accumulator, tickDelta);
+    }
+}
+
+void Simulation::StartThread() {
+    if (running) {
+        return;
+    }
+    std::cout << "Starting simulation thread at " << 1.0f / tickDelta << " Hz" << std::endl;
+    running = true;
+    thread = std::thread(&Simulation::ThreadLoop, this);
+}
+
+void Simulation::StopThread() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Simulation::ThreadLoop() {
+    auto tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(tickDelta));
+    auto nextTick = Clock::now();
+
+    while (running) {
+        Tick();
+        nextTick += tickDuration;
+
+        // Skip ticks we can no longer make rather than bursting to catch up
+        auto now = Clock::now();
+        if (now - nextTick > tickDuration * maxTicksPerFrame) {
+            nextTick = now;
+        }
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+float Simulation::GetAlpha() const {
+    if (!running) {
+        return accumulator / tickDelta;
+    }
+
+    // Threaded: how far we are past the last published tick
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+    float elapsed = static_cast<float>(now - lastTickNanos.load()) * 1.0e-9f;
+    return std::min(std::max(elapsed / tickDelta, 0.0f), 1.0f);
+}
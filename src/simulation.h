@@ -0,0 +1,42 @@
+#pragma once
+#include "world.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+// Runs World::Update at a fixed tick rate, either from the render loop
+// (Advance) or on a dedicated thread (StartThread). The renderer draws with
+// GetAlpha() to interpolate between the last two published ticks.
+class Simulation {
+public:
+    Simulation(World& world, float tickRate = 60.0f);
+    ~Simulation();
+
+    // Single-threaded mode: run every tick that is due for this frame
+    void Advance(float frameDelta);
+
+    void StartThread();
+    void StopThread();
+    bool IsThreaded() const { return running; }
+
+    float GetAlpha() const;
+    float GetTickDelta() const { return tickDelta; }
+    uint64_t GetTickCount() const { return tickCount; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    World& world;
+    float tickDelta;
+    float accumulator;
+    int maxTicksPerFrame;
+
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> tickCount;
+    std::atomic<int64_t> lastTickNanos;
+
+    void Tick();
+    void ThreadLoop();
+};
@@ -0,0 +1,143 @@
+#include "static_batch.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Every chunk is tracked under one name rather than one per cell
+const char* kAssetName = "scene/static";
+
+} // namespace
+
+StaticBatcher::StaticBatcher(const StaticBatchSettings& settings) : settings(settings) {
+}
+
+StaticBatcher::CellKey StaticBatcher::cellFor(const glm::vec3& position) const {
+    return CellKey(static_cast<int>(std::floor(position.x / settings.cellSize)),
+                   static_cast<int>(std::floor(position.z / settings.cellSize)));
+}
+
+void StaticBatcher::Add(Entity& entity) {
+    uint32_t key = entity.GetHandle().GetValue();
+    if (memberCells.count(key)) {
+        return;
+    }
+    CellKey cellKey = cellFor(entity.GetRenderTransform().position);
+    memberCells[key] = cellKey;
+    Cell& cell = cells[cellKey];
+    cell.members.push_back(entity.GetHandle());
+    cell.dirty = true;
+    cell.changedFrame = frame;
+}
+
+void StaticBatcher::Remove(Entity& entity) {
+    entity.SetBatched(false);
+    auto it = memberCells.find(entity.GetHandle().GetValue());
+    if (it == memberCells.end()) {
+        return;
+    }
+    Cell& cell = cells[it->second];
+    memberCells.erase(it);
+    cell.members.erase(std::remove(cell.members.begin(), cell.members.end(), entity.GetHandle()), cell.members.end());
+    cell.dirty = true;
+    cell.removed = true;
+    cell.changedFrame = frame;
+}
+
+void StaticBatcher::Update(const Registry<Entity>& entities, const ModelResolver& resolve) {
+    frame++;
+    stats.rebuilt = 0;
+    for (auto it = cells.begin(); it != cells.end();) {
+        Cell& cell = it->second;
+        // A removed source model takes the textures its chunks draw with
+        for (const Chunk& chunk : cell.chunks) {
+            if (!resolve(chunk.source)) {
+                cell.dirty = true;
+                cell.removed = true;
+                break;
+            }
+        }
+        if (cell.dirty && (cell.removed || cell.changedFrame + 1 < frame)) {
+            rebuild(cell, entities, resolve);
+            stats.rebuilt++;
+        }
+        if (cell.members.empty() && cell.chunks.empty()) {
+            it = cells.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (stats.rebuilt == 0) {
+        return;
+    }
+
+    chunkList.clear();
+    stats.entities = stats.cells = stats.vertices = 0;
+    for (const auto& entry : cells) {
+        for (const Chunk& chunk : entry.second.chunks) {
+            chunkList.push_back(chunk.model.get());
+            stats.vertices += chunk.model->GetVertices().count;
+        }
+        stats.entities += entry.second.batched;
+        stats.cells += entry.second.chunks.empty() ? 0 : 1;
+    }
+    stats.chunks = chunkList.size();
+}
+
+void StaticBatcher::rebuild(Cell& cell, const Registry<Entity>& entities, const ModelResolver& resolve) {
+    // Old chunks give their pool ranges back before the new ones are allocated
+    cell.chunks.clear();
+    cell.batched = 0;
+    cell.dirty = false;
+    cell.removed = false;
+
+    // Grouped by model, since a chunk draws with one material
+    std::vector<Entity*> members;
+    members.reserve(cell.members.size());
+    for (EntityHandle handle : cell.members) {
+        if (Entity* entity = entities.Get(handle)) {
+            entity->SetBatched(false);
+            members.push_back(entity);
+        }
+    }
+    std::stable_sort(members.begin(), members.end(), [](const Entity* a, const Entity* b) {
+        return a->GetModel().GetValue() < b->GetModel().GetValue();
+    });
+
+    size_t groupStart = 0;
+    while (groupStart < members.size()) {
+        ModelHandle source = members[groupStart]->GetModel();
+        size_t groupEnd = groupStart;
+        while (groupEnd < members.size() && members[groupEnd]->GetModel() == source) {
+            groupEnd++;
+        }
+        const Model* model = resolve(source);
+        if (model && model->IsUploaded()) {
+            MeshData mesh;
+            size_t chunkStart = groupStart;
+            auto flush = [&](size_t chunkEnd) {
+                if (mesh.vertices.empty()) {
+                    return;
+                }
+                cell.chunks.push_back({ std::make_unique<Model>(kAssetName, std::move(mesh), *model), source });
+                for (size_t i = chunkStart; i < chunkEnd; i++) {
+                    members[i]->SetBatched(true);
+                }
+                cell.batched += chunkEnd - chunkStart;
+                mesh = MeshData();
+                chunkStart = chunkEnd;
+            };
+            for (size_t i = groupStart; i < groupEnd; i++) {
+                if (mesh.vertices.size() / 8 >= settings.maxChunkVertices) {
+                    flush(i);
+                }
+                // Fails for every entity of the model alike, so the group stays unbatched
+                if (!model->AppendTransformed(members[i]->GetInterpolatedModelMatrix(1.0f), mesh)) {
+                    break;
+                }
+            }
+            flush(mesh.vertices.empty() ? chunkStart : groupEnd);
+        }
+        groupStart = groupEnd;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "model.h"
+#include "entity.h"
+#include "registry.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+struct StaticBatchSettings {
+    float cellSize = 64.0f;                  // Side of the square cells on the XZ plane, in meters
+    size_t maxChunkVertices = 256 * 1024;    // Bigger groups are split over several chunks
+};
+
+struct StaticBatchStats {
+    size_t entities = 0;    // Static entities drawn from chunks rather than on their own
+    size_t cells = 0;       // Cells with at least one chunk
+    size_t chunks = 0;
+    size_t vertices = 0;
+    size_t rebuilt = 0;     // Cells rebuilt by the last Update()
+};
+
+// Merges static entities into world-space geometry. Entities are binned into
+// square cells by position, and within a cell all entities of one model, and
+// so of one material, are pre-transformed into a chunk: a Model in the mesh
+// pool whose bounds cover just that chunk, drawn with an identity transform.
+// Thousands of props become a few chunks per cell that cull and draw like any
+// other model. A cell is rebuilt once it has gone a frame without additions,
+// so cells streaming in over several frames merge once; removals rebuild at
+// once. Entities whose model released its CPU data, or is animated, are left
+// unbatched and keep drawing on their own.
+class StaticBatcher {
+public:
+    // Uploaded model for a handle, null once removed
+    using ModelResolver = std::function<const Model*(ModelHandle)>;
+
+    explicit StaticBatcher(const StaticBatchSettings& settings = StaticBatchSettings());
+    StaticBatcher(const StaticBatcher&) = delete;
+    StaticBatcher& operator=(const StaticBatcher&) = delete;
+
+    // Under the scene's state lock; the entity is binned by its current position
+    void Add(Entity& entity);
+    void Remove(Entity& entity);
+
+    // GL thread under the state lock, once per frame: rebuilds changed cells
+    // and updates IsBatched() of their members
+    void Update(const Registry<Entity>& entities, const ModelResolver& resolve);
+
+    // Every cell's chunks, in world space
+    const std::vector<Model*>& GetChunks() const { return chunkList; }
+    const StaticBatchStats& GetStats() const { return stats; }
+
+private:
+    using CellKey = std::pair<int, int>;
+
+    struct Chunk {
+        std::unique_ptr<Model> model;
+        ModelHandle source;   // Whose material and textures the chunk draws with
+    };
+
+    struct Cell {
+        std::vector<EntityHandle> members;
+        std::vector<Chunk> chunks;
+        size_t batched = 0;
+        uint64_t changedFrame = 0;
+        bool dirty = false;
+        bool removed = false;   // Chunks still show removed entities, so don't wait
+    };
+
+    StaticBatchSettings settings;
+    std::map<CellKey, Cell> cells;
+    std::unordered_map<uint32_t, CellKey> memberCells;   // By entity handle value
+    std::vector<Model*> chunkList;
+    uint64_t frame = 0;
+    StaticBatchStats stats;
+
+    CellKey cellFor(const glm::vec3& position) const;
+    void rebuild(Cell& cell, const Registry<Entity>& entities, const ModelResolver& resolve);
+};
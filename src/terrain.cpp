@@ -0,0 +1,356 @@
+#include "terrain.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "memory_tracker.h"
+#include "deletion_queue.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <limits>
+
+namespace {
+
+const char* kAssetName = "terrain";
+
+// Planes as (normal, d) with normals pointing into the frustum
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+    glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+}
+
+bool boxInFrustum(const glm::vec4* planes, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    for (int i = 0; i < 6; i++) {
+        // Corner furthest along the plane normal
+        glm::vec3 corner(planes[i].x >= 0.0f ? boundsMax.x : boundsMin.x,
+                         planes[i].y >= 0.0f ? boundsMax.y : boundsMin.y,
+                         planes[i].z >= 0.0f ? boundsMax.z : boundsMin.z);
+        if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 closest = glm::clamp(center, boundsMin, boundsMax);
+    glm::vec3 delta = closest - center;
+    return glm::dot(delta, delta) <= radius * radius;
+}
+
+} // namespace
+
+Terrain::Terrain(std::shared_ptr<const Heightfield> heightfield, const TerrainSettings& settings)
+    : settings(settings), heightfield(std::move(heightfield)), resolution(this->heightfield->GetResolution()) {
+    // The terrain shader holds at most 16 morph ranges
+    this->settings.lodLevels = std::min(std::max(settings.lodLevels, 1), 16);
+
+    float leafSize = this->heightfield->GetSize() / static_cast<float>(1 << (this->settings.lodLevels - 1));
+    float range = leafSize * settings.lodRangeScale;
+    for (int level = 0; level < this->settings.lodLevels; level++) {
+        lodRanges.push_back(range);
+        range *= 2.0f;
+    }
+
+    buildGrid();
+    if (!this->heightfield->Empty()) {
+        buildMinMax();
+        buildOccluderHeights();
+        uploadHeights();
+    }
+}
+
+Terrain::~Terrain() {
+    DeletionQueue& queue = DeletionQueue::Get();
+    queue.DeleteVertexArray(gridVAO);
+    queue.DeleteBuffer(gridVBO, kAssetName, MemoryCategory::Vertex, gridVertexBytes);
+    queue.DeleteBuffer(gridEBO, kAssetName, MemoryCategory::Index, gridIndexBytes);
+    queue.DeleteBuffer(instanceVBO, kAssetName, MemoryCategory::Vertex, instanceBytes);
+    queue.DeleteTexture(heightTexture, kAssetName, heightTextureBytes);
+}
+
+void Terrain::buildGrid() {
+    int n = settings.gridResolution;
+    std::vector<glm::vec2> vertices;
+    vertices.reserve((n + 1) * (n + 1));
+    for (int z = 0; z <= n; z++) {
+        for (int x = 0; x <= n; x++) {
+            vertices.emplace_back(static_cast<float>(x) / n, static_cast<float>(z) / n);
+        }
+    }
+
+    std::vector<unsigned int> indices;
+    indices.reserve(n * n * 6);
+    for (int z = 0; z < n; z++) {
+        for (int x = 0; x < n; x++) {
+            unsigned int i0 = z * (n + 1) + x;
+            unsigned int i1 = i0 + 1;
+            unsigned int i2 = i0 + (n + 1);
+            unsigned int i3 = i2 + 1;
+            indices.insert(indices.end(), { i0, i2, i1, i1, i2, i3 });
+        }
+    }
+    gridIndexCount = static_cast<GLsizei>(indices.size());
+    gridVertexBytes = vertices.size() * sizeof(glm::vec2);
+    gridIndexBytes = indices.size() * sizeof(unsigned int);
+    instanceBytes = static_cast<int64_t>(settings.maxNodes) * sizeof(NodeInstance);
+
+    glGenVertexArrays(1, &gridVAO);
+    glGenBuffers(1, &gridVBO);
+    glGenBuffers(1, &gridEBO);
+    glGenBuffers(1, &instanceVBO);
+
+    GLState::Get().BindVertexArray(gridVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+    glBufferData(GL_ARRAY_BUFFER, gridVertexBytes, vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Per-node instance data: xz offset, size, LOD level
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_STREAM_DRAW);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(NodeInstance), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gridIndexBytes, indices.data(), GL_STATIC_DRAW);
+    GLState::Get().BindVertexArray(0);
+
+    MemoryTracker& tracker = MemoryTracker::Get();
+    tracker.Add(kAssetName, MemoryCategory::Vertex, MemoryDomain::GPU, gridVertexBytes + instanceBytes);
+    tracker.Add(kAssetName, MemoryCategory::Index, MemoryDomain::GPU, gridIndexBytes);
+}
+
+void Terrain::buildMinMax() {
+    int levels = settings.lodLevels;
+    minMax.assign(levels, std::vector<glm::vec2>());
+
+    // Leaves cover an inclusive range of samples so neighbouring bounds share their edge
+    int leafCount = 1 << (levels - 1);
+    minMax[0].resize(static_cast<size_t>(leafCount) * leafCount);
+    float samplesPerLeaf = static_cast<float>(resolution - 1) / leafCount;
+    JobSystem::Get().ParallelFor(leafCount, 4, [&](size_t begin, size_t end) {
+        for (size_t nz = begin; nz < end; nz++) {
+            int z0 = static_cast<int>(std::floor(nz * samplesPerLeaf));
+            int z1 = static_cast<int>(std::ceil((nz + 1) * samplesPerLeaf));
+            for (int nx = 0; nx < leafCount; nx++) {
+                int x0 = static_cast<int>(std::floor(nx * samplesPerLeaf));
+                int x1 = static_cast<int>(std::ceil((nx + 1) * samplesPerLeaf));
+                glm::vec2 range(heightfield->GetSample(x0, z0));
+                for (int z = z0; z <= z1; z++) {
+                    for (int x = x0; x <= x1; x++) {
+                        float h = heightfield->GetSample(x, z);
+                        range.x = std::min(range.x, h);
+                        range.y = std::max(range.y, h);
+                    }
+                }
+                minMax[0][nz * leafCount + nx] = range;
+            }
+        }
+    });
+
+    for (int level = 1; level < levels; level++) {
+        int count = leafCount >> level;
+        int childCount = count * 2;
+        minMax[level].resize(static_cast<size_t>(count) * count);
+        for (int nz = 0; nz < count; nz++) {
+            for (int nx = 0; nx < count; nx++) {
+                const std::vector<glm::vec2>& children = minMax[level - 1];
+                glm::vec2 a = children[(nz * 2) * childCount + nx * 2];
+                glm::vec2 b = children[(nz * 2) * childCount + nx * 2 + 1];
+                glm::vec2 c = children[(nz * 2 + 1) * childCount + nx * 2];
+                glm::vec2 d = children[(nz * 2 + 1) * childCount + nx * 2 + 1];
+                minMax[level][nz * count + nx] = glm::vec2(std::min(std::min(a.x, b.x), std::min(c.x, d.x)),
+                                                           std::max(std::max(a.y, b.y), std::max(c.y, d.y)));
+            }
+        }
+    }
+}
+
+void Terrain::buildOccluderHeights() {
+    int count = std::max(settings.occluderResolution, 2);
+    int cellCount = count - 1;
+    float samplesPerCell = static_cast<float>(resolution - 1) / cellCount;
+
+    // Lowest sample of each grid cell, inclusive of its edges
+    std::vector<float> cellMin(static_cast<size_t>(cellCount) * cellCount);
+    JobSystem::Get().ParallelFor(cellCount, 8, [&](size_t begin, size_t end) {
+        for (size_t cz = begin; cz < end; cz++) {
+            int z0 = static_cast<int>(std::floor(cz * samplesPerCell));
+            int z1 = static_cast<int>(std::ceil((cz + 1) * samplesPerCell));
+            for (int cx = 0; cx < cellCount; cx++) {
+                int x0 = static_cast<int>(std::floor(cx * samplesPerCell));
+                int x1 = static_cast<int>(std::ceil((cx + 1) * samplesPerCell));
+                float lowest = heightfield->GetSample(x0, z0);
+                for (int z = z0; z <= z1; z++) {
+                    for (int x = x0; x <= x1; x++) {
+                        lowest = std::min(lowest, heightfield->GetSample(x, z));
+                    }
+                }
+                cellMin[cz * cellCount + cx] = lowest;
+            }
+        }
+    });
+
+    // A vertex takes the minimum of the two rings of cells around it. One ring
+    // keeps the grid's own triangles under the heightfield; the second covers
+    // drawn triangles that straddle grid cells.
+    occluderHeights.resize(static_cast<size_t>(count) * count);
+    for (int z = 0; z < count; z++) {
+        for (int x = 0; x < count; x++) {
+            float lowest = std::numeric_limits<float>::max();
+            for (int cz = std::max(z - 2, 0); cz <= std::min(z + 1, cellCount - 1); cz++) {
+                for (int cx = std::max(x - 2, 0); cx <= std::min(x + 1, cellCount - 1); cx++) {
+                    lowest = std::min(lowest, cellMin[cz * cellCount + cx]);
+                }
+            }
+            occluderHeights[z * count + x] = lowest;
+        }
+    }
+}
+
+void Terrain::BuildOccluder(const glm::vec3& center, float radius, OccluderMesh& out) const {
+    out.positions.clear();
+    out.indices.clear();
+    if (occluderHeights.empty()) {
+        return;
+    }
+    int count = std::max(settings.occluderResolution, 2);
+    float spacing = heightfield->GetSize() / (count - 1);
+    float half = heightfield->GetSize() * 0.5f;
+    int x0 = std::max(static_cast<int>(std::floor((center.x - radius + half) / spacing)), 0);
+    int z0 = std::max(static_cast<int>(std::floor((center.z - radius + half) / spacing)), 0);
+    int x1 = std::min(static_cast<int>(std::ceil((center.x + radius + half) / spacing)), count - 1);
+    int z1 = std::min(static_cast<int>(std::ceil((center.z + radius + half) / spacing)), count - 1);
+    if (x1 <= x0 || z1 <= z0) {
+        return;
+    }
+
+    int columns = x1 - x0 + 1;
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            out.positions.push_back(glm::vec3(-half + x * spacing, occluderHeights[z * count + x], -half + z * spacing));
+        }
+    }
+    for (int z = 0; z < z1 - z0; z++) {
+        for (int x = 0; x < x1 - x0; x++) {
+            uint32_t corner = static_cast<uint32_t>(z * columns + x);
+            out.indices.insert(out.indices.end(), { corner, corner + columns, corner + 1,
+                                                    corner + 1, corner + columns, corner + columns + 1 });
+        }
+    }
+}
+
+void Terrain::uploadHeights() {
+    if (heightTexture == 0) {
+        glGenTextures(1, &heightTexture);
+    } else {
+        MemoryTracker::Get().Remove(kAssetName, MemoryCategory::Texture, MemoryDomain::GPU, heightTextureBytes);
+    }
+    heightTextureBytes = heightfield->GetSamples().size() * sizeof(float);
+
+    GLState::Get().BindTexture(GL_TEXTURE_2D, heightTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, heightfield->GetSamples().data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLState::Get().BindTexture(GL_TEXTURE_2D, 0);
+
+    MemoryTracker::Get().Add(kAssetName, MemoryCategory::Texture, MemoryDomain::GPU, heightTextureBytes);
+}
+
+void Terrain::nodeBounds(int level, int nx, int nz, glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    int count = 1 << (settings.lodLevels - 1 - level);
+    float nodeSize = heightfield->GetSize() / count;
+    float half = heightfield->GetSize() * 0.5f;
+    glm::vec2 range = minMax[level][nz * count + nx];
+    boundsMin = glm::vec3(-half + nx * nodeSize, range.x, -half + nz * nodeSize);
+    boundsMax = glm::vec3(boundsMin.x + nodeSize, range.y, boundsMin.z + nodeSize);
+}
+
+void Terrain::addNode(int level, const glm::vec3& boundsMin, float nodeSize) {
+    if (static_cast<int>(nodes.size()) >= settings.maxNodes) {
+        return;
+    }
+    nodes.push_back({ glm::vec2(boundsMin.x, boundsMin.z), nodeSize, static_cast<float>(level) });
+}
+
+void Terrain::selectNode(int level, int nx, int nz, const glm::vec4* planes, const glm::vec3& cameraPos) {
+    glm::vec3 boundsMin, boundsMax;
+    nodeBounds(level, nx, nz, boundsMin, boundsMax);
+    if (!boxInFrustum(planes, boundsMin, boundsMax)) {
+        return;
+    }
+
+    if (level == 0 || !sphereIntersectsBox(cameraPos, lodRanges[level - 1], boundsMin, boundsMax)) {
+        addNode(level, boundsMin, boundsMax.x - boundsMin.x);
+        return;
+    }
+
+    for (int child = 0; child < 4; child++) {
+        int cx = nx * 2 + (child & 1);
+        int cz = nz * 2 + (child >> 1);
+        glm::vec3 childMin, childMax;
+        nodeBounds(level - 1, cx, cz, childMin, childMax);
+        if (sphereIntersectsBox(cameraPos, lodRanges[level - 1], childMin, childMax)) {
+            selectNode(level - 1, cx, cz, planes, cameraPos);
+        } else if (boxInFrustum(planes, childMin, childMax)) {
+            // Outside the finer range the child is fully morphed, so it matches this level's grid
+            addNode(level - 1, childMin, childMax.x - childMin.x);
+        }
+    }
+}
+
+void Terrain::Draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos) {
+    if (heightfield->Empty()) {
+        return;
+    }
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(projection * view, planes);
+    nodes.clear();
+    selectNode(settings.lodLevels - 1, 0, 0, planes, cameraPos);
+    if (nodes.empty()) {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_STREAM_DRAW);  // Orphan last frame's nodes
+    glBufferSubData(GL_ARRAY_BUFFER, 0, nodes.size() * sizeof(NodeInstance), nodes.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.use();
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+    shader.setVec3("cameraPos", cameraPos);
+    shader.setFloat("terrainSize", heightfield->GetSize());
+    shader.setFloat("gridResolution", static_cast<float>(settings.gridResolution));
+    shader.setFloat("sampleSpacing", heightfield->GetSize() / (resolution - 1));
+    // Map [0,1] terrain coordinates onto texel centers
+    shader.setVec4("heightmapTransform", glm::vec4((resolution - 1.0f) / resolution, 0.5f / resolution,
+                                                   1.0f / resolution, 0.0f));
+    for (int level = 0; level < settings.lodLevels; level++) {
+        float end = lodRanges[level];
+        float start = (level > 0 ? lodRanges[level - 1] : 0.0f);
+        start += (end - start) * settings.morphStartRatio;
+        std::string name = "morphRanges[" + std::to_string(level) + "]";
+        shader.setVec2(name, glm::vec2(start, 1.0f / std::max(end - start, 0.001f)));
+    }
+
+    GLState::Get().BindTexture(0, GL_TEXTURE_2D, heightTexture);
+    shader.setInt("heightMap", 0);
+
+    GLState::Get().BindVertexArray(gridVAO);
+    glDrawElementsInstanced(GL_TRIANGLES, gridIndexCount, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(nodes.size()));
+}
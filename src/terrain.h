@@ -0,0 +1,83 @@
+#pragma once
+#include "shader.h"
+#include "occlusion.h"
+#include "heightfield.h"
+#include "../external/glm/glm/glm.hpp"
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+struct TerrainSettings {
+    int gridResolution = 32;       // Quads per node side; every node uses the same mesh
+    int lodLevels = 8;             // Quadtree depth; leaf nodes are size / 2^(lodLevels-1)
+    float lodRangeScale = 2.5f;    // Finest LOD range in leaf node sizes; each level doubles it
+    float morphStartRatio = 0.7f;  // Fraction of a LOD range after which vertices morph to the next level
+    int maxNodes = 1024;           // Hard cap on instanced nodes per frame
+    int occluderResolution = 257;  // Vertices per side of the occlusion mesh over the whole terrain
+};
+
+// Heightfield terrain rendered with CDLOD: a quadtree over the heightmap is
+// walked each frame against the camera's LOD ranges, and every selected node
+// draws the same grid mesh as one instance. Heights are sampled in the vertex
+// shader and vertices morph towards the next coarser grid near the end of
+// their range, so LOD transitions have no cracks or pops. The selected node
+// count depends on the LOD ranges, not on the terrain size. The heights
+// themselves come from a Heightfield the simulation may share.
+class Terrain {
+public:
+    // The heightfield is read once here; it must not change afterwards
+    Terrain(std::shared_ptr<const Heightfield> heightfield, const TerrainSettings& settings = TerrainSettings());
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    // CPU height queries in world space go here; safe from any thread
+    const std::shared_ptr<const Heightfield>& GetHeightfield() const { return heightfield; }
+
+    void Draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+
+    // Coarse grid within `radius` of `center` for OcclusionCuller. Each vertex
+    // takes the lowest height around it, so the mesh stays under the drawn
+    // surface at every LOD that is not coarser than the grid.
+    void BuildOccluder(const glm::vec3& center, float radius, OccluderMesh& out) const;
+
+    const TerrainSettings& GetSettings() const { return settings; }
+    int GetDrawnNodeCount() const { return static_cast<int>(nodes.size()); }
+    int64_t GetTriangleCount() const { return static_cast<int64_t>(nodes.size()) * settings.gridResolution * settings.gridResolution * 2; }
+
+private:
+    struct NodeInstance {
+        glm::vec2 offset;
+        float size;
+        float level;
+    };
+
+    TerrainSettings settings;
+    std::shared_ptr<const Heightfield> heightfield;
+    int resolution;
+    std::vector<std::vector<glm::vec2>> minMax;  // Per level (0 = leaves), min/max height of each node
+    std::vector<float> lodRanges;
+    std::vector<float> occluderHeights;          // occluderResolution^2 conservative heights
+    std::vector<NodeInstance> nodes;
+
+    GLuint heightTexture = 0;
+    GLuint gridVAO = 0, gridVBO = 0, gridEBO = 0, instanceVBO = 0;
+    GLsizei gridIndexCount = 0;
+    int64_t heightTextureBytes = 0, gridVertexBytes = 0, gridIndexBytes = 0, instanceBytes = 0;
+
+    void buildGrid();
+    void buildMinMax();
+    void buildOccluderHeights();
+    void uploadHeights();
+    void selectNode(int level, int nx, int nz, const glm::vec4* planes, const glm::vec3& cameraPos);
+    void addNode(int level, const glm::vec3& boundsMin, float nodeSize);
+    void nodeBounds(int level, int nx, int nz, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+};
@@ -0,0 +1,496 @@
+#include "texture_streamer.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "memory_tracker.h"
+#include "deletion_queue.h"
+#include "../external/stb/stb_image.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// 2x2 box filter; odd edges repeat the last row/column
+std::vector<unsigned char> downsample(const std::vector<unsigned char>& src, int width, int height) {
+    int outWidth = std::max(1, width / 2);
+    int outHeight = std::max(1, height / 2);
+    std::vector<unsigned char> dst(static_cast<size_t>(outWidth) * outHeight * 4);
+
+    for (int y = 0; y < outHeight; y++) {
+        int y0 = std::min(y * 2, height - 1);
+        int y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < outWidth; x++) {
+            int x0 = std::min(x * 2, width - 1);
+            int x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = src[(static_cast<size_t>(y0) * width + x0) * 4 + c] +
+                          src[(static_cast<size_t>(y0) * width + x1) * 4 + c] +
+                          src[(static_cast<size_t>(y1) * width + x0) * 4 + c] +
+                          src[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                dst[(static_cast<size_t>(y) * outWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+int levelWidth(int width, int level) { return std::max(1, width >> level); }
+
+}
+
+TextureStreamer& TextureStreamer::Get() {
+    static TextureStreamer instance;
+    return instance;
+}
+
+TextureLayer TextureStreamer::CreateFromEncoded(const std::string& asset, std::vector<unsigned char>&& encoded) {
+    auto source = std::make_shared<Source>();
+    int channels = 0;
+    if (!stbi_info_from_memory(encoded.data(), static_cast<int>(encoded.size()), &source->width, &source->height, &channels)) {
+        std::cout << "Error: Unsupported image format for streamed texture in " << asset << std::endl;
+        return TextureLayer();
+    }
+    source->encoded = true;
+    source->data = std::move(encoded);
+    return create(asset, source);
+}
+
+TextureLayer TextureStreamer::CreateFromPixels(const std::string& asset, int width, int height, std::vector<unsigned char>&& rgba) {
+    auto source = std::make_shared<Source>();
+    source->encoded = false;
+    source->width = width;
+    source->height = height;
+    source->data = std::move(rgba);
+    return create(asset, source);
+}
+
+TextureLayer TextureStreamer::create(const std::string& asset, std::shared_ptr<Source> source) {
+    if (source->width <= 0 || source->height <= 0) {
+        std::cout << "Invalid image data!" << std::endl;
+        return TextureLayer();
+    }
+
+    uint32_t id = findArray(source->width, source->height);
+    StreamedArray& array = arrays[id];
+    int index = 0;
+    while (array.layers[index].source) {
+        index++;
+    }
+
+    Layer& layer = array.layers[index];
+    layer.asset = asset;
+    layer.source = source;
+    layer.serial = nextSerial++;
+    layer.residentBase = array.lowBase;
+
+    // White placeholder in the always-resident levels until the image is decoded
+    GLState::Get().BindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::vector<unsigned char> white(static_cast<size_t>(levelWidth(array.width, array.lowBase)) *
+                                     levelWidth(array.height, array.lowBase) * 4, 255);
+    for (int level = array.lowBase; level < array.levelCount; level++) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, index, levelWidth(array.width, level),
+                        levelWidth(array.height, level), 1, GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+    }
+    updateBaseLevel(array);
+
+    MemoryTracker::Get().Add(asset, MemoryCategory::Staging, MemoryDomain::CPU, source->data.size());
+    scheduleLoad(id, array, index, array.lowBase, array.levelCount - 1);
+
+    TextureLayer texture;
+    texture.array = id;
+    texture.layer = index;
+    return texture;
+}
+
+uint32_t TextureStreamer::findArray(int width, int height) {
+    static GLint maxLayers = 0;
+    if (maxLayers == 0) {
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    }
+
+    for (auto& entry : arrays) {
+        StreamedArray& array = entry.second;
+        if (array.width != width || array.height != height) {
+            continue;
+        }
+        for (const Layer& layer : array.layers) {
+            if (!layer.source) {
+                return entry.first;
+            }
+        }
+        if (array.capacity * 2 <= maxLayers) {
+            grow(array);
+            return entry.first;
+        }
+    }
+
+    uint32_t id = nextArray++;
+    StreamedArray& array = arrays[id];
+    array.asset = "texture array " + std::to_string(width) + "x" + std::to_string(height);
+    array.width = width;
+    array.height = height;
+    array.levelCount = 1 + static_cast<int>(std::floor(std::log2(std::max(width, height))));
+    array.levelBytes.assign(array.levelCount, 0);
+    array.capacity = 1;
+    array.layers.resize(1);
+
+    array.lowBase = array.levelCount - 1;
+    while (array.lowBase > 0 &&
+           std::max(levelWidth(width, array.lowBase - 1), levelWidth(height, array.lowBase - 1)) <= settings.residentSize) {
+        array.lowBase--;
+    }
+    array.residentBase = array.lowBase;
+    array.wantedBase = array.lowBase;
+
+    array.texture = createArrayTexture(array.levelCount);
+    for (int level = array.lowBase; level < array.levelCount; level++) {
+        allocateLevel(array, level);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.residentBase);
+    return id;
+}
+
+GLuint TextureStreamer::createArrayTexture(int levelCount) {
+    GLuint id;
+    glGenTextures(1, &id);
+    GLState::Get().BindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+    static float maxAniso = -1.0f;
+    if (maxAniso < 0.0f) {
+        maxAniso = 0.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAniso);
+    }
+    if (maxAniso > 0.0f) {
+        glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAniso);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    return id;
+}
+
+void TextureStreamer::grow(StreamedArray& array) {
+    // Layer storage is fixed per level, so growing means a new texture; resident
+    // levels are copied on the GPU, which keeps every layer's handle valid
+    int oldCapacity = array.capacity;
+    GLuint oldTexture = array.texture;
+    int64_t oldBytes = 0;
+    for (int64_t bytes : array.levelBytes) {
+        oldBytes += bytes;
+    }
+
+    array.capacity *= 2;
+    array.layers.resize(array.capacity);
+    array.texture = createArrayTexture(array.levelCount);
+    std::vector<int> allocated;
+    for (int level = 0; level < array.levelCount; level++) {
+        if (array.levelBytes[level] > 0) {
+            array.levelBytes[level] = 0;
+            allocateLevel(array, level);
+            allocated.push_back(level);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.residentBase);
+
+    if (copyFramebuffer == 0) {
+        glGenFramebuffers(1, &copyFramebuffer);
+    }
+    GLState& state = GLState::Get();
+    GLuint previousRead = state.GetFramebuffer(GL_READ_FRAMEBUFFER);
+    state.BindFramebuffer(GL_READ_FRAMEBUFFER, copyFramebuffer);
+    for (int level : allocated) {
+        for (int layer = 0; layer < oldCapacity; layer++) {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, oldTexture, level, layer);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, 0, 0,
+                                levelWidth(array.width, level), levelWidth(array.height, level));
+        }
+    }
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+    state.BindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+
+    residentBytes -= oldBytes;
+    DeletionQueue::Get().DeleteTexture(oldTexture, array.asset, oldBytes);
+}
+
+void TextureStreamer::allocateLevel(StreamedArray& array, int level) {
+    if (array.levelBytes[level] > 0) {
+        return;
+    }
+    int width = levelWidth(array.width, level);
+    int height = levelWidth(array.height, level);
+    GLState::Get().BindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, array.capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    int64_t bytes = static_cast<int64_t>(width) * height * 4 * array.capacity;
+    array.levelBytes[level] = bytes;
+    residentBytes += bytes;
+    MemoryTracker::Get().Add(array.asset, MemoryCategory::Texture, MemoryDomain::GPU, bytes);
+}
+
+void TextureStreamer::Release(const TextureLayer& texture) {
+    auto it = arrays.find(texture.array);
+    if (it == arrays.end() || texture.layer < 0 || texture.layer >= it->second.capacity) {
+        return;
+    }
+
+    StreamedArray& array = it->second;
+    Layer& layer = array.layers[texture.layer];
+    if (!layer.source) {
+        return;
+    }
+    MemoryTracker::Get().Remove(layer.asset, MemoryCategory::Staging, MemoryDomain::CPU, layer.source->data.size());
+    layer = Layer();
+
+    for (const Layer& other : array.layers) {
+        if (other.source) {
+            updateBaseLevel(array);
+            return;
+        }
+    }
+
+    // Last user gone
+    int64_t bytes = 0;
+    for (int64_t levelBytes : array.levelBytes) {
+        bytes += levelBytes;
+    }
+    residentBytes -= bytes;
+    DeletionQueue::Get().DeleteTexture(array.texture, array.asset, bytes);
+    arrays.erase(it);
+}
+
+GLuint TextureStreamer::GetTexture(uint32_t array) const {
+    auto it = arrays.find(array);
+    return it != arrays.end() ? it->second.texture : 0;
+}
+
+void TextureStreamer::RequestLevel(const TextureLayer& texture, int level) {
+    auto it = arrays.find(texture.array);
+    if (it == arrays.end()) {
+        return;
+    }
+
+    StreamedArray& array = it->second;
+    level = std::min(std::max(level, 0), array.lowBase);
+    if (array.lastUsedFrame != frame) {
+        array.wantedBase = level;
+        array.lastUsedFrame = frame;
+    } else {
+        array.wantedBase = std::min(array.wantedBase, level);
+    }
+}
+
+int TextureStreamer::LevelForScreenSize(const TextureLayer& texture, float projectedPixels) const {
+    auto it = arrays.find(texture.array);
+    if (it == arrays.end()) {
+        return 0;
+    }
+
+    const StreamedArray& array = it->second;
+    if (projectedPixels <= 1.0f) {
+        return array.levelCount - 1;
+    }
+    float size = static_cast<float>(std::max(array.width, array.height));
+    int level = static_cast<int>(std::floor(std::log2(size / projectedPixels)));
+    return std::min(std::max(level, 0), array.levelCount - 1);
+}
+
+bool TextureStreamer::IsLevelResident(const TextureLayer& texture, int level) const {
+    auto it = arrays.find(texture.array);
+    if (it == arrays.end()) {
+        return true;
+    }
+    const StreamedArray& array = it->second;
+    return array.residentBase <= std::min(std::max(level, 0), array.lowBase);
+}
+
+void TextureStreamer::scheduleLoad(uint32_t id, StreamedArray& array, int layer, int firstLevel, int lastLevel) {
+    array.layers[layer].loading = true;
+    std::shared_ptr<const Source> source = array.layers[layer].source;
+    uint32_t serial = array.layers[layer].serial;
+
+    JobSystem::Get().Submit([this, id, layer, serial, source, firstLevel, lastLevel] {
+        int width = source->width;
+        int height = source->height;
+        std::vector<unsigned char> pixels;
+
+        if (source->encoded) {
+            int decodedWidth, decodedHeight, channels;
+            unsigned char* decoded = stbi_load_from_memory(source->data.data(), static_cast<int>(source->data.size()),
+                                                           &decodedWidth, &decodedHeight, &channels, STBI_rgb_alpha);
+            if (decoded) {
+                pixels.assign(decoded, decoded + static_cast<size_t>(width) * height * 4);
+                stbi_image_free(decoded);
+            }
+        } else {
+            pixels = source->data;
+        }
+
+        std::vector<ReadyMip> levels;
+        if (!pixels.empty()) {
+            // Build the chain down from level 0 and keep the requested range, coarsest first
+            for (int level = 0; level <= lastLevel; level++) {
+                if (level >= firstLevel) {
+                    levels.push_back({id, layer, serial, level, width, height, pixels, false});
+                }
+                if (level < lastLevel) {
+                    pixels = downsample(pixels, width, height);
+                    width = std::max(1, width / 2);
+                    height = std::max(1, height / 2);
+                }
+            }
+            std::reverse(levels.begin(), levels.end());
+            levels.back().lastInBatch = true;
+        } else {
+            levels.push_back({id, layer, serial, -1, 0, 0, {}, true});  // Decode failed; just clear the loading flag
+        }
+
+        std::lock_guard<std::mutex> lock(readyMutex);
+        for (auto& level : levels) {
+            ready.push_back(std::move(level));
+        }
+    });
+}
+
+void TextureStreamer::uploadLevel(StreamedArray& array, int layer, int level, int width, int height, const unsigned char* pixels) {
+    allocateLevel(array, level);
+    GLState::Get().BindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    Layer& target = array.layers[layer];
+    if (level == target.residentBase - 1) {
+        target.residentBase = level;
+        updateBaseLevel(array);
+    }
+}
+
+void TextureStreamer::updateBaseLevel(StreamedArray& array) {
+    // A level is only sampled once every layer holds it
+    int base = -1;
+    for (const Layer& layer : array.layers) {
+        if (layer.source) {
+            base = std::max(base, layer.residentBase);
+        }
+    }
+    if (base < 0 || base == array.residentBase) {
+        return;
+    }
+    array.residentBase = base;
+    GLState::Get().BindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.residentBase);
+}
+
+void TextureStreamer::dropFinestLevel(StreamedArray& array) {
+    int level = array.residentBase;
+    if (level >= array.lowBase) {
+        return;
+    }
+
+    array.residentBase++;
+    for (Layer& layer : array.layers) {
+        layer.residentBase = std::max(layer.residentBase, array.residentBase);
+    }
+    GLState::Get().BindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.residentBase);
+
+    // Redefine the level, and any finer ones layers had already loaded, as empty so the driver can release them
+    for (int finer = 0; finer <= level; finer++) {
+        if (array.levelBytes[finer] == 0) {
+            continue;
+        }
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, finer, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        residentBytes -= array.levelBytes[finer];
+        MemoryTracker::Get().Remove(array.asset, MemoryCategory::Texture, MemoryDomain::GPU, array.levelBytes[finer]);
+        array.levelBytes[finer] = 0;
+    }
+}
+
+void TextureStreamer::evictToBudget() {
+    while (residentBytes > settings.budgetBytes) {
+        // Least recently used array that still has detail above its always-resident mips
+        StreamedArray* victim = nullptr;
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (auto& entry : arrays) {
+            StreamedArray& array = entry.second;
+            if (array.residentBase < array.lowBase && array.lastUsedFrame < frame && array.lastUsedFrame < oldest) {
+                oldest = array.lastUsedFrame;
+                victim = &array;
+            }
+        }
+        if (!victim) {
+            return;  // Everything over budget is in use this frame
+        }
+        dropFinestLevel(*victim);
+    }
+}
+
+void TextureStreamer::Update() {
+    // Apply finished mips, finest level last so residency only ever grows contiguously
+    std::vector<ReadyMip> applied;
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        size_t count = 0;
+        size_t limit = static_cast<size_t>(settings.maxUploadsPerFrame);
+        while (count < ready.size() && (count < limit || ready[count].level < 0)) {
+            count++;
+        }
+        applied.assign(std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.begin() + count));
+        ready.erase(ready.begin(), ready.begin() + count);
+    }
+
+    for (const auto& mip : applied) {
+        auto it = arrays.find(mip.array);
+        if (it == arrays.end() || it->second.layers[mip.layer].serial != mip.serial) {
+            continue;  // Released while the job was in flight
+        }
+        StreamedArray& array = it->second;
+        Layer& layer = array.layers[mip.layer];
+        // Levels that would leave a gap (finer ones were evicted meanwhile) are discarded
+        if (mip.level >= 0 && mip.level >= layer.residentBase - 1) {
+            uploadLevel(array, mip.layer, mip.level, mip.width, mip.height, mip.pixels.data());
+        }
+        if (mip.lastInBatch) {
+            layer.loading = false;
+        }
+    }
+
+    // Arrays nobody asked for in a while no longer want their fine levels
+    for (auto& entry : arrays) {
+        StreamedArray& array = entry.second;
+        if (frame - array.lastUsedFrame > static_cast<uint64_t>(settings.idleFrames)) {
+            array.wantedBase = array.lowBase;
+        }
+    }
+
+    evictToBudget();
+
+    // Schedule loads for arrays that want more detail than they have, within budget
+    for (auto& entry : arrays) {
+        StreamedArray& array = entry.second;
+        if (array.wantedBase >= array.residentBase) {
+            continue;
+        }
+
+        int64_t needed = 0;
+        for (int level = array.wantedBase; level < array.residentBase; level++) {
+            if (array.levelBytes[level] == 0) {
+                needed += static_cast<int64_t>(levelWidth(array.width, level)) * levelWidth(array.height, level) * 4 * array.capacity;
+            }
+        }
+        if (residentBytes + needed > settings.budgetBytes) {
+            continue;
+        }
+        for (int index = 0; index < array.capacity; index++) {
+            Layer& layer = array.layers[index];
+            if (layer.source && !layer.loading && layer.residentBase > array.wantedBase) {
+                scheduleLoad(entry.first, array, index, array.wantedBase, layer.residentBase - 1);
+            }
+        }
+    }
+
+    frame++;
+}
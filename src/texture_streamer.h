@@ -0,0 +1,116 @@
+#pragma once
+#include "material.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#ifdef USE_GLES2
+    #include <GLES2/gl2.h>
+#else
+    #include <GL/glew.h>
+#endif
+
+struct TextureStreamingSettings {
+    int64_t budgetBytes = 256ll * 1024 * 1024;  // GPU bytes for all streamed textures
+    int residentSize = 64;                      // Mips at or below this size are always resident
+    int maxUploadsPerFrame = 4;                 // Mip uploads applied per Update()
+    int idleFrames = 120;                       // Frames without a request before detail may be dropped
+};
+
+// Streams texture mip levels under a GPU memory budget. Images are packed
+// into texture arrays by size, and an array streams as a unit: its layers
+// always share the same resident levels. Arrays start with only their small
+// mips resident; finer levels are decoded on the job system when a draw asks
+// for them, and the least recently used arrays lose their finest levels when
+// the budget is exceeded. Residency is expressed with GL_TEXTURE_BASE_LEVEL,
+// so an array is always complete and samplable.
+class TextureStreamer {
+public:
+    static TextureStreamer& Get();
+
+    // source is either an encoded image (PNG, JPEG) or raw RGBA8 pixels
+    TextureLayer CreateFromEncoded(const std::string& asset, std::vector<unsigned char>&& encoded);
+    TextureLayer CreateFromPixels(const std::string& asset, int width, int height, std::vector<unsigned char>&& rgba);
+    void Release(const TextureLayer& texture);
+
+    // GL name of an array; it changes when the array grows, so look it up when binding
+    GLuint GetTexture(uint32_t array) const;
+
+    // Ask for mip level `level` (0 = full resolution) to be resident this frame
+    void RequestLevel(const TextureLayer& texture, int level);
+    // Finest level worth having for a texture covering projectedPixels on screen
+    int LevelForScreenSize(const TextureLayer& texture, float projectedPixels) const;
+    // True once `level`, or a finer one, is resident; levels below the always-resident set count as resident
+    bool IsLevelResident(const TextureLayer& texture, int level) const;
+
+    // Main thread, once per frame: apply finished mips, evict, schedule loads
+    void Update();
+
+    void SetSettings(const TextureStreamingSettings& newSettings) { settings = newSettings; }
+    int64_t GetResidentBytes() const { return residentBytes; }
+
+private:
+    struct Source {
+        bool encoded;
+        int width, height;
+        std::vector<unsigned char> data;
+    };
+
+    struct Layer {
+        std::string asset;                      // Owner of the source
+        std::shared_ptr<const Source> source;   // Null for a free layer
+        uint32_t serial = 0;                    // Distinguishes reused layers from released ones
+        int residentBase = 0;                   // Finest level holding this layer's image
+        bool loading = false;
+    };
+
+    struct StreamedArray {
+        std::string asset;      // GPU memory is attributed to the array, not its users
+        GLuint texture = 0;
+        int width = 0, height = 0, levelCount = 0;
+        int capacity = 0;       // Allocated layers; doubles when full
+        int lowBase = 0;        // Coarsest set that is always kept
+        int residentBase = 0;   // Finest level resident in every layer
+        int wantedBase = 0;     // Finest level requested recently
+        uint64_t lastUsedFrame = 0;
+        std::vector<Layer> layers;
+        std::vector<int64_t> levelBytes;   // Storage of each level across all layers, 0 if unallocated
+    };
+
+    struct ReadyMip {
+        uint32_t array;
+        int layer;
+        uint32_t serial;
+        int level;
+        int width, height;
+        std::vector<unsigned char> pixels;
+        bool lastInBatch;
+    };
+
+    TextureStreamer() = default;
+
+    TextureStreamingSettings settings;
+    std::unordered_map<uint32_t, StreamedArray> arrays;
+    int64_t residentBytes = 0;
+    uint64_t frame = 0;
+    uint32_t nextArray = 1;
+    uint32_t nextSerial = 1;
+    GLuint copyFramebuffer = 0;
+
+    std::mutex readyMutex;
+    std::vector<ReadyMip> ready;
+
+    TextureLayer create(const std::string& asset, std::shared_ptr<Source> source);
+    uint32_t findArray(int width, int height);
+    GLuint createArrayTexture(int levelCount);
+    void grow(StreamedArray& array);
+    void allocateLevel(StreamedArray& array, int level);
+    void scheduleLoad(uint32_t id, StreamedArray& array, int layer, int firstLevel, int lastLevel);
+    void uploadLevel(StreamedArray& array, int layer, int level, int width, int height, const unsigned char* pixels);
+    void updateBaseLevel(StreamedArray& array);
+    void dropFinestLevel(StreamedArray& array);
+    void evictToBudget();
+};
@@ -0,0 +1,141 @@
+#include "udp_socket.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+// Winsock needs one WSAStartup per process before the first socket
+bool startNetworking() {
+    static bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+#else
+bool startNetworking() {
+    return true;
+}
+#endif
+
+sockaddr_in toSockaddr(const NetAddress& address) {
+    sockaddr_in result;
+    std::memset(&result, 0, sizeof(result));
+    result.sin_family = AF_INET;
+    result.sin_addr.s_addr = htonl(address.ip);
+    result.sin_port = htons(address.port);
+    return result;
+}
+
+} // namespace
+
+bool NetAddress::Parse(const char* host, uint16_t port, NetAddress& out) {
+    if (std::strcmp(host, "localhost") == 0) {
+        host = "127.0.0.1";
+    }
+    in_addr parsed;
+    if (inet_pton(AF_INET, host, &parsed) != 1) {
+        return false;
+    }
+    out.ip = ntohl(parsed.s_addr);
+    out.port = port;
+    return true;
+}
+
+UdpSocket::~UdpSocket() {
+    Close();
+}
+
+bool UdpSocket::Open(uint16_t port) {
+    Close();
+    if (!startNetworking()) {
+        std::cout << "Failed to start networking" << std::endl;
+        return false;
+    }
+
+    Handle socketHandle = static_cast<Handle>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    if (socketHandle == kInvalidHandle) {
+        std::cout << "Failed to create UDP socket" << std::endl;
+        return false;
+    }
+    handle = socketHandle;
+
+    NetAddress any;
+    any.port = port;
+    sockaddr_in address = toSockaddr(any);
+    if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cout << "Failed to bind UDP port " << port << std::endl;
+        Close();
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    bool ok = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+    bool ok = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    if (!ok) {
+        std::cout << "Failed to make UDP socket non-blocking" << std::endl;
+        Close();
+        return false;
+    }
+
+    sockaddr_in bound;
+    socklen_t length = sizeof(bound);
+    getsockname(handle, reinterpret_cast<sockaddr*>(&bound), &length);
+    boundPort = ntohs(bound.sin_port);
+    return true;
+}
+
+void UdpSocket::Close() {
+    if (handle == kInvalidHandle) {
+        return;
+    }
+#ifdef _WIN32
+    closesocket(handle);
+#else
+    close(handle);
+#endif
+    handle = kInvalidHandle;
+    boundPort = 0;
+}
+
+bool UdpSocket::Send(const NetAddress& to, const void* data, size_t size) {
+    if (handle == kInvalidHandle) {
+        return false;
+    }
+    sockaddr_in address = toSockaddr(to);
+    auto sent = sendto(handle, static_cast<const char*>(data), static_cast<int>(size), 0,
+                       reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    return sent == static_cast<decltype(sent)>(size);
+}
+
+size_t UdpSocket::Receive(NetAddress& from, void* buffer, size_t capacity) {
+    if (handle == kInvalidHandle) {
+        return 0;
+    }
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    auto received = recvfrom(handle, static_cast<char*>(buffer), static_cast<int>(capacity), 0,
+                             reinterpret_cast<sockaddr*>(&address), &length);
+    if (received <= 0) {
+        return 0;   // Nothing waiting, or an ICMP error from a previous send
+    }
+    from.ip = ntohl(address.sin_addr.s_addr);
+    from.port = ntohs(address.sin_port);
+    return static_cast<size_t>(received);
+}
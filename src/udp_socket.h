@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+struct NetAddress {
+    uint32_t ip = 0;      // Host byte order
+    uint16_t port = 0;
+
+    bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+    bool operator!=(const NetAddress& other) const { return !(*this == other); }
+
+    // Dotted IPv4 or "localhost"; false if the host cannot be parsed
+    static bool Parse(const char* host, uint16_t port, NetAddress& out);
+};
+
+// Non-blocking IPv4 datagram socket
+class UdpSocket {
+public:
+    UdpSocket() = default;
+    ~UdpSocket();
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // Port 0 binds an ephemeral port
+    bool Open(uint16_t port = 0);
+    void Close();
+    bool IsOpen() const { return handle != kInvalidHandle; }
+    uint16_t GetPort() const { return boundPort; }
+
+    bool Send(const NetAddress& to, const void* data, size_t size);
+    // Bytes of the next pending datagram, 0 if none is waiting
+    size_t Receive(NetAddress& from, void* buffer, size_t capacity);
+
+private:
+#ifdef _WIN32
+    using Handle = uintptr_t;
+    static constexpr Handle kInvalidHandle = ~static_cast<Handle>(0);
+#else
+    using Handle = int;
+    static constexpr Handle kInvalidHandle = -1;
+#endif
+
+    Handle handle = kInvalidHandle;
+    uint16_t boundPort = 0;
+};
@@ -0,0 +1,315 @@
+#include "world.h"
+#include "job_system.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+ModelHandle World::AddModel(const std::string& name, const char* path) {
+    std::cout << "Adding model: " << name << " from path: " << path << std::endl;
+    return AddModel(name, std::make_unique<ModelData>(path, false));
+}
+
+ModelHandle World::AddModel(const std::string& name, std::unique_ptr<ModelData> model) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    ModelHandle handle = models.Add(name, std::move(model));
+    if (!handle.IsValid()) {
+        return handle;
+    }
+    if (modelTypes.size() <= handle.GetIndex()) {
+        modelTypes.resize(handle.GetIndex() + 1);
+    }
+    modelTypes[handle.GetIndex()] = nextModelType++;
+    return handle;
+}
+
+void World::RemoveModel(ModelHandle model) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    models.Remove(model);
+}
+
+Entity* World::CreateEntity(ModelHandle model, const glm::vec3& position, const glm::vec3& rotation,
+                            const glm::vec3& scale) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    std::lock_guard<std::mutex> stateLock(stateMutex);
+    return createEntity(model, ShaderHandle(), position, rotation, scale);
+}
+
+Entity* World::createEntity(ModelHandle model, ShaderHandle shader, const glm::vec3& position,
+                            const glm::vec3& rotation, const glm::vec3& scale) {
+    const ModelData* source = models.Get(model);
+    if (!source) {
+        std::cout << "Error: Stale model handle for new entity" << std::endl;
+        return nullptr;
+    }
+    EntityHandle handle = entities.Add(std::make_unique<Entity>(model, shader, *source, position, rotation, scale));
+    Entity* entity = entities.Get(handle);
+    if (!entity) {
+        return nullptr;
+    }
+    entity->SetHandle(handle);
+    entity->SetId(nextEntityId++);
+    return entity;
+}
+
+void World::DestroyEntity(EntityHandle handle) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    std::lock_guard<std::mutex> stateLock(stateMutex);
+    Entity* entity = entities.Get(handle);
+    if (!entity) {
+        return;
+    }
+    onDestroyEntity(*entity);
+    if (entity->GetCollider() != kInvalidCollider) {
+        collision.Remove(entity->GetCollider());
+    }
+    auto obstacle = navigationObstacles.find(handle.GetValue());
+    if (obstacle != navigationObstacles.end()) {
+        navigation->RemoveObstacle(obstacle->second);
+        navigationObstacles.erase(obstacle);
+    }
+    movers.erase(std::remove_if(movers.begin(), movers.end(),
+                                [handle](const Mover& mover) { return mover.entity == handle; }),
+                 movers.end());
+    entities.Remove(handle);
+}
+
+ColliderId World::AddBoxCollider(Entity* entity, uint32_t layer, uint32_t mask) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    const ModelData* model = models.Get(entity->GetModel());
+    if (!model) {
+        return kInvalidCollider;
+    }
+    glm::vec3 localCenter = (model->GetBoundsMin() + model->GetBoundsMax()) * 0.5f;
+    glm::vec3 localHalfExtents = (model->GetBoundsMax() - model->GetBoundsMin()) * 0.5f;
+
+    ColliderId id = collision.AddBox(glm::vec3(0.0f), glm::mat3(1.0f), glm::vec3(0.0f), layer, mask, entity);
+    entity->SetCollider(id, localCenter, localHalfExtents);
+    entity->SyncCollider(collision);
+
+    // Static boxes block navigation with their world-space footprint
+    if (navigation && (layer & CollisionLayer::Static)) {
+        glm::mat4 matrix = entity->GetModelMatrix();
+        glm::vec2 footprintMin(std::numeric_limits<float>::max());
+        glm::vec2 footprintMax(-std::numeric_limits<float>::max());
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 local((corner & 1) ? model->GetBoundsMax().x : model->GetBoundsMin().x,
+                            (corner & 2) ? model->GetBoundsMax().y : model->GetBoundsMin().y,
+                            (corner & 4) ? model->GetBoundsMax().z : model->GetBoundsMin().z);
+            glm::vec3 world(matrix * glm::vec4(local, 1.0f));
+            footprintMin = glm::min(footprintMin, glm::vec2(world.x, world.z));
+            footprintMax = glm::max(footprintMax, glm::vec2(world.x, world.z));
+        }
+        navigationObstacles[entity->GetHandle().GetValue()] = navigation->AddObstacle(footprintMin, footprintMax);
+    }
+    return id;
+}
+
+void World::SetNavigation(std::unique_ptr<NavigationGrid> grid) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    navigation = std::move(grid);
+    navigationObstacles.clear();
+    for (Mover& mover : movers) {
+        mover.field = navigation ? navigation->RequestField(mover.order.destination) : nullptr;
+    }
+}
+
+void World::SetHeightfield(std::shared_ptr<const Heightfield> ground) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    heightfield = std::move(ground);
+}
+
+void World::MoveTo(Entity* entity, const MoveOrder& order) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    std::shared_ptr<const FlowField> field = navigation ? navigation->RequestField(order.destination) : nullptr;
+    for (Mover& mover : movers) {
+        if (mover.entity == entity->GetHandle()) {
+            mover.order = order;
+            mover.field = std::move(field);
+            return;
+        }
+    }
+    movers.push_back({ entity->GetHandle(), order, std::move(field) });
+}
+
+void World::Stop(Entity* entity) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    EntityHandle handle = entity->GetHandle();
+    movers.erase(std::remove_if(movers.begin(), movers.end(),
+                                [handle](const Mover& mover) { return mover.entity == handle; }),
+                 movers.end());
+}
+
+bool World::Raycast(const Ray& ray, SceneRayHit& hit, uint32_t layerMask) {
+    RaycastBatch(&ray, &hit, 1, layerMask);
+    return hit.entity != nullptr;
+}
+
+void World::RaycastBatch(const Ray* rays, SceneRayHit* hits, size_t count, uint32_t layerMask) {
+    struct Candidate {
+        Entity* entity;
+        uint32_t ray;
+    };
+
+    // Broadphase: which entities each ray can reach
+    std::vector<Candidate> candidates;
+    std::vector<ColliderId> colliders;
+    for (size_t i = 0; i < count; i++) {
+        hits[i] = SceneRayHit();
+        colliders.clear();
+        collision.QueryRay(rays[i], colliders, layerMask);
+        for (ColliderId id : colliders) {
+            candidates.push_back({ static_cast<Entity*>(collision.GetUserData(id)), static_cast<uint32_t>(i) });
+        }
+    }
+    if (candidates.empty()) {
+        return;
+    }
+
+    // Group by entity so each BVH is walked by packets of rays
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.entity != b.entity ? std::less<Entity*>()(a.entity, b.entity) : a.ray < b.ray;
+    });
+    std::vector<size_t> groupStarts;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (i == 0 || candidates[i].entity != candidates[i - 1].entity) {
+            groupStarts.push_back(i);
+        }
+    }
+    groupStarts.push_back(candidates.size());
+
+    std::vector<RayHit> results(candidates.size());
+    JobSystem::Get().ParallelFor(groupStarts.size() - 1, 1, [&](size_t begin, size_t end) {
+        for (size_t group = begin; group < end; group++) {
+            const Entity* entity = candidates[groupStarts[group]].entity;
+            const ModelData* model = models.Get(entity->GetModel());
+            if (!model || model->GetBVH().Empty()) {
+                continue;
+            }
+            const TriangleBVH& bvh = model->GetBVH();
+            for (size_t first = groupStarts[group]; first < groupStarts[group + 1]; first += 4) {
+                int packetSize = static_cast<int>(std::min<size_t>(4, groupStarts[group + 1] - first));
+                Ray packet[4];
+                for (int lane = 0; lane < packetSize; lane++) {
+                    packet[lane] = entity->ToModelSpace(rays[candidates[first + lane].ray]);
+                }
+                bvh.RaycastPacket(packet, &results[first], packetSize);
+            }
+        }
+    });
+
+    // Keep the closest hit per ray
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const RayHit& result = results[i];
+        SceneRayHit& hit = hits[candidates[i].ray];
+        if (result.Hit() && result.distance < hit.distance) {
+            const Ray& ray = rays[candidates[i].ray];
+            hit.entity = candidates[i].entity;
+            hit.distance = result.distance;
+            hit.point = ray.origin + ray.direction * result.distance;
+            hit.normal = hit.entity->GetWorldNormal(models.Get(hit.entity->GetModel())->GetBVH(), result);
+        }
+    }
+}
+
+void World::Update(float deltaTime) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+
+    updateMovers(deltaTime);
+
+    // Moved entities refresh their colliders, then contacts are rebuilt for this tick
+    for (size_t i = 0; i < entities.Size(); i++) {
+        entities[i].SyncCollider(collision);
+    }
+    collision.Update();
+
+    PublishState();
+}
+
+void World::updateMovers(float deltaTime) {
+    if (navigation) {
+        navigation->Update();
+    }
+    if (movers.empty()) {
+        return;
+    }
+
+    // One field sample per unit, however many share a destination
+    moverArrived.assign(movers.size(), 0);
+    JobSystem::Get().ParallelFor(movers.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Mover& mover = movers[i];
+            const MoveOrder& order = mover.order;
+            Entity* entity = entities.Get(mover.entity);
+            if (!entity) {
+                moverArrived[i] = 1;
+                continue;
+            }
+            Transform transform = entity->GetTransform();
+            glm::vec2 toGoal(order.destination.x - transform.position.x, order.destination.z - transform.position.z);
+            float distance = glm::length(toGoal);
+            if (distance <= order.arrivalRadius) {
+                moverArrived[i] = 1;
+                continue;
+            }
+
+            glm::vec2 direction = toGoal / distance;
+            if (mover.field && !navigation->Sample(*mover.field, transform.position, direction)) {
+                continue;   // Field not computed yet, or no way from here
+            }
+
+            glm::vec3 position = transform.position;
+            float step = std::min(order.speed * deltaTime, distance);
+            position.x += direction.x * step;
+            position.z += direction.y * step;
+            if (heightfield) {
+                position.y = heightfield->GetHeight(position.x, position.z);
+            }
+
+            // Turn the shorter way, keeping the angle continuous for interpolation
+            float heading = order.yawAxis == 2 ? std::atan2(-direction.x, -direction.y)
+                                               : std::atan2(direction.x, direction.y);
+            glm::vec3 rotation = transform.rotation;
+            float& yaw = order.yawAxis == 2 ? rotation.z : rotation.y;
+            float turn = std::remainder(glm::degrees(heading) + order.yawOffset - yaw, 360.0f);
+            float maxTurn = order.turnRate * deltaTime;
+            yaw += std::max(-maxTurn, std::min(maxTurn, turn));
+
+            entity->SetPosition(position);
+            entity->SetRotation(rotation);
+        }
+    });
+
+    size_t kept = 0;
+    for (size_t i = 0; i < movers.size(); i++) {
+        if (!moverArrived[i]) {
+            movers[kept++] = std::move(movers[i]);
+        }
+    }
+    movers.erase(movers.begin() + kept, movers.end());
+}
+
+void World::CaptureReplicatedEntities(std::vector<ReplicatedEntity>& out) {
+    std::lock_guard<std::mutex> simLock(simMutex);
+    out.resize(entities.Size());
+    for (size_t i = 0; i < entities.Size(); i++) {
+        const Transform& transform = entities[i].GetTransform();
+        out[i].id = entities[i].GetId();
+        out[i].type = modelTypes[entities[i].GetModel().GetIndex()];
+        out[i].position = transform.position;
+        out[i].rotation = transform.rotation;
+    }
+}
+
+glm::mat4 World::GetRenderMatrix(EntityHandle handle, float alpha) {
+    std::lock_guard<std::mutex> stateLock(stateMutex);
+    const Entity* entity = entities.Get(handle);
+    return entity ? entity->GetInterpolatedModelMatrix(alpha) : glm::mat4(1.0f);
+}
+
+void World::PublishState() {
+    std::lock_guard<std::mutex> stateLock(stateMutex);
+    for (size_t i = 0; i < entities.Size(); i++) {
+        entities[i].PublishState();
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "entity.h"
+#include "model_data.h"
+#include "heightfield.h"
+#include "collision.h"
+#include "replication.h"
+#include "navigation.h"
+#include "registry.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <mutex>
+#include <limits>
+
+struct SceneRayHit {
+    Entity* entity = nullptr;
+    float distance = std::numeric_limits<float>::max();   // In units of the ray direction
+    glm::vec3 point = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+};
+
+// Where and how an entity drives under World::MoveTo
+struct MoveOrder {
+    glm::vec3 destination = glm::vec3(0.0f);
+    float speed = 8.0f;             // Meters per second
+    float turnRate = 180.0f;        // Degrees per second
+    float arrivalRadius = 2.0f;     // The order ends within this distance of the destination
+    // Euler angle turned to face the direction of travel: 1 (Y) keeps a Y-up model's
+    // +Z forward, 2 (Z) a Z-up model's +Y forward once stood up by -90 degrees about X
+    int yawAxis = 1;
+    float yawOffset = 0.0f;         // Degrees added for models facing another way
+};
+
+// The simulation half of a match: entities, their models' CPU data, collision,
+// ground heights and navigation. Nothing here touches GL, so a dedicated
+// server runs Update() on its own; Scene adds the render resources on top.
+class World {
+public:
+    World() = default;
+    virtual ~World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    // Names are looked up once here; keep the returned handles rather than
+    // resolving names per tick. Loads only what the simulation reads (see ModelData).
+    ModelHandle AddModel(const std::string& name, const char* path);
+    ModelHandle AddModel(const std::string& name, std::unique_ptr<ModelData> model);
+    // Entities still using the model are skipped by ray casts until destroyed
+    void RemoveModel(ModelHandle model);
+    void RemoveModel(const std::string& name) { RemoveModel(FindModel(name)); }
+    bool HasModel(const std::string& name) const { return FindModel(name).IsValid(); }
+    ModelHandle FindModel(const std::string& name) const { return models.Find(name); }
+    // Null for stale handles
+    ModelData* GetModel(ModelHandle model) const { return models.Get(model); }
+
+    // Entity management; entities created here have no shader and are never drawn
+    Entity* CreateEntity(ModelHandle model,
+                        const glm::vec3& position = glm::vec3(0.0f),
+                        const glm::vec3& rotation = glm::vec3(0.0f),
+                        const glm::vec3& scale = glm::vec3(1.0f));
+    // Null once the entity is destroyed
+    Entity* GetEntity(EntityHandle entity) const { return entities.Get(entity); }
+    void DestroyEntity(EntityHandle entity);
+    void DestroyEntity(Entity* entity) { DestroyEntity(entity->GetHandle()); }
+    // Model matrix between the last two published ticks, read under the state lock:
+    // the render thread's view of an entity. Identity for stale handles.
+    glm::mat4 GetRenderMatrix(EntityHandle entity, float alpha = 1.0f);
+
+    // Box collider from the entity's model bounds; removed with the entity
+    ColliderId AddBoxCollider(Entity* entity, uint32_t layer = CollisionLayer::Unit, uint32_t mask = 0xffffffffu);
+    // Only touch from the simulation tick, or while the simulation is not running
+    CollisionWorld& GetCollisionWorld() { return collision; }
+
+    // Hit-scan against the triangles of entities with colliders from AddBoxCollider.
+    // Same threading rules as GetCollisionWorld().
+    bool Raycast(const Ray& ray, SceneRayHit& hit, uint32_t layerMask = 0xffffffffu);
+    // Many rays at once, e.g. every shot fired this tick; rays hitting the same
+    // entity are traced through its BVH together
+    void RaycastBatch(const Ray* rays, SceneRayHit* hits, size_t count, uint32_t layerMask = 0xffffffffu);
+
+    // Network view of every entity for ReplicationServer; types follow AddModel order
+    void CaptureReplicatedEntities(std::vector<ReplicatedEntity>& out);
+
+    // Optional ground that moving entities follow. Shared, so matches on one
+    // host can hold a single copy of the same map.
+    void SetHeightfield(std::shared_ptr<const Heightfield> ground);
+    const Heightfield* GetHeightfield() const { return heightfield.get(); }
+
+    // Optional flow-field navigation for MoveTo. Box colliders on the Static layer
+    // added afterwards block it until their entity is destroyed.
+    void SetNavigation(std::unique_ptr<NavigationGrid> grid);
+    // Same threading rules as GetCollisionWorld()
+    NavigationGrid* GetNavigation() { return navigation.get(); }
+    // Drives the entity over the ground towards the destination every tick, along the
+    // navigation field shared by all orders to the same place, or straight without one
+    void MoveTo(Entity* entity, const MoveOrder& order);
+    void Stop(Entity* entity);
+
+    // One fixed simulation tick; may run on the simulation thread
+    void Update(float deltaTime);
+
+protected:
+    Registry<ModelData> models;
+    Registry<Entity> entities;
+    uint32_t nextEntityId = 1;
+    std::vector<uint16_t> modelTypes;   // By model handle index
+    uint16_t nextModelType = 0;
+
+    std::shared_ptr<const Heightfield> heightfield;
+    CollisionWorld collision;
+
+    // simMutex guards the entity list against ticks; stateMutex guards the published render state
+    std::mutex simMutex;
+    std::mutex stateMutex;
+
+    // Both locks held; checks the model handle only
+    Entity* createEntity(ModelHandle model, ShaderHandle shader, const glm::vec3& position,
+                         const glm::vec3& rotation, const glm::vec3& scale);
+    // Both locks held, before the entity is removed
+    virtual void onDestroyEntity(Entity&) {}
+
+private:
+    struct Mover {
+        EntityHandle entity;
+        MoveOrder order;
+        std::shared_ptr<const FlowField> field;   // Null when driving straight
+    };
+    std::unique_ptr<NavigationGrid> navigation;
+    std::vector<Mover> movers;
+    std::vector<uint8_t> moverArrived;
+    std::unordered_map<uint32_t, ObstacleId> navigationObstacles;   // By entity handle value
+
+    void PublishState();
+    void updateMovers(float deltaTime);
+};
@@ -0,0 +1,243 @@
+#include "world_partition.h"
+#include "job_system.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+WorldPartition::WorldPartition(Scene& scene, const WorldStreamingSettings& settings)
+    : scene(scene), settings(settings), parseResults(std::make_shared<ParseResults>()) {
+}
+
+WorldPartition::~WorldPartition() {
+    for (auto& entry : cells) {
+        unload(entry.second);
+    }
+}
+
+bool WorldPartition::LoadManifest(const char* path) {
+    std::ifstream file(path);
+    if (!file.good()) {
+        std::cout << "Error: Cannot find world manifest at: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream stream(line);
+        std::string keyword;
+        if (!(stream >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        if (keyword == "cellsize") {
+            stream >> settings.cellSize;
+        } else if (keyword == "place") {
+            EntityPlacement placement;
+            stream >> placement.modelPath >> placement.shaderName
+                   >> placement.position.x >> placement.position.y >> placement.position.z;
+            if (stream.fail()) {
+                std::cout << "Error: Bad placement on line " << lineNumber << " of " << path << std::endl;
+                continue;
+            }
+            // Rotation and scale are optional
+            if (stream >> placement.rotation.x >> placement.rotation.y >> placement.rotation.z) {
+                if (!(stream >> placement.scale.x >> placement.scale.y >> placement.scale.z)) {
+                    placement.scale = glm::vec3(1.0f);
+                }
+            } else {
+                placement.rotation = glm::vec3(0.0f);
+            }
+            AddPlacement(placement);
+        } else {
+            std::cout << "Warning: Unknown keyword '" << keyword << "' on line " << lineNumber << " of " << path << std::endl;
+        }
+    }
+
+    std::cout << "World manifest " << path << ": " << cells.size() << " cells" << std::endl;
+    return true;
+}
+
+void WorldPartition::AddPlacement(const EntityPlacement& placement) {
+    Cell& cell = cells[cellFor(placement.position)];
+    cell.placements.push_back(placement);
+    if (std::find(cell.models.begin(), cell.models.end(), placement.modelPath) == cell.models.end()) {
+        cell.models.push_back(placement.modelPath);
+    }
+}
+
+WorldPartition::CellKey WorldPartition::cellFor(const glm::vec3& position) const {
+    return CellKey(static_cast<int>(std::floor(position.x / settings.cellSize)),
+                   static_cast<int>(std::floor(position.z / settings.cellSize)));
+}
+
+glm::vec3 WorldPartition::cellCenter(const CellKey& key) const {
+    return glm::vec3((key.first + 0.5f) * settings.cellSize, 0.0f, (key.second + 0.5f) * settings.cellSize);
+}
+
+size_t WorldPartition::GetLoadedCellCount() const {
+    size_t count = 0;
+    for (const auto& entry : cells) {
+        if (entry.second.state == CellState::Loaded) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void WorldPartition::Update(const glm::vec3& cameraPosition) {
+    glm::vec2 camera(cameraPosition.x, cameraPosition.z);
+
+    // Hysteresis: load inside loadRadius, unload outside unloadRadius
+    for (auto& entry : cells) {
+        glm::vec3 center = cellCenter(entry.first);
+        float distance = glm::length(glm::vec2(center.x, center.z) - camera);
+        Cell& cell = entry.second;
+
+        if (cell.state == CellState::Unloaded && distance < settings.loadRadius) {
+            beginLoad(cell);
+        } else if (cell.state != CellState::Unloaded && distance > settings.unloadRadius) {
+            unload(cell);
+        }
+    }
+
+    processUploads();
+    finishCells();
+}
+
+void WorldPartition::beginLoad(Cell& cell) {
+    cell.state = CellState::Loading;
+    for (const auto& path : cell.models) {
+        acquireModel(path);
+    }
+}
+
+void WorldPartition::unload(Cell& cell) {
+    if (cell.state == CellState::Unloaded) {
+        return;
+    }
+    for (EntityHandle entity : cell.entities) {
+        scene.DestroyEntity(entity);
+    }
+    cell.entities.clear();
+    cell.nextPlacement = 0;
+    for (const auto& path : cell.models) {
+        releaseModel(path);
+    }
+    cell.state = CellState::Unloaded;
+}
+
+void WorldPartition::acquireModel(const std::string& path) {
+    ModelSlot& slot = modelSlots[path];
+    slot.refCount++;
+    if (slot.inScene || slot.parsing) {
+        return;
+    }
+
+    slot.parsing = true;
+    std::shared_ptr<ParseResults> results = parseResults;
+    JobSystem::Get().Submit([results, path] {
+        // Parse only; GL objects are created later on the GL thread. Placed props are
+        // static, and the scene's batching needs their CPU geometry after upload.
+        auto model = std::make_unique<Model>(path.c_str(), true, false);
+        std::lock_guard<std::mutex> lock(results->mutex);
+        results->models.emplace_back(path, std::move(model));
+    });
+}
+
+void WorldPartition::releaseModel(const std::string& path) {
+    auto it = modelSlots.find(path);
+    if (it == modelSlots.end()) {
+        return;
+    }
+    ModelSlot& slot = it->second;
+    if (--slot.refCount > 0) {
+        return;
+    }
+
+    if (slot.inScene) {
+        scene.RemoveModel(path);
+        slot.inScene = false;
+    }
+    // A parse still in flight is dropped when it arrives
+    if (!slot.parsing) {
+        modelSlots.erase(it);
+    }
+}
+
+void WorldPartition::processUploads() {
+    {
+        std::lock_guard<std::mutex> lock(parseResults->mutex);
+        for (auto& result : parseResults->models) {
+            uploadQueue.push_back(std::move(result));
+        }
+        parseResults->models.clear();
+    }
+
+    // Always upload at least one model so a single large asset cannot stall streaming
+    size_t uploadedBytes = 0;
+    while (!uploadQueue.empty() && (uploadedBytes == 0 || uploadedBytes < settings.uploadBytesPerFrame)) {
+        std::string path = std::move(uploadQueue.front().first);
+        std::unique_ptr<Model> model = std::move(uploadQueue.front().second);
+        uploadQueue.pop_front();
+
+        auto it = modelSlots.find(path);
+        if (it == modelSlots.end()) {
+            continue;
+        }
+        ModelSlot& slot = it->second;
+        slot.parsing = false;
+        if (slot.refCount <= 0) {
+            modelSlots.erase(it);  // Every cell that wanted it has been unloaded
+            continue;
+        }
+
+        uploadedBytes += std::max<size_t>(model->GetPendingUploadBytes(), 1);
+        model->Upload();
+        scene.AddModel(path, std::move(model));
+        slot.inScene = true;
+    }
+}
+
+void WorldPartition::finishCells() {
+    size_t created = 0;
+    for (auto& entry : cells) {
+        Cell& cell = entry.second;
+        if (cell.state != CellState::Loading) {
+            continue;
+        }
+
+        bool ready = std::all_of(cell.models.begin(), cell.models.end(), [this](const std::string& path) {
+            auto it = modelSlots.find(path);
+            return it != modelSlots.end() && it->second.inScene;
+        });
+        if (!ready) {
+            continue;
+        }
+
+        // Spread entity creation over frames as well
+        while (cell.nextPlacement < cell.placements.size() && created < settings.entitiesPerFrame) {
+            const EntityPlacement& placement = cell.placements[cell.nextPlacement++];
+            // With terrain, placement heights are relative to the ground
+            glm::vec3 position = placement.position;
+            if (const Heightfield* ground = scene.GetHeightfield()) {
+                position.y += ground->GetHeight(position.x, position.z);
+            }
+            Entity* entity = scene.CreateEntity(placement.modelPath, placement.shaderName,
+                                                position, placement.rotation, placement.scale);
+            if (entity) {
+                scene.SetStatic(entity, true);
+                // Static layer: scenery also blocks navigation
+                scene.AddBoxCollider(entity, CollisionLayer::Static);
+                cell.entities.push_back(entity->GetHandle());
+            }
+            created++;
+        }
+        if (cell.nextPlacement == cell.placements.size()) {
+            cell.state = CellState::Loaded;
+        }
+    }
+}
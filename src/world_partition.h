@@ -0,0 +1,87 @@
+#pragma once
+#include "scene.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <utility>
+
+struct EntityPlacement {
+    std::string modelPath;
+    std::string shaderName;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+struct WorldStreamingSettings {
+    float cellSize = 50.0f;
+    float loadRadius = 100.0f;              // Cells whose center is closer than this start loading
+    float unloadRadius = 150.0f;            // ...and are only unloaded once further than this
+    size_t uploadBytesPerFrame = 4 << 20;   // GPU upload budget per Update()
+    size_t entitiesPerFrame = 64;           // Entity creations per Update()
+};
+
+// Splits the world into a grid of cells on the XZ plane. Cells around the
+// camera are loaded asynchronously: models are parsed on the job system and
+// uploaded on the GL thread under a per-frame budget, then the cell's entities
+// are created in the Scene as static scenery. Cells beyond the unload radius are removed again.
+class WorldPartition {
+public:
+    WorldPartition(Scene& scene, const WorldStreamingSettings& settings = WorldStreamingSettings());
+    ~WorldPartition();
+
+    // Text manifest: "cellsize <size>" and "place <model> <shader> x y z [rx ry rz [sx sy sz]]"
+    bool LoadManifest(const char* path);
+    void AddPlacement(const EntityPlacement& placement);
+
+    // GL thread, once per frame
+    void Update(const glm::vec3& cameraPosition);
+
+    size_t GetLoadedCellCount() const;
+    size_t GetCellCount() const { return cells.size(); }
+
+private:
+    enum class CellState { Unloaded, Loading, Loaded };
+
+    struct Cell {
+        std::vector<EntityPlacement> placements;
+        std::vector<std::string> models;   // Unique model paths used by the placements
+        std::vector<EntityHandle> entities;   // Stale once destroyed elsewhere; unload skips those
+        size_t nextPlacement = 0;
+        CellState state = CellState::Unloaded;
+    };
+
+    struct ModelSlot {
+        int refCount = 0;
+        bool parsing = false;
+        bool inScene = false;
+    };
+
+    // Shared with parse jobs so results can arrive after the partition is gone
+    struct ParseResults {
+        std::mutex mutex;
+        std::vector<std::pair<std::string, std::unique_ptr<Model>>> models;
+    };
+
+    using CellKey = std::pair<int, int>;
+
+    Scene& scene;
+    WorldStreamingSettings settings;
+    std::map<CellKey, Cell> cells;
+    std::unordered_map<std::string, ModelSlot> modelSlots;
+    std::shared_ptr<ParseResults> parseResults;
+    std::deque<std::pair<std::string, std::unique_ptr<Model>>> uploadQueue;
+
+    CellKey cellFor(const glm::vec3& position) const;
+    glm::vec3 cellCenter(const CellKey& key) const;
+    void beginLoad(Cell& cell);
+    void unload(Cell& cell);
+    void acquireModel(const std::string& path);
+    void releaseModel(const std::string& path);
+    void processUploads();
+    void finishCells();
+};